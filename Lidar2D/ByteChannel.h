@@ -16,4 +16,7 @@ Copyright (c) 2012 Rob Mayoff. All rights reserved.
 
 - (NSData *)readDataUntilTerminator:(char)terminator includingTerminator:(BOOL)includingTerminator withDeadline:(CFAbsoluteTime)deadline;
 
+// I return the bytes I have read from my file descriptor but not yet consumed, and forget them.  Use this when you take over reading my file descriptor yourself, so you don't lose bytes I read ahead.
+- (NSData *)takeBufferedData;
+
 @end
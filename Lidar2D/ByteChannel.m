@@ -58,6 +58,13 @@ static size_t readWithDeadline(int fd, char *buffer, size_t capacity, CFAbsolute
     return data;
 }
 
+- (NSData *)takeBufferedData {
+    NSData *data = [NSData dataWithBytes:buffer_ + readOffset_ length:writeOffset_ - readOffset_];
+    readOffset_ = 0;
+    writeOffset_ = 0;
+    return data;
+}
+
 #pragma mark - Implementation details
 
 - (void)readAndConsumeDataIncludingTerminator:(char)terminator withDeadline:(CFAbsoluteTime)deadline onTerminatorFound:(void (^)(char const *begin, char const *end))terminatorFoundBlock onTerminatorMissing:(void (^)(char const *begin, char const *end))terminatorMissingBlock onError:(void (^)(void))errorBlock {
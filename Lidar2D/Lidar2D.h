@@ -8,6 +8,15 @@ Copyright (c) 2012 Rob Mayoff. All rights reserved.
 
 @protocol Lidar2DObserver;
 
+// When a scan happened, as well as I can tell.
+typedef struct {
+    // The device's timestamp for the scan, in milliseconds on its own clock.  It wraps around at 2^24.
+    NSUInteger sensorTimestamp;
+
+    // When I finished reading the scan from the device, from `CFAbsoluteTimeGetCurrent`, before I hopped to the main queue.
+    CFAbsoluteTime receiveTime;
+} Lidar2DScanTiming;
+
 @interface Lidar2D : NSObject
 
 @property (nonatomic, readonly) NSString *devicePath;
@@ -24,6 +33,11 @@ Copyright (c) 2012 Rob Mayoff. All rights reserved.
 // `YES` if I am fully connected to my device.  While I am connected, the device sends me distance measurements, which I forward to my observers.
 @property (nonatomic, readonly) BOOL isConnected;
 
+// The device can skip scans between the ones it sends, to save the USB link and the host's work, and it can turn its laser off.  I apply these on my background queue, restarting the stream, which takes a few scan periods.  While the laser is off, I send no distance data.  By default, the device sends every scan.
+- (void)setScanSkipCount:(NSUInteger)skipCount laserOn:(BOOL)laserOn;
+@property (nonatomic, readonly) NSUInteger scanSkipCount; // at most 9
+@property (nonatomic, readonly) BOOL laserOn;
+
 - (void)addObserver:(id<Lidar2DObserver>)observer;
 - (void)removeObserver:(id<Lidar2DObserver>)observer;
 
@@ -33,12 +47,22 @@ Copyright (c) 2012 Rob Mayoff. All rights reserved.
 // The number of distinct angles at which the device measures distance.  The distances are equally-spaced around the arc of coverage.  Only valid after `isConnected` becomes true.
 @property (nonatomic, readonly) NSUInteger rayCount;
 
-// The size of the arc of coverage, in degrees.  The individual distances are evenly spaced around this arc.  This is the difference between the first distance angle and the last distance angle.  Only valid after `coverageDegrees` becomes true.
+// The size of the arc of coverage, in degrees.  The individual distances are evenly spaced around this arc.  This is `rayCount` times the angle between adjacent rays, so each ray owns an equal slice of the arc.  Only valid after `isConnected` becomes true.
 @property (nonatomic, readonly) double coverageDegrees;
 
 // The offset in degrees of the first ray from horizontal to the right.
 @property (nonatomic, readonly) double firstRayOffsetDegrees;
 
+// The index of the ray that points straight out the front of the device.  Only valid after `isConnected` becomes true.
+@property (nonatomic, readonly) NSUInteger frontRayIndex;
+
+// The number of scans the device sends per second.  Only valid after `isConnected` becomes true.
+@property (nonatomic, readonly) double scanFrequency;
+
+// The shortest and longest distances, in millimeters, that the device can measure.  I report distances outside this range as `Lidar2DDistance_Invalid`.  Only valid after `isConnected` becomes true.
+@property (nonatomic, readonly) double minimumDistance;
+@property (nonatomic, readonly) double maximumDistance;
+
 @end
 
 @protocol Lidar2DObserver
@@ -60,4 +84,7 @@ Copyright (c) 2012 Rob Mayoff. All rights reserved.
 // I received distance data from the device.  Use the `NSData+Lidar2D` category to access the distance values.
 - (void)lidar2d:(Lidar2D *)device didReceiveDistanceData:(NSData *)distanceData;
 
+// I send this right after `lidar2d:didReceiveDistanceData:`, with the same data, for observers that care when the scan happened.  Implement one or the other.
+- (void)lidar2d:(Lidar2D *)device didReceiveDistanceData:(NSData *)distanceData timing:(Lidar2DScanTiming)timing;
+
 @end
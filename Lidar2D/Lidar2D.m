@@ -64,6 +64,7 @@ static NSString *dialinDevicePathForIOService(io_service_t service) {
         if (![self startObservingTerminationNotificationsForIOService:service])
             return nil;
         _devicePath = dialinDevicePathForIOService(service);
+        _laserOn = YES;
         queue_ = dispatch_queue_create([[NSString stringWithFormat:@"com.dqd.Lidar2D-%s", _devicePath.fileSystemRepresentation] UTF8String], 0);
         group_ = dispatch_group_create();
         observers_ = [[DqdObserverSet alloc] initWithProtocol:@protocol(Lidar2DObserver)];
@@ -79,6 +80,9 @@ static NSString *dialinDevicePathForIOService(io_service_t service) {
         if (connection_)
             return;
         connection_ = [[Lidar2DConnection alloc] initWithDevicePath:_devicePath delegate:self];
+        if (connection_ && (_scanSkipCount != 0 || !_laserOn)) {
+            [connection_ setSkipScans:_scanSkipCount laserOn:_laserOn];
+        }
         dispatch_group_leave(group_);
         if (connection_) {
             dispatch_sync(dispatch_get_main_queue(), ^{
@@ -102,6 +106,22 @@ static NSString *dialinDevicePathForIOService(io_service_t service) {
     });
 }
 
+@synthesize scanSkipCount = _scanSkipCount;
+@synthesize laserOn = _laserOn;
+
+- (void)setScanSkipCount:(NSUInteger)skipCount laserOn:(BOOL)laserOn {
+    skipCount = MIN(skipCount, (NSUInteger)9);
+    if (skipCount == _scanSkipCount && laserOn == _laserOn)
+        return;
+    _scanSkipCount = skipCount;
+    _laserOn = laserOn;
+    dispatch_group_enter(group_);
+    dispatch_async(queue_, ^{
+        [connection_ setSkipScans:skipCount laserOn:laserOn];
+        dispatch_group_leave(group_);
+    });
+}
+
 - (BOOL)isBusy {
     return dispatch_group_wait(group_, DISPATCH_TIME_NOW) != 0;
 }
@@ -134,6 +154,22 @@ static NSString *dialinDevicePathForIOService(io_service_t service) {
     return connection_.firstRayOffsetDegrees;
 }
 
+- (NSUInteger)frontRayIndex {
+    return connection_.frontRayIndex;
+}
+
+- (double)scanFrequency {
+    return connection_.scanFrequency;
+}
+
+- (double)minimumDistance {
+    return connection_.minimumDistance;
+}
+
+- (double)maximumDistance {
+    return connection_.maximumDistance;
+}
+
 #pragma mark - Lidar2DConnectionDelegate protocol
 
 - (void)connection:(Lidar2DConnection *)connection didFailWithError:(NSError *)error {
@@ -143,10 +179,11 @@ static NSString *dialinDevicePathForIOService(io_service_t service) {
     });
 }
 
-- (void)connection:(Lidar2DConnection *)connection didReceiveDistanceData:(NSData *)distanceData {
+- (void)connection:(Lidar2DConnection *)connection didReceiveDistanceData:(NSData *)distanceData timing:(Lidar2DScanTiming)timing {
     (void)connection;
     dispatch_async(dispatch_get_main_queue(), ^{
         [observers_.proxy lidar2d:self didReceiveDistanceData:distanceData];
+        [observers_.proxy lidar2d:self didReceiveDistanceData:distanceData timing:timing];
     });
 }
 
@@ -7,6 +7,7 @@
 //
 
 #import <Foundation/Foundation.h>
+#import "Lidar2D.h"
 #import "Lidar2DAncillary.h"
 
 @protocol Lidar2DConnectionDelegate;
@@ -23,10 +24,18 @@
 // I tell `device` to stop streaming distances and close the device.  I block until I am finished closing the device.
 - (void)disconnect;
 
+// I restart streaming so the device skips `skipScans` scans (at most 9) between the ones it sends, or, if `laserOn` is NO, stop streaming, which turns the device's laser off.  I block until the device has answered.
+- (BOOL)setSkipScans:(NSUInteger)skipScans laserOn:(BOOL)laserOn;
+
+// These are only valid after I have read the device's specifications (the PP response) during initialization.
 @property (nonatomic, readonly) NSString *serialNumber;
 @property (nonatomic, readonly) NSUInteger rayCount;
 @property (nonatomic, readonly) double coverageDegrees;
 @property (nonatomic, readonly) double firstRayOffsetDegrees;
+@property (nonatomic, readonly) NSUInteger frontRayIndex;
+@property (nonatomic, readonly) double scanFrequency;
+@property (nonatomic, readonly) double minimumDistance;
+@property (nonatomic, readonly) double maximumDistance;
 
 @end
 
@@ -34,7 +43,7 @@
 
 // I can send these on a private queue.  You must forward them to the main queue yourself.
 - (void)connection:(Lidar2DConnection *)connection didFailWithError:(NSError *)error;
-- (void)connection:(Lidar2DConnection *)connection didReceiveDistanceData:(NSData *)distanceData;
+- (void)connection:(Lidar2DConnection *)connection didReceiveDistanceData:(NSData *)distanceData timing:(Lidar2DScanTiming)timing;
 
 @end
 
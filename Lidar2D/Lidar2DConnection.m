@@ -7,17 +7,13 @@
 //
 
 #import "Lidar2DConnection.h"
+#import "Lidar2DReactor.h"
 #import "SCIP20Channel.h"
 #import "ByteChannel.h"
 #import "NSData+Lidar2D.h"
+#import <poll.h>
 #import <termios.h>
 
-// Hardcoded for UTM-30LX
-static NSUInteger const kFirstRayStep = 0;
-static NSUInteger const kLastRayStep = 1080;
-static double const kCoverageDegrees = 270.25;
-static double const kFirstRayOffsetDegrees = -45.125;
-
 NSString *const Lidar2DErrorDomain = @"Lidar2DErrorDomain";
 NSString *const Lidar2DErrorStatusKey = @"status";
 NSString *const Lidar2DErrorExpectedStatusKey = @"expectedStatus";
@@ -27,12 +23,37 @@ static NSString *const SCIP20Status_StreamingData = @"99";
 static int const kWriteTimeoutInMilliseconds = 1000;
 static int const kReadTimeoutInMilliseconds = 1000;
 
+// The MD command's largest skip count.
+enum { kMaximumSkipScans = 9 };
+
+// When I reset the device, I discard incoming bytes until the line has been quiet for long enough that the device can't still be streaming.  A device left streaming by an earlier connection can send as few as one scan every `kMaximumSkipScans + 1` scan periods, and the slowest devices scan every 100 ms, so after QT I wait for quiet a little longer than that, `kStreamingDrainIdleInterval`.  The device only echoes QT's reply once it has stopped streaming, so when I see the whole reply I only wait `kDrainIdleInterval`, which is long enough for the end of a reply.  After RS the device isn't streaming, so that's all I wait for then, too.  I give up waiting for quiet after `kDrainTimeout`.
+static CFTimeInterval const kStreamingDrainIdleInterval = 0.1 * (kMaximumSkipScans + 1) + 0.05;
+static CFTimeInterval const kDrainIdleInterval = 0.05;
+static CFTimeInterval const kDrainTimeout = 3;
+
+// After a reset, the device refuses to stream (with status "0J") until its motor and laser are stable.  I retry with exponential backoff, starting at `kInitialReadyRetryInterval` and doubling up to `kMaximumReadyRetryInterval`, and give up after `kReadyTimeout`.
+static CFTimeInterval const kInitialReadyRetryInterval = 0.01;
+static CFTimeInterval const kMaximumReadyRetryInterval = 0.32;
+static CFTimeInterval const kReadyTimeout = 20;
+
 @implementation Lidar2DConnection {
-    dispatch_queue_t queue_;  // I run my streaming data reader loop on this queue.
+    dispatch_source_t readSource_; // The shared Lidar2DReactor calls me through this when streaming data arrives.
+    NSData *pendingStreamingData_; // Streaming data my byte channel read before I started using the reactor.
     NSString *devicePath_;
+    ByteChannel *byteChannel_;
     SCIP20Channel *channel_;
     int fd_;
     volatile BOOL wantStreaming_ : 1;
+    NSUInteger skipScans_; // the MD command's skip count: the device sends one scan and then skips this many
+
+    // I get these from the device's PP (specifications) response.  Steps are the device's angular units; `stepsPerRevolution_` of them make a full circle.
+    NSUInteger firstRayStep_;
+    NSUInteger lastRayStep_;
+    NSUInteger frontRayStep_;
+    NSUInteger stepsPerRevolution_;
+    NSUInteger scansPerMinute_;
+    SCIP20IntegerDatum minimumDistance_;
+    SCIP20IntegerDatum maximumDistance_;
 }
 
 #pragma mark - Package API
@@ -43,52 +64,106 @@ static int const kReadTimeoutInMilliseconds = 1000;
     if (self = [super init]) {
         devicePath_ = [devicePath copy];
         _delegate = delegate;
-        queue_ = dispatch_queue_create([[NSString stringWithFormat:@"com.dqd.Lidar2DConnection-%s", devicePath.fileSystemRepresentation] UTF8String], 0);
         wantStreaming_ = YES;
         if (![self connect])
             return nil;
-        dispatch_async(queue_, ^{
-            [self q_receiveStreamingData];
-        });
+        [self startReceivingStreamingData];
     }
     return self;
 }
 
 - (void)disconnect {
     wantStreaming_ = NO;
-    // Wait for the background loop to stop.
-    dispatch_sync(queue_, ^{});
+    // Wait for the reactor to stop sending me streaming data.
+    [[Lidar2DReactor sharedReactor] removeReadSource:readSource_];
+    readSource_ = NULL;
     [self stopStreamingData];
     channel_ = nil;
+    byteChannel_ = nil;
     close(fd_);
     fd_ = -1;
 }
 
+- (BOOL)setSkipScans:(NSUInteger)skipScans laserOn:(BOOL)laserOn {
+    // The device answers a new command in the middle of the stream, so I stop reading the stream and stop streaming before I send MD again.
+    wantStreaming_ = NO;
+    [[Lidar2DReactor sharedReactor] removeReadSource:readSource_];
+    readSource_ = NULL;
+    [self stopStreamingData];
+    skipScans_ = MIN(skipScans, (NSUInteger)kMaximumSkipScans);
+    if (!laserOn)
+        return YES;
+    CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+    if (![self startStreaming])
+        return NO;
+    [self startReceivingStreamingData];
+    NSLog(@"%@: streaming with skip count %lu after %.1f ms", devicePath_, (unsigned long)skipScans_, 1000 * (CFAbsoluteTimeGetCurrent() - startTime));
+    return YES;
+}
+
 @synthesize serialNumber = _serialNumber;
 
 - (NSUInteger)rayCount {
-    return kLastRayStep - kFirstRayStep + 1;
+    return lastRayStep_ - firstRayStep_ + 1;
 }
 
 - (double)coverageDegrees {
-    return kCoverageDegrees;
+    return self.rayCount * [self degreesPerStep];
 }
 
 - (double)firstRayOffsetDegrees {
-    return kFirstRayOffsetDegrees;
+    // The front ray points straight up.  I measure to the middle of the first ray's slice of the arc.
+    return 90 - (frontRayStep_ - firstRayStep_ + 0.5) * [self degreesPerStep];
+}
+
+- (NSUInteger)frontRayIndex {
+    return frontRayStep_ - firstRayStep_;
+}
+
+- (double)scanFrequency {
+    return scansPerMinute_ / 60.0;
+}
+
+- (double)minimumDistance {
+    return minimumDistance_;
+}
+
+- (double)maximumDistance {
+    return maximumDistance_;
 }
 
 #pragma mark - Connection details
 
+// I connect in phases and log how long each phase takes, so it's easy to see where reconnect time goes.
 - (BOOL)connect {
-    return YES
-    && [self openFile]
-    && [self configureTerminalSettings]
-    && [self resetDevice]
-    && [self initSCIP20Channel]
-//    && [self setHighSensitivityMode]
-    && [self readDeviceDictionaries]
-    && [self startStreaming];
+    CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+    BOOL ok = YES
+    && [self runConnectionPhase:@"open" block:^{
+        return (BOOL)(YES
+        && [self openFile]
+        && [self configureTerminalSettings]);
+    }]
+    && [self runConnectionPhase:@"reset" block:^{
+        return [self resetDevice];
+    }]
+    && [self runConnectionPhase:@"identify" block:^{
+        return (BOOL)(YES
+        && [self initSCIP20Channel]
+//        && [self setHighSensitivityMode]
+        && [self readDeviceDictionaries]);
+    }]
+    && [self runConnectionPhase:@"start streaming" block:^{
+        return [self startStreaming];
+    }];
+    NSLog(@"%@: connecting %@ after %.1f ms", devicePath_, ok ? @"succeeded" : @"failed", 1000 * (CFAbsoluteTimeGetCurrent() - startTime));
+    return ok;
+}
+
+- (BOOL)runConnectionPhase:(NSString *)name block:(BOOL (^)(void))block {
+    CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+    BOOL ok = block();
+    NSLog(@"%@: connection phase \"%@\" %@ after %.1f ms", devicePath_, name, ok ? @"finished" : @"failed", 1000 * (CFAbsoluteTimeGetCurrent() - startTime));
+    return ok;
 }
 
 - (BOOL)openFile {
@@ -126,25 +201,60 @@ static int const kReadTimeoutInMilliseconds = 1000;
 
 - (BOOL)resetDevice {
     // I don't do this through the SCIP20Channel because I don't want SCIP20Channel to have to deal with starting up in the middle of a streaming data packet.
-    [self writeCommandAndFlushIncomingBytes:"QT\n"];
-    [self writeCommandAndFlushIncomingBytes:"RS\n"];
-    return YES;
+    // A streaming packet's lines are either full, or its last line, followed by an empty line, so a short line followed by another line can only be QT's reply.
+    return YES
+    && [self writeCommandAndDrainUntilIdle:"QT\n" reply:"\nQT\n00P\n\n" idleInterval:kStreamingDrainIdleInterval]
+    && [self writeCommandAndDrainUntilIdle:"RS\n" reply:NULL idleInterval:kDrainIdleInterval];
 }
 
-- (void)writeCommandAndFlushIncomingBytes:(char const *)command {
-    write(fd_, command, strlen(command));
-    static char buffer[4096]; // I don't need what I read so it doesn't matter if it's clobbered.
-    for (int i = 0; i < 4; ++i) {
-        usleep(100000); // Allow some time for data to arrive.
-        while (read(fd_, buffer, sizeof buffer) > 0) {
-            // nothing
+// I send `command` and then discard incoming bytes until none have arrived for `idleInterval`, or for `kDrainIdleInterval` once I've drained `reply`.  I return NO only if I couldn't send the command or the device vanished.  If the line never goes quiet, I log it and return YES anyway, because the SCIP20Channel will report any desynchronization.
+- (BOOL)writeCommandAndDrainUntilIdle:(char const *)command reply:(char const *)reply idleInterval:(CFTimeInterval)idleInterval {
+    if (write(fd_, command, strlen(command)) < 0)
+        return [self reportPosixErrorWithAction:@"resetting the device"];
+
+    // I keep the end of what I've drained in front of the buffer, so I can find a reply that spans two reads.  It starts with a newline because the reply can be the first thing I read.
+    static char buffer[4096 + 16]; // I don't need what I read so it doesn't matter if it's clobbered.
+    size_t const tailCapacity = 16;
+    size_t replyLength = reply ? strlen(reply) : 0;
+    size_t tailLength = 1;
+    buffer[0] = '\n';
+    BOOL sawReply = NO;
+
+    struct pollfd pfd = { .fd = fd_, .events = POLLIN };
+    CFAbsoluteTime deadline = CFAbsoluteTimeGetCurrent() + kDrainTimeout;
+    size_t bytesDrained = 0;
+    while (CFAbsoluteTimeGetCurrent() < deadline) {
+        int idleMilliseconds = (int)((sawReply ? kDrainIdleInterval : idleInterval) * 1000);
+        int rc = poll(&pfd, 1, idleMilliseconds);
+        if (rc == 0)
+            return YES;
+        if (rc < 0) {
+            if (errno == EINTR)
+                continue;
+            return [self reportPosixErrorWithAction:@"waiting for the device to go idle"];
+        }
+        if (pfd.revents & (POLLHUP | POLLERR | POLLNVAL)) {
+            errno = EIO;
+            return [self reportPosixErrorWithAction:@"waiting for the device to go idle"];
+        }
+        ssize_t count;
+        while ((count = read(fd_, buffer + tailLength, sizeof buffer - tailCapacity)) > 0) {
+            bytesDrained += count;
+            size_t length = tailLength + count;
+            if (reply && !sawReply && memmem(buffer, length, reply, replyLength)) {
+                sawReply = YES;
+            }
+            tailLength = MIN(length, tailCapacity);
+            memmove(buffer, buffer + length - tailLength, tailLength);
         }
     }
+    NSLog(@"%@: line still busy %.0f ms after sending %.2s (%zu bytes drained)", devicePath_, kDrainTimeout * 1000, command, bytesDrained);
+    return YES;
 }
 
 - (BOOL)initSCIP20Channel {
-    ByteChannel *byteChannel = [[ByteChannel alloc] initWithFileDescriptor:fd_];
-    channel_ = [[SCIP20Channel alloc] initWithByteChannel:byteChannel];
+    byteChannel_ = [[ByteChannel alloc] initWithFileDescriptor:fd_];
+    channel_ = [[SCIP20Channel alloc] initWithByteChannel:byteChannel_];
     return YES;
 }
 
@@ -161,21 +271,20 @@ static int const kReadTimeoutInMilliseconds = 1000;
 
 - (BOOL)startStreaming {
     wantStreaming_ = YES;
-        NSString *command = [NSString stringWithFormat:@"MD%04lu%04lu00000", (unsigned long)kFirstRayStep, (unsigned long)kLastRayStep];
+    // No clustering, `skipScans_` skipped scans between each scan sent, and no limit on the number of scans.
+    NSString *command = [NSString stringWithFormat:@"MD%04lu%04lu00%01lu00", (unsigned long)firstRayStep_, (unsigned long)lastRayStep_, (unsigned long)skipScans_];
     __block BOOL didSucceed = NO;
     __block BOOL shouldKeepLooping = YES;
-    BOOL isFirstTime = YES;
-    CFAbsoluteTime endTime = CFAbsoluteTimeGetCurrent() + 20;
-    do {
-        if (isFirstTime) {
-            isFirstTime = NO;
-        } else {
-            usleep(250000);
-        }
-        
+    __block NSString *lastStatus = nil;
+    NSUInteger attempts = 0;
+    CFTimeInterval retryInterval = kInitialReadyRetryInterval;
+    CFAbsoluteTime endTime = CFAbsoluteTimeGetCurrent() + kReadyTimeout;
+    while (YES) {
+        ++attempts;
         [channel_ sendCommand:command ignoringSpuriousResponses:NO onEmptyResponse:^(NSString *status) {
             if ([status isEqualToString:@"0J"]) {
                 // Undocumented status code that appears for about 10 seconds when the device is connected.  I assume it means "not ready, try again soon".
+                lastStatus = status;
             } else {
                 shouldKeepLooping = NO;
                 didSucceed = [self checkOKStatus:status];
@@ -185,7 +294,18 @@ static int const kReadTimeoutInMilliseconds = 1000;
             shouldKeepLooping = NO;
             didSucceed = NO;
         }];
-    } while (shouldKeepLooping && CFAbsoluteTimeGetCurrent() < endTime);
+
+        if (!shouldKeepLooping)
+            break;
+        if (CFAbsoluteTimeGetCurrent() + retryInterval >= endTime) {
+            // Report the not-ready status as the failure.
+            [self checkOKStatus:lastStatus];
+            break;
+        }
+        usleep((useconds_t)(retryInterval * 1000000));
+        retryInterval = MIN(2 * retryInterval, kMaximumReadyRetryInterval);
+    }
+    NSLog(@"%@: sent MD %lu time%s", devicePath_, (unsigned long)attempts, attempts == 1 ? "" : "s");
     return didSucceed;
 }
 
@@ -201,34 +321,81 @@ static int const kReadTimeoutInMilliseconds = 1000;
 
 #pragma mark - Streaming data receiver details
 
-static Lidar2DDistance filteredDistanceForInteger(SCIP20IntegerDatum integerDatum) {
-    return (integerDatum < 20 || integerDatum > 5600) ? Lidar2DDistance_Invalid : (Lidar2DDistance)integerDatum;
+static Lidar2DDistance filteredDistanceForInteger(SCIP20IntegerDatum integerDatum, SCIP20IntegerDatum minimum, SCIP20IntegerDatum maximum) {
+    return (integerDatum < minimum || integerDatum > maximum) ? Lidar2DDistance_Invalid : (Lidar2DDistance)integerDatum;
 }
 
-static NSData *distanceDataForIntegerData(NSData *integerData) {
+static NSData *distanceDataForIntegerData(NSData *integerData, SCIP20IntegerDatum minimum, SCIP20IntegerDatum maximum) {
     size_t count = integerData.length / sizeof(SCIP20IntegerDatum);
     Lidar2DDistance distances[count];
     SCIP20IntegerDatum const *integers = integerData.bytes;
     for (size_t i = 0; i < count; ++i) {
-        distances[i] = filteredDistanceForInteger(integers[i]);
+        distances[i] = filteredDistanceForInteger(integers[i], minimum, maximum);
     }
     return [NSData dataWithBytes:distances length:sizeof distances];
 }
 
-- (void)q_receiveStreamingData {
-    while (wantStreaming_) {
-        [channel_ receiveStreamingResponseWithDataEncodingLength:3 onResponse:^(NSString *command, NSString *status, NSUInteger timestamp, NSData *integerData) {
-            (void)command; (void)timestamp;
-            if ([self checkStatus:status isEqualToStatus:SCIP20Status_StreamingData]) {
-                [_delegate connection:self didReceiveDistanceData:distanceDataForIntegerData(integerData)];
-            } else {
-                wantStreaming_ = NO;
-            }
-        } onError:^(NSError *error) {
-            [_delegate connection:self didFailWithError:error];
-            wantStreaming_ = NO;
-        }];
+// Methods whose names start with `r_` run on the shared Lidar2DReactor's queue.
+
+- (void)startReceivingStreamingData {
+    // If I stopped the last stream in the middle of a scan, the channel still has its start, which would swallow the start of this stream.
+    [channel_ discardStreamingBytes];
+    // The byte channel may have read the start of the stream along with the MD response.  I consume those bytes before anything I read myself.
+    pendingStreamingData_ = [byteChannel_ takeBufferedData];
+    // The handler retains me until `disconnect` removes the source.  The handler can cancel `readSource_` as soon as it first runs, so I set it before I resume the source.
+    Lidar2DReactor *reactor = [Lidar2DReactor sharedReactor];
+    readSource_ = [reactor addReadSourceForFileDescriptor:fd_ handler:^{
+        [self r_readStreamingData];
+    }];
+    [reactor resumeReadSource:readSource_];
+}
+
+- (void)r_readStreamingData {
+    if (pendingStreamingData_) {
+        NSData *data = pendingStreamingData_;
+        pendingStreamingData_ = nil;
+        [self r_consumeStreamingBytes:data.bytes length:data.length];
     }
+
+    char buffer[4096];
+    ssize_t count = 0;
+    while (wantStreaming_ && (count = read(fd_, buffer, sizeof buffer)) > 0) {
+        [self r_consumeStreamingBytes:buffer length:count];
+    }
+    if (!wantStreaming_ || (count < 0 && (errno == EAGAIN || errno == EINTR)))
+        return;
+
+    // End of file or a real error means the device is gone.
+    if (count == 0) {
+        errno = EIO;
+    }
+    [self reportPosixErrorWithAction:@"reading streaming data"];
+    [self r_stopReceivingStreamingData];
+}
+
+- (void)r_consumeStreamingBytes:(void const *)bytes length:(size_t)length {
+    [channel_ consumeStreamingBytes:bytes length:length dataEncodingLength:3 onResponse:^(NSString *command, NSString *status, NSUInteger timestamp, NSData *integerData) {
+        (void)command;
+        if (!wantStreaming_)
+            return;
+        if ([self checkStatus:status isEqualToStatus:SCIP20Status_StreamingData]) {
+            Lidar2DScanTiming timing = { timestamp, CFAbsoluteTimeGetCurrent() };
+            [_delegate connection:self didReceiveDistanceData:distanceDataForIntegerData(integerData, minimumDistance_, maximumDistance_) timing:timing];
+        } else {
+            [self r_stopReceivingStreamingData];
+        }
+    } onError:^(NSError *error) {
+        if (!wantStreaming_)
+            return;
+        [_delegate connection:self didFailWithError:error];
+        [self r_stopReceivingStreamingData];
+    }];
+}
+
+- (void)r_stopReceivingStreamingData {
+    wantStreaming_ = NO;
+    // `disconnect` still has to remove the source, but the reactor won't call me again.
+    dispatch_source_cancel(readSource_);
 }
 
 #pragma mark - Error reporting details
@@ -273,9 +440,12 @@ static NSData *distanceDataForIntegerData(NSData *integerData) {
 - (BOOL)readSpecificationsDictionary {
     __block BOOL ok = YES;
     [channel_ sendCommand:@"PP" onDictionaryResponse:^(NSString *status, NSDictionary *info) {
-        if (![self checkOKStatus:status])
+        if (![self checkOKStatus:status]) {
+            ok = NO;
             return;
+        }
         NSLog(@"device specifications: %@", info);
+        ok = [self applySpecificationsDictionary:info];
     } onError:^(NSError *error) {
         [_delegate connection:self didFailWithError:error];
         ok = NO;
@@ -283,6 +453,57 @@ static NSData *distanceDataForIntegerData(NSData *integerData) {
     return ok;
 }
 
+- (BOOL)applySpecificationsDictionary:(NSDictionary *)info {
+    NSInteger minimumDistance, maximumDistance, stepsPerRevolution, firstStep, lastStep, frontStep, scansPerMinute;
+    if (!(YES
+        && [self getInteger:&minimumDistance forKey:@"DMIN" inSpecifications:info]
+        && [self getInteger:&maximumDistance forKey:@"DMAX" inSpecifications:info]
+        && [self getInteger:&stepsPerRevolution forKey:@"ARES" inSpecifications:info]
+        && [self getInteger:&firstStep forKey:@"AMIN" inSpecifications:info]
+        && [self getInteger:&lastStep forKey:@"AMAX" inSpecifications:info]
+        && [self getInteger:&frontStep forKey:@"AFRT" inSpecifications:info]
+        && [self getInteger:&scansPerMinute forKey:@"SCAN" inSpecifications:info]))
+        return NO;
+
+    // The MD command only has room for four digits per step number.
+    if (stepsPerRevolution <= 0 || firstStep < 0 || lastStep < firstStep || lastStep > 9999 || frontStep < firstStep || frontStep > lastStep || scansPerMinute <= 0 || minimumDistance < 0 || maximumDistance < minimumDistance || maximumDistance > UINT16_MAX)
+        return [self reportSpecificationsError:info key:nil];
+
+    firstRayStep_ = firstStep;
+    lastRayStep_ = lastStep;
+    frontRayStep_ = frontStep;
+    stepsPerRevolution_ = stepsPerRevolution;
+    scansPerMinute_ = scansPerMinute;
+    minimumDistance_ = (SCIP20IntegerDatum)minimumDistance;
+    maximumDistance_ = (SCIP20IntegerDatum)maximumDistance;
+    return YES;
+}
+
+- (BOOL)getInteger:(NSInteger *)integerOut forKey:(NSString *)key inSpecifications:(NSDictionary *)info {
+    NSString *string = info[key];
+    if (string && [[NSScanner scannerWithString:string] scanInteger:integerOut])
+        return YES;
+    return [self reportSpecificationsError:info key:key];
+}
+
+// I return NO to make it easy to call me and then return NO.
+- (BOOL)reportSpecificationsError:(NSDictionary *)info key:(NSString *)key {
+    NSMutableDictionary *userInfo = [@{
+        @"action": @"reading the device specifications",
+        @"specifications": info,
+        NSFilePathErrorKey: devicePath_
+    } mutableCopy];
+    if (key) {
+        userInfo[@"key"] = key;
+    }
+    [_delegate connection:self didFailWithError:[NSError errorWithDomain:Lidar2DErrorDomain code:0 userInfo:userInfo]];
+    return NO;
+}
+
+- (double)degreesPerStep {
+    return 360.0 / stepsPerRevolution_;
+}
+
 - (BOOL)readStateDictionary {
     __block BOOL ok = YES;
     [channel_ sendCommand:@"II" onDictionaryResponse:^(NSString *status, NSDictionary *info) {
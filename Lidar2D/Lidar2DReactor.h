@@ -0,0 +1,24 @@
+/*
+Copyright (c) 2012 Rob Mayoff. All rights reserved.
+*/
+
+#import <Foundation/Foundation.h>
+
+// Lidar2DReactor is private to the Lidar2D package.
+
+// I watch the file descriptors of all streaming devices from a single serial queue.  Streaming from N devices costs one queue and no threads blocked in `poll`, instead of a queue and a blocked thread per device.
+@interface Lidar2DReactor : NSObject
+
+// All Lidar2DConnections share me.
++ (Lidar2DReactor *)sharedReactor;
+
+// I return a source that will call `handler` on my queue whenever `fd` is readable.  The handler should read everything available without blocking.  The source is suspended, so you can store it where the handler will look for it before you pass it to `resumeReadSource:`.  You must pass it to `removeReadSource:` before you close `fd`.
+- (dispatch_source_t)addReadSourceForFileDescriptor:(int)fd handler:(void (^)(void))handler;
+
+// I start calling the handler of `source`, which `addReadSourceForFileDescriptor:handler:` returned.
+- (void)resumeReadSource:(dispatch_source_t)source;
+
+// I stop calling the handler of `source` and release it.  When I return, the handler is not running and will never run again, so you can close its file descriptor.  Don't send me this from my queue.
+- (void)removeReadSource:(dispatch_source_t)source;
+
+@end
@@ -0,0 +1,52 @@
+/*
+Copyright (c) 2012 Rob Mayoff. All rights reserved.
+*/
+
+#import "Lidar2DReactor.h"
+
+@implementation Lidar2DReactor {
+    dispatch_queue_t queue_; // I run every read handler on this queue.
+}
+
+#pragma mark - Package API
+
++ (Lidar2DReactor *)sharedReactor {
+    static Lidar2DReactor *reactor;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        reactor = [[self alloc] init];
+    });
+    return reactor;
+}
+
+- (id)init {
+    if ((self = [super init])) {
+        queue_ = dispatch_queue_create("com.dqd.Lidar2DReactor", 0);
+    }
+    return self;
+}
+
+- (void)dealloc {
+    dispatch_release(queue_);
+}
+
+- (dispatch_source_t)addReadSourceForFileDescriptor:(int)fd handler:(void (^)(void))handler {
+    dispatch_source_t source = dispatch_source_create(DISPATCH_SOURCE_TYPE_READ, fd, 0, queue_);
+    dispatch_source_set_event_handler(source, handler);
+    return source;
+}
+
+- (void)resumeReadSource:(dispatch_source_t)source {
+    dispatch_resume(source);
+}
+
+- (void)removeReadSource:(dispatch_source_t)source {
+    if (!source)
+        return;
+    dispatch_source_cancel(source);
+    // A cancelled source doesn't start any more handlers, but one might be running right now.  My queue is serial, so once this empty block runs, no handler for `source` is running.
+    dispatch_sync(queue_, ^{});
+    dispatch_release(source);
+}
+
+@end
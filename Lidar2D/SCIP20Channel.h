@@ -46,4 +46,10 @@ typedef void (^SCIP20StreamingDataResponseBlock)(NSString *command, NSString *st
 // I try to receive an encoded data response without sending a command first.  If I receive a valid response, I pass the echoed command, the response status and the decoded data to `responseBlock`.  Otherwise, I call `errorBlock`.
 - (void)receiveStreamingResponseWithDataEncodingLength:(int)encodingLength onResponse:(SCIP20StreamingDataResponseBlock)responseBlock onError:(SCIP20ErrorBlock)errorBlock;
 
+// I parse streaming responses from bytes that you read from the device yourself, for example when a reactor tells you the device is readable.  I keep any incomplete response until you give me the rest of it.  I call `responseBlock` or `errorBlock` once for each complete response in the bytes I have so far, just like `receiveStreamingResponseWithDataEncodingLength:onResponse:onError:`.
+- (void)consumeStreamingBytes:(void const *)bytes length:(size_t)length dataEncodingLength:(int)encodingLength onResponse:(SCIP20StreamingDataResponseBlock)responseBlock onError:(SCIP20ErrorBlock)errorBlock;
+
+// I forget the incomplete response I'm keeping for `consumeStreamingBytes:...`.  Send me this before you start a new stream, because the rest of that response will never come.
+- (void)discardStreamingBytes;
+
 @end
@@ -24,10 +24,14 @@ static NSString *commandFromEchoLine(NSData *echoLine) {
     return command;
 }
 
+// If this many bytes of streaming data arrive without completing a response, I assume I'm out of sync with the device.
+static NSUInteger const kMaximumStreamingResponseLength = 65536;
+
 @implementation SCIP20Channel {
     ByteChannel *channel_;
     uint64_t commandNumber_;
     CFAbsoluteTime deadline_;
+    NSMutableData *streamingBytes_; // Bytes passed to `consumeStreamingBytes:...` that don't yet form a complete response.
 }
 
 #pragma mark - Public API
@@ -82,30 +86,98 @@ static NSString *commandFromEchoLine(NSData *echoLine) {
 
 - (void)receiveStreamingResponseWithDataEncodingLength:(int)encodingLength onResponse:(SCIP20StreamingDataResponseBlock)responseBlock onError:(SCIP20ErrorBlock)errorBlock {
     [self readResponsePacketWithBlock:^(NSData *echoLine, NSString *status, NSArray *payloadChunks) {
-        if (payloadChunks.count < 1) {
-            errorBlock([NSError errorWithDomain:SCIP20ErrorDomain code:SCIP20ErrorCode_MissingTimestampLine userInfo:@{
-                @"echoLine": echoLine,
-                @"status": status,
-                @"payload": payloadChunks
-            }]);
-            return;
-        }
+        [self decodeStreamingResponseWithEchoLine:echoLine status:status payloadChunks:payloadChunks encodingLength:encodingLength onResponse:responseBlock onError:errorBlock];
+    } onError:errorBlock];
+}
 
-        NSError *error;
-        NSUInteger timestamp = [self timestampByDecodingChunk:payloadChunks[0] error:&error];
-        
-        if (!error) {
-            NSData *data = [self dataByDecodingPayloadChunks:[payloadChunks subarrayWithRange:NSMakeRange(1, payloadChunks.count-1)] withEncodingLength:encodingLength error:&error];
-            if (data) {
-                NSString *echo = commandFromEchoLine(echoLine);
-                responseBlock(echo, status, timestamp, data);
+- (void)consumeStreamingBytes:(void const *)bytes length:(size_t)length dataEncodingLength:(int)encodingLength onResponse:(SCIP20StreamingDataResponseBlock)responseBlock onError:(SCIP20ErrorBlock)errorBlock {
+    if (!streamingBytes_) {
+        streamingBytes_ = [[NSMutableData alloc] init];
+    }
+    [streamingBytes_ appendBytes:bytes length:length];
+
+    char const *start = streamingBytes_.bytes;
+    char const *end = start + streamingBytes_.length;
+    char const *packetStart = start;
+    while (packetStart < end) {
+        // A response ends with an empty line.
+        char const *packetEnd = NULL;
+        for (char const *p = memchr(packetStart, '\n', end - packetStart); p && p + 1 < end; p = memchr(p + 1, '\n', end - p - 1)) {
+            if (p[1] == '\n') {
+                packetEnd = p + 2;
+                break;
             }
         }
+        if (!packetEnd)
+            break;
+        [self decodeStreamingPacketBytes:packetStart length:packetEnd - packetStart encodingLength:encodingLength onResponse:responseBlock onError:errorBlock];
+        packetStart = packetEnd;
+    }
 
-        if (error) {
-            errorBlock(error);
+    [streamingBytes_ replaceBytesInRange:NSMakeRange(0, packetStart - start) withBytes:NULL length:0];
+    if (streamingBytes_.length > kMaximumStreamingResponseLength) {
+        streamingBytes_.length = 0;
+        errorBlock([NSError errorWithDomain:SCIP20ErrorDomain code:SCIP20ErrorCode_Desynchronized userInfo:nil]);
+    }
+}
+
+- (void)discardStreamingBytes {
+    streamingBytes_.length = 0;
+}
+
+#pragma mark - Implementation details - streaming response decoding
+
+// `bytes` is one complete response, including the empty line at the end.
+- (void)decodeStreamingPacketBytes:(char const *)bytes length:(size_t)length encodingLength:(int)encodingLength onResponse:(SCIP20StreamingDataResponseBlock)responseBlock onError:(SCIP20ErrorBlock)errorBlock {
+    char const *end = bytes + length - 1; // Exclude the empty line's newline.
+    char const *echoEnd = (char const *)memchr(bytes, '\n', end - bytes) + 1;
+    NSData *echoLine = [NSData dataWithBytes:bytes length:echoEnd - bytes];
+    if (echoEnd == end) {
+        errorBlock([NSError errorWithDomain:SCIP20ErrorDomain code:SCIP20ErrorCode_MissingStatusLine userInfo:nil]);
+        return;
+    }
+
+    // Each remaining line ends with a checksum character and a newline, which I discard.
+    NSString *status = nil;
+    NSMutableArray *payloadChunks = [[NSMutableArray alloc] init];
+    for (char const *lineStart = echoEnd; lineStart < end; ) {
+        char const *lineEnd = memchr(lineStart, '\n', end - lineStart);
+        NSData *line = [NSData dataWithBytes:lineStart length:MAX(lineEnd - lineStart, 1) - 1];
+        if (status) {
+            [payloadChunks addObject:line];
+        } else {
+            status = [[NSString alloc] initWithData:line encoding:NSUTF8StringEncoding];
         }
-    } onError:errorBlock];
+        lineStart = lineEnd + 1;
+    }
+
+    [self decodeStreamingResponseWithEchoLine:echoLine status:status payloadChunks:payloadChunks encodingLength:encodingLength onResponse:responseBlock onError:errorBlock];
+}
+
+- (void)decodeStreamingResponseWithEchoLine:(NSData *)echoLine status:(NSString *)status payloadChunks:(NSArray *)payloadChunks encodingLength:(int)encodingLength onResponse:(SCIP20StreamingDataResponseBlock)responseBlock onError:(SCIP20ErrorBlock)errorBlock {
+    if (payloadChunks.count < 1) {
+        errorBlock([NSError errorWithDomain:SCIP20ErrorDomain code:SCIP20ErrorCode_MissingTimestampLine userInfo:@{
+            @"echoLine": echoLine,
+            @"status": status,
+            @"payload": payloadChunks
+        }]);
+        return;
+    }
+
+    NSError *error;
+    NSUInteger timestamp = [self timestampByDecodingChunk:payloadChunks[0] error:&error];
+    
+    if (!error) {
+        NSData *data = [self dataByDecodingPayloadChunks:[payloadChunks subarrayWithRange:NSMakeRange(1, payloadChunks.count-1)] withEncodingLength:encodingLength error:&error];
+        if (data) {
+            NSString *echo = commandFromEchoLine(echoLine);
+            responseBlock(echo, status, timestamp, data);
+        }
+    }
+
+    if (error) {
+        errorBlock(error);
+    }
 }
 
 #pragma mark - Implementation details - send & receive helpers
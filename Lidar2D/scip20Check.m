@@ -0,0 +1,133 @@
+/*
+Copyright (c) 2012 Rob Mayoff. All rights reserved.
+*/
+
+// I check SCIP20Channel's streaming parser on packets I build myself, so I don't need a device.
+//
+// usage: clang -fobjc-arc -framework Foundation -o scip20Check scip20Check.m SCIP20Channel.m ByteChannel.m && ./scip20Check
+
+#import "SCIP20Channel.h"
+
+static int const kEncodingLength = 3;
+static size_t const kMaximumDataLineLength = 64;
+
+static void appendLine(NSMutableData *packet, char const *bytes, size_t length) {
+    unsigned sum = 0;
+    for (size_t i = 0; i < length; ++i) {
+        sum += (unsigned char)bytes[i];
+    }
+    char trailer[2] = { (char)((sum & 0x3F) + 0x30), '\n' };
+    [packet appendBytes:bytes length:length];
+    [packet appendBytes:trailer length:sizeof trailer];
+}
+
+static void encode(NSUInteger value, char *bytes, size_t length) {
+    for (size_t i = 0; i < length; ++i) {
+        bytes[i] = (char)(((value >> (6 * (length - 1 - i))) & 0x3F) + 0x30);
+    }
+}
+
+// I return the distances `first`, `first + 1` and so on, as the channel decodes them.
+static NSData *distancesStartingAt(SCIP20IntegerDatum first, NSUInteger count) {
+    NSMutableData *data = [NSMutableData dataWithLength:count * sizeof(SCIP20IntegerDatum)];
+    SCIP20IntegerDatum *distances = data.mutableBytes;
+    for (NSUInteger i = 0; i < count; ++i) {
+        distances[i] = (SCIP20IntegerDatum)(first + i);
+    }
+    return data;
+}
+
+// I return the MD streaming packet of one scan of `distances`, with `timestamp`.
+static NSData *streamingPacket(NSUInteger timestamp, NSData *distances) {
+    NSMutableData *packet = [NSMutableData data];
+    char const echo[] = "MD0000009900000\n";
+    [packet appendBytes:echo length:sizeof echo - 1];
+    appendLine(packet, "99", 2);
+
+    char line[kMaximumDataLineLength];
+    encode(timestamp, line, 4);
+    appendLine(packet, line, 4);
+
+    NSUInteger count = distances.length / sizeof(SCIP20IntegerDatum);
+    SCIP20IntegerDatum const *values = distances.bytes;
+    NSMutableData *encoded = [NSMutableData dataWithLength:count * kEncodingLength];
+    for (NSUInteger i = 0; i < count; ++i) {
+        encode(values[i], (char *)encoded.mutableBytes + i * kEncodingLength, kEncodingLength);
+    }
+    for (size_t offset = 0; offset < encoded.length; offset += kMaximumDataLineLength) {
+        appendLine(packet, (char const *)encoded.bytes + offset, MIN(kMaximumDataLineLength, encoded.length - offset));
+    }
+    [packet appendBytes:"\n" length:1];
+    return packet;
+}
+
+@interface ScanCollector : NSObject
+@property (nonatomic, strong) NSMutableArray *timestamps;
+@property (nonatomic, strong) NSMutableArray *scans;
+@property (nonatomic, strong) NSMutableArray *errors;
+- (void)consume:(NSData *)bytes with:(SCIP20Channel *)channel;
+@end
+
+@implementation ScanCollector
+
+- (id)init {
+    if ((self = [super init])) {
+        _timestamps = [NSMutableArray array];
+        _scans = [NSMutableArray array];
+        _errors = [NSMutableArray array];
+    }
+    return self;
+}
+
+- (void)consume:(NSData *)bytes with:(SCIP20Channel *)channel {
+    [channel consumeStreamingBytes:bytes.bytes length:bytes.length dataEncodingLength:kEncodingLength onResponse:^(NSString *command, NSString *status, NSUInteger timestamp, NSData *data) {
+        (void)command;
+        if ([status isEqualToString:@"99"]) {
+            [_timestamps addObject:@(timestamp)];
+            [_scans addObject:data];
+        } else {
+            [_errors addObject:[NSString stringWithFormat:@"status %@", status]];
+        }
+    } onError:^(NSError *error) {
+        [_errors addObject:error];
+    }];
+}
+
+@end
+
+static BOOL check(BOOL condition, char const *description) {
+    printf("%s  %s\n", condition ? "ok    " : "FAILED", description);
+    return condition;
+}
+
+int main(void) {
+    @autoreleasepool {
+        BOOL ok = YES;
+        NSData *first = distancesStartingAt(1000, 100);
+        NSData *second = distancesStartingAt(2000, 100);
+        NSData *firstPacket = streamingPacket(10, first);
+        NSData *secondPacket = streamingPacket(35, second);
+
+        // The reactor hands me whatever `read` returns, so packets arrive in arbitrary pieces.
+        SCIP20Channel *channel = [[SCIP20Channel alloc] initWithByteChannel:nil];
+        ScanCollector *collector = [[ScanCollector alloc] init];
+        NSMutableData *stream = [NSMutableData dataWithData:firstPacket];
+        [stream appendData:secondPacket];
+        for (NSUInteger offset = 0; offset < stream.length; offset += 7) {
+            [collector consume:[stream subdataWithRange:NSMakeRange(offset, MIN((NSUInteger)7, stream.length - offset))] with:channel];
+        }
+        ok &= check(collector.errors.count == 0 && collector.scans.count == 2 && [collector.scans[0] isEqualToData:first] && [collector.scans[1] isEqualToData:second] && [collector.timestamps[1] isEqual:@35], "two scans in 7-byte pieces");
+
+        // When I stop streaming in the middle of a scan and start again, the new stream starts with a new packet.  The start of the old scan must not swallow it.
+        channel = [[SCIP20Channel alloc] initWithByteChannel:nil];
+        collector = [[ScanCollector alloc] init];
+        [collector consume:firstPacket with:channel];
+        [collector consume:[secondPacket subdataWithRange:NSMakeRange(0, secondPacket.length / 2)] with:channel];
+        [channel discardStreamingBytes];
+        NSData *third = distancesStartingAt(3000, 100);
+        [collector consume:streamingPacket(60, third) with:channel];
+        ok &= check(collector.errors.count == 0 && collector.scans.count == 2 && [collector.scans[1] isEqualToData:third] && [collector.timestamps[1] isEqual:@60], "restart with half a scan buffered");
+
+        return ok ? 0 : 1;
+    }
+}
@@ -0,0 +1,286 @@
+//
+//  Lidar2DHotplugManager.cpp
+//  mickeyMouse
+//
+//  Copyright (c) 2012 Rob Mayoff. All rights reserved.
+//
+
+#include "Lidar2DHotplugManager.h"
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <linux/netlink.h>
+#include <poll.h>
+#include <set>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using std::map;
+using std::set;
+using std::string;
+
+namespace Lidar2DLinux {
+
+static uint16_t const kHokuyoVendorID = 0x15d1;
+static char const kTTYClassPath[] = "/sys/class/tty";
+static char const kTTYNamePrefix[] = "ttyACM";
+
+// The kernel multicasts uevents to group 1.  (udevd rebroadcasts them to group 2 after processing, but I don't need to wait for that.)
+static unsigned const kKernelUeventGroup = 1;
+
+// A uevent message is a header line plus at most 2048 bytes of environment.
+static size_t const kUeventBufferSize = 8192;
+
+// I ask for a big receive buffer so a burst of unrelated uevents (say, a USB hub full of devices) doesn't overflow it.  If it overflows anyway, I rescan sysfs.
+static int const kReceiveBufferSize = 1024 * 1024;
+
+// How far up the sysfs tree I look for the USB device that owns a tty.  A ttyACM's `device` link points at the USB interface, whose parent is the USB device.
+static int const kMaximumUSBDeviceDepth = 4;
+
+// sysfs helpers
+
+static bool hasTTYNamePrefix(string const &name) {
+    return name.compare(0, sizeof kTTYNamePrefix - 1, kTTYNamePrefix) == 0;
+}
+
+static bool readAttribute(string const &directory, char const *name, string &value) {
+    string path = directory + "/" + name;
+    FILE *file = fopen(path.c_str(), "re");
+    if (!file)
+        return false;
+    char buffer[256];
+    bool ok = fgets(buffer, sizeof buffer, file) != NULL;
+    fclose(file);
+    if (!ok)
+        return false;
+    value = buffer;
+    while (!value.empty() && (value[value.size() - 1] == '\n' || value[value.size() - 1] == ' ')) {
+        value.resize(value.size() - 1);
+    }
+    return true;
+}
+
+static bool readHexAttribute(string const &directory, char const *name, uint16_t &value) {
+    string text;
+    if (!readAttribute(directory, name, text))
+        return false;
+    char *end;
+    unsigned long number = strtoul(text.c_str(), &end, 16);
+    if (end == text.c_str() || *end != '\0' || number > UINT16_MAX)
+        return false;
+    value = (uint16_t)number;
+    return true;
+}
+
+bool getDeviceInfoForTTY(string const &ttyName, DeviceInfo &info) {
+    string linkPath = string(kTTYClassPath) + "/" + ttyName + "/device";
+    char resolved[PATH_MAX];
+    if (!realpath(linkPath.c_str(), resolved))
+        return false;
+
+    string directory = resolved;
+    for (int depth = 0; depth < kMaximumUSBDeviceDepth; ++depth) {
+        if (readHexAttribute(directory, "idVendor", info.vendorID) && readHexAttribute(directory, "idProduct", info.productID)) {
+            info.devicePath = "/dev/" + ttyName;
+            info.sysfsPath = directory;
+            if (!readAttribute(directory, "serial", info.serialNumber)) {
+                info.serialNumber.clear();
+            }
+            if (!readAttribute(directory, "product", info.product)) {
+                info.product.clear();
+            }
+            return true;
+        }
+        string::size_type slash = directory.rfind('/');
+        if (slash == string::npos || slash == 0)
+            break;
+        directory.resize(slash);
+    }
+    return false;
+}
+
+// HotplugManager
+
+HotplugManager::HotplugManager(HotplugManagerDelegate &delegate)
+    : delegate_(delegate), fd_(-1)
+{ }
+
+HotplugManager::~HotplugManager() {
+    stop();
+}
+
+bool HotplugManager::start() {
+    if (isStarted())
+        return true;
+
+    fd_ = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_KOBJECT_UEVENT);
+    if (fd_ < 0) {
+        reportError("opening the uevent socket");
+        return false;
+    }
+
+    // This is only a hint, so I don't care if it fails.
+    setsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &kReceiveBufferSize, sizeof kReceiveBufferSize);
+
+    struct sockaddr_nl address;
+    memset(&address, 0, sizeof address);
+    address.nl_family = AF_NETLINK;
+    address.nl_groups = kKernelUeventGroup;
+    if (bind(fd_, (struct sockaddr *)&address, sizeof address) < 0) {
+        reportError("binding the uevent socket");
+        stop();
+        return false;
+    }
+
+    // I start listening before I scan, so I can't miss a device that appears between the scan and the first uevent.
+    rescanDevices();
+    return true;
+}
+
+void HotplugManager::stop() {
+    if (fd_ >= 0) {
+        close(fd_);
+        fd_ = -1;
+    }
+    devices_.clear();
+}
+
+void HotplugManager::handleEvents() {
+    char buffer[kUeventBufferSize];
+    while (isStarted()) {
+        struct sockaddr_nl sender;
+        struct iovec iov = { buffer, sizeof buffer - 1 };
+        struct msghdr header;
+        memset(&header, 0, sizeof header);
+        header.msg_name = &sender;
+        header.msg_namelen = sizeof sender;
+        header.msg_iov = &iov;
+        header.msg_iovlen = 1;
+
+        ssize_t length = recvmsg(fd_, &header, 0);
+        if (length < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return;
+            if (errno == EINTR)
+                continue;
+            if (errno == ENOBUFS) {
+                // The kernel dropped uevents.  I don't know which, so I compare my devices with sysfs.
+                rescanDevices();
+                continue;
+            }
+            reportError("receiving a uevent");
+            return;
+        }
+
+        // Only the kernel can send from port 0.  I ignore anything else so a local process can't fake a sensor.
+        if (header.msg_namelen != sizeof sender || sender.nl_pid != 0 || (header.msg_flags & MSG_TRUNC))
+            continue;
+
+        buffer[length] = '\0';
+        handleEvent(buffer, length);
+    }
+}
+
+bool HotplugManager::waitForEvents(int timeoutMilliseconds) {
+    if (!isStarted())
+        return false;
+    struct pollfd pfd = { fd_, POLLIN, 0 };
+    int rc = poll(&pfd, 1, timeoutMilliseconds);
+    if (rc < 0) {
+        if (errno == EINTR)
+            return true;
+        reportError("waiting for uevents");
+        return false;
+    }
+    if (rc > 0) {
+        handleEvents();
+    }
+    return true;
+}
+
+// `message` is a header like `add@/devices/...` followed by NUL-terminated `KEY=value` strings.
+void HotplugManager::handleEvent(char const *message, size_t length) {
+    char const *action = NULL;
+    char const *subsystem = NULL;
+    char const *deviceName = NULL;
+    char const *end = message + length;
+    for (char const *p = message + strlen(message) + 1; p < end; p += strlen(p) + 1) {
+        if (strncmp(p, "ACTION=", 7) == 0) {
+            action = p + 7;
+        } else if (strncmp(p, "SUBSYSTEM=", 10) == 0) {
+            subsystem = p + 10;
+        } else if (strncmp(p, "DEVNAME=", 8) == 0) {
+            deviceName = p + 8;
+        }
+    }
+
+    if (!action || !subsystem || !deviceName || strcmp(subsystem, "tty") != 0)
+        return;
+
+    // DEVNAME is relative to /dev.
+    string ttyName = deviceName;
+    if (ttyName.find('/') != string::npos || !hasTTYNamePrefix(ttyName))
+        return;
+
+    if (strcmp(action, "add") == 0) {
+        deviceWasAdded(ttyName);
+    } else if (strcmp(action, "remove") == 0) {
+        deviceWasRemoved(ttyName);
+    }
+}
+
+void HotplugManager::deviceWasAdded(string const &ttyName) {
+    if (devices_.count(ttyName))
+        return;
+    DeviceInfo info;
+    if (!getDeviceInfoForTTY(ttyName, info) || info.vendorID != kHokuyoVendorID)
+        return;
+    devices_[ttyName] = info;
+    delegate_.hotplugManagerDidConnectToDevice(*this, info);
+}
+
+void HotplugManager::deviceWasRemoved(string const &ttyName) {
+    map<string, DeviceInfo>::iterator it = devices_.find(ttyName);
+    if (it == devices_.end())
+        return;
+    DeviceInfo info = it->second;
+    devices_.erase(it);
+    delegate_.hotplugManagerDidTerminateDevice(*this, info);
+}
+
+void HotplugManager::rescanDevices() {
+    set<string> present;
+    DIR *directory = opendir(kTTYClassPath);
+    if (!directory) {
+        reportError("scanning for ttys");
+        return;
+    }
+    while (struct dirent *entry = readdir(directory)) {
+        if (hasTTYNamePrefix(entry->d_name)) {
+            present.insert(entry->d_name);
+        }
+    }
+    closedir(directory);
+
+    // Collect the vanished devices first, because `deviceWasRemoved` modifies `devices_`.
+    set<string> vanished;
+    for (map<string, DeviceInfo>::const_iterator it = devices_.begin(); it != devices_.end(); ++it) {
+        if (!present.count(it->first)) {
+            vanished.insert(it->first);
+        }
+    }
+    for (set<string>::const_iterator it = vanished.begin(); it != vanished.end(); ++it) {
+        deviceWasRemoved(*it);
+    }
+    for (set<string>::const_iterator it = present.begin(); it != present.end(); ++it) {
+        deviceWasAdded(*it);
+    }
+}
+
+void HotplugManager::reportError(char const *action) {
+    delegate_.hotplugManagerDidReceiveError(*this, errno, action);
+}
+
+}
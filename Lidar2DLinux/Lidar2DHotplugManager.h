@@ -0,0 +1,92 @@
+//
+//  Lidar2DHotplugManager.h
+//  mickeyMouse
+//
+//  Copyright (c) 2012 Rob Mayoff. All rights reserved.
+//
+
+#ifndef Lidar2DHotplugManager_h
+#define Lidar2DHotplugManager_h
+
+#include <map>
+#include <stdint.h>
+#include <string>
+
+namespace Lidar2DLinux {
+
+// Everything I can learn about a sensor from sysfs, without opening its tty.
+struct DeviceInfo {
+    std::string devicePath; // for example `/dev/ttyACM0`
+    std::string sysfsPath; // the sensor's USB device directory under `/sys/devices`
+    std::string serialNumber; // the USB serial number string, which is empty if the device doesn't report one
+    std::string product; // the USB product string
+    uint16_t vendorID;
+    uint16_t productID;
+};
+
+class HotplugManager;
+
+class HotplugManagerDelegate {
+public:
+    virtual ~HotplugManagerDelegate() {}
+
+    // A sensor appeared, or was already connected when you started me.
+    virtual void hotplugManagerDidConnectToDevice(HotplugManager &manager, DeviceInfo const &device) = 0;
+
+    // A sensor I previously reported has been physically disconnected.  `device` is what I reported when it connected.
+    virtual void hotplugManagerDidTerminateDevice(HotplugManager &manager, DeviceInfo const &device) = 0;
+
+    // I encountered an error.  `errorNumber` is an `errno` value and `action` describes what I was doing.
+    virtual void hotplugManagerDidReceiveError(HotplugManager &manager, int errorNumber, char const *action) = 0;
+};
+
+// I am the Linux counterpart of `Lidar2DManager`.  I listen on the kernel's uevent netlink socket for Hokuyo (USB vendor 0x15d1) ttyACM devices coming and going, so I notify my delegate as soon as the kernel does instead of rescanning `/dev` on a timer.
+//
+// I don't have a thread of my own.  Add my `fileDescriptor` to your poll or epoll set and send me `handleEvents` when it's readable, or call `waitForEvents` from a loop.  I notify my delegate from inside those calls.
+class HotplugManager {
+public:
+    explicit HotplugManager(HotplugManagerDelegate &delegate);
+
+    // I stop myself if I'm started.
+    ~HotplugManager();
+
+    // I open the uevent socket and then notify my delegate of any already-connected devices before returning.  I return false (after notifying my delegate of the error) if I can't open the socket.
+    bool start();
+
+    // I close the uevent socket and forget my devices without notifying my delegate.
+    void stop();
+
+    bool isStarted() const { return fd_ >= 0; }
+
+    // The uevent socket.  It's non-blocking.  It's -1 if I'm not started.
+    int fileDescriptor() const { return fd_; }
+
+    // I read every pending uevent without blocking and notify my delegate of any sensors that connected or terminated.
+    void handleEvents();
+
+    // I wait up to `timeoutMilliseconds` (forever if it's negative) for uevents, then handle them.  I return false if I'm not started or the wait failed.
+    bool waitForEvents(int timeoutMilliseconds);
+
+private:
+    HotplugManager(HotplugManager const &); // not implemented
+    HotplugManager &operator=(HotplugManager const &); // not implemented
+
+    void handleEvent(char const *message, size_t length);
+    void deviceWasAdded(std::string const &ttyName);
+    void deviceWasRemoved(std::string const &ttyName);
+    void rescanDevices();
+    void reportError(char const *action);
+
+    HotplugManagerDelegate &delegate_;
+    int fd_;
+
+    // The sensors I have reported as connected, keyed by tty name (for example `ttyACM0`).  I need these to report terminations, because sysfs has already forgotten a device by the time I hear it was removed.
+    std::map<std::string, DeviceInfo> devices_;
+};
+
+// I fill in `info` from sysfs for the tty named `ttyName` (for example `ttyACM0`).  I return false if the tty isn't a USB device.  I don't check the vendor.
+bool getDeviceInfoForTTY(std::string const &ttyName, DeviceInfo &info);
+
+}
+
+#endif
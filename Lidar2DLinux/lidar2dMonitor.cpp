@@ -0,0 +1,53 @@
+//
+//  lidar2dMonitor.cpp
+//  mickeyMouse
+//
+//  Copyright (c) 2012 Rob Mayoff. All rights reserved.
+//
+
+// I print a line whenever a Hokuyo sensor is connected or disconnected, until I'm killed.
+
+#include "Lidar2DHotplugManager.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+using namespace Lidar2DLinux;
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+class Monitor : public HotplugManagerDelegate {
+public:
+    virtual void hotplugManagerDidConnectToDevice(HotplugManager &manager, DeviceInfo const &device) {
+        (void)manager;
+        printf("%.6f connected %s serial \"%s\" product \"%s\" (%04x:%04x) at %s\n", now(), device.devicePath.c_str(), device.serialNumber.c_str(), device.product.c_str(), device.vendorID, device.productID, device.sysfsPath.c_str());
+        fflush(stdout);
+    }
+
+    virtual void hotplugManagerDidTerminateDevice(HotplugManager &manager, DeviceInfo const &device) {
+        (void)manager;
+        printf("%.6f terminated %s serial \"%s\"\n", now(), device.devicePath.c_str(), device.serialNumber.c_str());
+        fflush(stdout);
+    }
+
+    virtual void hotplugManagerDidReceiveError(HotplugManager &manager, int errorNumber, char const *action) {
+        (void)manager;
+        fprintf(stderr, "error: %s: %s\n", action, strerror(errorNumber));
+    }
+};
+
+int main(int argc, char *argv[]) {
+    (void)argc; (void)argv;
+    Monitor monitor;
+    HotplugManager manager(monitor);
+    if (!manager.start())
+        return 1;
+    while (manager.waitForEvents(-1)) {
+        // nothing
+    }
+    return 1;
+}
@@ -32,7 +32,7 @@ static NSString *const kPointerTracksTouchesItemIdentifier = @"pointerTracksTouc
 
     CGPoint touchPoint_; // in CG screen coordinates
     BOOL shouldPointerTrackTouches_ : 1;
-    BOOL touchWasDown_ : 1;
+    BOOL isDragging_ : 1; // I've sent a left mouse down for a drag and not yet the matching up
 }
 
 #pragma mark - Public API
@@ -97,6 +97,10 @@ static NSString *const kPointerTracksTouchesItemIdentifier = @"pointerTracksTouc
 - (IBAction)pointerTracksTouchesButtonWasPressed:(id)sender {
     (void)sender;
     shouldPointerTrackTouches_ = !shouldPointerTrackTouches_;
+    if (!shouldPointerTrackTouches_ && isDragging_) {
+        [self sendMouseEventWithType:kCGEventLeftMouseUp button:kCGMouseButtonLeft clickState:1 timestamp:CFAbsoluteTimeGetCurrent()];
+        isDragging_ = NO;
+    }
     [self updateInterfaceForCurrentState];
 }
 
@@ -205,24 +209,66 @@ static NSString *const kPointerTracksTouchesItemIdentifier = @"pointerTracksTouc
     [self updateInterfaceForCurrentState];
 }
 
-- (void)touchDetector:(TouchDetector *)detector didDetectTouches:(NSUInteger)count atScreenPoints:(const CGPoint *)points {
+- (void)touchDetector:(TouchDetector *)detector didRecognizeGestures:(DetectedGesture const *)gestures count:(NSUInteger)count {
     (void)detector;
     if (!shouldPointerTrackTouches_)
         return;
 
-    if (count > 1) {
-        NSLog(@"%lu touches detected; ignoring all", count);
-    } else if (count == 1) {
-        touchPoint_ = CGPointMake(points[0].x, [NSScreen mainScreen].frame.size.height - points[0].y);
-        if (touchWasDown_) {
-            [self sendMouseEventWithType:kCGEventLeftMouseDragged];
-        } else {
-            [self sendMouseEventWithType:kCGEventLeftMouseDown];
-            touchWasDown_ = YES;
+    for (NSUInteger i = 0; i < count; ++i) {
+        DetectedGesture gesture = gestures[i];
+        touchPoint_ = CGPointMake(gesture.screenPoint.x, [NSScreen mainScreen].frame.size.height - gesture.screenPoint.y);
+        switch (gesture.type) {
+            case DetectedGestureType_Tap:
+            case DetectedGestureType_DoubleTap: {
+                // The second click of a double-click only differs by its click state.
+                int64_t clickState = gesture.type == DetectedGestureType_DoubleTap ? 2 : 1;
+                [self sendMouseEventWithType:kCGEventLeftMouseDown button:kCGMouseButtonLeft clickState:clickState timestamp:gesture.timestamp];
+                [self sendMouseEventWithType:kCGEventLeftMouseUp button:kCGMouseButtonLeft clickState:clickState timestamp:gesture.timestamp];
+                break;
+            }
+
+            case DetectedGestureType_LongPress:
+                if (gesture.phase == DetectedGesturePhase_Began) {
+                    [self sendMouseEventWithType:kCGEventRightMouseDown button:kCGMouseButtonRight clickState:1 timestamp:gesture.timestamp];
+                    [self sendMouseEventWithType:kCGEventRightMouseUp button:kCGMouseButtonRight clickState:1 timestamp:gesture.timestamp];
+                }
+                break;
+
+            case DetectedGestureType_Drag:
+                switch (gesture.phase) {
+                    case DetectedGesturePhase_Began:
+                        // I press where the finger landed, so the drag picks up what the finger touched, and then drag at once to where the finger is.
+                        [self sendMouseEventWithType:kCGEventLeftMouseDown button:kCGMouseButtonLeft clickState:1 timestamp:gesture.timestamp];
+                        touchPoint_ = CGPointMake(gesture.screenPoint.x + gesture.translation.x, [NSScreen mainScreen].frame.size.height - (gesture.screenPoint.y + gesture.translation.y));
+                        [self sendMouseEventWithType:kCGEventLeftMouseDragged button:kCGMouseButtonLeft clickState:1 timestamp:gesture.timestamp];
+                        isDragging_ = YES;
+                        break;
+                    case DetectedGesturePhase_Changed:
+                        if (isDragging_) {
+                            [self sendMouseEventWithType:kCGEventLeftMouseDragged button:kCGMouseButtonLeft clickState:1 timestamp:gesture.timestamp];
+                        }
+                        break;
+                    default:
+                        if (isDragging_) {
+                            [self sendMouseEventWithType:kCGEventLeftMouseUp button:kCGMouseButtonLeft clickState:1 timestamp:gesture.timestamp];
+                            isDragging_ = NO;
+                        }
+                        break;
+                }
+                break;
+
+            case DetectedGestureType_Scroll:
+                if (gesture.phase != DetectedGesturePhase_Ended) {
+                    // The content follows the fingers, like on a trackpad.  A positive wheel delta moves the content down or right, and the gesture's y grows upward.
+                    [self sendScrollEventWithDeltaX:gesture.translation.x deltaY:-gesture.translation.y timestamp:gesture.timestamp];
+                }
+                break;
+
+            case DetectedGestureType_Pinch:
+            case DetectedGestureType_Swipe:
+                // There's no public API to post magnify or swipe events, so I leave these to observers that act on them directly.
+                break;
         }
-    } else if (touchWasDown_) {
-        [self sendMouseEventWithType:kCGEventLeftMouseUp];
-        touchWasDown_ = NO;
     }
 }
 
@@ -239,12 +285,29 @@ static NSString *const kPointerTracksTouchesItemIdentifier = @"pointerTracksTouc
 
 #pragma mark - Implementation details
 
-- (void)sendMouseEventWithType:(CGEventType)type {
-    CGEventRef event = CGEventCreateMouseEvent(NULL, type, touchPoint_, kCGMouseButtonLeft);
-    CGEventPost(kCGHIDEventTap, event);
+- (void)sendMouseEventWithType:(CGEventType)type button:(CGMouseButton)button clickState:(int64_t)clickState timestamp:(NSTimeInterval)timestamp {
+    CGEventRef event = CGEventCreateMouseEvent(NULL, type, touchPoint_, button);
+    CGEventSetIntegerValueField(event, kCGMouseEventClickState, clickState);
+    [self postEvent:event withTimestamp:timestamp];
+    CFRelease(event);
+}
+
+- (void)sendScrollEventWithDeltaX:(CGFloat)deltaX deltaY:(CGFloat)deltaY timestamp:(NSTimeInterval)timestamp {
+    CGEventRef event = CGEventCreateScrollWheelEvent(NULL, kCGScrollEventUnitPixel, 2, (int32_t)lround(deltaY), (int32_t)lround(deltaX));
+    CGEventSetLocation(event, touchPoint_);
+    [self postEvent:event withTimestamp:timestamp];
     CFRelease(event);
 }
 
+// I date `event` when the sensor saw the touches, not when I post it, so the receiver sees the gesture's true timing (how fast a drag moved, or how far apart two clicks were) despite the sensor and queue latency.
+- (void)postEvent:(CGEventRef)event withTimestamp:(NSTimeInterval)timestamp {
+    double age = MAX(CFAbsoluteTimeGetCurrent() - timestamp, 0);
+    CGEventTimestamp now = CGEventGetTimestamp(event);
+    CGEventTimestamp ageNanoseconds = (CGEventTimestamp)(age * 1e9);
+    CGEventSetTimestamp(event, ageNanoseconds < now ? now - ageNanoseconds : now);
+    CGEventPost(kCGHIDEventTap, event);
+}
+
 - (void)updateInterfaceForCurrentState {
     [controlWindow_.toolbar validateVisibleItems];
     controlWindow_.toolbar.selectedItemIdentifier = shouldPointerTrackTouches_ ? kPointerTracksTouchesItemIdentifier : nil;
@@ -1,13 +0,0 @@
-//
-//  EWMATouchSelection.h
-//  mickeyMouse
-//
-//  Created by Rob Mayoff on 12/28/12.
-//  Copyright (c) 2012 Rob Mayoff. All rights reserved.
-//
-
-#import "TouchSelection.h"
-
-@interface EWMATouchSelection : TouchSelection
-
-@end
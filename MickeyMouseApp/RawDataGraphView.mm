@@ -1,5 +1,5 @@
 //
-//  RawDataGraphView.m
+//  RawDataGraphView.mm
 //  mickeyMouse
 //
 //  Created by Rob Mayoff on 12/10/12.
@@ -9,11 +9,17 @@
 #import "Lidar2D.h"
 #import "NSData+Lidar2D.h"
 #import "RawDataGraphView.h"
+#import "RayTable.h"
 
 @interface RawDataGraphView () <Lidar2DObserver>
 @end
 
-@implementation RawDataGraphView
+@implementation RawDataGraphView {
+    // The direction of each ray in my flipped, centered coordinates.  I rebuild this only when the number of rays or the device's coverage changes, not on every redraw.
+    TouchEngine::RayTable rays_;
+    double raysCoverageDegrees_;
+    double raysFirstRayOffsetDegrees_;
+}
 
 #pragma mark - Public API
 
@@ -51,7 +57,7 @@
         return;
 
     Lidar2DDistance const *distances = _data.lidar2D_distances;
-    CGFloat distanceCount = _data.lidar2D_distanceCount;
+    NSUInteger distanceCount = _data.lidar2D_distanceCount;
     Lidar2DDistance const *thresholdDistances = _thresholdDistances.lidar2D_distances;
 
     CGContextRef gc = [[NSGraphicsContext currentContext] graphicsPort];
@@ -59,20 +65,18 @@
         NSRect bounds = self.bounds;
         CGContextTranslateCTM(gc, CGRectGetMidX(bounds), CGRectGetMidY(bounds));
 
-        CGFloat const indexToDegrees= _device.coverageDegrees / distanceCount;
-        CGFloat const baseDegrees = _device.firstRayOffsetDegrees;
-        CGFloat const degreesToRadians = M_PI / 180;
+        [self updateRaysForCount:distanceCount];
         NSColor *redColor = [NSColor redColor];
         NSColor *greenColor = [NSColor greenColor];
         NSColor *blueColor = [NSColor blueColor];
         __unsafe_unretained NSColor *currentColor = nil;
         
-        for (CGFloat i = 0; i < distanceCount; ++i) {
-            CGFloat distance = distances[(int)i];
+        for (NSUInteger i = 0; i < distanceCount; ++i) {
+            CGFloat distance = distances[i];
             CGFloat radius = distance / 4.0;
 
             __unsafe_unretained NSColor *desiredColor = nil;
-            if (thresholdDistances && distance < thresholdDistances[(int)i]) {
+            if (thresholdDistances && distance < thresholdDistances[i]) {
                 desiredColor = greenColor;
             } else if (distance == Lidar2DDistance_Invalid) {
                 desiredColor = blueColor;
@@ -86,15 +90,31 @@
                 currentColor = desiredColor;
             }
             
-            CGFloat x = -cos((baseDegrees + i * indexToDegrees) * degreesToRadians) * radius;
-            CGFloat y = sin((baseDegrees + i * indexToDegrees) * degreesToRadians) * radius;
+            TouchEngine::Point end = rays_.pointForRay(i, radius);
             CGContextMoveToPoint(gc, 0, 0);
-            CGContextAddLineToPoint(gc, x, y);
+            CGContextAddLineToPoint(gc, end.x, end.y);
             CGContextStrokePath(gc);
         }
     } CGContextRestoreGState(gc);
 }
 
+#pragma mark - Ray table details
+
+- (void)updateRaysForCount:(NSUInteger)count {
+    double coverageDegrees = _device.coverageDegrees;
+    double firstRayOffsetDegrees = _device.firstRayOffsetDegrees;
+    if (rays_.rayCount() == count && raysCoverageDegrees_ == coverageDegrees && raysFirstRayOffsetDegrees_ == firstRayOffsetDegrees)
+        return;
+
+    // I draw the first ray toward the left, so I mirror x.
+    TouchEngine::AffineTransform mirror;
+    mirror.a = -1;
+    double const degreesToRadians = M_PI / 180;
+    rays_.rebuild(count, firstRayOffsetDegrees * degreesToRadians, coverageDegrees / count * degreesToRadians, mirror);
+    raysCoverageDegrees_ = coverageDegrees;
+    raysFirstRayOffsetDegrees_ = firstRayOffsetDegrees;
+}
+
 #pragma mark - Lidar2DObserver protocol
 
 - (void)lidar2DDidTerminate:(Lidar2D *)device {
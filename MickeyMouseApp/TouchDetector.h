@@ -23,8 +23,51 @@ typedef enum {
     TouchCalibrationResult_MultipleTouchesDetected
 } TouchCalibrationResult;
 
+typedef enum {
+    DetectedTouchPhase_Began, // This is the first time I'm reporting this touch.
+    DetectedTouchPhase_Moved, // I reported this touch before.  Its point may not have changed.
+    DetectedTouchPhase_Ended // The touch lifted.  This is the last time I'll report its identifier.
+} DetectedTouchPhase;
+
+// A touch that I've followed from scan to scan.  Its identifier stays the same as long as the finger stays down.
+typedef struct {
+    uint32_t identifier;
+    DetectedTouchPhase phase;
+    CGPoint screenPoint;
+    CGPoint predictedScreenPoint; // where I expect the touch to be by the time you handle this, to hide the sensor and queue latency
+} DetectedTouch;
+
+typedef enum {
+    DetectedGestureType_Tap,
+    DetectedGestureType_DoubleTap,
+    DetectedGestureType_LongPress,
+    DetectedGestureType_Drag,
+    DetectedGestureType_Scroll,
+    DetectedGestureType_Pinch,
+    DetectedGestureType_Swipe
+} DetectedGestureType;
+
+typedef enum {
+    DetectedGesturePhase_Began,
+    DetectedGesturePhase_Changed,
+    DetectedGesturePhase_Ended,
+    DetectedGesturePhase_Recognized // for taps, double-taps and swipes, which happen all at once
+} DetectedGesturePhase;
+
+// A gesture that I recognized from the touches I tracked.  See `TouchEngine::GestureEvent`.
+typedef struct {
+    DetectedGestureType type;
+    DetectedGesturePhase phase;
+    NSTimeInterval timestamp; // when the sensor saw the touches that settled this gesture, on the `CFAbsoluteTimeGetCurrent` clock, so you can deliver it with the same timing
+    CGPoint screenPoint; // for a drag's beginning, where the finger landed
+    CGPoint translation; // Drag, LongPress and Scroll: how far the gesture moved since its previous event; for a drag's beginning, from where the finger landed to where it is now
+    CGFloat scale; // Pinch: how much the fingers spread since the gesture's previous event
+    CGPoint velocity; // Swipe: in screen points per second
+} DetectedGesture;
+
 @protocol TouchDetectorObserver;
 
+// I connect a `TouchEngine::Engine`, which holds all of the detection logic, to a `Lidar2D`, the screens and the user defaults.
 @interface TouchDetector : NSObject
 
 - (id)initWithDevice:(Lidar2D *)device;
@@ -71,6 +114,12 @@ typedef enum {
 // Touch detection.
 - (void)touchDetector:(TouchDetector *)detector didDetectTouches:(NSUInteger)count atScreenPoints:(CGPoint const *)points;
 
+// I send this right after `touchDetector:didDetectTouches:atScreenPoints:` with the same touches, followed from earlier scans, plus the touches that just lifted.  I also send it when I stop detecting touches, with every touch ended.  `touches` is ordered oldest first.
+- (void)touchDetector:(TouchDetector *)detector didTrackTouches:(DetectedTouch const *)touches count:(NSUInteger)count;
+
+// I send this right after `touchDetector:didTrackTouches:count:` when the tracked touches settled some gestures.  I decide each gesture as soon as the touches allow, so a tap arrives with the touches that lifted.
+- (void)touchDetector:(TouchDetector *)detector didRecognizeGestures:(DetectedGesture const *)gestures count:(NSUInteger)count;
+
 // For the raw data graph view.
 - (void)touchDetector:(TouchDetector *)detector didUpdateTouchThresholds:(Lidar2DDistance const *)thresholds count:(NSUInteger)count;
 
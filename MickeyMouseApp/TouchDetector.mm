@@ -1,33 +1,106 @@
 //  Copyright (c) 2012 Rob Mayoff. All rights reserved.
 
 #import "DqdObserverSet.h"
-#import "EWMATouchSelection.h"
 #import "Lidar2D.h"
-#import "MiddleRayTouchSelection.h"
 #import "NSData+Lidar2D.h"
-#import "TouchCalibration.h"
 #import "TouchDetector.h"
-#import "TouchThresholdCalibration.h"
+#import "GestureRecognizer.h"
+#import "IdlePolicy.h"
+#import "ScanBus.h"
+#import "ScanClock.h"
+#import "TouchEngine.h"
+#import "TouchPublisher.h"
+#import <memory>
 #import <vector>
 
 using std::vector;
 
-@interface TouchDetector () <Lidar2DObserver, TouchThresholdCalibrationDelegate, TouchCalibrationDelegate>
+// The engine stores distances in the same format as `Lidar2D`, so I can pass distance reports straight through.
+static_assert(sizeof(TouchEngine::Distance) == sizeof(Lidar2DDistance), "TouchEngine::Distance must match Lidar2DDistance");
+
+// I pass gesture types and phases straight through, too.
+static_assert((int)DetectedGestureType_Swipe == (int)TouchEngine::GestureType_Swipe, "DetectedGestureType must match TouchEngine::GestureType");
+static_assert((int)DetectedGesturePhase_Recognized == (int)TouchEngine::GesturePhase_Recognized, "DetectedGesturePhase must match TouchEngine::GesturePhase");
+
+@interface TouchDetector () <Lidar2DObserver>
+- (void)engineDidChangeState;
+- (void)engineDidFinishCalibratingThreshold;
+- (void)engineDidFinishCalibratingTouchAtPoint:(CGPoint)point withResult:(TouchCalibrationResult)result;
+- (void)engineDidDetectTouches:(TouchEngine::Point const *)points count:(size_t)count;
+- (void)engineDidTrackTouches:(TouchEngine::TrackedTouch const *)touches count:(size_t)count timestamp:(double)timestamp;
+- (void)engineDidUpdateThresholds:(TouchEngine::Distance const *)thresholds count:(size_t)count;
 @end
 
+namespace {
+
+// I forward notifications from the engine to the `TouchDetector` that owns me.
+class EngineObserverBridge : public TouchEngine::EngineObserver {
+public:
+    EngineObserverBridge() : detector(nil) { }
+
+    __unsafe_unretained TouchDetector *detector;
+
+    virtual void engineDidChangeState(TouchEngine::Engine &engine, TouchEngine::State state) {
+        (void)engine; (void)state;
+        [detector engineDidChangeState];
+    }
+
+    virtual void engineDidFinishCalibratingThreshold(TouchEngine::Engine &engine) {
+        (void)engine;
+        [detector engineDidFinishCalibratingThreshold];
+    }
+
+    virtual void engineDidFinishCalibratingTouch(TouchEngine::Engine &engine, TouchEngine::Point screenPoint, TouchEngine::CalibrationResult result) {
+        (void)engine;
+        TouchCalibrationResult detectorResult =
+            result == TouchEngine::CalibrationResult_NoTouchDetected ? TouchCalibrationResult_NoTouchDetected
+            : result == TouchEngine::CalibrationResult_MultipleTouchesDetected ? TouchCalibrationResult_MultipleTouchesDetected
+            : TouchCalibrationResult_Success;
+        [detector engineDidFinishCalibratingTouchAtPoint:CGPointMake(screenPoint.x, screenPoint.y) withResult:detectorResult];
+    }
+
+    virtual void engineDidDetectTouches(TouchEngine::Engine &engine, TouchEngine::Point const *points, size_t count, double timestamp) {
+        (void)engine; (void)timestamp;
+        [detector engineDidDetectTouches:points count:count];
+    }
+
+    virtual void engineDidTrackTouches(TouchEngine::Engine &engine, TouchEngine::TrackedTouch const *touches, size_t count, double timestamp) {
+        (void)engine;
+        [detector engineDidTrackTouches:touches count:count timestamp:timestamp];
+    }
+
+    virtual void engineDidUpdateThresholds(TouchEngine::Engine &engine, TouchEngine::Distance const *thresholds, size_t count) {
+        (void)engine;
+        [detector engineDidUpdateThresholds:thresholds count:count];
+    }
+};
+
+}
+
 @implementation TouchDetector {
     Lidar2D *device_;
     NSString *calibrationDataKey_;
     DqdObserverSet *observers_;
-    void (^distancesReportHandler_)(NSData *distanceData);
-    TouchThresholdCalibration *touchThresholdCalibration_;
-    TouchSelection *touchSelection_;
-    TouchCalibration *touchCalibration_;
+    EngineObserverBridge engineObserver_;
+    std::unique_ptr<TouchEngine::Engine> engine_;
+    vector<CGPoint> touchPoints_;
+    vector<DetectedTouch> trackedTouches_;
+    TouchEngine::GestureRecognizer gestureRecognizer_;
+    vector<DetectedGesture> gestures_;
+    TouchEngine::TouchPublisher touchPublisher_;
+    TouchEngine::ScanBusWriter scanBus_;
+    TouchEngine::ScanClock scanClock_;
+    double deliveryLatency_; // smoothed seconds from a scan's timestamp until I handle it on the main queue
+    TouchEngine::IdlePolicy idlePolicy_;
+    TouchEngine::IdlePolicy::Mode idleMode_; // the mode I last logged
+    TouchEngine::IdlePolicy::SensorRequest sensorRequest_; // the request I last gave the device
+    BOOL idleTickIsScheduled_;
 }
 
 #pragma mark - Public API
 
 - (void)dealloc {
+    [[NSNotificationCenter defaultCenter] removeObserver:self name:NSApplicationDidChangeScreenParametersNotification object:nil];
     [device_ removeObserver:self];
 }
 
@@ -35,60 +108,51 @@ using std::vector;
     if ((self = [super init])) {
         device_ = device;
         [device addObserver:self];
-        touchThresholdCalibration_ = [[TouchThresholdCalibration alloc] init];
-        touchThresholdCalibration_.delegate = self;
-        touchCalibration_ = [[TouchCalibration alloc] init];
-        touchCalibration_.delegate = self;
-        touchCalibration_.thresholdCalibration = touchThresholdCalibration_;
-        if (YES) {
-            touchSelection_ = [[MiddleRayTouchSelection alloc] init];
-        } else {
-            touchSelection_ = [[EWMATouchSelection alloc] init];
-        }
-        touchSelection_.thresholdCalibration = touchThresholdCalibration_;
-        [self setAppropriateNonBusyState];
+        engineObserver_.detector = self;
+        engine_.reset(new TouchEngine::Engine(engineObserver_));
+        // My observers only need to hear about scans that could change what's touching the screen, so I let the engine idle while nothing moves.
+        engine_->setChangeDetectionEnabled(true);
+        [self updateSweepSelection];
+        [self updateTouchPublisherSubscribers];
+        idleMode_ = idlePolicy_.mode();
+        sensorRequest_ = idlePolicy_.sensorRequest();
+        [self updateIdlePolicyParameters];
+        [self updateScreenRects];
+        [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(screenParametersDidChange:) name:NSApplicationDidChangeScreenParametersNotification object:nil];
     }
     return self;
 }
 
 - (void)reset {
-    [touchThresholdCalibration_ reset];
-    [touchCalibration_ reset];
-    [self setAppropriateNonBusyState];
+    engine_->reset();
 }
 
-@synthesize state = _state;
+- (TouchDetectorState)state {
+    switch (engine_->state()) {
+        case TouchEngine::State_AwaitingThresholdCalibration: return TouchDetectorState_AwaitingTouchThresholdCalibration;
+        case TouchEngine::State_CalibratingThreshold: return TouchDetectorState_CalibratingTouchThreshold;
+        case TouchEngine::State_AwaitingTouchCalibration: return TouchDetectorState_AwaitingTouchCalibration;
+        case TouchEngine::State_CalibratingTouch: return TouchDetectorState_CalibratingTouch;
+        case TouchEngine::State_DetectingTouches: return TouchDetectorState_DetectingTouches;
+    }
+}
 
 - (BOOL)canStartCalibratingTouchThreshold {
-    return ![self isBusy] && device_.isConnected;
+    return engine_->canStartCalibratingThreshold() && device_.isConnected;
 }
 
 - (void)startCalibratingTouchThreshold {
     [self requireNotBusy];
-    [touchThresholdCalibration_ reset];
-    self.state = TouchDetectorState_CalibratingTouchThreshold;
-
-    __weak TouchDetector *me = self;
-    distancesReportHandler_ = ^(NSData *distanceData) {
-        TouchDetector *self = me;
-        [self calibrateTouchThresholdWithDistanceData:distanceData];
-    };
+    engine_->startCalibratingThreshold();
 }
 
 - (BOOL)canStartCalibratingTouchAtPoint {
-    return ![self isBusy] && device_.isConnected && touchThresholdCalibration_.ready;
+    return engine_->canStartCalibratingTouch() && device_.isConnected;
 }
 
 - (void)startCalibratingTouchAtPoint:(CGPoint)point {
     [self requireNotBusy];
-    [touchCalibration_ startCalibratingTouchAtScreenPoint:point];
-    self.state = TouchDetectorState_CalibratingTouch;
-
-    __weak TouchDetector *me = self;
-    distancesReportHandler_ = ^(NSData *distanceData) {
-        TouchDetector *self = me;
-        [self calibrateTouchWithDistanceData:distanceData];
-    };
+    engine_->startCalibratingTouchAtPoint(TouchEngine::Point(point.x, point.y));
 }
 
 - (void)addObserver:(id<TouchDetectorObserver>)observer {
@@ -103,7 +167,7 @@ using std::vector;
 }
 
 - (void)notifyObserverOfCurrentState:(id<TouchDetectorObserver>)observer {
-    switch (_state) {
+    switch (self.state) {
         case TouchDetectorState_AwaitingTouchThresholdCalibration:
             [observer touchDetectorIsAwaitingTouchThresholdCalibration:self];
             break;
@@ -114,7 +178,7 @@ using std::vector;
             [observer touchDetectorIsAwaitingTouchCalibration:self];
             break;
         case TouchDetectorState_CalibratingTouch:
-            [observer touchDetector:self isCalibratingTouchAtPoint:touchCalibration_.currentCalibrationScreenPoint];
+            [observer touchDetector:self isCalibratingTouchAtPoint:[self currentCalibrationScreenPoint]];
             break;
         case TouchDetectorState_DetectingTouches:
             [observer touchDetectorIsDetectingTouches:self];
@@ -125,10 +189,12 @@ using std::vector;
 #pragma mark - Lidar2DObserver protocol
 
 - (void)lidar2dDidConnect:(Lidar2D *)device {
-    touchCalibration_.radiansPerRay = device.coverageDegrees * (2 * M_PI / 360.0) / device.rayCount;
+    engine_->setGeometry(TouchEngine::SensorGeometry(device.rayCount, device.coverageDegrees));
+    [self resetLatencyMeasurementForDevice:device];
+    [self resetIdlePolicy];
+    [self createScanBusForDevice:device];
     calibrationDataKey_ = [@"calibration-" stringByAppendingString:device.serialNumber];
     [self loadCalibrationData];
-    [self setAppropriateNonBusyState];
 }
 
 -  (void)lidar2DDidTerminate:(Lidar2D *)device {
@@ -136,159 +202,345 @@ using std::vector;
     // Nothing to do
 }
 
-- (void)lidar2d:(Lidar2D *)device didReceiveDistanceData:(NSData *)distanceData {
+- (void)lidar2d:(Lidar2D *)device didReceiveDistanceData:(NSData *)distanceData timing:(Lidar2DScanTiming)timing {
     (void)device;
-    if (distancesReportHandler_) {
-        distancesReportHandler_(distanceData);
+    double timestamp = scanClock_.hostTimeForScan((uint32_t)timing.sensorTimestamp, timing.receiveTime);
+    [self measureDeliveryLatencyOfScanWithTimestamp:timestamp];
+    // Other processes get every scan, even the ones I skip while idle.
+    if (scanBus_.isCreated() && distanceData.lidar2D_distanceCount <= scanBus_.maximumRayCount()) {
+        scanBus_.publish(distanceData.lidar2D_distances, distanceData.lidar2D_distanceCount, timestamp, timing.receiveTime, (uint32_t)timing.sensorTimestamp);
+    }
+    // I only slow down while detecting touches; calibration needs every scan.
+    BOOL detecting = engine_->state() == TouchEngine::State_DetectingTouches;
+    if (detecting && !idlePolicy_.shouldExamineScan(timestamp))
+        return;
+    size_t skippedScanCount = engine_->skippedScanCount();
+    CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+    engine_->processScan(distanceData.lidar2D_distances, distanceData.lidar2D_distanceCount, timestamp);
+    if (detecting && engine_->state() == TouchEngine::State_DetectingTouches) {
+        idlePolicy_.didExamineScan(timestamp, engine_->skippedScanCount() == skippedScanCount, CFAbsoluteTimeGetCurrent() - startTime);
+        [self applyIdlePolicy];
     }
 }
 
-#pragma mark - Implementation details - general state management
+#pragma mark - Engine notifications
+
+- (void)engineDidChangeState {
+    [self resetIdlePolicy];
+    gestureRecognizer_.reset();
+    [self saveCalibrationData];
+    [self notifyObserverOfCurrentState:observers_.proxy];
+}
+
+- (void)engineDidFinishCalibratingThreshold {
+    [observers_.proxy touchDetectorDidFinishCalibratingTouchThreshold:self];
+}
 
-- (void)setState:(TouchDetectorState)state {
-    if (_state != state) {
-        _state = state;
-        [self saveCalibrationData];
-        [self notifyObserverOfCurrentState:observers_.proxy];
+- (void)engineDidFinishCalibratingTouchAtPoint:(CGPoint)point withResult:(TouchCalibrationResult)result {
+    [observers_.proxy touchDetector:self didFinishCalibratingTouchAtPoint:point withResult:result];
+}
+
+- (void)engineDidDetectTouches:(TouchEngine::Point const *)points count:(size_t)count {
+    touchPoints_.clear();
+    for (size_t i = 0; i < count; ++i) {
+        touchPoints_.push_back(CGPointMake(points[i].x, points[i].y));
     }
+    [observers_.proxy touchDetector:self didDetectTouches:touchPoints_.size() atScreenPoints:touchPoints_.data()];
 }
 
-- (void)setAppropriateNonBusyState {
-    TouchDetectorState newState =
-        !touchThresholdCalibration_.ready ? TouchDetectorState_AwaitingTouchThresholdCalibration
-        : !touchCalibration_.ready ? TouchDetectorState_AwaitingTouchCalibration
-        : TouchDetectorState_DetectingTouches;
-    if (newState != _state) {
-        self.state = newState;
-        if (newState == TouchDetectorState_DetectingTouches) {
-            [self startDetectingTouches];
+- (void)engineDidTrackTouches:(TouchEngine::TrackedTouch const *)touches count:(size_t)count timestamp:(double)timestamp {
+    if (touchPublisher_.subscriberCount() > 0) {
+        vector<TouchEngine::Point> const &points = engine_->detectedScreenPoints();
+        touchPublisher_.publish(timestamp, touches, count, points.data(), engine_->detectedSensorTouches().data(), points.size());
+    }
+
+    trackedTouches_.clear();
+    for (size_t i = 0; i < count; ++i) {
+        DetectedTouch touch;
+        touch.identifier = touches[i].identifier;
+        touch.phase = touches[i].phase == TouchEngine::TouchPhase_Began ? DetectedTouchPhase_Began
+            : touches[i].phase == TouchEngine::TouchPhase_Ended ? DetectedTouchPhase_Ended
+            : DetectedTouchPhase_Moved;
+        touch.screenPoint = CGPointMake(touches[i].position.x, touches[i].position.y);
+        touch.predictedScreenPoint = CGPointMake(touches[i].predictedPosition.x, touches[i].predictedPosition.y);
+        trackedTouches_.push_back(touch);
+    }
+    [observers_.proxy touchDetector:self didTrackTouches:trackedTouches_.data() count:trackedTouches_.size()];
+
+    gestureRecognizer_.update(touches, count, timestamp);
+    if (gestureRecognizer_.eventCount() > 0) {
+        gestures_.clear();
+        for (size_t i = 0; i < gestureRecognizer_.eventCount(); ++i) {
+            TouchEngine::GestureEvent const &event = gestureRecognizer_.events()[i];
+            DetectedGesture gesture;
+            gesture.type = (DetectedGestureType)event.type;
+            gesture.phase = (DetectedGesturePhase)event.phase;
+            gesture.timestamp = event.timestamp;
+            gesture.screenPoint = CGPointMake(event.position.x, event.position.y);
+            gesture.translation = CGPointMake(event.translation.x, event.translation.y);
+            gesture.scale = event.scale;
+            gesture.velocity = CGPointMake(event.velocity.x, event.velocity.y);
+            gestures_.push_back(gesture);
         }
+        [observers_.proxy touchDetector:self didRecognizeGestures:gestures_.data() count:gestures_.size()];
     }
 }
 
-// When this returns YES, it means I'm doing something that reads from the device, so I can't start anything new that reads from the device.
-- (BOOL)isBusy {
-    switch (_state) {
-        case TouchDetectorState_AwaitingTouchThresholdCalibration: return NO;
-        case TouchDetectorState_CalibratingTouchThreshold: return YES;
-        case TouchDetectorState_AwaitingTouchCalibration: return NO;
-        case TouchDetectorState_CalibratingTouch: return YES;
-        case TouchDetectorState_DetectingTouches: return NO;
-    }
+- (void)engineDidUpdateThresholds:(TouchEngine::Distance const *)thresholds count:(size_t)count {
+    [observers_.proxy touchDetector:self didUpdateTouchThresholds:thresholds count:count];
+}
+
+#pragma mark - Implementation details - general state management
+
+- (CGPoint)currentCalibrationScreenPoint {
+    TouchEngine::Point point = engine_->currentCalibrationScreenPoint();
+    return CGPointMake(point.x, point.y);
 }
 
 // I throw an exception if I'm busy.
 - (void)requireNotBusy {
-    if ([self isBusy]) {
-        [NSException raise:NSInternalInconsistencyException format:@"received %s while in state %@", __func__, [self stateString]];
+    if (engine_->isBusy()) {
+        [NSException raise:NSInternalInconsistencyException format:@"received %s while in state %s", __func__, TouchEngine::stateName(engine_->state())];
     }
 }
 
-- (NSString *)stateString {
-#define StateString(State) case TouchDetectorState_##State: return @#State
-    switch (_state) {
-        StateString(AwaitingTouchThresholdCalibration);
-        StateString(CalibratingTouchThreshold);
-        StateString(AwaitingTouchCalibration);
-        StateString(CalibratingTouch);
-        StateString(DetectingTouches);
-    }
-#undef StateString
-}
+#pragma mark - Latency details
 
-#pragma mark - Calibration data serialization
+// A scan reaches me a while after the sensor takes it: the bytes have to arrive, and then the main queue has to get to it.  I tell the engine how long that takes, so it can predict where touches will be when my observers handle them.
 
-static NSString *const kTouchThresholdKey = @"touchThreshold";
-static NSString *const kTouchKey = @"touch";
+static double const kDeliveryLatencySmoothing = 0.05;
 
-- (void)loadCalibrationData {
-    NSDictionary *plist = [[NSUserDefaults standardUserDefaults] valueForKey:calibrationDataKey_];
-    if (plist) {
-        [touchThresholdCalibration_ restoreDataPropertyList:plist[kTouchThresholdKey]];
-        [touchCalibration_ restoreDataPropertyList:plist[kTouchKey]];
+- (void)resetLatencyMeasurementForDevice:(Lidar2D *)device {
+    scanClock_.reset();
+    deliveryLatency_ = 0;
+    TouchEngine::MotionPredictor::Parameters parameters = engine_->motionPredictor().parameters();
+    // The sensor's timestamp is from around the start of a scan, so on average it sees a finger half a scan period earlier.
+    if (device.scanFrequency > 0) {
+        parameters.sensorLatency = 0.5 / device.scanFrequency;
     }
+    engine_->setMotionPredictorParameters(parameters);
 }
 
-- (void)saveCalibrationData {
-    NSDictionary *plist = @{
-        kTouchThresholdKey: [touchThresholdCalibration_ dataPropertyList],
-        kTouchKey: [touchCalibration_ dataPropertyList]
-    };
-    [[NSUserDefaults standardUserDefaults] setValue:plist forKey:calibrationDataKey_];
+- (void)measureDeliveryLatencyOfScanWithTimestamp:(double)timestamp {
+    double latency = CFAbsoluteTimeGetCurrent() - timestamp;
+    deliveryLatency_ = deliveryLatency_ > 0 ? deliveryLatency_ + kDeliveryLatencySmoothing * (latency - deliveryLatency_) : latency;
+    engine_->setDeliveryLatency(deliveryLatency_);
 }
 
-#pragma mark - Touch threshold calibration details
+#pragma mark - Idle power
+
+// While nobody touches the surface, I look at fewer scans, and if the user defaults ask for it, I slow the sensor down and turn its laser off between peeks.  The first scan I look at that shows a change brings everything back to full rate.
+static NSString *const kIdleSensorSkipScansKey = @"idleSensorSkipScans";
+static NSString *const kDormantAfterSecondsKey = @"dormantAfterSeconds";
+
+- (void)updateIdlePolicyParameters {
+    NSUserDefaults *defaults = [NSUserDefaults standardUserDefaults];
+    TouchEngine::IdlePolicy::Parameters parameters = idlePolicy_.parameters();
+    parameters.idleSensorSkipScans = (unsigned)MAX([defaults integerForKey:kIdleSensorSkipScansKey], 0);
+    parameters.dormantAfterSeconds = MAX([defaults doubleForKey:kDormantAfterSecondsKey], 0);
+    idlePolicy_.setParameters(parameters);
+}
 
-- (void)calibrateTouchThresholdWithDistanceData:(NSData *)distanceData {
-    [touchThresholdCalibration_ calibrateWithDistanceData:distanceData];
-    [self stopCalibratingTouchThresholdIfReady];
+- (void)resetIdlePolicy {
+    idlePolicy_.reset(CFAbsoluteTimeGetCurrent());
+    [self applyIdlePolicy];
 }
 
-- (void)stopCalibratingTouchThresholdIfReady {
-    if (touchThresholdCalibration_.ready) {
-        distancesReportHandler_ = nil;
-        [observers_.proxy touchDetectorDidFinishCalibratingTouchThreshold:self];
-        [self setAppropriateNonBusyState];
+- (void)applyIdlePolicy {
+    TouchEngine::IdlePolicy::Mode mode = idlePolicy_.mode();
+    if (mode != idleMode_) {
+        idleMode_ = mode;
+        [self logIdleReport];
+    }
+
+    TouchEngine::IdlePolicy::SensorRequest request = idlePolicy_.sensorRequest();
+    if (request != sensorRequest_) {
+        sensorRequest_ = request;
+        [device_ setScanSkipCount:request.skipScans laserOn:request.laserOn];
+    }
+
+    // While the laser is off, no scans arrive to wake the policy, so I wake it for its next peek.
+    double tickTime = idlePolicy_.nextTickTime();
+    if (tickTime < HUGE_VAL && !idleTickIsScheduled_) {
+        idleTickIsScheduled_ = YES;
+        double delay = MAX(tickTime - CFAbsoluteTimeGetCurrent(), 0.0);
+        __weak TouchDetector *weakSelf = self;
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
+            [weakSelf idleTickDidFire];
+        });
     }
 }
 
-- (void)touchThresholdCalibration:(TouchThresholdCalibration *)calibration didUpdateThresholds:(const Lidar2DDistance *)thresholds count:(NSUInteger)count {
-    (void)calibration;
-    [observers_.proxy touchDetector:self didUpdateTouchThresholds:thresholds count:count];
+- (void)idleTickDidFire {
+    idleTickIsScheduled_ = NO;
+    idlePolicy_.tick(CFAbsoluteTimeGetCurrent());
+    [self applyIdlePolicy];
 }
 
-#pragma mark - Touch calibration details
+- (void)logIdleReport {
+    TouchEngine::IdlePolicy::Report report = idlePolicy_.report();
+    NSLog(@"touch detector is %s; wake latency %.0f ms mean, %.0f ms worst over %lu wakes", TouchEngine::idleModeName(idleMode_), 1000 * report.meanWakeLatency, 1000 * report.worstWakeLatency, (unsigned long)report.wakeCount);
+    for (int m = 0; m < TouchEngine::IdlePolicy::Mode_Count; ++m) {
+        TouchEngine::IdlePolicy::ModeStatistics const &statistics = report.modes[m];
+        if (statistics.seconds <= 0)
+            continue;
+        NSLog(@"  %-7s %9.0f s  %6.1f scans/s received  %6.1f scans/s examined  %6.3f%% CPU", TouchEngine::idleModeName((TouchEngine::IdlePolicy::Mode)m), statistics.seconds,
+            statistics.scansReceived / statistics.seconds, statistics.scansExamined / statistics.seconds, 100 * statistics.processingSeconds / statistics.seconds);
+    }
+}
+
+#pragma mark - Touch selection
+
+// The name of a selection for `TouchEngine::makeSweepSelection`, like `defaults write <bundle id> touchSelection ewma`.  I keep the engine's default if it's missing or unknown.
+static NSString *const kTouchSelectionKey = @"touchSelection";
 
-- (void)calibrateTouchWithDistanceData:(NSData *)distanceData {
-    [touchCalibration_ calibrateWithDistanceData:distanceData];
+- (void)updateSweepSelection {
+    NSString *name = [[NSUserDefaults standardUserDefaults] stringForKey:kTouchSelectionKey];
+    if (!name)
+        return;
+    std::unique_ptr<TouchEngine::SweepSelection> selection = TouchEngine::makeSweepSelection(name.UTF8String);
+    if (!selection) {
+        NSLog(@"ignoring unknown %@ %@", kTouchSelectionKey, name);
+        return;
+    }
+    engine_->setSweepSelection(std::move(selection));
 }
 
-- (void)touchCalibrationDidSucceed {
-    [self stopCalibratingTouchWithResult:TouchCalibrationResult_Success];
+#pragma mark - Touch publishing
+
+// Other processes on this machine can watch the touches without owning the sensor.  These are arrays of Unix-domain datagram socket paths, which get `TouchEngine::TouchPublisher`'s binary encoding, and of loopback UDP ports, which get TUIO, like `defaults write <bundle id> tuioPorts -array 3333`.
+static NSString *const kTouchStreamSocketsKey = @"touchStreamSockets";
+static NSString *const kTUIOPortsKey = @"tuioPorts";
+
+- (void)updateTouchPublisherSubscribers {
+    touchPublisher_.removeAllSubscribers();
+    NSUserDefaults *defaults = [NSUserDefaults standardUserDefaults];
+    for (NSString *path in [defaults arrayForKey:kTouchStreamSocketsKey]) {
+        if (![path isKindOfClass:[NSString class]] || !touchPublisher_.addUnixSubscriber(path.fileSystemRepresentation)) {
+            NSLog(@"ignoring %@ entry %@: %s", kTouchStreamSocketsKey, path, strerror(errno));
+        }
+    }
+    for (NSNumber *port in [defaults arrayForKey:kTUIOPortsKey]) {
+        if (![port isKindOfClass:[NSNumber class]] || !touchPublisher_.addUDPSubscriber(port.unsignedShortValue)) {
+            NSLog(@"ignoring %@ entry %@: %s", kTUIOPortsKey, port, strerror(errno));
+        }
+    }
 }
 
-- (void)touchCalibrationDidFailWithMultipleTouches {
-    [self stopCalibratingTouchWithResult:TouchCalibrationResult_MultipleTouchesDetected];
+#pragma mark - Scan bus
+
+// The POSIX shared memory name of a `TouchEngine::ScanBusWriter` that gets every raw scan, so other processes on this machine can read them without owning the sensor, like `defaults write <bundle id> scanBusName /mickeyMouse-scans`.  Darwin limits the name to 31 characters.
+static NSString *const kScanBusNameKey = @"scanBusName";
+
+// The ring holds 0.4 seconds of scans at 40 Hz, so a reader can be that far behind before it loses any.
+static size_t const kScanBusSlotCount = 16;
+
+- (void)createScanBusForDevice:(Lidar2D *)device {
+    scanBus_.destroy();
+    NSString *name = [[NSUserDefaults standardUserDefaults] stringForKey:kScanBusNameKey];
+    if (name.length == 0)
+        return;
+    if (!scanBus_.create(name.UTF8String, kScanBusSlotCount, device.rayCount, TouchEngine::SensorGeometry(device.rayCount, device.coverageDegrees))) {
+        NSLog(@"can't create scan bus %@: %s", name, strerror(errno));
+    }
 }
 
-- (void)touchCalibrationDidFailWithNoTouches {
-    [self stopCalibratingTouchWithResult:TouchCalibrationResult_NoTouchDetected];
+#pragma mark - Screen details
+
+// I only report touches that land on a screen.
+- (void)updateScreenRects {
+    vector<TouchEngine::Rect> rects;
+    for (NSScreen *screen in [NSScreen screens]) {
+        NSRect frame = screen.frame;
+        rects.push_back(TouchEngine::Rect(frame.origin.x, frame.origin.y, frame.size.width, frame.size.height));
+    }
+    engine_->setScreenRects(rects);
+
+    // TUIO positions are fractions of the main screen, from its top left.
+    TouchEngine::TouchPublisher::Parameters parameters = touchPublisher_.parameters();
+    if (!rects.empty()) {
+        parameters.screen = rects[0];
+    }
+    parameters.screenYGrowsUp = true;
+    touchPublisher_.setParameters(parameters);
 }
 
-- (void)stopCalibratingTouchWithResult:(TouchCalibrationResult)result {
-    distancesReportHandler_ = nil;
-    [observers_.proxy touchDetector:self didFinishCalibratingTouchAtPoint:touchCalibration_.currentCalibrationScreenPoint withResult:result];
-    [self setAppropriateNonBusyState];
+- (void)screenParametersDidChange:(NSNotification *)note {
+    (void)note;
+    [self updateScreenRects];
 }
 
-#pragma mark - Touch detection details
+#pragma mark - Calibration data serialization
 
-static BOOL isValidScreenPoint(CGPoint point) {
-    for (NSScreen *screen in [NSScreen screens]) {
-        if (CGRectContainsPoint(screen.frame, point))
-            return YES;
+// These keys and encodings predate the touch engine.  I keep them so existing calibrations still load.
+static NSString *const kTouchThresholdKey = @"touchThreshold";
+static NSString *const kTouchKey = @"touch";
+static NSString *const kReadyKey = @"ready";
+static NSString *const kThresholdDistancesKey = @"distances";
+static NSString *const kSensorPointsKey = @"sensorPoints";
+static NSString *const kScreenPointsKey = @"screenPoints";
+
+static NSData *dataWithPoints(vector<TouchEngine::Point> const &points) {
+    vector<CGPoint> cgPoints;
+    for (auto p = points.begin(); p != points.end(); ++p) {
+        cgPoints.push_back(CGPointMake(p->x, p->y));
     }
-    return NO;
+    return [NSData dataWithBytes:cgPoints.data() length:cgPoints.size() * sizeof cgPoints[0]];
 }
 
-- (void)detectTouchesWithDistanceData:(NSData *)distanceData {
-    __block vector<CGPoint> touchPoints;
-    [touchSelection_ forEachTouchInDistanceData:distanceData do:^(NSUInteger rayIndex, Lidar2DDistance distance) {
-        CGPoint screenPoint = [touchCalibration_ screenPointForRayIndex:rayIndex distance:distance];
-        if (isValidScreenPoint(screenPoint)) {
-            touchPoints.push_back(screenPoint);
-        }
-    }];
-    [observers_.proxy touchDetector:self didDetectTouches:touchPoints.size() atScreenPoints:touchPoints.data()];
+static void getPointsFromData(NSData *data, vector<TouchEngine::Point> &points) {
+    CGPoint const *p = (CGPoint const *)data.bytes;
+    NSUInteger count = data.length / sizeof *p;
+    points.clear();
+    for (NSUInteger i = 0; i < count; ++i) {
+        points.push_back(TouchEngine::Point(p[i].x, p[i].y));
+    }
 }
 
-- (void)startDetectingTouches {
-    self.state = TouchDetectorState_DetectingTouches;
+- (void)loadCalibrationData {
+    NSDictionary *plist = [[NSUserDefaults standardUserDefaults] valueForKey:calibrationDataKey_];
+    if (!plist)
+        return;
+
+    TouchEngine::CalibrationData data;
+    NSDictionary *thresholdPlist = plist[kTouchThresholdKey];
+    data.thresholdsReady = [thresholdPlist[kReadyKey] boolValue];
+    if (data.thresholdsReady) {
+        NSData *distanceData = thresholdPlist[kThresholdDistancesKey];
+        Lidar2DDistance const *distances = distanceData.lidar2D_distances;
+        data.thresholds.assign(distances, distances + distanceData.lidar2D_distanceCount);
+    }
+
+    NSDictionary *touchPlist = plist[kTouchKey];
+    NSData *sensorPointsData = touchPlist[kSensorPointsKey];
+    NSData *screenPointsData = touchPlist[kScreenPointsKey];
+    if (sensorPointsData && screenPointsData) {
+        getPointsFromData(sensorPointsData, data.sensorPoints);
+        getPointsFromData(screenPointsData, data.screenPoints);
+    }
+
+    engine_->restoreCalibrationData(data);
+}
 
-    __weak TouchDetector *me = self;
-    distancesReportHandler_ = ^(NSData *distanceData) {
-        [me detectTouchesWithDistanceData:distanceData];
+- (void)saveCalibrationData {
+    if (!calibrationDataKey_)
+        return;
+
+    TouchEngine::CalibrationData data = engine_->calibrationData();
+    NSDictionary *thresholdPlist = data.thresholdsReady
+        ? @{
+            kReadyKey: @YES,
+            kThresholdDistancesKey: [NSData dataWithBytes:data.thresholds.data() length:data.thresholds.size() * sizeof data.thresholds[0]]
+        }
+        : @{ kReadyKey: @NO };
+    NSDictionary *plist = @{
+        kTouchThresholdKey: thresholdPlist,
+        kTouchKey: @{
+            kSensorPointsKey: dataWithPoints(data.sensorPoints),
+            kScreenPointsKey: dataWithPoints(data.screenPoints)
+        }
     };
+    [[NSUserDefaults standardUserDefaults] setValue:plist forKey:calibrationDataKey_];
 }
 
 @end
@@ -0,0 +1,70 @@
+//
+//  AffineFit.cpp
+//  mickeyMouse
+//
+//  Copyright (c) 2012 Rob Mayoff. All rights reserved.
+//
+
+#include "AffineFit.h"
+
+namespace TouchEngine {
+
+// If the determinant of the sensor co-moments is this small relative to the product of their variances, I treat the sensor points as collinear.
+static double const kCollinearTolerance = 1e-9;
+
+void AffineFit::reset() {
+    weight_ = 0;
+    sensorMean_ = Point();
+    screenMean_ = Point();
+    xx_ = xy_ = yy_ = 0;
+    ux_ = uy_ = vx_ = vy_ = 0;
+}
+
+void AffineFit::add(Point sensorPoint, Point screenPoint, double weight) {
+    if (!(weight > 0))
+        return;
+
+    // This is West's weighted update: each co-moment grows by the product of the deviations from the old means, scaled by the weight of the new pair and the share of the old pairs.
+    double newWeight = weight_ + weight;
+    double scale = weight * weight_ / newWeight;
+    double dx = sensorPoint.x - sensorMean_.x;
+    double dy = sensorPoint.y - sensorMean_.y;
+    double du = screenPoint.x - screenMean_.x;
+    double dv = screenPoint.y - screenMean_.y;
+
+    xx_ += scale * dx * dx;
+    xy_ += scale * dx * dy;
+    yy_ += scale * dy * dy;
+    ux_ += scale * du * dx;
+    uy_ += scale * du * dy;
+    vx_ += scale * dv * dx;
+    vy_ += scale * dv * dy;
+
+    double share = weight / newWeight;
+    sensorMean_.x += share * dx;
+    sensorMean_.y += share * dy;
+    screenMean_.x += share * du;
+    screenMean_.y += share * dv;
+    weight_ = newWeight;
+}
+
+bool AffineFit::solve(AffineTransform &transform) const {
+    double determinant = xx_ * yy_ - xy_ * xy_;
+    if (!(determinant > kCollinearTolerance * xx_ * yy_))
+        return false;
+
+    double a = (ux_ * yy_ - uy_ * xy_) / determinant;
+    double c = (uy_ * xx_ - ux_ * xy_) / determinant;
+    double b = (vx_ * yy_ - vy_ * xy_) / determinant;
+    double d = (vy_ * xx_ - vx_ * xy_) / determinant;
+
+    transform.a = a;
+    transform.b = b;
+    transform.c = c;
+    transform.d = d;
+    transform.tx = screenMean_.x - a * sensorMean_.x - c * sensorMean_.y;
+    transform.ty = screenMean_.y - b * sensorMean_.x - d * sensorMean_.y;
+    return true;
+}
+
+}
@@ -0,0 +1,45 @@
+//
+//  AffineFit.h
+//  mickeyMouse
+//
+//  Copyright (c) 2012 Rob Mayoff. All rights reserved.
+//
+
+#ifndef AffineFit_h
+#define AffineFit_h
+
+#include "TouchEngineTypes.h"
+
+namespace TouchEngine {
+
+// I fit an affine transform from sensor points to screen points by weighted least squares, one pair of points at a time.  Adding a pair and solving each cost O(1), however many pairs I've seen, so a calibration can keep refining itself as touches come in.
+//
+// I keep the normal equations of the fit in centered form: the weighted means of the points and their weighted co-moments about those means.  That's the same information as the 3x3 normal matrix, but the translation drops out, leaving a 2x2 system I solve directly.  I update the means as I go, so I don't suffer the cancellation that raw sums of squares do when the points are far from the origin.
+class AffineFit {
+public:
+    AffineFit() { reset(); }
+
+    // I forget every pair.
+    void reset();
+
+    // I add a pair.  A calibration touch has weight 1.  Give a touch you're less sure of a smaller weight.
+    void add(Point sensorPoint, Point screenPoint, double weight = 1);
+
+    double totalWeight() const { return weight_; }
+
+    // I set `transform` to the transform that best fits my pairs.  If the sensor points are collinear, which includes having fewer than three, no unique transform fits, so I return false and leave `transform` alone.
+    bool solve(AffineTransform &transform) const;
+
+private:
+    double weight_;
+    Point sensorMean_;
+    Point screenMean_;
+
+    // Weighted co-moments.  x and y are the sensor coordinates; u and v are the screen coordinates.
+    double xx_, xy_, yy_;
+    double ux_, uy_, vx_, vy_;
+};
+
+}
+
+#endif
@@ -0,0 +1,159 @@
+//
+//  BackgroundModel.cpp
+//  mickeyMouse
+//
+//  Copyright (c) 2012 Rob Mayoff. All rights reserved.
+//
+
+#include "BackgroundModel.h"
+#include "SweepKernel.h"
+#include <algorithm>
+
+using std::vector;
+
+namespace TouchEngine {
+
+static uint16_t const kMaximumTouchedScans = UINT16_MAX;
+
+BackgroundModel::Parameters::Parameters()
+    : learningRate(0.01f), sigmaMultiplier(4), minimumMarginFraction(1 - 0.95f), guardRays(2), publishIntervalScans(40), absorbAfterScans(40 * 60)
+{ }
+
+BackgroundModel::BackgroundModel()
+    : scansSincePublish_(0)
+{ }
+
+void BackgroundModel::seed(vector<Distance> const &thresholds, float thresholdScale) {
+    size_t count = thresholds.size();
+    means_.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        means_[i] = isValidDistance(thresholds[i]) ? thresholds[i] / thresholdScale : kInvalidDistance;
+    }
+    variances_.assign(count, 0);
+    touchedScans_.assign(count, 0);
+    excludedMask_.assign(touchedRayMaskWordCount(count), 0);
+    previousTouchedMask_.assign(touchedRayMaskWordCount(count), 0);
+    scansSincePublish_ = 0;
+}
+
+void BackgroundModel::clear() {
+    means_.clear();
+    variances_.clear();
+    touchedScans_.clear();
+    excludedMask_.clear();
+    previousTouchedMask_.clear();
+    scansSincePublish_ = 0;
+}
+
+// A ray is excluded if it or any ray within `guard` of it is touched.
+static void dilateMask(uint64_t const *mask, size_t wordCount, unsigned guard, uint64_t *dilated) {
+    guard = std::min(guard, 63u);
+    for (size_t w = 0; w < wordCount; ++w) {
+        uint64_t word = mask[w];
+        uint64_t previous = w > 0 ? mask[w - 1] : 0;
+        uint64_t next = w + 1 < wordCount ? mask[w + 1] : 0;
+        uint64_t result = word;
+        for (unsigned k = 1; k <= guard; ++k) {
+            result |= (word << k) | (previous >> (64 - k));
+            result |= (word >> k) | (next << (64 - k));
+        }
+        dilated[w] = result;
+    }
+}
+
+void BackgroundModel::update(Distance const *distances, size_t count, uint64_t const *touchedMask, RayRegion const *region) {
+    if (!isSeeded())
+        return;
+    count = std::min(count, means_.size());
+    size_t wordCount = touchedRayMaskWordCount(count);
+    dilateMask(touchedMask, wordCount, parameters_.guardRays, excludedMask_.data());
+
+    float *means = means_.data();
+    float *variances = variances_.data();
+    uint16_t *touchedScans = touchedScans_.data();
+    float const rate = parameters_.learningRate;
+    unsigned const absorbAfter = parameters_.absorbAfterScans;
+    uint64_t const *regionMask = region && !region->includesEverything() ? region->mask() : NULL;
+    size_t const regionWordCount = regionMask ? touchedRayMaskWordCount(region->rayCount()) : 0;
+
+    for (size_t w = 0; w < wordCount; ++w) {
+        size_t base = w * kTouchedRayMaskBitsPerWord;
+        size_t end = std::min(base + kTouchedRayMaskBitsPerWord, count);
+        uint64_t touched = touchedMask[w];
+
+        // A ray's counter counts consecutive touched scans, so a ray that was touched last scan but isn't now starts over.
+        for (uint64_t bits = previousTouchedMask_[w] & ~touched; bits; bits &= bits - 1) {
+            touchedScans[base + countTrailingZeros(bits)] = 0;
+        }
+        previousTouchedMask_[w] = touched;
+
+        // An invalid distance leaves a ray's statistics alone, so a word outside the region has nothing to learn.
+        if (w < regionWordCount && regionMask[w] == 0)
+            continue;
+
+        uint64_t learnable = ~excludedMask_[w];
+        for (uint64_t bits = touched; bits; bits &= bits - 1) {
+            size_t i = base + countTrailingZeros(bits);
+            if (touchedScans[i] < kMaximumTouchedScans) {
+                ++touchedScans[i];
+            }
+            if (absorbAfter && touchedScans[i] >= absorbAfter) {
+                learnable |= (uint64_t)1 << (i - base);
+                // A ray with no surface behind it has no mean to move, so it takes the new distance outright.
+                if (!isValidDistance(means[i]) && isValidDistance(distances[i])) {
+                    means[i] = distances[i];
+                    variances[i] = 0;
+                }
+            }
+        }
+
+        // Few rays are excluded, so rather than test every ray's bit in the update loop, I save the excluded rays' statistics, update every ray, and put the saved ones back.  That keeps the mask out of the per-ray loop, which is the hot part of this method.
+        float savedMeans[kTouchedRayMaskBitsPerWord];
+        float savedVariances[kTouchedRayMaskBitsPerWord];
+        uint64_t excluded = ~learnable;
+        for (uint64_t bits = excluded; bits; bits &= bits - 1) {
+            size_t j = countTrailingZeros(bits);
+            if (base + j < end) {
+                savedMeans[j] = means[base + j];
+                savedVariances[j] = variances[base + j];
+            }
+        }
+
+        for (size_t i = base; i < end; ++i) {
+            Distance distance = distances[i];
+            float mean = means[i];
+            // An invalid distance or mean gets weight zero, which leaves the ray's statistics unchanged.
+            bool ok = isValidDistance(distance) && isValidDistance(mean);
+            float weight = ok ? rate : 0.0f;
+            float difference = ok ? distance - mean : 0.0f;
+            float increment = weight * difference;
+            means[i] = mean + increment;
+            variances[i] = (1 - weight) * (variances[i] + difference * increment);
+        }
+
+        for (uint64_t bits = excluded; bits; bits &= bits - 1) {
+            size_t j = countTrailingZeros(bits);
+            if (base + j < end) {
+                means[base + j] = savedMeans[j];
+                variances[base + j] = savedVariances[j];
+            }
+        }
+    }
+
+    ++scansSincePublish_;
+}
+
+void BackgroundModel::computeThresholds(vector<Distance> &thresholds) {
+    size_t count = means_.size();
+    thresholds.resize(count);
+    float const sigmaMultiplier = parameters_.sigmaMultiplier;
+    float const marginFraction = parameters_.minimumMarginFraction;
+    for (size_t i = 0; i < count; ++i) {
+        float mean = means_[i];
+        float margin = std::max(sigmaMultiplier * sqrtf(variances_[i]), marginFraction * mean);
+        thresholds[i] = isValidDistance(mean) ? mean - margin : kInvalidDistance;
+    }
+    scansSincePublish_ = 0;
+}
+
+}
@@ -0,0 +1,85 @@
+//
+//  BackgroundModel.h
+//  mickeyMouse
+//
+//  Copyright (c) 2012 Rob Mayoff. All rights reserved.
+//
+
+#ifndef BackgroundModel_h
+#define BackgroundModel_h
+
+#include "RayRegion.h"
+#include "TouchEngineTypes.h"
+#include <stdint.h>
+#include <vector>
+
+namespace TouchEngine {
+
+// I keep learning what the untouched surface looks like while the engine detects touches, so the thresholds follow slow drift (the mount settling, temperature, furniture moved farther away) without a manual recalibration.
+//
+// For each ray I keep an exponentially-weighted running mean and variance of the distance.  I only learn from rays that aren't part of a touch, and not from the few rays next to a touch either, because the edge of a finger often reads as a partial hit.  A ray that stays touched for `absorbAfterScans` scans in a row is learned anyway, so an object placed closer than the old surface stops looking like a touch eventually.
+//
+// I don't touch the detector.  When `isDueToPublish` is true, send me `computeThresholds` and publish the result to the `ThresholdCalibration`.
+class BackgroundModel {
+public:
+    struct Parameters {
+        // The weight of each new scan in the running statistics.  At 40 scans per second, 0.01 has a time constant of about 2.5 seconds.
+        float learningRate;
+
+        // A ray's threshold is its mean minus the larger of `sigmaMultiplier` standard deviations and `minimumMarginFraction` of the mean.
+        float sigmaMultiplier;
+        float minimumMarginFraction;
+
+        // How many rays on each side of a touched sweep I also leave alone.
+        unsigned guardRays;
+
+        // How many scans go by between publications.
+        unsigned publishIntervalScans;
+
+        // How many consecutive touched scans before I learn a ray anyway.  Zero means never.
+        unsigned absorbAfterScans;
+
+        Parameters();
+    };
+
+    BackgroundModel();
+
+    void setParameters(Parameters const &parameters) { parameters_ = parameters; }
+    Parameters const &parameters() const { return parameters_; }
+
+    // I forget everything and start over from `thresholds`, which were computed by scaling the untouched surface by `thresholdScale`.
+    void seed(std::vector<Distance> const &thresholds, float thresholdScale);
+
+    // I forget everything and stop learning until I'm seeded again.
+    void clear();
+
+    bool isSeeded() const { return !means_.empty(); }
+
+    // I learn from one scan.  `touchedMask` has one bit per ray, set for rays that are shorter than the current thresholds (see `ThresholdCalibration::computeTouchedRayMask`).  I ignore rays past my seeded ray count.  If you give me a `region`, I skip the 64-ray words that have none of its rays, which must be invalid in `distances` (see `RayRegion::restrictScan`).
+    void update(Distance const *distances, size_t count, uint64_t const *touchedMask, RayRegion const *region = NULL);
+
+    bool isDueToPublish() const { return isSeeded() && scansSincePublish_ >= parameters_.publishIntervalScans; }
+
+    // I store the current thresholds in `thresholds` and restart the publication interval.
+    void computeThresholds(std::vector<Distance> &thresholds);
+
+    std::vector<float> const &means() const { return means_; }
+    std::vector<float> const &variances() const { return variances_; }
+
+private:
+    Parameters parameters_;
+    std::vector<float> means_;
+    std::vector<float> variances_;
+    std::vector<uint16_t> touchedScans_;
+
+    // The touched rays from the previous scan, so I know whose `touchedScans_` to reset.
+    std::vector<uint64_t> previousTouchedMask_;
+
+    // Scratch space for `update`: the rays I mustn't learn from in this scan.
+    std::vector<uint64_t> excludedMask_;
+    unsigned scansSincePublish_;
+};
+
+}
+
+#endif
@@ -0,0 +1,143 @@
+//
+//  ChangeDetector.cpp
+//  mickeyMouse
+//
+//  Copyright (c) 2012 Rob Mayoff. All rights reserved.
+//
+
+#include "ChangeDetector.h"
+#include "SweepKernel.h"
+#include <algorithm>
+#include <math.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define TOUCH_ENGINE_X86 1
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define TOUCH_ENGINE_NEON 1
+#include <arm_neon.h>
+#endif
+
+using std::vector;
+
+namespace TouchEngine {
+
+Distance const ChangeDetector::kDefaultEpsilon = 20;
+
+// Mask kernels
+
+// Two invalid distances subtract to NaN, and NaN is never greater than epsilon, so they count as the same without a special case.  An invalid distance minus a valid one is infinite, so they differ.
+
+static void computeChangedRayMaskTail(Distance const *distances, Distance const *reference, size_t begin, size_t count, Distance epsilon, uint64_t *mask) {
+    if (begin >= count)
+        return;
+    uint64_t word = 0;
+    for (size_t i = begin; i < count; ++i) {
+        word |= (uint64_t)(fabsf(distances[i] - reference[i]) > epsilon) << (i - begin);
+    }
+    mask[begin / kTouchedRayMaskBitsPerWord] = word;
+}
+
+void computeChangedRayMaskScalar(Distance const *distances, Distance const *reference, size_t count, Distance epsilon, uint64_t *mask) {
+    size_t fullWords = count / kTouchedRayMaskBitsPerWord;
+    for (size_t w = 0; w < fullWords; ++w) {
+        Distance const *d = distances + w * kTouchedRayMaskBitsPerWord;
+        Distance const *r = reference + w * kTouchedRayMaskBitsPerWord;
+        uint64_t word = 0;
+        for (unsigned i = 0; i < kTouchedRayMaskBitsPerWord; ++i) {
+            word |= (uint64_t)(fabsf(d[i] - r[i]) > epsilon) << i;
+        }
+        mask[w] = word;
+    }
+    computeChangedRayMaskTail(distances, reference, fullWords * kTouchedRayMaskBitsPerWord, count, epsilon, mask);
+}
+
+#if TOUCH_ENGINE_X86
+
+// SSE2 is part of x86-64, so I don't need to check for it.  Like the median filter, this is one pass over a short scan, so wider vectors wouldn't pay for a dispatch.
+void computeChangedRayMask(Distance const *distances, Distance const *reference, size_t count, Distance epsilon, uint64_t *mask) {
+    __m128 const signBit = _mm_set1_ps(-0.0f);
+    __m128 const limit = _mm_set1_ps(epsilon);
+    size_t fullWords = count / kTouchedRayMaskBitsPerWord;
+    for (size_t w = 0; w < fullWords; ++w) {
+        Distance const *d = distances + w * kTouchedRayMaskBitsPerWord;
+        Distance const *r = reference + w * kTouchedRayMaskBitsPerWord;
+        uint64_t word = 0;
+        for (unsigned i = 0; i < kTouchedRayMaskBitsPerWord; i += 4) {
+            __m128 difference = _mm_andnot_ps(signBit, _mm_sub_ps(_mm_loadu_ps(d + i), _mm_loadu_ps(r + i)));
+            word |= (uint64_t)(unsigned)_mm_movemask_ps(_mm_cmpgt_ps(difference, limit)) << i;
+        }
+        mask[w] = word;
+    }
+    computeChangedRayMaskTail(distances, reference, fullWords * kTouchedRayMaskBitsPerWord, count, epsilon, mask);
+}
+
+#elif TOUCH_ENGINE_NEON
+
+void computeChangedRayMask(Distance const *distances, Distance const *reference, size_t count, Distance epsilon, uint64_t *mask) {
+    static uint32_t const kLaneBits[4] = { 1, 2, 4, 8 };
+    uint32x4_t const laneBits = vld1q_u32(kLaneBits);
+    float32x4_t const limit = vdupq_n_f32(epsilon);
+    size_t fullWords = count / kTouchedRayMaskBitsPerWord;
+    for (size_t w = 0; w < fullWords; ++w) {
+        Distance const *d = distances + w * kTouchedRayMaskBitsPerWord;
+        Distance const *r = reference + w * kTouchedRayMaskBitsPerWord;
+        uint64_t word = 0;
+        for (unsigned i = 0; i < kTouchedRayMaskBitsPerWord; i += 4) {
+            uint32x4_t changed = vandq_u32(vcgtq_f32(vabdq_f32(vld1q_f32(d + i), vld1q_f32(r + i)), limit), laneBits);
+            uint32x2_t pairs = vadd_u32(vget_low_u32(changed), vget_high_u32(changed));
+            word |= (uint64_t)(vget_lane_u32(pairs, 0) + vget_lane_u32(pairs, 1)) << i;
+        }
+        mask[w] = word;
+    }
+    computeChangedRayMaskTail(distances, reference, fullWords * kTouchedRayMaskBitsPerWord, count, epsilon, mask);
+}
+
+#else
+
+void computeChangedRayMask(Distance const *distances, Distance const *reference, size_t count, Distance epsilon, uint64_t *mask) {
+    computeChangedRayMaskScalar(distances, reference, count, epsilon, mask);
+}
+
+#endif
+
+// ChangeDetector
+
+ChangeDetector::ChangeDetector()
+    : epsilon_(kDefaultEpsilon), hasReference_(false)
+{ }
+
+void ChangeDetector::reset() {
+    hasReference_ = false;
+}
+
+bool ChangeDetector::detectChanges(Distance const *distances, size_t count, uint64_t const *relevantMask, size_t relevantRayCount) {
+    size_t wordCount = touchedRayMaskWordCount(count);
+    if (!hasReference_ || reference_.size() != count) {
+        changedMask_.assign(wordCount, ~(uint64_t)0);
+        return true;
+    }
+
+    computeChangedRayMask(distances, reference_.data(), count, epsilon_, changedMask_.data());
+    // A relevant word may end partway through, so I keep the rays past `relevantRayCount` with a mask of their own.
+    size_t relevantWordCount = relevantMask ? std::min(touchedRayMaskWordCount(relevantRayCount), wordCount) : 0;
+    uint64_t any = 0;
+    for (size_t w = 0; w < wordCount; ++w) {
+        uint64_t changed = changedMask_[w];
+        if (w < relevantWordCount) {
+            size_t base = w * kTouchedRayMaskBitsPerWord;
+            uint64_t beyond = relevantRayCount - base >= kTouchedRayMaskBitsPerWord ? 0 : ~(uint64_t)0 << (relevantRayCount - base);
+            changed &= relevantMask[w] | beyond;
+        }
+        any |= changed;
+    }
+    return any != 0;
+}
+
+void ChangeDetector::setReference(Distance const *distances, size_t count) {
+    reference_.assign(distances, distances + count);
+    changedMask_.resize(touchedRayMaskWordCount(count));
+    hasReference_ = true;
+}
+
+}
@@ -0,0 +1,57 @@
+//
+//  ChangeDetector.h
+//  mickeyMouse
+//
+//  Copyright (c) 2012 Rob Mayoff. All rights reserved.
+//
+
+#ifndef ChangeDetector_h
+#define ChangeDetector_h
+
+#include "TouchEngineTypes.h"
+#include <stdint.h>
+#include <vector>
+
+namespace TouchEngine {
+
+// I tell the engine whether a scan differs from the last one it processed.  When nobody is touching the surface, every ray stays within sensor noise from scan to scan, and there is nothing to detect, map or report.
+//
+// I compare each ray with my reference scan and set its bit in my changed-ray mask if it moved by more than `epsilon`.  The comparison is one SIMD pass over the scan, like `computeTouchedRayMask`.  I only take a new reference when you give me one, so a slow drift adds up against the reference until it shows as a change.
+class ChangeDetector {
+public:
+    // The default epsilon, in millimeters.  A finger moves a ray by at least the margin between the background and its threshold, which is 5% of the background distance, so keep epsilon well under that.
+    static Distance const kDefaultEpsilon;
+
+    ChangeDetector();
+
+    void setEpsilon(Distance epsilon) { epsilon_ = epsilon; }
+    Distance epsilon() const { return epsilon_; }
+
+    // I forget my reference, so the next scan counts as changed.
+    void reset();
+
+    // I compare `distances` with my reference and return true if any ray changed.  If you give me `relevantMask`, with one bit for each of `relevantRayCount` rays, I ignore changes to the rays whose bits are clear; rays past `relevantRayCount` are always relevant.  A scan with a different number of rays than my reference counts as changed everywhere.
+    bool detectChanges(Distance const *distances, size_t count, uint64_t const *relevantMask = NULL, size_t relevantRayCount = 0);
+
+    // I make `distances` my reference.
+    void setReference(Distance const *distances, size_t count);
+
+    // One bit per ray, set if the ray changed in the most recent `detectChanges`.  Only meaningful if that scan had as many rays as my reference.
+    uint64_t const *changedRayMask() const { return changedMask_.data(); }
+
+private:
+    Distance epsilon_;
+    std::vector<Distance> reference_;
+    std::vector<uint64_t> changedMask_;
+    bool hasReference_;
+};
+
+// I set bit `i` of `mask` if `distances[i]` and `reference[i]` differ by more than `epsilon`.  Two invalid distances are the same; an invalid distance and a valid one differ.  `mask` must have room for `touchedRayMaskWordCount(count)` words, and I clear the bits past `count` in the last word.
+void computeChangedRayMask(Distance const *distances, Distance const *reference, size_t count, Distance epsilon, uint64_t *mask);
+
+// The portable version of `computeChangedRayMask`, for reference and benchmarking.
+void computeChangedRayMaskScalar(Distance const *distances, Distance const *reference, size_t count, Distance epsilon, uint64_t *mask);
+
+}
+
+#endif
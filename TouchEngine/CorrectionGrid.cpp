@@ -0,0 +1,196 @@
+//
+//  CorrectionGrid.cpp
+//  mickeyMouse
+//
+//  Copyright (c) 2012 Rob Mayoff. All rights reserved.
+//
+
+#include "CorrectionGrid.h"
+#include <algorithm>
+
+using std::vector;
+
+namespace TouchEngine {
+
+// The grid extends this fraction of the calibrated extent beyond the outermost touches on each side, because the user touches near the edges of the screen, not at them.
+static double const kMarginFraction = 0.25;
+
+static size_t const kNodesPerSide = CorrectionGrid::kCellsPerSide + 1;
+
+size_t const CorrectionGrid::kMinimumTouches;
+size_t const CorrectionGrid::kCellsPerSide;
+double const CorrectionGrid::kDefaultSmoothing = 0.001;
+
+// The thin-plate spline's radial basis function, r^2 log r, in terms of r^2.
+static double radialBasis(double distanceSquared) {
+    return distanceSquared > 0 ? 0.5 * distanceSquared * log(distanceSquared) : 0;
+}
+
+// I solve `matrix` (size by size, row by row) times X = `rightSides` (size by 2) in place by Gaussian elimination with partial pivoting.  I return false if `matrix` is singular.
+static bool solveLinearSystem(vector<double> &matrix, vector<double> &rightSides, size_t size) {
+    double largest = 0;
+    for (size_t i = 0; i < matrix.size(); ++i) {
+        largest = std::max(largest, fabs(matrix[i]));
+    }
+    double const tolerance = largest * 1e-12;
+
+    for (size_t column = 0; column < size; ++column) {
+        size_t pivot = column;
+        for (size_t row = column + 1; row < size; ++row) {
+            if (fabs(matrix[row * size + column]) > fabs(matrix[pivot * size + column])) {
+                pivot = row;
+            }
+        }
+        if (!(fabs(matrix[pivot * size + column]) > tolerance))
+            return false;
+        if (pivot != column) {
+            std::swap_ranges(&matrix[pivot * size], &matrix[pivot * size] + size, &matrix[column * size]);
+            std::swap_ranges(&rightSides[pivot * 2], &rightSides[pivot * 2] + 2, &rightSides[column * 2]);
+        }
+
+        double const *pivotRow = &matrix[column * size];
+        for (size_t row = column + 1; row < size; ++row) {
+            double *targetRow = &matrix[row * size];
+            double factor = targetRow[column] / pivotRow[column];
+            if (factor == 0)
+                continue;
+            for (size_t k = column; k < size; ++k) {
+                targetRow[k] -= factor * pivotRow[k];
+            }
+            rightSides[row * 2] -= factor * rightSides[column * 2];
+            rightSides[row * 2 + 1] -= factor * rightSides[column * 2 + 1];
+        }
+    }
+
+    for (size_t row = size; row-- > 0; ) {
+        double const *rowValues = &matrix[row * size];
+        for (size_t side = 0; side < 2; ++side) {
+            double sum = rightSides[row * 2 + side];
+            for (size_t k = row + 1; k < size; ++k) {
+                sum -= rowValues[k] * rightSides[k * 2 + side];
+            }
+            rightSides[row * 2 + side] = sum / rowValues[row];
+        }
+    }
+    return true;
+}
+
+CorrectionGrid::CorrectionGrid()
+    : originX_(0), originY_(0), cellsPerUnitX_(0), cellsPerUnitY_(0)
+{ }
+
+void CorrectionGrid::clear() {
+    nodes_.clear();
+}
+
+bool CorrectionGrid::build(vector<Point> const &sensorPoints, vector<Point> const &screenPoints, double smoothing) {
+    clear();
+    size_t const count = std::min(sensorPoints.size(), screenPoints.size());
+    if (count < kMinimumTouches)
+        return false;
+
+    // I fit the spline in coordinates centered on the touches and scaled to about one unit, to keep the system well conditioned.
+    double minimumX = HUGE_VAL, maximumX = -HUGE_VAL, minimumY = HUGE_VAL, maximumY = -HUGE_VAL;
+    for (size_t i = 0; i < count; ++i) {
+        minimumX = std::min(minimumX, sensorPoints[i].x);
+        maximumX = std::max(maximumX, sensorPoints[i].x);
+        minimumY = std::min(minimumY, sensorPoints[i].y);
+        maximumY = std::max(maximumY, sensorPoints[i].y);
+    }
+    double const centerX = (minimumX + maximumX) / 2;
+    double const centerY = (minimumY + maximumY) / 2;
+    double const extent = std::max(maximumX - minimumX, maximumY - minimumY);
+    if (!(extent > 0))
+        return false;
+    double const scale = 1 / extent;
+
+    vector<Point> knots(count);
+    for (size_t i = 0; i < count; ++i) {
+        knots[i] = Point((sensorPoints[i].x - centerX) * scale, (sensorPoints[i].y - centerY) * scale);
+    }
+
+    // The spline's system is [K + smoothing I, P; P^T, 0] [w; a] = [screen; 0], where K holds the radial basis between knots and P holds (1, x, y) for each knot.
+    size_t const size = count + 3;
+    vector<double> matrix(size * size, 0);
+    vector<double> rightSides(size * 2, 0);
+    for (size_t i = 0; i < count; ++i) {
+        double *row = &matrix[i * size];
+        for (size_t j = 0; j < count; ++j) {
+            double dx = knots[i].x - knots[j].x;
+            double dy = knots[i].y - knots[j].y;
+            row[j] = radialBasis(dx * dx + dy * dy);
+        }
+        row[i] += smoothing;
+        row[count] = matrix[count * size + i] = 1;
+        row[count + 1] = matrix[(count + 1) * size + i] = knots[i].x;
+        row[count + 2] = matrix[(count + 2) * size + i] = knots[i].y;
+        rightSides[i * 2] = screenPoints[i].x;
+        rightSides[i * 2 + 1] = screenPoints[i].y;
+    }
+    if (!solveLinearSystem(matrix, rightSides, size))
+        return false;
+
+    double const *weights = rightSides.data();
+    double const *affine = weights + count * 2;
+
+    edge_.a = affine[2] * scale;
+    edge_.b = affine[3] * scale;
+    edge_.c = affine[4] * scale;
+    edge_.d = affine[5] * scale;
+
+    double const margin = extent * kMarginFraction;
+    originX_ = minimumX - margin;
+    originY_ = minimumY - margin;
+    double const width = maximumX - minimumX + 2 * margin;
+    double const height = maximumY - minimumY + 2 * margin;
+    cellsPerUnitX_ = kCellsPerSide / width;
+    cellsPerUnitY_ = kCellsPerSide / height;
+
+    nodes_.resize(kNodesPerSide * kNodesPerSide);
+    for (size_t row = 0; row < kNodesPerSide; ++row) {
+        double y = ((originY_ + row * height / kCellsPerSide) - centerY) * scale;
+        for (size_t column = 0; column < kNodesPerSide; ++column) {
+            double x = ((originX_ + column * width / kCellsPerSide) - centerX) * scale;
+            Point node(affine[0] + affine[2] * x + affine[4] * y, affine[1] + affine[3] * x + affine[5] * y);
+            for (size_t i = 0; i < count; ++i) {
+                double dx = x - knots[i].x;
+                double dy = y - knots[i].y;
+                double basis = radialBasis(dx * dx + dy * dy);
+                node.x += weights[i * 2] * basis;
+                node.y += weights[i * 2 + 1] * basis;
+            }
+            nodes_[row * kNodesPerSide + column] = node;
+        }
+    }
+    return true;
+}
+
+Point CorrectionGrid::screenPointForSensorPoint(Point sensorPoint) const {
+    double const cells = kCellsPerSide;
+    double gridX = (sensorPoint.x - originX_) * cellsPerUnitX_;
+    double gridY = (sensorPoint.y - originY_) * cellsPerUnitY_;
+    double clampedX = std::min(std::max(gridX, 0.0), cells);
+    double clampedY = std::min(std::max(gridY, 0.0), cells);
+    size_t column = std::min((size_t)clampedX, kCellsPerSide - 1);
+    size_t row = std::min((size_t)clampedY, kCellsPerSide - 1);
+    double fx = clampedX - column;
+    double fy = clampedY - row;
+
+    Point const *node = &nodes_[row * kNodesPerSide + column];
+    Point const &p00 = node[0];
+    Point const &p10 = node[1];
+    Point const &p01 = node[kNodesPerSide];
+    Point const &p11 = node[kNodesPerSide + 1];
+    double bottomX = p00.x + fx * (p10.x - p00.x);
+    double bottomY = p00.y + fx * (p10.y - p00.y);
+    double topX = p01.x + fx * (p11.x - p01.x);
+    double topY = p01.y + fx * (p11.y - p01.y);
+
+    // Zero inside the grid.
+    double beyondX = (gridX - clampedX) / cellsPerUnitX_;
+    double beyondY = (gridY - clampedY) / cellsPerUnitY_;
+    return Point(bottomX + fy * (topX - bottomX) + edge_.a * beyondX + edge_.c * beyondY,
+        bottomY + fy * (topY - bottomY) + edge_.b * beyondX + edge_.d * beyondY);
+}
+
+}
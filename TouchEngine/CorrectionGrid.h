@@ -0,0 +1,58 @@
+//
+//  CorrectionGrid.h
+//  mickeyMouse
+//
+//  Copyright (c) 2012 Rob Mayoff. All rights reserved.
+//
+
+#ifndef CorrectionGrid_h
+#define CorrectionGrid_h
+
+#include "TouchEngineTypes.h"
+#include <vector>
+
+namespace TouchEngine {
+
+// I map sensor points to screen points non-linearly, for surfaces where an affine transform leaves errors that grow toward the far corners (from beam divergence, or a sensor mounted at a tilt).
+//
+// I fit a thin-plate spline through the calibration touches: the smoothest surface that passes near every touch, which is affine plus a bending term.  Evaluating the spline costs a logarithm per calibration touch, so I bake it into a grid of `kCellsPerSide` by `kCellsPerSide` cells over the calibrated part of sensor space, and a lookup is one bilinear interpolation.  Beyond the grid, I continue from its edge with the spline's affine part.
+class CorrectionGrid {
+public:
+    // A spline through fewer touches than this isn't any better than an affine transform.
+    static size_t const kMinimumTouches = 9;
+
+    static size_t const kCellsPerSide = 64;
+
+    // Enough to smooth over a few points of noise in each calibration touch.
+    static double const kDefaultSmoothing;
+
+    CorrectionGrid();
+
+    void clear();
+
+    // `true` until I've built a grid.
+    bool isEmpty() const { return nodes_.empty(); }
+
+    // I fit my spline to the pairs and bake my grid.  `smoothing` trades passing through each pair for a flatter surface; 0 interpolates exactly.  If there are fewer than `kMinimumTouches` pairs, or the pairs don't determine a spline (because the sensor points are collinear or repeated), I return false and become empty.
+    bool build(std::vector<Point> const &sensorPoints, std::vector<Point> const &screenPoints, double smoothing);
+
+    // I must not be empty.
+    Point screenPointForSensorPoint(Point sensorPoint) const;
+
+private:
+    // The sensor point at the grid's first node, and how many cells there are per sensor unit.
+    double originX_;
+    double originY_;
+    double cellsPerUnitX_;
+    double cellsPerUnitY_;
+
+    // The linear part of the spline's affine part, for extrapolating beyond the grid.
+    AffineTransform edge_;
+
+    // Screen points for the `(kCellsPerSide + 1)` squared grid nodes, row by row.
+    std::vector<Point> nodes_;
+};
+
+}
+
+#endif
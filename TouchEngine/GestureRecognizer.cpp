@@ -0,0 +1,301 @@
+//
+//  GestureRecognizer.cpp
+//  mickeyMouse
+//
+//  Copyright (c) 2012 Rob Mayoff. All rights reserved.
+//
+
+#include "GestureRecognizer.h"
+#include <algorithm>
+#include <math.h>
+
+namespace TouchEngine {
+
+char const *gestureTypeName(GestureType type) {
+#define GestureTypeName(Type) case GestureType_##Type: return #Type
+    switch (type) {
+        GestureTypeName(Tap);
+        GestureTypeName(DoubleTap);
+        GestureTypeName(LongPress);
+        GestureTypeName(Drag);
+        GestureTypeName(Scroll);
+        GestureTypeName(Pinch);
+        GestureTypeName(Swipe);
+    }
+#undef GestureTypeName
+    return "Unknown";
+}
+
+char const *gesturePhaseName(GesturePhase phase) {
+#define GesturePhaseName(Phase) case GesturePhase_##Phase: return #Phase
+    switch (phase) {
+        GesturePhaseName(Began);
+        GesturePhaseName(Changed);
+        GesturePhaseName(Ended);
+        GesturePhaseName(Recognized);
+    }
+#undef GesturePhaseName
+    return "Unknown";
+}
+
+size_t const GestureRecognizer::kMaximumEvents;
+
+static double distanceBetween(Point a, Point b) {
+    return hypot(a.x - b.x, a.y - b.y);
+}
+
+static Point difference(Point a, Point b) {
+    return Point(a.x - b.x, a.y - b.y);
+}
+
+static Point midpoint(Point a, Point b) {
+    return Point((a.x + b.x) / 2, (a.y + b.y) / 2);
+}
+
+GestureRecognizer::Parameters::Parameters()
+    : tapSlop(15), doubleTapSlop(40), tapMaximumSeconds(0.3), doubleTapIntervalSeconds(0.3), longPressSeconds(0.5), pinchThreshold(0.1), swipeMinimumSpeed(1000), swipeMaximumSeconds(0.3)
+{ }
+
+GestureRecognizer::GestureRecognizer() {
+    reset();
+}
+
+void GestureRecognizer::reset() {
+    mode_ = Mode_Idle;
+    maximumTouchCount_ = 0;
+    identifier_ = 0;
+    startTime_ = 0;
+    identifiers_[0] = identifiers_[1] = 0;
+    startDistance_ = lastDistance_ = 0;
+    hasPreviousTap_ = false;
+    previousTapTime_ = 0;
+    eventCount_ = 0;
+}
+
+void GestureRecognizer::update(TrackedTouch const *touches, size_t count, double timestamp) {
+    eventCount_ = 0;
+    if (count == 0) {
+        // The fingers vanished without lifting, because the tracker was reset or you sent me an empty frame.  I end what they were doing where they left it.
+        if (mode_ != Mode_Idle) {
+            endGesture(timestamp);
+            mode_ = Mode_Idle;
+        }
+        return;
+    }
+    if (mode_ == Mode_Idle) {
+        beginSession(touches[0], timestamp);
+    }
+
+    maximumTouchCount_ = std::max(maximumTouchCount_, count);
+    if (mode_ != Mode_Finished) {
+        if (maximumTouchCount_ > 2) {
+            endGesture(timestamp);
+            mode_ = Mode_Finished;
+        } else if (maximumTouchCount_ == 2) {
+            updateTwoFingers(touches, count, timestamp);
+        } else {
+            updateOneFinger(touches[0], timestamp);
+        }
+    }
+
+    bool anyDown = false;
+    for (size_t i = 0; i < count && !anyDown; ++i) {
+        anyDown = touches[i].phase != TouchPhase_Ended;
+    }
+    if (!anyDown) {
+        mode_ = Mode_Idle;
+    }
+}
+
+void GestureRecognizer::beginSession(TrackedTouch const &touch, double timestamp) {
+    mode_ = Mode_OneFinger;
+    maximumTouchCount_ = 0;
+    identifier_ = touch.identifier;
+    startTime_ = timestamp;
+    startPosition_ = touch.position;
+    lastPosition_ = touch.position;
+    lastVelocity_ = Point();
+}
+
+void GestureRecognizer::updateOneFinger(TrackedTouch const &touch, double timestamp) {
+    // The tracker only ends a touch, so a different identifier means a finger lifted and another landed between two frames.  I treat it as the end of the session.
+    bool ended = touch.phase == TouchPhase_Ended || touch.identifier != identifier_;
+    if (!ended) {
+        lastVelocity_ = touch.velocity;
+    }
+    double moved = distanceBetween(touch.position, startPosition_);
+
+    switch (mode_) {
+        case Mode_OneFinger:
+            if (moved > parameters_.tapSlop) {
+                // The drag begins where the finger landed, so whatever the finger pressed is what it drags.  The translation brings it to where the finger is now.
+                mode_ = Mode_Dragging;
+                GestureEvent &event = addEvent(GestureType_Drag, GesturePhase_Began, timestamp, startPosition_);
+                event.translation = difference(touch.predictedPosition, startPosition_);
+                lastPosition_ = touch.predictedPosition;
+                if (ended) {
+                    endGesture(timestamp);
+                }
+            } else if (ended) {
+                if (timestamp - startTime_ <= parameters_.tapMaximumSeconds) {
+                    recognizeTap(timestamp);
+                }
+                mode_ = Mode_Finished;
+            } else if (timestamp - startTime_ >= parameters_.longPressSeconds) {
+                mode_ = Mode_LongPressing;
+                addEvent(GestureType_LongPress, GesturePhase_Began, timestamp, startPosition_);
+                lastPosition_ = startPosition_;
+            }
+            break;
+
+        case Mode_Dragging:
+        case Mode_LongPressing:
+            if (ended) {
+                endGesture(timestamp);
+            } else {
+                GestureType type = mode_ == Mode_Dragging ? GestureType_Drag : GestureType_LongPress;
+                // A long press doesn't move until the finger leaves the slop, so a still finger doesn't jitter whatever it's pressing.
+                if (type == GestureType_Drag || moved > parameters_.tapSlop) {
+                    GestureEvent &event = addEvent(type, GesturePhase_Changed, timestamp, touch.predictedPosition);
+                    event.translation = difference(touch.predictedPosition, lastPosition_);
+                    lastPosition_ = touch.predictedPosition;
+                }
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+void GestureRecognizer::recognizeTap(double timestamp) {
+    bool isDoubleTap = hasPreviousTap_
+        && startTime_ - previousTapTime_ <= parameters_.doubleTapIntervalSeconds
+        && distanceBetween(startPosition_, previousTapPosition_) <= parameters_.doubleTapSlop;
+    if (isDoubleTap) {
+        addEvent(GestureType_DoubleTap, GesturePhase_Recognized, timestamp, startPosition_);
+        // A third tap starts over, rather than making another double-tap.
+        hasPreviousTap_ = false;
+    } else {
+        addEvent(GestureType_Tap, GesturePhase_Recognized, timestamp, startPosition_);
+        hasPreviousTap_ = true;
+        previousTapTime_ = timestamp;
+        previousTapPosition_ = startPosition_;
+    }
+}
+
+void GestureRecognizer::updateTwoFingers(TrackedTouch const *touches, size_t count, double timestamp) {
+    switch (mode_) {
+        case Mode_OneFinger:
+        case Mode_Dragging:
+        case Mode_LongPressing:
+            endGesture(timestamp);
+            if (count == 2 && touches[0].phase != TouchPhase_Ended && touches[1].phase != TouchPhase_Ended) {
+                beginTwoFingers(touches);
+            } else {
+                mode_ = Mode_Finished;
+            }
+            return;
+        default:
+            break;
+    }
+
+    // The session is over as soon as either finger lifts.
+    if (count != 2 || touches[0].phase == TouchPhase_Ended || touches[1].phase == TouchPhase_Ended
+        || touches[0].identifier != identifiers_[0] || touches[1].identifier != identifiers_[1])
+    {
+        endGesture(timestamp);
+        mode_ = Mode_Finished;
+        return;
+    }
+
+    double distance = distanceBetween(touches[0].position, touches[1].position);
+    Point centroid = midpoint(touches[0].position, touches[1].position);
+    Point predictedCentroid = midpoint(touches[0].predictedPosition, touches[1].predictedPosition);
+    switch (mode_) {
+        case Mode_TwoFingers:
+            if (startDistance_ > 0 && fabs(distance / startDistance_ - 1) > parameters_.pinchThreshold) {
+                mode_ = Mode_Pinching;
+                GestureEvent &event = addEvent(GestureType_Pinch, GesturePhase_Began, timestamp, predictedCentroid);
+                event.scale = distance / startDistance_;
+                lastDistance_ = distance;
+                lastPosition_ = predictedCentroid;
+            } else if (distanceBetween(centroid, startCentroid_) > parameters_.tapSlop) {
+                mode_ = Mode_Scrolling;
+                GestureEvent &event = addEvent(GestureType_Scroll, GesturePhase_Began, timestamp, predictedCentroid);
+                event.translation = difference(predictedCentroid, startCentroid_);
+                lastPosition_ = predictedCentroid;
+            }
+            break;
+
+        case Mode_Scrolling: {
+            GestureEvent &event = addEvent(GestureType_Scroll, GesturePhase_Changed, timestamp, predictedCentroid);
+            event.translation = difference(predictedCentroid, lastPosition_);
+            lastPosition_ = predictedCentroid;
+            break;
+        }
+
+        case Mode_Pinching: {
+            GestureEvent &event = addEvent(GestureType_Pinch, GesturePhase_Changed, timestamp, predictedCentroid);
+            event.scale = lastDistance_ > 0 ? distance / lastDistance_ : 1;
+            lastDistance_ = distance;
+            lastPosition_ = predictedCentroid;
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+void GestureRecognizer::beginTwoFingers(TrackedTouch const *touches) {
+    mode_ = Mode_TwoFingers;
+    identifiers_[0] = touches[0].identifier;
+    identifiers_[1] = touches[1].identifier;
+    startDistance_ = lastDistance_ = distanceBetween(touches[0].position, touches[1].position);
+    startCentroid_ = midpoint(touches[0].position, touches[1].position);
+    lastPosition_ = startCentroid_;
+}
+
+// I end the continuous gesture in progress, if there is one, where its last event left it.  A drag that ends fast enough, soon enough, is also a swipe.
+void GestureRecognizer::endGesture(double timestamp) {
+    switch (mode_) {
+        case Mode_Dragging: {
+            addEvent(GestureType_Drag, GesturePhase_Ended, timestamp, lastPosition_);
+            double speed = hypot(lastVelocity_.x, lastVelocity_.y);
+            if (timestamp - startTime_ <= parameters_.swipeMaximumSeconds && speed >= parameters_.swipeMinimumSpeed) {
+                GestureEvent &event = addEvent(GestureType_Swipe, GesturePhase_Recognized, timestamp, lastPosition_);
+                event.velocity = lastVelocity_;
+            }
+            break;
+        }
+        case Mode_LongPressing:
+            addEvent(GestureType_LongPress, GesturePhase_Ended, timestamp, lastPosition_);
+            break;
+        case Mode_Scrolling:
+            addEvent(GestureType_Scroll, GesturePhase_Ended, timestamp, lastPosition_);
+            break;
+        case Mode_Pinching:
+            addEvent(GestureType_Pinch, GesturePhase_Ended, timestamp, lastPosition_);
+            break;
+        default:
+            break;
+    }
+    mode_ = Mode_Finished;
+}
+
+// No frame settles more than a few events, so running out of room means a bug.  I overwrite the last event rather than write past my array.
+GestureEvent &GestureRecognizer::addEvent(GestureType type, GesturePhase phase, double timestamp, Point position) {
+    GestureEvent &event = events_[std::min(eventCount_, kMaximumEvents - 1)];
+    eventCount_ = std::min(eventCount_ + 1, kMaximumEvents);
+    event.type = type;
+    event.phase = phase;
+    event.timestamp = timestamp;
+    event.position = position;
+    event.translation = Point();
+    event.scale = 1;
+    event.velocity = Point();
+    return event;
+}
+
+}
@@ -0,0 +1,150 @@
+//
+//  GestureRecognizer.h
+//  mickeyMouse
+//
+//  Copyright (c) 2012 Rob Mayoff. All rights reserved.
+//
+
+#ifndef GestureRecognizer_h
+#define GestureRecognizer_h
+
+#include "TouchEngineTypes.h"
+#include "TouchTracker.h"
+#include <stddef.h>
+#include <stdint.h>
+
+namespace TouchEngine {
+
+enum GestureType {
+    GestureType_Tap, // one finger down and up without moving
+    GestureType_DoubleTap, // a tap soon after another tap, at about the same place
+    GestureType_LongPress, // one finger held down without moving; it can move once the press has begun
+    GestureType_Drag, // one finger moving
+    GestureType_Scroll, // two fingers moving together
+    GestureType_Pinch, // two fingers spreading apart or closing together
+    GestureType_Swipe // a quick one-finger flick, when the finger lifts
+};
+
+char const *gestureTypeName(GestureType type);
+
+enum GesturePhase {
+    GesturePhase_Began,
+    GesturePhase_Changed,
+    GesturePhase_Ended,
+    GesturePhase_Recognized // for the gestures that happen all at once: taps and swipes
+};
+
+char const *gesturePhaseName(GesturePhase phase);
+
+struct GestureEvent {
+    GestureType type;
+    GesturePhase phase;
+    double timestamp; // the timestamp of the touches that settled this event, on the sensor's clock, so you can deliver the event with the same timing
+    Point position; // in screen coordinates: where the finger landed for a tap, a long press or the beginning of a drag, and otherwise where the finger is, or the midpoint of two fingers
+    Point translation; // Drag, LongPress and Scroll: how far the position moved since the gesture's previous event; for a drag's beginning, from where the finger landed to where it is now
+    double scale; // Pinch: the distance between the fingers divided by the distance at the gesture's previous event; 1 for the others
+    Point velocity; // Swipe: the finger's velocity just before it lifted, in screen points per second
+};
+
+// I turn the touches a `TouchTracker` follows, one frame at a time, into gestures.
+//
+// Every decision happens in the `update` for the frame that settles it.  I never wait for a later frame or a timer, so these are my latency budgets:
+//
+// - A tap is recognized on the frame its touch ends.  A double-tap is a tap followed by a `DoubleTap` in place of the second `Tap`, so I never hold a tap back to see whether another follows.
+// - A long press begins on the first frame at least `longPressSeconds` after the finger landed.
+// - A drag or scroll begins on the first frame that moves past `tapSlop`, and a pinch on the first frame that changes the fingers' distance by `pinchThreshold`.
+// - A swipe is recognized on the frame its touch ends, right after the drag ends.
+//
+// Continuous gestures follow each touch's `predictedPosition`, like the pointer did before me, so they don't lag behind the finger.  I decide between gestures with the measured positions, which don't overshoot.
+//
+// A session lasts from the first finger down until every finger is up.  One finger makes taps, long presses, drags and swipes.  A second finger ends any one-finger gesture and starts a scroll or pinch.  A third finger ends everything until every finger is up.
+//
+// I don't allocate after construction, so you can call `update` for every scan.
+class GestureRecognizer {
+public:
+    // `update` makes at most this many events.
+    static size_t const kMaximumEvents = 8;
+
+    struct Parameters {
+        // In screen points: how far a finger can move and still be tapping or pressing, and how far apart two taps can be and still be a double-tap.
+        double tapSlop;
+        double doubleTapSlop;
+
+        // In seconds: the longest a tap can last, the longest from the end of one tap to the start of the next for a double-tap, and how long a finger must stay still for a long press.
+        double tapMaximumSeconds;
+        double doubleTapIntervalSeconds;
+        double longPressSeconds;
+
+        // How much the distance between two fingers must change, as a fraction, before they're pinching.
+        double pinchThreshold;
+
+        // A drag that lasts no longer than `swipeMaximumSeconds` and ends at least this fast, in screen points per second, is also a swipe.
+        double swipeMinimumSpeed;
+        double swipeMaximumSeconds;
+
+        Parameters();
+    };
+
+    GestureRecognizer();
+
+    void setParameters(Parameters const &parameters) { parameters_ = parameters; }
+    Parameters const &parameters() const { return parameters_; }
+
+    // I forget the current session and the previous tap, without ending anything.
+    void reset();
+
+    // I look at the touches of one frame, as `TouchTracker` or `MotionPredictor` reports them, and replace my events with the ones this frame settles.  A frame with no touches ends the session, as if every finger lifted, except that a tap in progress isn't recognized.
+    void update(TrackedTouch const *touches, size_t count, double timestamp);
+
+    GestureEvent const *events() const { return events_; }
+    size_t eventCount() const { return eventCount_; }
+
+private:
+    enum Mode {
+        Mode_Idle, // no fingers down
+        Mode_OneFinger, // one finger down, not yet doing anything
+        Mode_Dragging,
+        Mode_LongPressing,
+        Mode_TwoFingers, // two fingers down, not yet doing anything
+        Mode_Scrolling,
+        Mode_Pinching,
+        Mode_Finished // the session's gesture is over; I wait for every finger to lift
+    };
+
+    void beginSession(TrackedTouch const &touch, double timestamp);
+    void updateOneFinger(TrackedTouch const &touch, double timestamp);
+    void updateTwoFingers(TrackedTouch const *touches, size_t count, double timestamp);
+    void beginTwoFingers(TrackedTouch const *touches);
+    void recognizeTap(double timestamp);
+    void endGesture(double timestamp);
+    GestureEvent &addEvent(GestureType type, GesturePhase phase, double timestamp, Point position);
+
+    Parameters parameters_;
+    Mode mode_;
+    size_t maximumTouchCount_; // the most fingers down at once in this session
+
+    // The one-finger state.
+    uint32_t identifier_;
+    double startTime_;
+    Point startPosition_;
+    Point lastPosition_; // where the gesture's previous event put it
+    Point lastVelocity_;
+
+    // The two-finger state.
+    uint32_t identifiers_[2];
+    double startDistance_;
+    double lastDistance_;
+    Point startCentroid_;
+
+    // The previous tap, for double-taps.
+    bool hasPreviousTap_;
+    double previousTapTime_;
+    Point previousTapPosition_;
+
+    GestureEvent events_[kMaximumEvents];
+    size_t eventCount_;
+};
+
+}
+
+#endif
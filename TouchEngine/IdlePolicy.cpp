@@ -0,0 +1,141 @@
+//
+//  IdlePolicy.cpp
+//  mickeyMouse
+//
+//  Copyright (c) 2012 Rob Mayoff. All rights reserved.
+//
+
+#include "IdlePolicy.h"
+#include <algorithm>
+#include <math.h>
+
+namespace TouchEngine {
+
+char const *idleModeName(IdlePolicy::Mode mode) {
+    switch (mode) {
+        case IdlePolicy::Mode_Active: return "active";
+        case IdlePolicy::Mode_Idle: return "idle";
+        case IdlePolicy::Mode_Dormant: return "dormant";
+        case IdlePolicy::Mode_Count: break;
+    }
+    return "unknown";
+}
+
+IdlePolicy::Parameters::Parameters()
+    : idleAfterSeconds(30), idleDecimation(4), idleSensorSkipScans(0), dormantAfterSeconds(0), dormantPeekIntervalSeconds(1), dormantPeekScans(2)
+{ }
+
+IdlePolicy::IdlePolicy() {
+    reset(0);
+}
+
+void IdlePolicy::reset(double now) {
+    now_ = now;
+    lastActivityTime_ = now;
+    lastExaminedTime_ = now;
+    enterMode(Mode_Active, now);
+    std::fill(statistics_, statistics_ + Mode_Count, ModeStatistics());
+    wakeCount_ = 0;
+    totalWakeLatency_ = 0;
+    worstWakeLatency_ = 0;
+}
+
+bool IdlePolicy::shouldExamineScan(double timestamp) {
+    advanceTo(timestamp);
+    ++statistics_[mode_].scansReceived;
+    switch (mode_) {
+        case Mode_Active:
+            return true;
+        case Mode_Idle:
+            if (++scansSinceExamined_ < parameters_.idleDecimation)
+                return false;
+            scansSinceExamined_ = 0;
+            return true;
+        case Mode_Dormant:
+            // A scan can straggle in after I turn the laser off.
+            return peeking_;
+        case Mode_Count:
+            break;
+    }
+    return true;
+}
+
+void IdlePolicy::didExamineScan(double timestamp, bool active, double processingSeconds) {
+    advanceTo(timestamp);
+    ModeStatistics &statistics = statistics_[mode_];
+    ++statistics.scansExamined;
+    statistics.processingSeconds += processingSeconds;
+
+    if (active) {
+        if (mode_ != Mode_Active) {
+            double latency = timestamp - lastExaminedTime_;
+            ++wakeCount_;
+            totalWakeLatency_ += latency;
+            worstWakeLatency_ = std::max(worstWakeLatency_, latency);
+            enterMode(Mode_Active, timestamp);
+        }
+        lastActivityTime_ = timestamp;
+    } else if (mode_ == Mode_Dormant && peeking_ && ++peekScansExamined_ >= parameters_.dormantPeekScans) {
+        peeking_ = false;
+        nextPeekTime_ = timestamp + parameters_.dormantPeekIntervalSeconds;
+    }
+    lastExaminedTime_ = timestamp;
+}
+
+void IdlePolicy::tick(double now) {
+    advanceTo(now);
+}
+
+double IdlePolicy::nextTickTime() const {
+    return mode_ == Mode_Dormant && !peeking_ ? nextPeekTime_ : HUGE_VAL;
+}
+
+IdlePolicy::SensorRequest IdlePolicy::sensorRequest() const {
+    SensorRequest request = { 0, true };
+    if (mode_ != Mode_Active) {
+        request.skipScans = parameters_.idleSensorSkipScans;
+    }
+    if (mode_ == Mode_Dormant) {
+        request.laserOn = peeking_;
+    }
+    return request;
+}
+
+IdlePolicy::Report IdlePolicy::report() const {
+    Report report;
+    std::copy(statistics_, statistics_ + Mode_Count, report.modes);
+    report.wakeCount = wakeCount_;
+    report.meanWakeLatency = wakeCount_ ? totalWakeLatency_ / wakeCount_ : 0;
+    report.worstWakeLatency = worstWakeLatency_;
+    return report;
+}
+
+void IdlePolicy::enterMode(Mode mode, double now) {
+    mode_ = mode;
+    modeStartTime_ = now;
+    scansSinceExamined_ = 0;
+    peeking_ = false;
+    nextPeekTime_ = now + parameters_.dormantPeekIntervalSeconds;
+    peekScansExamined_ = 0;
+}
+
+// I charge the time since I last heard from you to my current mode, and then make the transitions that only depend on time.
+void IdlePolicy::advanceTo(double now) {
+    if (now > now_) {
+        statistics_[mode_].seconds += now - now_;
+        now_ = now;
+    }
+
+    if (mode_ == Mode_Active && now_ - lastActivityTime_ >= parameters_.idleAfterSeconds) {
+        enterMode(Mode_Idle, now_);
+    }
+    if (mode_ == Mode_Idle && parameters_.dormantAfterSeconds > 0 && now_ - modeStartTime_ >= parameters_.dormantAfterSeconds) {
+        enterMode(Mode_Dormant, now_);
+    }
+    if (mode_ == Mode_Dormant && !peeking_ && now_ >= nextPeekTime_) {
+        peeking_ = true;
+        peekScansExamined_ = 0;
+    }
+}
+
+}
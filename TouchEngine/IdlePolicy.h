@@ -0,0 +1,126 @@
+//
+//  IdlePolicy.h
+//  mickeyMouse
+//
+//  Copyright (c) 2012 Rob Mayoff. All rights reserved.
+//
+
+#ifndef IdlePolicy_h
+#define IdlePolicy_h
+
+#include <stddef.h>
+
+namespace TouchEngine {
+
+// I decide how hard the host and the sensor work when nobody is touching the surface.  A kiosk runs around the clock, and most of that time nothing is in front of it.
+//
+// I have three modes:
+//
+// - Active: the host examines every scan, and the sensor sends every scan.
+// - Idle, after `idleAfterSeconds` without activity: the host examines one scan in `idleDecimation`, and the sensor skips `idleSensorSkipScans` scans between the ones it sends.
+// - Dormant, after another `dormantAfterSeconds` of idle, if that's nonzero: the laser is off, except that every `dormantPeekIntervalSeconds` I turn it on long enough to examine `dormantPeekScans` scans.
+//
+// Activity is any examined scan that the engine didn't skip as unchanged (see `Engine::setChangeDetectionEnabled`), so I need change detection to ever leave active mode.  The first examined scan with activity puts me straight back in active mode.
+//
+// I don't talk to the sensor or keep time myself.  You tell me about scans and time, and apply my `sensorRequest` when it changes.  Every time is in seconds on one clock of your choosing.
+class IdlePolicy {
+public:
+    enum Mode {
+        Mode_Active,
+        Mode_Idle,
+        Mode_Dormant,
+        Mode_Count
+    };
+
+    struct Parameters {
+        double idleAfterSeconds;
+        unsigned idleDecimation; // 1 examines every scan
+        unsigned idleSensorSkipScans; // 0 keeps the sensor at full rate; the SCIP 2.0 MD command allows up to 9
+
+        double dormantAfterSeconds; // 0 never turns the laser off
+        double dormantPeekIntervalSeconds;
+        unsigned dormantPeekScans; // I examine this many scans per peek, in case the first one after the laser comes on is noisy
+
+        Parameters();
+    };
+
+    // What I want from the sensor right now.
+    struct SensorRequest {
+        unsigned skipScans;
+        bool laserOn;
+
+        bool operator==(SensorRequest const &other) const { return skipScans == other.skipScans && laserOn == other.laserOn; }
+        bool operator!=(SensorRequest const &other) const { return !(*this == other); }
+    };
+
+    // What happened while I was in one mode.  Divide by `seconds` for rates: `scansReceived` is the load on the USB link, and `processingSeconds` is the host's CPU time.
+    struct ModeStatistics {
+        double seconds;
+        size_t scansReceived;
+        size_t scansExamined;
+        double processingSeconds;
+    };
+
+    struct Report {
+        ModeStatistics modes[Mode_Count];
+
+        // The wake latency is the time from the last examined scan before a wake to the scan that woke me: how long a finger could have been down before I looked.
+        size_t wakeCount;
+        double meanWakeLatency;
+        double worstWakeLatency;
+    };
+
+    IdlePolicy();
+
+    void setParameters(Parameters const &parameters) { parameters_ = parameters; }
+    Parameters const &parameters() const { return parameters_; }
+
+    // I go to active mode and forget my statistics.
+    void reset(double now);
+
+    // A scan arrived at `timestamp`.  I return whether you should examine it, which means giving it to the engine and then sending me `didExamineScan`.
+    bool shouldExamineScan(double timestamp);
+
+    // You examined the scan from `timestamp`, spending `processingSeconds` on it.  `active` is whether it showed activity.
+    void didExamineScan(double timestamp, bool active, double processingSeconds);
+
+    // Time passed without scans.  While the laser is off, no scans arrive to move me along, so send me this at `nextTickTime`.
+    void tick(double now);
+
+    // When I next need a `tick`: the start of the next peek while I'm dormant with the laser off, and infinity otherwise.
+    double nextTickTime() const;
+
+    Mode mode() const { return mode_; }
+    SensorRequest sensorRequest() const;
+
+    // My statistics up to the most recent time you gave me.
+    Report report() const;
+
+private:
+    void enterMode(Mode mode, double now);
+    void advanceTo(double now);
+
+    Parameters parameters_;
+    Mode mode_;
+    double modeStartTime_;
+    double now_;
+    double lastActivityTime_;
+    double lastExaminedTime_;
+    size_t scansSinceExamined_;
+
+    // While I'm dormant: whether the laser is on for a peek, and when the next peek starts or how many scans this one has examined.
+    bool peeking_;
+    double nextPeekTime_;
+    unsigned peekScansExamined_;
+
+    ModeStatistics statistics_[Mode_Count];
+    size_t wakeCount_;
+    double totalWakeLatency_;
+    double worstWakeLatency_;
+};
+
+char const *idleModeName(IdlePolicy::Mode mode);
+
+}
+
+#endif
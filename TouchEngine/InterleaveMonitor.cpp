@@ -0,0 +1,112 @@
+//
+//  InterleaveMonitor.cpp
+//  mickeyMouse
+//
+//  Copyright (c) 2012 Rob Mayoff. All rights reserved.
+//
+
+#include "InterleaveMonitor.h"
+#include <algorithm>
+#include <math.h>
+
+using std::vector;
+
+namespace TouchEngine {
+
+double const InterleaveMonitor::kPeriodWeight = 0.05;
+double const InterleaveMonitor::kDropoutPeriods = 1.5;
+
+InterleaveMonitor::InterleaveMonitor() {
+    reset(0);
+}
+
+void InterleaveMonitor::reset(size_t sensorCount) {
+    Sensor sensor = { 0, 0, 0 };
+    sensors_.assign(sensorCount, sensor);
+    updateCount_ = 0;
+    firstUpdateTime_ = 0;
+    lastUpdateTime_ = 0;
+    intervalMean_ = 0;
+    intervalSquares_ = 0;
+    worstInterval_ = 0;
+}
+
+void InterleaveMonitor::observeScan(size_t sensor, double timestamp) {
+    if (sensor >= sensors_.size()) {
+        Sensor newSensor = { 0, 0, 0 };
+        sensors_.resize(sensor + 1, newSensor);
+    }
+    Sensor &s = sensors_[sensor];
+    if (s.scanCount > 0) {
+        double interval = timestamp - s.lastTimestamp;
+        if (interval > 0) {
+            if (s.period == 0) {
+                s.period = interval;
+            } else if (interval < kDropoutPeriods * s.period) {
+                s.period += kPeriodWeight * (interval - s.period);
+            }
+        }
+    }
+    s.lastTimestamp = timestamp;
+    ++s.scanCount;
+}
+
+void InterleaveMonitor::observeUpdate(double timestamp) {
+    if (updateCount_ == 0) {
+        firstUpdateTime_ = timestamp;
+    } else {
+        double interval = timestamp - lastUpdateTime_;
+        double delta = interval - intervalMean_;
+        intervalMean_ += delta / updateCount_;
+        intervalSquares_ += delta * (interval - intervalMean_);
+        worstInterval_ = std::max(worstInterval_, interval);
+    }
+    lastUpdateTime_ = timestamp;
+    ++updateCount_;
+}
+
+// I measure a sensor's phase from its most recent scan and sensor 0's, so a slow drift between their clocks shows up as it happens.
+double InterleaveMonitor::phase(size_t sensor) const {
+    if (sensor == 0 || sensors_.empty())
+        return 0;
+    Sensor const &reference = sensors_[0];
+    Sensor const &s = sensors_[sensor];
+    if (reference.period <= 0 || s.scanCount == 0 || reference.scanCount == 0)
+        return 0;
+    double phase = fmod(s.lastTimestamp - reference.lastTimestamp, reference.period) / reference.period;
+    return phase < 0 ? phase + 1 : phase;
+}
+
+InterleaveMonitor::Report InterleaveMonitor::report() const {
+    Report report;
+    report.idealUpdateRate = 0;
+    vector<double> phases;
+    for (size_t i = 0; i < sensors_.size(); ++i) {
+        SensorPhase sensorPhase = { sensors_[i].scanCount, sensors_[i].period, phase(i) };
+        report.sensors.push_back(sensorPhase);
+        if (sensors_[i].period > 0) {
+            report.idealUpdateRate += 1 / sensors_[i].period;
+            phases.push_back(sensorPhase.phase);
+        }
+    }
+
+    report.phaseSpread = 0;
+    if (phases.size() > 1) {
+        std::sort(phases.begin(), phases.end());
+        double smallestGap = phases.front() + 1 - phases.back();
+        for (size_t i = 1; i < phases.size(); ++i) {
+            smallestGap = std::min(smallestGap, phases[i] - phases[i - 1]);
+        }
+        report.phaseSpread = smallestGap * phases.size();
+    }
+
+    report.updateCount = updateCount_;
+    double span = lastUpdateTime_ - firstUpdateTime_;
+    report.updateRate = updateCount_ > 1 && span > 0 ? (updateCount_ - 1) / span : 0;
+    report.meanUpdateInterval = intervalMean_;
+    report.updateIntervalJitter = updateCount_ > 2 ? sqrt(intervalSquares_ / (updateCount_ - 2)) : 0;
+    report.worstUpdateInterval = worstInterval_;
+    return report;
+}
+
+}
@@ -0,0 +1,87 @@
+//
+//  InterleaveMonitor.h
+//  mickeyMouse
+//
+//  Copyright (c) 2012 Rob Mayoff. All rights reserved.
+//
+
+#ifndef InterleaveMonitor_h
+#define InterleaveMonitor_h
+
+#include <stddef.h>
+#include <vector>
+
+namespace TouchEngine {
+
+// I watch the scan timestamps of several free-running sensors and the touch updates made from them, and tell you how well the sensors' scans interleave.
+//
+// Two sensors at 40 Hz can give you a touch update every 12.5 ms, but only if their scans are half a period apart.  Their motors free-run and nothing sets their phase, so I measure it: each sensor's period, and where its scans fall within sensor 0's period.  Then I measure what you actually got: how often updates came and how evenly.
+//
+// Every time is in seconds on one clock of your choosing.
+class InterleaveMonitor {
+public:
+    // How much a new scan interval moves my estimate of a sensor's period.
+    static double const kPeriodWeight;
+
+    // A scan interval more than this many periods long is a dropout, which I leave out of the period.
+    static double const kDropoutPeriods;
+
+    struct SensorPhase {
+        size_t scanCount;
+        double period; // seconds; zero until I've seen two scans
+        double phase; // where the sensor's scans fall in sensor 0's period, from 0 to 1; zero for sensor 0
+    };
+
+    struct Report {
+        std::vector<SensorPhase> sensors;
+
+        // The phase spread is the smallest gap between two sensors' phases, as a fraction of the even spacing `1 / sensorCount`.  1 is perfect interleaving, and 0 is sensors scanning in lockstep, which gains nothing.
+        double phaseSpread;
+
+        // The rate the sensors could deliver together if they were perfectly interleaved, and the rate you got.
+        double idealUpdateRate;
+        size_t updateCount;
+        double updateRate;
+
+        // The intervals between updates: their mean, their standard deviation (the jitter), and the longest.
+        double meanUpdateInterval;
+        double updateIntervalJitter;
+        double worstUpdateInterval;
+    };
+
+    InterleaveMonitor();
+
+    // I forget everything and expect `sensorCount` sensors.
+    void reset(size_t sensorCount);
+
+    // Sensor `sensor` delivered a scan at `timestamp`.
+    void observeScan(size_t sensor, double timestamp);
+
+    // You sent a touch update at `timestamp`.
+    void observeUpdate(double timestamp);
+
+    Report report() const;
+
+private:
+    struct Sensor {
+        size_t scanCount;
+        double period;
+        double lastTimestamp;
+    };
+
+    double phase(size_t sensor) const;
+
+    std::vector<Sensor> sensors_;
+
+    size_t updateCount_;
+    double firstUpdateTime_;
+    double lastUpdateTime_;
+    // Welford's running mean and sum of squared differences of the update intervals.
+    double intervalMean_;
+    double intervalSquares_;
+    double worstInterval_;
+};
+
+}
+
+#endif
@@ -0,0 +1,123 @@
+//
+//  MotionPredictor.cpp
+//  mickeyMouse
+//
+//  Copyright (c) 2012 Rob Mayoff. All rights reserved.
+//
+
+#include "MotionPredictor.h"
+#include <algorithm>
+
+namespace TouchEngine {
+
+// My initial guess of the velocity comes from the tracker's last two positions, so I start out very unsure of it.
+static double const kInitialVelocityVariance = 2000.0 * 2000.0;
+
+MotionPredictor::Parameters::Parameters()
+    : sensorLatency(0.0125), accelerationNoise(10000000), measurementNoise(9), maximumPredictionDistance(150)
+{ }
+
+MotionPredictor::MotionPredictor()
+    : deliveryLatency_(0), filterCount_(0), touchCount_(0)
+{ }
+
+void MotionPredictor::reset() {
+    filterCount_ = 0;
+    touchCount_ = 0;
+}
+
+void MotionPredictor::update(TrackedTouch const *touches, size_t count, double timestamp) {
+    count = std::min(count, sizeof touches_ / sizeof touches_[0]);
+    double const horizon = predictionHorizon();
+    double const maximumDistance = parameters_.maximumPredictionDistance;
+
+    // Both my filters and the touches are in increasing identifier order, so I can match them by merging.  I drop the filters of tracks that have disappeared and start filters for tracks that just began.
+    size_t read = 0;
+    size_t write = 0;
+    Filter previousFilters[TouchTracker::kMaximumTracks];
+    size_t previousCount = filterCount_;
+    std::copy(filters_, filters_ + filterCount_, previousFilters);
+
+    for (size_t i = 0; i < count; ++i) {
+        TrackedTouch const &touch = touches[i];
+        while (read < previousCount && previousFilters[read].identifier < touch.identifier) {
+            ++read;
+        }
+
+        Filter filter;
+        if (read < previousCount && previousFilters[read].identifier == touch.identifier) {
+            filter = previousFilters[read++];
+            advanceFilter(filter, timestamp);
+            // A touch the tracker is holding across a dropout has no new position.
+            if (touch.missedScans == 0) {
+                correctFilter(filter, touch.position);
+            }
+        } else {
+            startFilter(filter, touch, timestamp);
+        }
+
+        if (touch.phase != TouchPhase_Ended && write < TouchTracker::kMaximumTracks) {
+            filters_[write++] = filter;
+        }
+
+        TrackedTouch &predicted = touches_[i];
+        predicted = touch;
+        predicted.velocity = Point(filter.vx, filter.vy);
+        double dx = filter.vx * horizon;
+        double dy = filter.vy * horizon;
+        double distance = sqrt(dx * dx + dy * dy);
+        if (distance > maximumDistance) {
+            dx *= maximumDistance / distance;
+            dy *= maximumDistance / distance;
+        }
+        predicted.predictedPosition = Point(filter.x + dx, filter.y + dy);
+    }
+
+    filterCount_ = write;
+    touchCount_ = count;
+}
+
+void MotionPredictor::startFilter(Filter &filter, TrackedTouch const &touch, double timestamp) {
+    filter.identifier = touch.identifier;
+    filter.timestamp = timestamp;
+    filter.x = touch.position.x;
+    filter.y = touch.position.y;
+    filter.vx = touch.velocity.x;
+    filter.vy = touch.velocity.y;
+    filter.p00 = parameters_.measurementNoise;
+    filter.p01 = 0;
+    filter.p11 = kInitialVelocityVariance;
+}
+
+void MotionPredictor::advanceFilter(Filter &filter, double timestamp) {
+    double dt = timestamp - filter.timestamp;
+    if (dt <= 0)
+        return;
+    filter.timestamp = timestamp;
+    filter.x += filter.vx * dt;
+    filter.y += filter.vy * dt;
+
+    double q = parameters_.accelerationNoise;
+    filter.p00 += dt * (2 * filter.p01 + dt * filter.p11) + q * dt * dt * dt / 3;
+    filter.p01 += dt * filter.p11 + q * dt * dt / 2;
+    filter.p11 += q * dt;
+}
+
+void MotionPredictor::correctFilter(Filter &filter, Point position) {
+    double s = filter.p00 + parameters_.measurementNoise;
+    double k0 = filter.p00 / s;
+    double k1 = filter.p01 / s;
+
+    double innovationX = position.x - filter.x;
+    double innovationY = position.y - filter.y;
+    filter.x += k0 * innovationX;
+    filter.vx += k1 * innovationX;
+    filter.y += k0 * innovationY;
+    filter.vy += k1 * innovationY;
+
+    filter.p11 -= k1 * filter.p01;
+    filter.p00 *= 1 - k0;
+    filter.p01 *= 1 - k0;
+}
+
+}
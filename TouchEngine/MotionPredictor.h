@@ -0,0 +1,89 @@
+//
+//  MotionPredictor.h
+//  mickeyMouse
+//
+//  Copyright (c) 2012 Rob Mayoff. All rights reserved.
+//
+
+#ifndef MotionPredictor_h
+#define MotionPredictor_h
+
+#include "TouchEngineTypes.h"
+#include "TouchTracker.h"
+#include <stdint.h>
+
+namespace TouchEngine {
+
+// I hide the latency between a finger moving and the event that reports it.  By the time a touch reaches its consumer, the finger has moved on: the scan took time, the bytes took time to arrive, and the main queue took time to run.  So I extrapolate each touch forward to when its consumer will see it.
+//
+// I run a constant-velocity Kalman filter per tracked touch, and set each touch's `predictedPosition` to the filtered position plus the filtered velocity times the prediction horizon.  The horizon is `sensorLatency` plus the delivery latency you measure and give me.  I cap the extrapolation at `maximumPredictionDistance` so a finger that stops suddenly doesn't fling the pointer.
+//
+// Like `TouchTracker`, I never allocate memory after I'm constructed.
+class MotionPredictor {
+public:
+    struct Parameters {
+        // Seconds from when the sensor sees the finger to the timestamp you give the engine.  You can't measure this from the host, so it's a per-deployment setting.  With a timestamp from `ScanClock`, it's about half a scan period.
+        double sensorLatency;
+
+        // How much I expect a finger to accelerate, as the spectral density of white-noise acceleration, in screen points squared per second cubed.  Bigger values follow quick changes of direction faster; smaller values smooth more.
+        double accelerationNoise;
+
+        // The variance of a touch position, in screen points squared.
+        double measurementNoise;
+
+        double maximumPredictionDistance;
+
+        Parameters();
+    };
+
+    MotionPredictor();
+
+    void setParameters(Parameters const &parameters) { parameters_ = parameters; }
+    Parameters const &parameters() const { return parameters_; }
+
+    // Seconds from the timestamp of a scan to when its touches reach the consumer.  Measure it as the consumer sees the touches and give it to me; I add it to `sensorLatency` to get my prediction horizon.
+    void setDeliveryLatency(double seconds) { deliveryLatency_ = seconds; }
+    double deliveryLatency() const { return deliveryLatency_; }
+
+    double predictionHorizon() const { return parameters_.sensorLatency + deliveryLatency_; }
+
+    // I forget all of my filters.
+    void reset();
+
+    // I filter `touches`, which must come from a `TouchTracker`, and store them with their predicted positions in my `touches`.
+    void update(TrackedTouch const *touches, size_t count, double timestamp);
+
+    TrackedTouch const *touches() const { return touches_; }
+    size_t touchCount() const { return touchCount_; }
+
+private:
+    MotionPredictor(MotionPredictor const &); // not implemented
+    MotionPredictor &operator=(MotionPredictor const &); // not implemented
+
+    // The x and y axes have the same noise, so they share one covariance matrix.
+    struct Filter {
+        uint32_t identifier;
+        double timestamp;
+        double x, vx;
+        double y, vy;
+        double p00, p01, p11; // the symmetric covariance of (position, velocity)
+    };
+
+    void startFilter(Filter &filter, TrackedTouch const &touch, double timestamp);
+    void advanceFilter(Filter &filter, double timestamp);
+    void correctFilter(Filter &filter, Point position);
+
+    Parameters parameters_;
+    double deliveryLatency_;
+
+    // In the same order as the tracker's touches, which is increasing identifier order.
+    Filter filters_[TouchTracker::kMaximumTracks];
+    size_t filterCount_;
+
+    TrackedTouch touches_[2 * TouchTracker::kMaximumTracks];
+    size_t touchCount_;
+};
+
+}
+
+#endif
@@ -0,0 +1,118 @@
+//
+//  RayRegion.cpp
+//  mickeyMouse
+//
+//  Copyright (c) 2012 Rob Mayoff. All rights reserved.
+//
+
+#include "RayRegion.h"
+#include "SweepKernel.h"
+#include <algorithm>
+
+using std::vector;
+
+namespace TouchEngine {
+
+size_t const RayRegion::kGuardRays;
+
+// `true` if the beam from `origin` along `direction` crosses `rect`.  This is the slab test: the beam is inside the rect for the parameters where it's between both pairs of edges.
+static bool beamCrossesRect(Point origin, Point direction, Rect const &rect) {
+    double nearest = 0;
+    double farthest = HUGE_VAL;
+    double const origins[2] = { origin.x, origin.y };
+    double const directions[2] = { direction.x, direction.y };
+    double const minimums[2] = { rect.x, rect.y };
+    double const maximums[2] = { rect.x + rect.width, rect.y + rect.height };
+    for (int axis = 0; axis < 2; ++axis) {
+        if (directions[axis] == 0) {
+            if (origins[axis] < minimums[axis] || origins[axis] > maximums[axis])
+                return false;
+            continue;
+        }
+        double entry = (minimums[axis] - origins[axis]) / directions[axis];
+        double exit = (maximums[axis] - origins[axis]) / directions[axis];
+        if (entry > exit) {
+            std::swap(entry, exit);
+        }
+        nearest = std::max(nearest, entry);
+        farthest = std::min(farthest, exit);
+    }
+    return nearest <= farthest;
+}
+
+RayRegion::RayRegion()
+    : includesEverything_(true), rayCount_(0)
+{ }
+
+void RayRegion::includeEverything() {
+    includesEverything_ = true;
+    rayCount_ = 0;
+    intervals_.clear();
+    mask_.clear();
+    restricted_.clear();
+}
+
+void RayRegion::compute(RayTable const &screenRays, vector<Rect> const &screenRects) {
+    if (screenRects.empty() || screenRays.rayCount() == 0) {
+        includeEverything();
+        return;
+    }
+
+    includesEverything_ = false;
+    rayCount_ = screenRays.rayCount();
+    intervals_.clear();
+    Point const origin = screenRays.origin();
+    for (size_t i = 0; i < rayCount_; ++i) {
+        Point direction = screenRays.direction(i);
+        bool crosses = false;
+        for (size_t r = 0; r < screenRects.size() && !crosses; ++r) {
+            crosses = beamCrossesRect(origin, direction, screenRects[r]);
+        }
+        if (!crosses)
+            continue;
+
+        size_t location = i > kGuardRays ? i - kGuardRays : 0;
+        size_t end = std::min(i + kGuardRays + 1, rayCount_);
+        if (!intervals_.empty() && intervals_.back().end() >= location) {
+            intervals_.back().length = end - intervals_.back().location;
+        } else {
+            intervals_.push_back(SweepRange(location, end - location));
+        }
+    }
+
+    mask_.assign(touchedRayMaskWordCount(rayCount_), 0);
+    restricted_.assign(rayCount_, kInvalidDistance);
+    for (vector<SweepRange>::const_iterator it = intervals_.begin(); it != intervals_.end(); ++it) {
+        for (size_t i = it->location; i < it->end(); ++i) {
+            mask_[i / kTouchedRayMaskBitsPerWord] |= (uint64_t)1 << (i % kTouchedRayMaskBitsPerWord);
+        }
+    }
+}
+
+size_t RayRegion::includedRayCount() const {
+    size_t count = 0;
+    for (vector<SweepRange>::const_iterator it = intervals_.begin(); it != intervals_.end(); ++it) {
+        count += it->length;
+    }
+    return count;
+}
+
+Distance const *RayRegion::restrictScan(Distance const *distances, size_t count) {
+    if (includesEverything_)
+        return distances;
+    if (restricted_.size() < count) {
+        restricted_.resize(count);
+    }
+    Distance *restricted = restricted_.data();
+    for (vector<SweepRange>::const_iterator it = intervals_.begin(); it != intervals_.end(); ++it) {
+        if (it->location >= count)
+            break;
+        std::copy(distances + it->location, distances + std::min(it->end(), count), restricted + it->location);
+    }
+    if (count > rayCount_) {
+        std::copy(distances + rayCount_, distances + count, restricted + rayCount_);
+    }
+    return restricted;
+}
+
+}
@@ -0,0 +1,58 @@
+//
+//  RayRegion.h
+//  mickeyMouse
+//
+//  Copyright (c) 2012 Rob Mayoff. All rights reserved.
+//
+
+#ifndef RayRegion_h
+#define RayRegion_h
+
+#include "RayTable.h"
+#include "TouchEngineTypes.h"
+#include <stdint.h>
+#include <vector>
+
+namespace TouchEngine {
+
+// The rays whose beams can cross a screen.  A touch on any other ray maps outside every screen and gets thrown away, so detection only needs to look at these.  On a wall-mounted sensor that's about a third of the scan.
+//
+// I find them by following each ray's beam in screen coordinates, from a `RayTable` mapped through the touch calibration, and checking whether it crosses any of the screen rectangles.  I add `kGuardRays` rays on either side of each interval, for touches on the edges of a screen and for the difference between the affine transform and a `CorrectionGrid`.
+class RayRegion {
+public:
+    static size_t const kGuardRays = 4;
+
+    RayRegion();
+
+    // I include every ray.
+    void includeEverything();
+
+    // I include the rays of `screenRays` whose beams cross one of `screenRects`.  If there are no rects, I include every ray.
+    void compute(RayTable const &screenRays, std::vector<Rect> const &screenRects);
+
+    bool includesEverything() const { return includesEverything_; }
+
+    // The included rays, as disjoint ranges in ray order.  Empty if I include everything.
+    std::vector<SweepRange> const &intervals() const { return intervals_; }
+
+    // Only meaningful if I don't include everything.
+    size_t includedRayCount() const;
+
+    // One bit per ray, set if I include it, for `rayCount()` rays.  Only meaningful if I don't include everything.
+    uint64_t const *mask() const { return mask_.data(); }
+    size_t rayCount() const { return rayCount_; }
+
+    // I return `distances` with every ray I don't include replaced by `kInvalidDistance`, so nothing downstream finds a touch there.  I only copy the included rays, into a buffer whose other rays I invalidated when I computed my region.  If I include everything, I return `distances` itself.  Rays past `rayCount()` pass through.
+    Distance const *restrictScan(Distance const *distances, size_t count);
+
+private:
+    bool includesEverything_;
+    size_t rayCount_;
+    std::vector<SweepRange> intervals_;
+    std::vector<uint64_t> mask_;
+    std::vector<Distance> restricted_;
+};
+
+}
+
+#endif
@@ -0,0 +1,33 @@
+//
+//  RayTable.cpp
+//  mickeyMouse
+//
+//  Copyright (c) 2012 Rob Mayoff. All rights reserved.
+//
+
+#include "RayTable.h"
+
+namespace TouchEngine {
+
+void RayTable::rebuild(size_t rayCount, double firstRayRadians, double radiansPerRay, AffineTransform const &transform) {
+    origin_ = Point(transform.tx, transform.ty);
+    directions_.resize(rayCount);
+    for (size_t i = 0; i < rayCount; ++i) {
+        double radians = firstRayRadians + i * radiansPerRay;
+        double x = cos(radians);
+        double y = sin(radians);
+        directions_[i] = Point(transform.a * x + transform.c * y, transform.b * x + transform.d * y);
+    }
+}
+
+void RayTable::rebuild(RayTable const &source, AffineTransform const &transform) {
+    origin_ = transform.apply(source.origin_);
+    size_t count = source.directions_.size();
+    directions_.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        Point direction = source.directions_[i];
+        directions_[i] = Point(transform.a * direction.x + transform.c * direction.y, transform.b * direction.x + transform.d * direction.y);
+    }
+}
+
+}
@@ -0,0 +1,48 @@
+//
+//  RayTable.h
+//  mickeyMouse
+//
+//  Copyright (c) 2012 Rob Mayoff. All rights reserved.
+//
+
+#ifndef RayTable_h
+#define RayTable_h
+
+#include "TouchEngineTypes.h"
+#include <vector>
+
+namespace TouchEngine {
+
+// I turn a ray index and a distance into a point with one multiply-add per coordinate.  I store each ray's unit direction already mapped through a transform, and the sensor's origin mapped through it, so I never compute a cosine or a sine per point.  Rebuild me when the geometry or the transform changes.
+class RayTable {
+public:
+    RayTable() { }
+
+    // Ray `i` leaves the sensor at `firstRayRadians + i * radiansPerRay`.  I map its unit direction through the linear part of `transform` and the sensor's origin through all of it.
+    void rebuild(size_t rayCount, double firstRayRadians, double radiansPerRay, AffineTransform const &transform);
+
+    // I take `source`'s rays and map them through `transform`.  This needs no trigonometry, so it's the cheap way to follow a transform that changes often.
+    void rebuild(RayTable const &source, AffineTransform const &transform);
+
+    void clear() { directions_.clear(); }
+
+    size_t rayCount() const { return directions_.size(); }
+    bool contains(size_t rayIndex) const { return rayIndex < directions_.size(); }
+
+    Point origin() const { return origin_; }
+    Point direction(size_t rayIndex) const { return directions_[rayIndex]; }
+
+    // `rayIndex` must be less than `rayCount()`.
+    Point pointForRay(size_t rayIndex, double distance) const {
+        Point const &direction = directions_[rayIndex];
+        return Point(origin_.x + distance * direction.x, origin_.y + distance * direction.y);
+    }
+
+private:
+    Point origin_;
+    std::vector<Point> directions_;
+};
+
+}
+
+#endif
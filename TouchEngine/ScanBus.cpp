@@ -0,0 +1,291 @@
+//
+//  ScanBus.cpp
+//  mickeyMouse
+//
+//  Copyright (c) 2012 Rob Mayoff. All rights reserved.
+//
+
+#include "ScanBus.h"
+#include <algorithm>
+#include <atomic>
+#include <errno.h>
+#include <fcntl.h>
+#include <new>
+#include <stdexcept>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace TouchEngine {
+
+// Section shared memory layout
+
+// The writer and readers are separate processes, so the atomics in shared memory must work without a lock.
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2, "the scan bus needs lock-free 32- and 64-bit atomics");
+
+namespace {
+
+uint32_t const kMagic = 0x5343424D; // "MBCS" in memory on little-endian machines
+uint32_t const kVersion = 1;
+size_t const kCacheLine = 64;
+
+// The bus starts with this header, and the slots follow it.
+struct BusHeader {
+    std::atomic<uint32_t> magic; // the writer sets this last, so a reader never sees a half-made header
+    uint32_t version;
+    uint32_t slotCount;
+    uint32_t maximumRayCount;
+    uint64_t slotSize; // in bytes, including the slot header
+    uint64_t rayCount; // the sensor geometry
+    double coverageDegrees;
+
+    // The writer changes this for every scan, so it gets a cache line of its own.
+    alignas(kCacheLine) std::atomic<uint64_t> publishedCount;
+};
+
+// Each slot starts with this header, and its distances follow it.
+struct SlotHeader {
+    // Odd while the writer is changing the slot.  Otherwise `2 * (sequence + 1)` for the scan the slot holds, or 0 if it has never held one.
+    std::atomic<uint64_t> lock;
+    double timestamp;
+    double receiveTime;
+    uint32_t sensorTimestamp;
+    uint32_t rayCount;
+};
+
+size_t const kHeaderSize = (sizeof(BusHeader) + kCacheLine - 1) / kCacheLine * kCacheLine;
+size_t const kSlotHeaderSize = (sizeof(SlotHeader) + kCacheLine - 1) / kCacheLine * kCacheLine;
+
+size_t slotSizeForRays(size_t rayCount) {
+    return kSlotHeaderSize + (rayCount * sizeof(Distance) + kCacheLine - 1) / kCacheLine * kCacheLine;
+}
+
+uint64_t stableLockForSequence(uint64_t sequence) {
+    return 2 * (sequence + 1);
+}
+
+}
+
+// Section ScanBusWriter
+
+ScanBusWriter::ScanBusWriter()
+    : header_(0), mappedSize_(0), slotCount_(0), maximumRayCount_(0), slotSize_(0), publishedCount_(0)
+{ }
+
+ScanBusWriter::~ScanBusWriter() {
+    destroy();
+}
+
+bool ScanBusWriter::create(char const *name, size_t slotCount, size_t maximumRayCount, SensorGeometry const &geometry) {
+    if (header_)
+        throw std::logic_error("TouchEngine::ScanBusWriter received create while it already has a bus");
+    if (slotCount < 2)
+        throw std::logic_error("TouchEngine::ScanBusWriter received create with fewer than two slots");
+
+    // A bus left over from a writer that crashed might have a different shape, so I start from a new object.  Readers still attached to the old one keep it until they detach.
+    shm_unlink(name);
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0)
+        return false;
+
+    size_t slotSize = slotSizeForRays(maximumRayCount);
+    size_t mappedSize = kHeaderSize + slotCount * slotSize;
+    void *memory = MAP_FAILED;
+    if (ftruncate(fd, (off_t)mappedSize) == 0) {
+        memory = mmap(0, mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    int error = errno;
+    close(fd);
+    if (memory == MAP_FAILED) {
+        shm_unlink(name);
+        errno = error;
+        return false;
+    }
+
+    // `ftruncate` filled the object with zeros, which is every slot's never-used lock.
+    BusHeader *header = new (memory) BusHeader;
+    header->version = kVersion;
+    header->slotCount = (uint32_t)slotCount;
+    header->maximumRayCount = (uint32_t)maximumRayCount;
+    header->slotSize = slotSize;
+    header->rayCount = geometry.rayCount;
+    header->coverageDegrees = geometry.coverageDegrees;
+    header->publishedCount.store(0, std::memory_order_relaxed);
+    for (size_t i = 0; i < slotCount; ++i) {
+        SlotHeader *slot = new ((char *)memory + kHeaderSize + i * slotSize) SlotHeader;
+        slot->lock.store(0, std::memory_order_relaxed);
+    }
+    header->magic.store(kMagic, std::memory_order_release);
+
+    name_ = name;
+    header_ = memory;
+    mappedSize_ = mappedSize;
+    slotCount_ = slotCount;
+    maximumRayCount_ = maximumRayCount;
+    slotSize_ = slotSize;
+    publishedCount_ = 0;
+    return true;
+}
+
+void ScanBusWriter::destroy() {
+    if (!header_)
+        return;
+    munmap(header_, mappedSize_);
+    shm_unlink(name_.c_str());
+    header_ = 0;
+}
+
+void ScanBusWriter::publish(Distance const *distances, size_t count, double timestamp, double receiveTime, uint32_t sensorTimestamp) {
+    if (!header_)
+        throw std::logic_error("TouchEngine::ScanBusWriter received publish without a bus");
+    if (count > maximumRayCount_)
+        throw std::logic_error("TouchEngine::ScanBusWriter received a scan with more rays than its bus holds");
+
+    uint64_t sequence = publishedCount_;
+    char *slotMemory = (char *)header_ + kHeaderSize + (sequence % slotCount_) * slotSize_;
+    SlotHeader *slot = (SlotHeader *)slotMemory;
+
+    // The release fence keeps the odd lock ahead of my writes to the slot, so a reader that sees any of them also sees the lock change.
+    slot->lock.store(slot->lock.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot->timestamp = timestamp;
+    slot->receiveTime = receiveTime;
+    slot->sensorTimestamp = sensorTimestamp;
+    slot->rayCount = (uint32_t)count;
+    memcpy(slotMemory + kSlotHeaderSize, distances, count * sizeof *distances);
+    slot->lock.store(stableLockForSequence(sequence), std::memory_order_release);
+
+    publishedCount_ = sequence + 1;
+    ((BusHeader *)header_)->publishedCount.store(publishedCount_, std::memory_order_release);
+}
+
+// Section ScanBusReader
+
+ScanBusReader::ScanBusReader()
+    : header_(0), mappedSize_(0), slotCount_(0), maximumRayCount_(0), slotSize_(0), nextSequence_(0), overrunCount_(0)
+{ }
+
+ScanBusReader::~ScanBusReader() {
+    detach();
+}
+
+bool ScanBusReader::attach(char const *name) {
+    if (header_)
+        throw std::logic_error("TouchEngine::ScanBusReader received attach while already attached");
+
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0)
+        return false;
+    struct stat status;
+    void *memory = MAP_FAILED;
+    size_t mappedSize = 0;
+    if (fstat(fd, &status) == 0) {
+        mappedSize = (size_t)status.st_size;
+        if (mappedSize < kHeaderSize) {
+            errno = EINVAL;
+        } else {
+            memory = mmap(0, mappedSize, PROT_READ, MAP_SHARED, fd, 0);
+        }
+    }
+    int error = errno;
+    close(fd);
+    if (memory == MAP_FAILED) {
+        errno = error;
+        return false;
+    }
+
+    BusHeader const *header = (BusHeader const *)memory;
+    bool understood = header->magic.load(std::memory_order_acquire) == kMagic
+        && header->version == kVersion
+        && header->slotCount >= 2
+        && header->slotSize >= slotSizeForRays(header->maximumRayCount)
+        && kHeaderSize + header->slotCount * header->slotSize <= mappedSize;
+    if (!understood) {
+        munmap(memory, mappedSize);
+        errno = EINVAL;
+        return false;
+    }
+
+    header_ = memory;
+    mappedSize_ = mappedSize;
+    slotCount_ = header->slotCount;
+    maximumRayCount_ = header->maximumRayCount;
+    slotSize_ = header->slotSize;
+    nextSequence_ = header->publishedCount.load(std::memory_order_acquire);
+    overrunCount_ = 0;
+    return true;
+}
+
+void ScanBusReader::detach() {
+    if (!header_)
+        return;
+    munmap(const_cast<void *>(header_), mappedSize_);
+    header_ = 0;
+}
+
+SensorGeometry ScanBusReader::geometry() const {
+    if (!header_)
+        return SensorGeometry();
+    BusHeader const *header = (BusHeader const *)header_;
+    return SensorGeometry(header->rayCount, header->coverageDegrees);
+}
+
+uint64_t ScanBusReader::publishedCount() const {
+    return header_ ? ((BusHeader const *)header_)->publishedCount.load(std::memory_order_acquire) : 0;
+}
+
+bool ScanBusReader::nextScan(ScanBusScan &scan) {
+    uint64_t published = publishedCount();
+    while (nextSequence_ < published) {
+        // The writer may already be changing the slot after the newest scan, which is the oldest scan's slot, so one slot of the ring is never safe.
+        uint64_t oldestSafe = published > slotCount_ - 1 ? published - (slotCount_ - 1) : 0;
+        if (nextSequence_ < oldestSafe) {
+            overrunCount_ += oldestSafe - nextSequence_;
+            nextSequence_ = oldestSafe;
+        }
+        if (readSlot(nextSequence_, scan)) {
+            ++nextSequence_;
+            return true;
+        }
+        // The writer overwrote the slot while I looked at it.
+        ++overrunCount_;
+        ++nextSequence_;
+        published = publishedCount();
+    }
+    return false;
+}
+
+bool ScanBusReader::latestScan(ScanBusScan &scan) {
+    uint64_t published = publishedCount();
+    if (nextSequence_ < published) {
+        nextSequence_ = published - 1;
+    }
+    return nextScan(scan);
+}
+
+bool ScanBusReader::readSlot(uint64_t sequence, ScanBusScan &scan) const {
+    char const *slotMemory = (char const *)header_ + kHeaderSize + (sequence % slotCount_) * slotSize_;
+    SlotHeader const *slot = (SlotHeader const *)slotMemory;
+    uint64_t lock = slot->lock.load(std::memory_order_acquire);
+    if (lock != stableLockForSequence(sequence))
+        return false;
+
+    scan.sequence = sequence;
+    scan.timestamp = slot->timestamp;
+    scan.receiveTime = slot->receiveTime;
+    scan.sensorTimestamp = slot->sensorTimestamp;
+    scan.count = std::min((size_t)slot->rayCount, maximumRayCount_);
+    scan.distances = (Distance const *)(slotMemory + kSlotHeaderSize);
+    scan.slot = slot;
+    scan.slotSequence = lock;
+    return isIntact(scan);
+}
+
+// The acquire fence keeps my reads of the slot ahead of this second look at its lock.
+bool ScanBusReader::isIntact(ScanBusScan const &scan) const {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return ((SlotHeader const *)scan.slot)->lock.load(std::memory_order_relaxed) == scan.slotSequence;
+}
+
+}
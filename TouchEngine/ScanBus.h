@@ -0,0 +1,123 @@
+//
+//  ScanBus.h
+//  mickeyMouse
+//
+//  Copyright (c) 2012 Rob Mayoff. All rights reserved.
+//
+
+#ifndef ScanBus_h
+#define ScanBus_h
+
+#include "TouchEngineTypes.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+namespace TouchEngine {
+
+// Only one process can open a sensor, because `Lidar2DConnection` locks its tty.  The process that owns the sensor can put every scan on a scan bus, and any number of other processes, such as monitoring tools, can read the scans from it without asking the owner for anything.
+//
+// A scan bus is a POSIX shared memory object holding a ring of slots.  Each slot holds one scan and is guarded by a sequence lock: the writer makes the slot's sequence odd while it writes the slot and then sets it to an even number that says which scan the slot holds.  A reader checks the sequence before and after it looks at a slot, so it never blocks the writer and never trusts a scan the writer changed under it.  The writer doesn't know the readers exist, so a slow reader can't slow it down; it just loses scans, and I count them.
+//
+// Readers use scans in place, without copying them out of the shared memory.  Because the writer can overwrite a slot while you're using it, check `ScanBusReader::isIntact` after you've read a scan's distances and throw away what you computed from them if it says no.  The ring has enough slots that this only happens to a reader that's far behind.
+
+// One scan on the bus, as a reader sees it.
+struct ScanBusScan {
+    uint64_t sequence; // how many scans the writer published before this one
+    double timestamp; // when the sensor took the scan, in host time
+    double receiveTime; // when the host received the scan, in host time
+    uint32_t sensorTimestamp; // the sensor's own timestamp, in milliseconds
+    Distance const *distances; // in the shared memory; see `ScanBusReader::isIntact`
+    size_t count;
+
+    // For `ScanBusReader::isIntact`.
+    void const *slot;
+    uint64_t slotSequence;
+};
+
+// I create a scan bus and publish scans on it.  I don't allocate or make system calls in `publish`, so you can call it from the thread that receives the scans.
+class ScanBusWriter {
+public:
+    ScanBusWriter();
+
+    // I destroy the bus if I made one.
+    ~ScanBusWriter();
+
+    // I create the bus `name` (a POSIX shared memory name, like `/mickeyMouse-scans`) with `slotCount` slots of up to `maximumRayCount` rays, for a sensor with `geometry`, and return true.  If a bus with that name is left over from a writer that crashed, I replace it.  I return false and set `errno` if I can't.  It's a logic error to create a bus when I already have one, or with fewer than two slots.
+    bool create(char const *name, size_t slotCount, size_t maximumRayCount, SensorGeometry const &geometry);
+
+    // I unmap and unlink my bus.  Readers that are attached keep the memory, but they won't see any more scans.
+    void destroy();
+
+    bool isCreated() const { return header_ != 0; }
+    size_t maximumRayCount() const { return maximumRayCount_; }
+
+    // I copy one scan into the next slot.  It's a logic error to publish without a bus or with more rays than the bus holds.
+    void publish(Distance const *distances, size_t count, double timestamp, double receiveTime, uint32_t sensorTimestamp);
+
+    uint64_t publishedCount() const { return publishedCount_; }
+
+private:
+    ScanBusWriter(ScanBusWriter const &); // not implemented
+    ScanBusWriter &operator=(ScanBusWriter const &); // not implemented
+
+    std::string name_;
+    void *header_;
+    size_t mappedSize_;
+    size_t slotCount_;
+    size_t maximumRayCount_;
+    size_t slotSize_;
+    uint64_t publishedCount_;
+};
+
+// I read scans from a scan bus that another process writes.  I map the bus read-only, and I don't allocate or make system calls while reading.
+class ScanBusReader {
+public:
+    ScanBusReader();
+
+    // I detach if I'm attached.
+    ~ScanBusReader();
+
+    // I attach to the bus `name` and return true.  I start after the newest scan on the bus.  I return false and set `errno` if the bus doesn't exist, I can't map it, or it isn't a scan bus I understand.  It's a logic error to attach when I'm already attached.
+    bool attach(char const *name);
+
+    void detach();
+
+    bool isAttached() const { return header_ != 0; }
+    SensorGeometry geometry() const;
+    size_t slotCount() const { return slotCount_; }
+    size_t maximumRayCount() const { return maximumRayCount_; }
+
+    // I set `scan` to the oldest scan I haven't given you yet that's still safely on the bus, and return true.  I return false if there's no new scan.  If the writer got more than a ring ahead of me, I skip the scans it overwrote and count them in `overrunCount`.
+    bool nextScan(ScanBusScan &scan);
+
+    // I set `scan` to the newest scan on the bus, skipping any others I haven't given you, and return true.  I return false if there's no new scan.  Scans you skip this way don't count as overruns.
+    bool latestScan(ScanBusScan &scan);
+
+    // I return true if the writer hasn't touched `scan`'s slot since I gave you `scan`, so everything you read from its distances is good.
+    bool isIntact(ScanBusScan const &scan) const;
+
+    // How many scans the writer has published.
+    uint64_t publishedCount() const;
+
+    // How many scans I lost because the writer overwrote them before I read them.
+    uint64_t overrunCount() const { return overrunCount_; }
+
+private:
+    ScanBusReader(ScanBusReader const &); // not implemented
+    ScanBusReader &operator=(ScanBusReader const &); // not implemented
+
+    bool readSlot(uint64_t sequence, ScanBusScan &scan) const;
+
+    void const *header_;
+    size_t mappedSize_;
+    size_t slotCount_;
+    size_t maximumRayCount_;
+    size_t slotSize_;
+    uint64_t nextSequence_;
+    uint64_t overrunCount_;
+};
+
+}
+
+#endif
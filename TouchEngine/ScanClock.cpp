@@ -0,0 +1,52 @@
+//
+//  ScanClock.cpp
+//  mickeyMouse
+//
+//  Copyright (c) 2012 Rob Mayoff. All rights reserved.
+//
+
+#include "ScanClock.h"
+#include <algorithm>
+
+namespace TouchEngine {
+
+uint32_t const ScanClock::kSensorTimestampMask;
+double const ScanClock::kMaximumDrift = 100e-6;
+
+ScanClock::ScanClock() {
+    reset();
+}
+
+void ScanClock::reset() {
+    started_ = false;
+    lastSensorMilliseconds_ = 0;
+    sensorSeconds_ = 0;
+    offset_ = 0;
+    lastTransferDelay_ = 0;
+}
+
+double ScanClock::hostTimeForScan(uint32_t sensorMilliseconds, double receiveTime) {
+    sensorMilliseconds &= kSensorTimestampMask;
+    uint32_t elapsed = (sensorMilliseconds - lastSensorMilliseconds_) & kSensorTimestampMask;
+    // A jump of more than half the clock's range is really a step backward, which means the sensor restarted its clock.
+    if (started_ && elapsed > kSensorTimestampMask / 2) {
+        started_ = false;
+    }
+
+    if (!started_) {
+        started_ = true;
+        sensorSeconds_ = 0;
+        offset_ = receiveTime;
+    } else {
+        double elapsedSeconds = elapsed * 1e-3;
+        sensorSeconds_ += elapsedSeconds;
+        offset_ = std::min(offset_ + kMaximumDrift * elapsedSeconds, receiveTime - sensorSeconds_);
+    }
+    lastSensorMilliseconds_ = sensorMilliseconds;
+
+    double hostTime = sensorSeconds_ + offset_;
+    lastTransferDelay_ = receiveTime - hostTime;
+    return hostTime;
+}
+
+}
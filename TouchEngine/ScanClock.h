@@ -0,0 +1,47 @@
+//
+//  ScanClock.h
+//  mickeyMouse
+//
+//  Copyright (c) 2012 Rob Mayoff. All rights reserved.
+//
+
+#ifndef ScanClock_h
+#define ScanClock_h
+
+#include <stdint.h>
+
+namespace TouchEngine {
+
+// I turn the sensor's scan timestamps into host time, so a scan's timestamp says when the sensor took it rather than when the host got around to reading it.
+//
+// The sensor stamps each scan with its own millisecond clock, which wraps around.  The host time when a scan arrives is the sensor time plus a constant offset plus a transfer delay that varies from scan to scan but is never negative.  So I track the smallest offset I've seen, which is the offset with the least delay in it, and let it creep up slowly in case the two clocks run at slightly different rates.
+class ScanClock {
+public:
+    // SCIP 2.0 timestamps have 24 bits.
+    static uint32_t const kSensorTimestampMask = 0xFFFFFF;
+
+    // How fast I let my offset grow, in seconds per second, to follow a sensor clock that runs slow.
+    static double const kMaximumDrift;
+
+    ScanClock();
+
+    // I forget the sensor clock, for example because the sensor reconnected.
+    void reset();
+
+    // `sensorMilliseconds` is the scan's timestamp from the sensor and `receiveTime` is the host time, in seconds, when it arrived.  I return the host time when the sensor took the scan, which is never later than `receiveTime`.
+    double hostTimeForScan(uint32_t sensorMilliseconds, double receiveTime);
+
+    // How long the most recent scan took to arrive, by my estimate.
+    double lastTransferDelay() const { return lastTransferDelay_; }
+
+private:
+    bool started_;
+    uint32_t lastSensorMilliseconds_;
+    double sensorSeconds_; // the unwrapped sensor clock
+    double offset_;
+    double lastTransferDelay_;
+};
+
+}
+
+#endif
@@ -0,0 +1,166 @@
+//
+//  ScanFilter.cpp
+//  mickeyMouse
+//
+//  Copyright (c) 2012 Rob Mayoff. All rights reserved.
+//
+
+#include "ScanFilter.h"
+#include <algorithm>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define TOUCH_ENGINE_X86 1
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define TOUCH_ENGINE_NEON 1
+#include <arm_neon.h>
+#endif
+
+using std::vector;
+
+namespace TouchEngine {
+
+size_t const ScanFilter::kMaximumLength;
+
+// Median kernels
+
+// I write every median as a network of minimums and maximums, so each SIMD version is a straight transliteration of these.  The median of five uses the identity median(a, b, c, d, e) = median(e, max(min(a, b), min(c, d)), min(max(a, b), max(c, d))).
+
+static inline Distance minimum(Distance a, Distance b) { return b < a ? b : a; }
+static inline Distance maximum(Distance a, Distance b) { return a < b ? b : a; }
+
+static inline Distance median3(Distance a, Distance b, Distance c) {
+    return maximum(minimum(a, b), minimum(maximum(a, b), c));
+}
+
+static inline Distance median5(Distance a, Distance b, Distance c, Distance d, Distance e) {
+    return median3(e, maximum(minimum(a, b), minimum(c, d)), minimum(maximum(a, b), maximum(c, d)));
+}
+
+static void computeScanMediansTail(Distance const *const *scans, size_t scanCount, size_t begin, size_t count, Distance *medians) {
+    if (scanCount == 3) {
+        for (size_t i = begin; i < count; ++i) {
+            medians[i] = median3(scans[0][i], scans[1][i], scans[2][i]);
+        }
+    } else {
+        for (size_t i = begin; i < count; ++i) {
+            medians[i] = median5(scans[0][i], scans[1][i], scans[2][i], scans[3][i], scans[4][i]);
+        }
+    }
+}
+
+void computeScanMediansScalar(Distance const *const *scans, size_t scanCount, size_t count, Distance *medians) {
+    computeScanMediansTail(scans, scanCount, 0, count, medians);
+}
+
+#if TOUCH_ENGINE_X86
+
+// SSE2 is part of x86-64, so I don't need to check for it.  The scans are too short and too few for wider vectors to pay for a dispatch.
+static inline __m128 median3(__m128 a, __m128 b, __m128 c) {
+    return _mm_max_ps(_mm_min_ps(a, b), _mm_min_ps(_mm_max_ps(a, b), c));
+}
+
+void computeScanMedians(Distance const *const *scans, size_t scanCount, size_t count, Distance *medians) {
+    size_t const vectorCount = count & ~(size_t)3;
+    if (scanCount == 3) {
+        for (size_t i = 0; i < vectorCount; i += 4) {
+            _mm_storeu_ps(medians + i, median3(_mm_loadu_ps(scans[0] + i), _mm_loadu_ps(scans[1] + i), _mm_loadu_ps(scans[2] + i)));
+        }
+    } else {
+        for (size_t i = 0; i < vectorCount; i += 4) {
+            __m128 a = _mm_loadu_ps(scans[0] + i);
+            __m128 b = _mm_loadu_ps(scans[1] + i);
+            __m128 c = _mm_loadu_ps(scans[2] + i);
+            __m128 d = _mm_loadu_ps(scans[3] + i);
+            __m128 e = _mm_loadu_ps(scans[4] + i);
+            __m128 low = _mm_max_ps(_mm_min_ps(a, b), _mm_min_ps(c, d));
+            __m128 high = _mm_min_ps(_mm_max_ps(a, b), _mm_max_ps(c, d));
+            _mm_storeu_ps(medians + i, median3(e, low, high));
+        }
+    }
+    computeScanMediansTail(scans, scanCount, vectorCount, count, medians);
+}
+
+#elif TOUCH_ENGINE_NEON
+
+static inline float32x4_t median3(float32x4_t a, float32x4_t b, float32x4_t c) {
+    return vmaxq_f32(vminq_f32(a, b), vminq_f32(vmaxq_f32(a, b), c));
+}
+
+void computeScanMedians(Distance const *const *scans, size_t scanCount, size_t count, Distance *medians) {
+    size_t const vectorCount = count & ~(size_t)3;
+    if (scanCount == 3) {
+        for (size_t i = 0; i < vectorCount; i += 4) {
+            vst1q_f32(medians + i, median3(vld1q_f32(scans[0] + i), vld1q_f32(scans[1] + i), vld1q_f32(scans[2] + i)));
+        }
+    } else {
+        for (size_t i = 0; i < vectorCount; i += 4) {
+            float32x4_t a = vld1q_f32(scans[0] + i);
+            float32x4_t b = vld1q_f32(scans[1] + i);
+            float32x4_t c = vld1q_f32(scans[2] + i);
+            float32x4_t d = vld1q_f32(scans[3] + i);
+            float32x4_t e = vld1q_f32(scans[4] + i);
+            float32x4_t low = vmaxq_f32(vminq_f32(a, b), vminq_f32(c, d));
+            float32x4_t high = vminq_f32(vmaxq_f32(a, b), vmaxq_f32(c, d));
+            vst1q_f32(medians + i, median3(e, low, high));
+        }
+    }
+    computeScanMediansTail(scans, scanCount, vectorCount, count, medians);
+}
+
+#else
+
+void computeScanMedians(Distance const *const *scans, size_t scanCount, size_t count, Distance *medians) {
+    computeScanMediansScalar(scans, scanCount, count, medians);
+}
+
+#endif
+
+// Public API
+
+ScanFilter::ScanFilter()
+    : length_(1), rayCount_(0), hasHistory_(false), nextScan_(0)
+{ }
+
+void ScanFilter::setLength(size_t length) {
+    if (length != 1 && length != 3 && length != 5)
+        throw std::logic_error("ScanFilter length must be 1, 3 or 5");
+    length_ = length;
+    reset();
+}
+
+void ScanFilter::reset() {
+    hasHistory_ = false;
+    nextScan_ = 0;
+}
+
+Distance const *ScanFilter::filter(Distance const *distances, size_t count) {
+    if (length_ == 1)
+        return distances;
+
+    if (count != rayCount_ || !hasHistory_) {
+        rayCount_ = count;
+        history_.resize(length_ * count);
+        filtered_.resize(count);
+        for (size_t row = 0; row < length_; ++row) {
+            std::copy(distances, distances + count, &history_[row * count]);
+        }
+        hasHistory_ = true;
+        nextScan_ = 1 % length_;
+        std::copy(distances, distances + count, filtered_.begin());
+        return filtered_.data();
+    }
+
+    std::copy(distances, distances + count, &history_[nextScan_ * count]);
+    nextScan_ = (nextScan_ + 1) % length_;
+
+    Distance const *scans[kMaximumLength];
+    for (size_t row = 0; row < length_; ++row) {
+        scans[row] = &history_[row * count];
+    }
+    computeScanMedians(scans, length_, count, filtered_.data());
+    return filtered_.data();
+}
+
+}
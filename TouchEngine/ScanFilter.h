@@ -0,0 +1,53 @@
+//
+//  ScanFilter.h
+//  mickeyMouse
+//
+//  Copyright (c) 2012 Rob Mayoff. All rights reserved.
+//
+
+#ifndef ScanFilter_h
+#define ScanFilter_h
+
+#include "TouchEngineTypes.h"
+#include <vector>
+
+namespace TouchEngine {
+
+// I suppress single-scan speckle (dust, edge hits, mixed pixels) before the engine compares a scan against its thresholds.  I replace each ray's distance with the median of that ray's distances over the last `length` scans, so a blip that lasts fewer than half of them never reaches the thresholds and never becomes a phantom touch.
+//
+// Unlike a moving average, a median doesn't smear a real change across the window: a finger that lands shows up whole, `(length - 1) / 2` scans late.  That delay is the price; a 3-scan median costs one scan period of latency on a real touch.
+class ScanFilter {
+public:
+    static size_t const kMaximumLength = 5;
+
+    ScanFilter();
+
+    // 1 turns me off.  3 or 5 are medians over that many scans.  Anything else is a logic error.  Changing my length forgets my history.
+    void setLength(size_t length);
+    size_t length() const { return length_; }
+
+    // I forget my history, so the next scan starts it over.
+    void reset();
+
+    // I add `distances` to my history and return the filtered scan, which stays valid until you send me another message.  I fill my history with the first scan after a reset or a change in the number of rays, so the median is defined from the first scan on.  When I'm off, I return `distances`.
+    Distance const *filter(Distance const *distances, size_t count);
+
+private:
+    size_t length_;
+    size_t rayCount_;
+    bool hasHistory_;
+    size_t nextScan_; // the history row the next scan replaces
+
+    std::vector<Distance> history_; // `length_` rows of `rayCount_` distances
+    std::vector<Distance> filtered_;
+};
+
+// The per-ray median of `scanCount` scans (3 or 5) of `count` rays each, stored in `medians`.  I use SIMD min/max networks where the CPU has them.
+void computeScanMedians(Distance const *const *scans, size_t scanCount, size_t count, Distance *medians);
+
+// The portable version of `computeScanMedians`, for reference and benchmarking.
+void computeScanMediansScalar(Distance const *const *scans, size_t scanCount, size_t count, Distance *medians);
+
+}
+
+#endif
@@ -0,0 +1,149 @@
+//
+//  ScanRecording.cpp
+//  mickeyMouse
+//
+//  Copyright (c) 2012 Rob Mayoff. All rights reserved.
+//
+
+#include "ScanRecording.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+using std::string;
+
+namespace TouchEngine {
+
+static char const kSeparators[] = " \t\r\n";
+
+ScanRecordingReader::ScanRecordingReader(FILE *file)
+    : file_(file), lineNumber_(0)
+{ }
+
+bool ScanRecordingReader::readEvent(RecordingEvent &event) {
+    errorMessage_.clear();
+    char chunk[4096];
+    while (true) {
+        // A scan line of a 1440-ray sensor is longer than `chunk`, so I accumulate chunks until I have a whole line.
+        line_.clear();
+        while (fgets(chunk, sizeof chunk, file_)) {
+            line_ += chunk;
+            if (!line_.empty() && line_[line_.size() - 1] == '\n')
+                break;
+        }
+        if (line_.empty()) {
+            if (ferror(file_))
+                return fail(strerror(errno));
+            return false;
+        }
+        ++lineNumber_;
+
+        char *line = &line_[0];
+        line += strspn(line, kSeparators);
+        if (*line == '\0' || *line == '#')
+            continue;
+        return parseLine(line, event);
+    }
+}
+
+bool ScanRecordingReader::fail(char const *message) {
+    char prefix[32];
+    snprintf(prefix, sizeof prefix, "line %zu: ", lineNumber_);
+    errorMessage_ = string(prefix) + message;
+    return false;
+}
+
+static bool parseDouble(char *&cursor, double &value) {
+    char *end;
+    value = strtod(cursor, &end);
+    if (end == cursor)
+        return false;
+    cursor = end;
+    return true;
+}
+
+static bool parseDistance(char *&cursor, Distance &distance) {
+    cursor += strspn(cursor, kSeparators);
+    if (*cursor == '-' && (cursor[1] == '\0' || strchr(kSeparators, cursor[1]))) {
+        distance = kInvalidDistance;
+        ++cursor;
+        return true;
+    }
+    char *end;
+    distance = strtof(cursor, &end);
+    if (end == cursor)
+        return false;
+    cursor = end;
+    return true;
+}
+
+static bool atEndOfLine(char *cursor) {
+    return cursor[strspn(cursor, kSeparators)] == '\0';
+}
+
+bool ScanRecordingReader::parseLine(char *line, RecordingEvent &event) {
+    size_t keywordLength = strcspn(line, kSeparators);
+    string keyword(line, keywordLength);
+    char *cursor = line + keywordLength;
+
+    if (keyword == "scan") {
+        event.kind = RecordingEvent::Kind_Scan;
+        if (!parseDouble(cursor, event.timestamp))
+            return fail("scan needs a timestamp");
+        event.distances.clear();
+        while (!atEndOfLine(cursor)) {
+            Distance distance;
+            if (!parseDistance(cursor, distance))
+                return fail("scan has a malformed distance");
+            event.distances.push_back(distance);
+        }
+        return true;
+    }
+
+    if (keyword == "geometry") {
+        event.kind = RecordingEvent::Kind_Geometry;
+        double rayCount;
+        if (!parseDouble(cursor, rayCount) || rayCount < 1 || !parseDouble(cursor, event.geometry.coverageDegrees) || !atEndOfLine(cursor))
+            return fail("geometry needs a ray count and a coverage angle");
+        event.geometry.rayCount = (size_t)rayCount;
+        return true;
+    }
+
+    if (keyword == "screen") {
+        event.kind = RecordingEvent::Kind_Screen;
+        Rect &rect = event.screen;
+        if (!parseDouble(cursor, rect.x) || !parseDouble(cursor, rect.y) || !parseDouble(cursor, rect.width) || !parseDouble(cursor, rect.height) || !atEndOfLine(cursor))
+            return fail("screen needs x, y, width and height");
+        return true;
+    }
+
+    if (keyword == "calibrate-thresholds") {
+        event.kind = RecordingEvent::Kind_CalibrateThresholds;
+        if (!atEndOfLine(cursor))
+            return fail("calibrate-thresholds takes no arguments");
+        return true;
+    }
+
+    if (keyword == "calibrate-touch") {
+        event.kind = RecordingEvent::Kind_CalibrateTouch;
+        if (!parseDouble(cursor, event.screenPoint.x) || !parseDouble(cursor, event.screenPoint.y) || !atEndOfLine(cursor))
+            return fail("calibrate-touch needs a screen point");
+        return true;
+    }
+
+    return fail(("unknown event " + keyword).c_str());
+}
+
+void writeRecordedScan(FILE *file, double timestamp, Distance const *distances, size_t count) {
+    fprintf(file, "scan %.6f", timestamp);
+    for (size_t i = 0; i < count; ++i) {
+        if (isValidDistance(distances[i])) {
+            fprintf(file, " %g", distances[i]);
+        } else {
+            fputs(" -", file);
+        }
+    }
+    fputc('\n', file);
+}
+
+}
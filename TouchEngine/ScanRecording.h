@@ -0,0 +1,74 @@
+//
+//  ScanRecording.h
+//  mickeyMouse
+//
+//  Copyright (c) 2012 Rob Mayoff. All rights reserved.
+//
+
+#ifndef ScanRecording_h
+#define ScanRecording_h
+
+#include "TouchEngineTypes.h"
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+namespace TouchEngine {
+
+// A scan recording is a text file with one event per line.  Blank lines and lines starting with `#` are ignored.
+//
+//     geometry <ray count> <coverage degrees>
+//     screen <x> <y> <width> <height>
+//     scan <timestamp> <distance>...
+//     calibrate-thresholds
+//     calibrate-touch <screen x> <screen y>
+//
+// An invalid distance is `-`.  `dumpStreamingData` writes `geometry` and `scan` lines; add the calibration lines by hand to replay a calibration session.
+
+struct RecordingEvent {
+    enum Kind {
+        Kind_Geometry,
+        Kind_Screen,
+        Kind_Scan,
+        Kind_CalibrateThresholds,
+        Kind_CalibrateTouch
+    };
+
+    Kind kind;
+    SensorGeometry geometry; // for `Kind_Geometry`
+    Rect screen; // for `Kind_Screen`
+    double timestamp; // for `Kind_Scan`
+    std::vector<Distance> distances; // for `Kind_Scan`
+    Point screenPoint; // for `Kind_CalibrateTouch`
+
+    RecordingEvent() : kind(Kind_Scan), timestamp(0) { }
+};
+
+// I read events from a scan recording.
+class ScanRecordingReader {
+public:
+    // I don't close `file`.
+    explicit ScanRecordingReader(FILE *file);
+
+    // I read the next event into `event`, reusing its storage.  I return false at the end of the file or on a malformed line; check `errorMessage` to tell them apart.
+    bool readEvent(RecordingEvent &event);
+
+    // Empty unless `readEvent` failed on a malformed line or a read error.  Includes the line number.
+    std::string const &errorMessage() const { return errorMessage_; }
+
+private:
+    bool parseLine(char *line, RecordingEvent &event);
+    bool fail(char const *message);
+
+    FILE *file_;
+    std::string line_;
+    size_t lineNumber_;
+    std::string errorMessage_;
+};
+
+// I write `distances` as a `scan` line.
+void writeRecordedScan(FILE *file, double timestamp, Distance const *distances, size_t count);
+
+}
+
+#endif
@@ -0,0 +1,168 @@
+//
+//  ScreenCalibration.cpp
+//  mickeyMouse
+//
+//  Copyright (c) 2012 Rob Mayoff. All rights reserved.
+//
+
+#include "ScreenCalibration.h"
+#include "ThresholdCalibration.h"
+#include <algorithm>
+
+using std::vector;
+
+namespace TouchEngine {
+
+// A ray only counts as touched during touch calibration if it reported a valid distance in every report.
+static size_t const kDistancesNeededForRayToBeTreatedAsTouch = ScreenCalibration::kReportsNeeded;
+
+ScreenCalibration::ScreenCalibration()
+    : rayCount_(0), radiansPerRay_(0), reportsReceived_(0), nonlinearCorrectionEnabled_(false), mappingRevision_(0), ready_(false)
+{ }
+
+void ScreenCalibration::setGeometry(SensorGeometry const &geometry) {
+    rayCount_ = geometry.rayCount;
+    radiansPerRay_ = geometry.radiansPerRay();
+    sensorRays_.rebuild(rayCount_, 0, radiansPerRay_, AffineTransform());
+    screenRays_.rebuild(sensorRays_, transform_);
+    ++mappingRevision_;
+}
+
+void ScreenCalibration::reset() {
+    sensorPoints_.clear();
+    screenPoints_.clear();
+    fit_.reset();
+    correctionGrid_.clear();
+    ++mappingRevision_;
+    reportsReceived_ = 0;
+    ready_ = false;
+}
+
+void ScreenCalibration::setNonlinearCorrectionEnabled(bool enabled) {
+    nonlinearCorrectionEnabled_ = enabled;
+    rebuildCorrectionGrid();
+}
+
+void ScreenCalibration::startCalibratingTouchAtScreenPoint(Point screenPoint) {
+    currentScreenPoint_ = screenPoint;
+    reportsReceived_ = 0;
+    ready_ = false;
+}
+
+ScreenCalibration::Result ScreenCalibration::calibrate(Distance const *distances, size_t count, ThresholdCalibration const &thresholdCalibration) {
+    if (reportsReceived_ == 0) {
+        resetDistanceAccumulators(count);
+    }
+    accumulateDistances(distances, count);
+    if (++reportsReceived_ < kReportsNeeded)
+        return Result_InProgress;
+
+    vector<Distance> averages;
+    getAverageDistances(averages);
+    size_t touchesFound = 0;
+    size_t rayIndex = 0;
+    thresholdCalibration.forEachTouchedSweep(averages.data(), averages.size(), [&](SweepRange sweep) {
+        ++touchesFound;
+        rayIndex = sweep.middle();
+    });
+
+    if (touchesFound != 1) {
+        resumeReadyIfPossible();
+        return touchesFound == 0 ? Result_NoTouchDetected : Result_MultipleTouchesDetected;
+    }
+
+    Point sensorPoint = sensorPointForRay(rayIndex, averages[rayIndex]);
+    sensorPoints_.push_back(sensorPoint);
+    screenPoints_.push_back(currentScreenPoint_);
+    fit_.add(sensorPoint, currentScreenPoint_);
+    becomeReadyIfPossible();
+    return Result_Success;
+}
+
+Point ScreenCalibration::sensorPointForRayOutsideGeometry(size_t rayIndex, Distance distance) const {
+    double radians = rayIndex * radiansPerRay_;
+    return Point(distance * cos(radians), distance * sin(radians));
+}
+
+void ScreenCalibration::restore(vector<Point> const &sensorPoints, vector<Point> const &screenPoints) {
+    size_t count = std::min(sensorPoints.size(), screenPoints.size());
+    sensorPoints_.assign(sensorPoints.begin(), sensorPoints.begin() + count);
+    screenPoints_.assign(screenPoints.begin(), screenPoints.begin() + count);
+    fit_.reset();
+    for (size_t i = 0; i < count; ++i) {
+        fit_.add(sensorPoints_[i], screenPoints_[i]);
+    }
+    becomeReadyIfPossible();
+}
+
+bool ScreenCalibration::refine(Point screenPoint, Point intendedScreenPoint, double weight) {
+    if (!ready_ || !correctionGrid_.isEmpty())
+        return false;
+    fit_.add(transform_.inverted().apply(screenPoint), intendedScreenPoint, weight);
+    return computeTransform();
+}
+
+// Implementation details
+
+void ScreenCalibration::resetDistanceAccumulators(size_t count) {
+    distanceSums_.assign(count, 0);
+    distanceCounts_.assign(count, 0);
+}
+
+void ScreenCalibration::accumulateDistances(Distance const *distances, size_t count) {
+    if (count < distanceCounts_.size()) {
+        distanceCounts_.resize(count);
+        distanceSums_.resize(count);
+    }
+    for (size_t i = 0, n = distanceCounts_.size(); i < n; ++i) {
+        Distance distance = distances[i];
+        if (!isValidDistance(distance))
+            continue;
+        distanceSums_[i] += distance;
+        ++distanceCounts_[i];
+    }
+}
+
+void ScreenCalibration::getAverageDistances(vector<Distance> &averages) const {
+    size_t count = distanceSums_.size();
+    averages.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        averages.push_back(distanceCounts_[i] >= kDistancesNeededForRayToBeTreatedAsTouch
+            ? distanceSums_[i] / distanceCounts_[i]
+            : kInvalidDistance);
+    }
+}
+
+void ScreenCalibration::resumeReadyIfPossible() {
+    if (sensorPoints_.size() >= kTouchesNeeded) {
+        ready_ = true;
+    }
+}
+
+void ScreenCalibration::becomeReadyIfPossible() {
+    if (sensorPoints_.size() < kTouchesNeeded)
+        return;
+    // If the touches are collinear, there's no unique transform.  I stay not ready so the user calibrates another touch.
+    ready_ = computeTransform();
+    rebuildCorrectionGrid();
+}
+
+bool ScreenCalibration::computeTransform() {
+    if (!fit_.solve(transform_))
+        return false;
+    screenRays_.rebuild(sensorRays_, transform_);
+    ++mappingRevision_;
+    return true;
+}
+
+void ScreenCalibration::rebuildCorrectionGrid() {
+    // If the spline fails, I fall back to the affine transform.
+    if (nonlinearCorrectionEnabled_) {
+        correctionGrid_.build(sensorPoints_, screenPoints_, CorrectionGrid::kDefaultSmoothing);
+    } else {
+        correctionGrid_.clear();
+    }
+    ++mappingRevision_;
+}
+
+}
@@ -0,0 +1,123 @@
+//
+//  ScreenCalibration.h
+//  mickeyMouse
+//
+//  Copyright (c) 2012 Rob Mayoff. All rights reserved.
+//
+
+#ifndef ScreenCalibration_h
+#define ScreenCalibration_h
+
+#include "AffineFit.h"
+#include "CorrectionGrid.h"
+#include "RayTable.h"
+#include "TouchEngineTypes.h"
+#include <stdint.h>
+#include <vector>
+
+namespace TouchEngine {
+
+class ThresholdCalibration;
+
+// I learn how to map a touch from sensor coordinates to screen coordinates.  The user touches `kTouchesNeeded` known screen points, one at a time.  For each, I average `kReportsNeeded` reports and find the single touched sweep.  Then I fit an affine transform from the sensor points to the screen points.  I keep the fit's normal equations, so each touch, including the ones you give me to `refine` during normal use, updates the transform in constant time.
+//
+// If you turn on non-linear correction and the user calibrates at least `CorrectionGrid::kMinimumTouches` touches, I map touches through a `CorrectionGrid` instead of the affine transform.
+class ScreenCalibration {
+public:
+    static size_t const kTouchesNeeded = 3;
+    static size_t const kReportsNeeded = 20;
+
+    enum Result {
+        Result_InProgress, // I need more reports for the current touch.
+        Result_Success,
+        Result_NoTouchDetected,
+        Result_MultipleTouchesDetected
+    };
+
+    ScreenCalibration();
+
+    // I throw away my calibration data and become not ready.
+    void reset();
+
+    // `true` if I have calibrated enough touches to map sensor points to screen points.
+    bool isReady() const { return ready_; }
+
+    // Set this from the device when it connects.
+    void setGeometry(SensorGeometry const &geometry);
+    double radiansPerRay() const { return radiansPerRay_; }
+
+    // When this is on, I map touches through a thin-plate spline baked into a `CorrectionGrid`, once there are enough calibration touches for one.  It's off by default.
+    void setNonlinearCorrectionEnabled(bool enabled);
+    bool nonlinearCorrectionEnabled() const { return nonlinearCorrectionEnabled_; }
+
+    // `true` if I'm mapping touches through my correction grid.
+    bool isUsingCorrectionGrid() const { return !correctionGrid_.isEmpty(); }
+
+    // I prepare to calibrate a touch at `screenPoint` and become not ready until that touch is done.
+    void startCalibratingTouchAtScreenPoint(Point screenPoint);
+
+    Point currentCalibrationScreenPoint() const { return currentScreenPoint_; }
+
+    // I add one report to the current touch.  `thresholdCalibration` must be ready.  When I have enough reports, I finish calibrating the touch and return the result; until then I return `Result_InProgress`.
+    Result calibrate(Distance const *distances, size_t count, ThresholdCalibration const &thresholdCalibration);
+
+    // I look up the ray in my ray tables, so these don't compute a cosine or a sine unless the ray is beyond the geometry you gave me.
+    Point sensorPointForRay(size_t rayIndex, Distance distance) const {
+        return sensorRays_.contains(rayIndex) ? sensorRays_.pointForRay(rayIndex, distance) : sensorPointForRayOutsideGeometry(rayIndex, distance);
+    }
+    Point screenPointForRay(size_t rayIndex, Distance distance) const {
+        if (!correctionGrid_.isEmpty())
+            return correctionGrid_.screenPointForSensorPoint(sensorPointForRay(rayIndex, distance));
+        return screenRays_.contains(rayIndex) ? screenRays_.pointForRay(rayIndex, distance) : transform_.apply(sensorPointForRayOutsideGeometry(rayIndex, distance));
+    }
+
+    // This changes whenever the way I map rays to screen points changes, so you can tell when to recompute anything you derived from it.
+    unsigned long mappingRevision() const { return mappingRevision_; }
+
+    // Each ray's direction in screen coordinates, mapped through my current affine transform.  I rebuild this when my geometry or my transform changes, so anything else that turns rays into screen points can share it.
+    RayTable const &screenRays() const { return screenRays_; }
+
+    AffineTransform const &transform() const { return transform_; }
+    std::vector<Point> const &sensorPoints() const { return sensorPoints_; }
+    std::vector<Point> const &screenPoints() const { return screenPoints_; }
+
+    // I replace my calibrated touches and become ready if there are enough of them.  The vectors must be the same size.
+    void restore(std::vector<Point> const &sensorPoints, std::vector<Point> const &screenPoints);
+
+    // I refine my transform with a touch I mapped to `screenPoint` that you know the user meant to put at `intendedScreenPoint`, such as a tap on a button.  `weight` is how much the touch counts relative to a calibration touch.  I return false if I'm not ready or I'm using my correction grid, which only calibration touches shape.  I don't add refining touches to `sensorPoints` and `screenPoints`, so they don't outlive a `restore`.
+    bool refine(Point screenPoint, Point intendedScreenPoint, double weight);
+
+private:
+    void resetDistanceAccumulators(size_t count);
+    void accumulateDistances(Distance const *distances, size_t count);
+    void getAverageDistances(std::vector<Distance> &averages) const;
+    void resumeReadyIfPossible();
+    void becomeReadyIfPossible();
+    bool computeTransform();
+    void rebuildCorrectionGrid();
+    Point sensorPointForRayOutsideGeometry(size_t rayIndex, Distance distance) const;
+
+    size_t rayCount_;
+    double radiansPerRay_;
+    Point currentScreenPoint_;
+    size_t reportsReceived_;
+
+    // Each element corresponds to one ray and accumulates the valid distances reported for that ray since I started calibrating the current touch.
+    std::vector<Distance> distanceSums_;
+    std::vector<uint16_t> distanceCounts_;
+
+    std::vector<Point> sensorPoints_;
+    std::vector<Point> screenPoints_;
+    AffineFit fit_;
+    AffineTransform transform_;
+    RayTable sensorRays_;
+    RayTable screenRays_;
+    bool nonlinearCorrectionEnabled_;
+    CorrectionGrid correctionGrid_;
+    unsigned long mappingRevision_;
+    bool ready_;
+};
+
+}
+
+#endif
@@ -0,0 +1,75 @@
+//
+//  SweepClustering.cpp
+//  mickeyMouse
+//
+//  Copyright (c) 2012 Rob Mayoff. All rights reserved.
+//
+
+#include "SweepClustering.h"
+#include <algorithm>
+
+using std::vector;
+
+namespace TouchEngine {
+
+SweepClustering::Parameters::Parameters()
+    : minimumGap(20), raySpacings(3)
+{ }
+
+SweepClustering::SweepClustering()
+    : radiansPerRay_(0)
+{ }
+
+void SweepClustering::setGeometry(SensorGeometry const &geometry) {
+    radiansPerRay_ = geometry.radiansPerRay();
+    rays_.rebuild(geometry.rayCount, 0, radiansPerRay_, AffineTransform());
+}
+
+void SweepClustering::clusterSweep(Distance const *distances, SweepRange sweep, vector<TouchCluster> &clusters) const {
+    if (sweep.length == 0)
+        return;
+
+    // The spacing between adjacent rays at range r is r * radiansPerRay.  I judge each jump at the nearer ray's range, which is the finger in front.
+    double const gapPerMillimeter = parameters_.raySpacings * radiansPerRay_;
+    double const minimumGap = parameters_.minimumGap;
+
+    size_t start = sweep.location;
+    for (size_t i = sweep.location + 1; i < sweep.end(); ++i) {
+        double previous = distances[i - 1];
+        double current = distances[i];
+        double gap = std::max(minimumGap, gapPerMillimeter * std::min(previous, current));
+        if (fabs(current - previous) > gap) {
+            appendCluster(distances, SweepRange(start, i - start), clusters);
+            start = i;
+        }
+    }
+    appendCluster(distances, SweepRange(start, sweep.end() - start), clusters);
+}
+
+Point SweepClustering::pointForRay(size_t rayIndex, Distance distance) const {
+    if (rays_.contains(rayIndex))
+        return rays_.pointForRay(rayIndex, distance);
+    double radians = rayIndex * radiansPerRay_;
+    return Point(distance * cos(radians), distance * sin(radians));
+}
+
+void SweepClustering::appendCluster(Distance const *distances, SweepRange rays, vector<TouchCluster> &clusters) const {
+    double sumX = 0, sumY = 0, sumDistance = 0;
+    for (size_t i = rays.location; i < rays.end(); ++i) {
+        Point point = pointForRay(i, distances[i]);
+        sumX += point.x;
+        sumY += point.y;
+        sumDistance += distances[i];
+    }
+
+    TouchCluster cluster;
+    cluster.rays = rays;
+    cluster.centroid = Point(sumX / rays.length, sumY / rays.length);
+    Point first = pointForRay(rays.location, distances[rays.location]);
+    Point last = pointForRay(rays.end() - 1, distances[rays.end() - 1]);
+    cluster.width = hypot(last.x - first.x, last.y - first.y);
+    cluster.distance = (Distance)(sumDistance / rays.length);
+    clusters.push_back(cluster);
+}
+
+}
@@ -0,0 +1,62 @@
+//
+//  SweepClustering.h
+//  mickeyMouse
+//
+//  Copyright (c) 2012 Rob Mayoff. All rights reserved.
+//
+
+#ifndef SweepClustering_h
+#define SweepClustering_h
+
+#include "RayTable.h"
+#include "TouchEngineTypes.h"
+#include <vector>
+
+namespace TouchEngine {
+
+// A group of adjacent touched rays that I think hit one finger.
+struct TouchCluster {
+    SweepRange rays;
+    Point centroid; // the mean of the rays' points, in sensor coordinates (millimeters)
+    double width; // millimeters from the point of the first ray to the point of the last
+    Distance distance; // the mean distance of the rays
+};
+
+// I split touched sweeps into clusters.  A sweep is a run of adjacent touched rays, so two fingers at nearly the same angle but different ranges make one sweep.  Within a sweep, the rays that hit one finger have nearly the same distance, so I start a new cluster wherever the distance jumps between two adjacent rays by more than a gap.  The gap grows with range, because the rays spread apart and a finger's edge foreshortens the farther away it is.
+//
+// I visit each ray once, in the order of the scan, so clustering a sweep costs O(rays).
+class SweepClustering {
+public:
+    struct Parameters {
+        // The smallest jump, in millimeters, that splits a sweep.  A finger is about 15 mm across, so its near and far edges never differ by more than this.
+        double minimumGap;
+
+        // The jump that splits a sweep grows to this many times the spacing between adjacent rays at the range of the jump.
+        double raySpacings;
+
+        Parameters();
+    };
+
+    SweepClustering();
+
+    void setParameters(Parameters const &parameters) { parameters_ = parameters; }
+    Parameters const &parameters() const { return parameters_; }
+
+    // Set this from the device when it connects.
+    void setGeometry(SensorGeometry const &geometry);
+
+    // I split `sweep` of `distances` into clusters and append them to `clusters`.  Every ray in `sweep` must be valid.
+    void clusterSweep(Distance const *distances, SweepRange sweep, std::vector<TouchCluster> &clusters) const;
+
+private:
+    Point pointForRay(size_t rayIndex, Distance distance) const;
+    void appendCluster(Distance const *distances, SweepRange rays, std::vector<TouchCluster> &clusters) const;
+
+    Parameters parameters_;
+    double radiansPerRay_;
+    RayTable rays_;
+};
+
+}
+
+#endif
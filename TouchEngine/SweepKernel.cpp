@@ -0,0 +1,188 @@
+//
+//  SweepKernel.cpp
+//  mickeyMouse
+//
+//  Copyright (c) 2012 Rob Mayoff. All rights reserved.
+//
+
+#include "SweepKernel.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define TOUCH_ENGINE_X86 1
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define TOUCH_ENGINE_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace TouchEngine {
+
+// Every implementation fills whole 64-ray words with SIMD and leaves the rest to this.
+static void computeTouchedRayMaskTail(Distance const *distances, Distance const *thresholds, size_t begin, size_t count, uint64_t *mask) {
+    if (begin >= count)
+        return;
+    uint64_t word = 0;
+    for (size_t i = begin; i < count; ++i) {
+        word |= (uint64_t)(distances[i] < thresholds[i]) << (i - begin);
+    }
+    mask[begin / kTouchedRayMaskBitsPerWord] = word;
+}
+
+void computeTouchedRayMaskScalar(Distance const *distances, Distance const *thresholds, size_t count, uint64_t *mask) {
+    size_t fullWords = count / kTouchedRayMaskBitsPerWord;
+    for (size_t w = 0; w < fullWords; ++w) {
+        Distance const *d = distances + w * kTouchedRayMaskBitsPerWord;
+        Distance const *t = thresholds + w * kTouchedRayMaskBitsPerWord;
+        uint64_t word = 0;
+        for (unsigned i = 0; i < kTouchedRayMaskBitsPerWord; ++i) {
+            word |= (uint64_t)(d[i] < t[i]) << i;
+        }
+        mask[w] = word;
+    }
+    computeTouchedRayMaskTail(distances, thresholds, fullWords * kTouchedRayMaskBitsPerWord, count, mask);
+}
+
+#if TOUCH_ENGINE_X86
+
+// SSE2 is part of x86-64, so I don't need to check for it there.
+static void computeTouchedRayMaskSSE2(Distance const *distances, Distance const *thresholds, size_t count, uint64_t *mask) {
+    size_t fullWords = count / kTouchedRayMaskBitsPerWord;
+    for (size_t w = 0; w < fullWords; ++w) {
+        Distance const *d = distances + w * kTouchedRayMaskBitsPerWord;
+        Distance const *t = thresholds + w * kTouchedRayMaskBitsPerWord;
+        uint64_t word = 0;
+        for (unsigned i = 0; i < kTouchedRayMaskBitsPerWord; i += 4) {
+            __m128 lessThan = _mm_cmplt_ps(_mm_loadu_ps(d + i), _mm_loadu_ps(t + i));
+            word |= (uint64_t)(unsigned)_mm_movemask_ps(lessThan) << i;
+        }
+        mask[w] = word;
+    }
+    computeTouchedRayMaskTail(distances, thresholds, fullWords * kTouchedRayMaskBitsPerWord, count, mask);
+}
+
+__attribute__((target("avx")))
+static void computeTouchedRayMaskAVX(Distance const *distances, Distance const *thresholds, size_t count, uint64_t *mask) {
+    size_t fullWords = count / kTouchedRayMaskBitsPerWord;
+    for (size_t w = 0; w < fullWords; ++w) {
+        Distance const *d = distances + w * kTouchedRayMaskBitsPerWord;
+        Distance const *t = thresholds + w * kTouchedRayMaskBitsPerWord;
+        uint64_t word = 0;
+        for (unsigned i = 0; i < kTouchedRayMaskBitsPerWord; i += 8) {
+            __m256 lessThan = _mm256_cmp_ps(_mm256_loadu_ps(d + i), _mm256_loadu_ps(t + i), _CMP_LT_OQ);
+            word |= (uint64_t)(unsigned)_mm256_movemask_ps(lessThan) << i;
+        }
+        mask[w] = word;
+    }
+    computeTouchedRayMaskTail(distances, thresholds, fullWords * kTouchedRayMaskBitsPerWord, count, mask);
+}
+
+__attribute__((target("avx512f")))
+static void computeTouchedRayMaskAVX512(Distance const *distances, Distance const *thresholds, size_t count, uint64_t *mask) {
+    size_t fullWords = count / kTouchedRayMaskBitsPerWord;
+    for (size_t w = 0; w < fullWords; ++w) {
+        Distance const *d = distances + w * kTouchedRayMaskBitsPerWord;
+        Distance const *t = thresholds + w * kTouchedRayMaskBitsPerWord;
+        uint64_t word = 0;
+        for (unsigned i = 0; i < kTouchedRayMaskBitsPerWord; i += 16) {
+            __mmask16 lessThan = _mm512_cmp_ps_mask(_mm512_loadu_ps(d + i), _mm512_loadu_ps(t + i), _CMP_LT_OQ);
+            word |= (uint64_t)lessThan << i;
+        }
+        mask[w] = word;
+    }
+    computeTouchedRayMaskTail(distances, thresholds, fullWords * kTouchedRayMaskBitsPerWord, count, mask);
+}
+
+#endif
+
+#if TOUCH_ENGINE_NEON
+
+static void computeTouchedRayMaskNEON(Distance const *distances, Distance const *thresholds, size_t count, uint64_t *mask) {
+    static uint32_t const kLaneBits[4] = { 1, 2, 4, 8 };
+    uint32x4_t const laneBits = vld1q_u32(kLaneBits);
+    size_t fullWords = count / kTouchedRayMaskBitsPerWord;
+    for (size_t w = 0; w < fullWords; ++w) {
+        Distance const *d = distances + w * kTouchedRayMaskBitsPerWord;
+        Distance const *t = thresholds + w * kTouchedRayMaskBitsPerWord;
+        uint64_t word = 0;
+        for (unsigned i = 0; i < kTouchedRayMaskBitsPerWord; i += 4) {
+            uint32x4_t lessThan = vandq_u32(vcltq_f32(vld1q_f32(d + i), vld1q_f32(t + i)), laneBits);
+            uint32x2_t pairs = vadd_u32(vget_low_u32(lessThan), vget_high_u32(lessThan));
+            word |= (uint64_t)(vget_lane_u32(pairs, 0) + vget_lane_u32(pairs, 1)) << i;
+        }
+        mask[w] = word;
+    }
+    computeTouchedRayMaskTail(distances, thresholds, fullWords * kTouchedRayMaskBitsPerWord, count, mask);
+}
+
+#endif
+
+typedef void (*TouchedRayMaskFunction)(Distance const *distances, Distance const *thresholds, size_t count, uint64_t *mask);
+
+struct TouchedRayMaskImplementation {
+    TouchedRayMaskFunction function;
+    char const *name;
+};
+
+static TouchedRayMaskImplementation chooseTouchedRayMaskImplementation() {
+    TouchedRayMaskImplementation implementation = { computeTouchedRayMaskScalar, "scalar" };
+#if TOUCH_ENGINE_X86
+    implementation.function = computeTouchedRayMaskSSE2;
+    implementation.name = "sse2";
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        implementation.function = computeTouchedRayMaskAVX512;
+        implementation.name = "avx512f";
+    } else if (__builtin_cpu_supports("avx")) {
+        implementation.function = computeTouchedRayMaskAVX;
+        implementation.name = "avx";
+    }
+#elif TOUCH_ENGINE_NEON
+    implementation.function = computeTouchedRayMaskNEON;
+    implementation.name = "neon";
+#endif
+    return implementation;
+}
+
+// C++11 guarantees this is initialized once, even if several threads race to call me first.
+static TouchedRayMaskImplementation const &touchedRayMaskImplementationForCPU() {
+    static TouchedRayMaskImplementation const implementation = chooseTouchedRayMaskImplementation();
+    return implementation;
+}
+
+void computeTouchedRayMask(Distance const *distances, Distance const *thresholds, size_t count, uint64_t *mask) {
+    touchedRayMaskImplementationForCPU().function(distances, thresholds, count, mask);
+}
+
+char const *touchedRayMaskImplementation() {
+    return touchedRayMaskImplementationForCPU().name;
+}
+
+size_t extractSweepsFromTouchedRayMask(uint64_t const *mask, size_t count, SweepRange *ranges, size_t maxRanges) {
+    size_t found = 0;
+    size_t wordCount = touchedRayMaskWordCount(count);
+    uint64_t carry = 0;
+    size_t start = 0;
+    for (size_t i = 0; i < wordCount; ++i) {
+        uint64_t word = mask[i];
+        uint64_t edges = word ^ ((word << 1) | carry);
+        size_t base = i * kTouchedRayMaskBitsPerWord;
+        while (edges) {
+            unsigned bit = countTrailingZeros(edges);
+            if ((word >> bit) & 1) {
+                start = base + bit;
+            } else {
+                if (found == maxRanges)
+                    return found;
+                ranges[found++] = SweepRange(start, base + bit - start);
+            }
+            edges &= edges - 1;
+        }
+        carry = word >> 63;
+    }
+    if (carry && found < maxRanges) {
+        ranges[found++] = SweepRange(start, count - start);
+    }
+    return found;
+}
+
+}
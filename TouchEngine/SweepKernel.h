@@ -0,0 +1,71 @@
+//
+//  SweepKernel.h
+//  mickeyMouse
+//
+//  Copyright (c) 2012 Rob Mayoff. All rights reserved.
+//
+
+#ifndef SweepKernel_h
+#define SweepKernel_h
+
+#include "TouchEngineTypes.h"
+#include <stdint.h>
+
+namespace TouchEngine {
+
+// The touched-sweep kernel works in two passes.  First I compare a whole scan against the thresholds with SIMD and pack the results into a bitmask with one bit per ray, set if the ray is touched.  Then I find the runs of set bits by walking the transitions with count-trailing-zeros, which costs one step per sweep edge instead of one per ray.
+
+static size_t const kTouchedRayMaskBitsPerWord = 64;
+
+// The number of `uint64_t` words needed to hold a mask of `count` rays.
+inline size_t touchedRayMaskWordCount(size_t count) {
+    return (count + kTouchedRayMaskBitsPerWord - 1) / kTouchedRayMaskBitsPerWord;
+}
+
+// I set bit `i` of `mask` if `distances[i] < thresholds[i]`.  `mask` must have room for `touchedRayMaskWordCount(count)` words.  I clear the bits past `count` in the last word.  I pick the widest instruction set the CPU supports the first time you call me.
+void computeTouchedRayMask(Distance const *distances, Distance const *thresholds, size_t count, uint64_t *mask);
+
+// The portable version of `computeTouchedRayMask`, for reference and benchmarking.
+void computeTouchedRayMaskScalar(Distance const *distances, Distance const *thresholds, size_t count, uint64_t *mask);
+
+// The name of the instruction set `computeTouchedRayMask` uses on this CPU, like `avx2` or `scalar`.
+char const *touchedRayMaskImplementation();
+
+inline unsigned countTrailingZeros(uint64_t word) {
+    return (unsigned)__builtin_ctzll(word);
+}
+
+// I call `body(SweepRange)` for each run of set bits in the first `count` bits of `mask`, in order.
+template <class Body>
+inline void forEachSweepInTouchedRayMask(uint64_t const *mask, size_t count, Body body) {
+    size_t wordCount = touchedRayMaskWordCount(count);
+    uint64_t carry = 0; // the top bit of the previous word
+    size_t start = 0;
+    for (size_t i = 0; i < wordCount; ++i) {
+        uint64_t word = mask[i];
+        // A set bit in `edges` is a ray whose touched state differs from the ray before it.
+        uint64_t edges = word ^ ((word << 1) | carry);
+        size_t base = i * kTouchedRayMaskBitsPerWord;
+        while (edges) {
+            unsigned bit = countTrailingZeros(edges);
+            if ((word >> bit) & 1) {
+                start = base + bit;
+            } else {
+                body(SweepRange(start, base + bit - start));
+            }
+            edges &= edges - 1;
+        }
+        carry = word >> 63;
+    }
+    // The bits past `count` are clear, so a run only reaches the end of the mask when `count` fills the last word.
+    if (carry) {
+        body(SweepRange(start, count - start));
+    }
+}
+
+// I store the runs of set bits in the first `count` bits of `mask` into `ranges`, in order, and return how many I stored.  I stop after `maxRanges`; a scan of `count` rays never has more than `(count + 1) / 2` sweeps.
+size_t extractSweepsFromTouchedRayMask(uint64_t const *mask, size_t count, SweepRange *ranges, size_t maxRanges);
+
+}
+
+#endif
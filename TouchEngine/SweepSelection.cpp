@@ -0,0 +1,47 @@
+//
+//  SweepSelection.cpp
+//  mickeyMouse
+//
+//  Copyright (c) 2012 Rob Mayoff. All rights reserved.
+//
+
+#include "SweepSelection.h"
+#include <string.h>
+
+using std::vector;
+
+namespace TouchEngine {
+
+float const EWMAPolicy::kCurrentDistanceWeight = 0.3f;
+float const TrimmedMeanPolicy::kTrimFraction = 0.25f;
+
+char const *const kSweepSelectionNames[] = { "middle", "ewma", "centroid", "trimmed", "cluster", NULL };
+
+std::unique_ptr<SweepSelection> makeSweepSelection(char const *name) {
+    std::unique_ptr<SweepSelection> selection;
+    if (strcmp(name, "middle") == 0) {
+        selection.reset(new MiddleRaySweepSelection);
+    } else if (strcmp(name, "ewma") == 0) {
+        selection.reset(new EWMASweepSelection);
+    } else if (strcmp(name, "centroid") == 0) {
+        selection.reset(new CentroidSweepSelection);
+    } else if (strcmp(name, "trimmed") == 0) {
+        selection.reset(new TrimmedMeanSweepSelection);
+    } else if (strcmp(name, "cluster") == 0) {
+        selection.reset(new ClusterSweepSelection);
+    }
+    return selection;
+}
+
+void ClusterSweepSelection::selectTouches(Distance const *distances, size_t count, ThresholdCalibration const &thresholdCalibration, vector<SensorTouch> &touches) {
+    touches.clear();
+    clusters_.clear();
+    thresholdCalibration.forEachTouchedSweep(distances, count, [&](SweepRange sweep) {
+        clustering_.clusterSweep(distances, sweep, clusters_);
+    });
+    for (vector<TouchCluster>::const_iterator it = clusters_.begin(); it != clusters_.end(); ++it) {
+        touches.push_back(SensorTouch(it->rays.middle(), it->distance, it->rays));
+    }
+}
+
+}
@@ -0,0 +1,218 @@
+//
+//  SweepSelection.h
+//  mickeyMouse
+//
+//  Copyright (c) 2012 Rob Mayoff. All rights reserved.
+//
+
+#ifndef SweepSelection_h
+#define SweepSelection_h
+
+#include "SweepClustering.h"
+#include "ThresholdCalibration.h"
+#include "TouchEngineTypes.h"
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+namespace TouchEngine {
+
+// One touch, in sensor terms.
+struct SensorTouch {
+    size_t rayIndex; // the ray I treat as the touch's direction
+    Distance distance; // the touch's distance along that ray
+    SweepRange sweep; // the touched sweep the touch came from
+
+    SensorTouch() : rayIndex(0), distance(kInvalidDistance) { }
+    SensorTouch(size_t rayIndex_, Distance distance_, SweepRange sweep_) : rayIndex(rayIndex_), distance(distance_), sweep(sweep_) { }
+};
+
+// I turn the touched sweeps of a scan into touches.  Subclasses decide which ray and distance represent each sweep.
+class SweepSelection {
+public:
+    virtual ~SweepSelection() { }
+
+    // The engine sends me this when its geometry changes and when it adopts me.  I ignore it by default.
+    virtual void setGeometry(SensorGeometry const &geometry) { (void)geometry; }
+
+    // I clear `touches` and then append one touch for each touched sweep I accept.
+    virtual void selectTouches(Distance const *distances, size_t count, ThresholdCalibration const &thresholdCalibration, std::vector<SensorTouch> &touches) = 0;
+};
+
+// I make the selection named `name`: "middle", "ewma", "centroid", "trimmed" or "cluster".  I return null if I don't know the name.
+std::unique_ptr<SweepSelection> makeSweepSelection(char const *name);
+
+// The names `makeSweepSelection` knows, ending with null.
+extern char const *const kSweepSelectionNames[];
+
+// Selection policies
+
+// A policy decides which ray and distance represent one touched sweep.  `PolicySweepSelection` calls it for every sweep of a scan, so I keep the policies here in the header where the compiler can inline them into the sweep loop.  Each policy has these members:
+//
+//     void beginScan(ThresholdCalibration const &thresholdCalibration);
+//     bool selectTouch(Distance const *distances, SweepRange sweep, SensorTouch &touch); // `false` to reject the sweep
+//     void endScan(size_t touchCount);
+
+// The middle ray of the sweep, at that ray's distance.
+struct MiddleRayPolicy {
+    void beginScan(ThresholdCalibration const &) { }
+
+    bool selectTouch(Distance const *distances, SweepRange sweep, SensorTouch &touch) {
+        size_t middle = sweep.middle();
+        touch = SensorTouch(middle, distances[middle], sweep);
+        return true;
+    }
+
+    void endScan(size_t) { }
+};
+
+// I ignore sweeps narrower than three rays.  For the others, I report the middle ray at an exponentially-weighted moving average of the distances of the sweep's inner rays, so the reported distance doesn't jitter.  I only keep one average, so I'm meant for a single touch.
+class EWMAPolicy {
+public:
+    static float const kCurrentDistanceWeight;
+
+    EWMAPolicy() : touchDistance_(-1) { }
+
+    void beginScan(ThresholdCalibration const &) { }
+
+    bool selectTouch(Distance const *distances, SweepRange sweep, SensorTouch &touch) {
+        if (sweep.length < 3)
+            return false;
+        // The edge rays of a sweep often clip the finger, so I only average the inner rays.
+        SweepRange inner(sweep.location + 1, sweep.length - 2);
+        Distance sum = 0;
+        for (size_t i = inner.location; i < inner.end(); ++i) {
+            sum += distances[i];
+        }
+        Distance currentDistance = sum / inner.length;
+        touchDistance_ = (touchDistance_ > 0)
+            ? kCurrentDistanceWeight * currentDistance + (1 - kCurrentDistanceWeight) * touchDistance_
+            : currentDistance;
+        touch = SensorTouch(sweep.middle(), touchDistance_, sweep);
+        return true;
+    }
+
+    void endScan(size_t touchCount) {
+        if (touchCount == 0) {
+            touchDistance_ = -1;
+        }
+    }
+
+private:
+    // Negative when no touch was seen in the previous scan.
+    Distance touchDistance_;
+};
+
+// I weight each ray of the sweep by how far it reaches past its threshold, and report the ray nearest the weighted mean ray at the weighted mean distance.  A ray that barely clips the edge of a finger hardly counts, so the touch doesn't wobble as the edge rays come and go.
+class CentroidPolicy {
+public:
+    void beginScan(ThresholdCalibration const &thresholdCalibration) { thresholds_ = thresholdCalibration.thresholds(); }
+
+    bool selectTouch(Distance const *distances, SweepRange sweep, SensorTouch &touch) {
+        Distance const *thresholds = thresholds_ ? thresholds_->data() : NULL;
+        size_t end = thresholds_ ? std::min(sweep.end(), thresholds_->size()) : sweep.location;
+        float weightSum = 0, raySum = 0, distanceSum = 0;
+        for (size_t i = sweep.location; i < end; ++i) {
+            // A ray that never returned during calibration has no threshold to reach past, so it has no weight.
+            if (!isValidDistance(thresholds[i])) {
+                continue;
+            }
+            float weight = std::max(thresholds[i] - distances[i], 0.0f);
+            weightSum += weight;
+            raySum += weight * (i - sweep.location);
+            distanceSum += weight * distances[i];
+        }
+        if (!(weightSum > 0) || !std::isfinite(weightSum) || !std::isfinite(raySum) || !std::isfinite(distanceSum)) {
+            size_t middle = sweep.middle();
+            touch = SensorTouch(middle, distances[middle], sweep);
+        } else {
+            touch = SensorTouch(sweep.location + (size_t)(raySum / weightSum + 0.5f), distanceSum / weightSum, sweep);
+        }
+        return true;
+    }
+
+    void endScan(size_t) { thresholds_.reset(); }
+
+private:
+    // Held for the length of one scan, so the thresholds can't change under me.
+    ThresholdSnapshot thresholds_;
+};
+
+// I report the middle ray at the mean distance of the sweep's rays, leaving out the nearest and farthest `kTrimFraction` of them.  A stray long or short reading at the edge of the finger doesn't move the touch.
+class TrimmedMeanPolicy {
+public:
+    static float const kTrimFraction;
+
+    void beginScan(ThresholdCalibration const &) { }
+
+    bool selectTouch(Distance const *distances, SweepRange sweep, SensorTouch &touch) {
+        // I only grow my scratch space, so after the first few scans this doesn't allocate.
+        scratch_.assign(distances + sweep.location, distances + sweep.end());
+        size_t trim = (size_t)(sweep.length * kTrimFraction);
+        std::vector<Distance>::iterator first = scratch_.begin() + trim;
+        std::vector<Distance>::iterator last = scratch_.end() - trim;
+        if (trim > 0) {
+            std::nth_element(scratch_.begin(), first, scratch_.end());
+            std::nth_element(first, last - 1, scratch_.end());
+        }
+        Distance sum = 0;
+        for (std::vector<Distance>::const_iterator it = first; it != last; ++it) {
+            sum += *it;
+        }
+        touch = SensorTouch(sweep.middle(), sum / (last - first), sweep);
+        return true;
+    }
+
+    void endScan(size_t) { }
+
+private:
+    std::vector<Distance> scratch_;
+};
+
+// I select touches with `Policy`, one of the policies above.  The engine calls me through `SweepSelection` once per scan, and I call my policy directly for each sweep, so the per-sweep work inlines into the sweep loop.
+template <class Policy>
+class PolicySweepSelection : public SweepSelection {
+public:
+    Policy &policy() { return policy_; }
+
+    virtual void selectTouches(Distance const *distances, size_t count, ThresholdCalibration const &thresholdCalibration, std::vector<SensorTouch> &touches) {
+        touches.clear();
+        policy_.beginScan(thresholdCalibration);
+        thresholdCalibration.forEachTouchedSweep(distances, count, [&](SweepRange sweep) {
+            SensorTouch touch;
+            if (policy_.selectTouch(distances, sweep, touch)) {
+                touches.push_back(touch);
+            }
+        });
+        policy_.endScan(touches.size());
+    }
+
+private:
+    Policy policy_;
+};
+
+typedef PolicySweepSelection<MiddleRayPolicy> MiddleRaySweepSelection;
+typedef PolicySweepSelection<EWMAPolicy> EWMASweepSelection;
+typedef PolicySweepSelection<CentroidPolicy> CentroidSweepSelection;
+typedef PolicySweepSelection<TrimmedMeanPolicy> TrimmedMeanSweepSelection;
+
+// I split each touched sweep into clusters with a `SweepClustering`, so two fingers at nearly the same angle are two touches.  I report each cluster's middle ray at the cluster's mean distance.
+class ClusterSweepSelection : public SweepSelection {
+public:
+    void setClusteringParameters(SweepClustering::Parameters const &parameters) { clustering_.setParameters(parameters); }
+
+    virtual void setGeometry(SensorGeometry const &geometry) { clustering_.setGeometry(geometry); }
+    virtual void selectTouches(Distance const *distances, size_t count, ThresholdCalibration const &thresholdCalibration, std::vector<SensorTouch> &touches);
+
+    // The clusters of the most recent scan, in the same order as its touches.
+    std::vector<TouchCluster> const &clusters() const { return clusters_; }
+
+private:
+    SweepClustering clustering_;
+    std::vector<TouchCluster> clusters_;
+};
+
+}
+
+#endif
@@ -0,0 +1,87 @@
+//
+//  ThresholdCalibration.cpp
+//  mickeyMouse
+//
+//  Copyright (c) 2012 Rob Mayoff. All rights reserved.
+//
+
+#include "ThresholdCalibration.h"
+#include <algorithm>
+#include <stdexcept>
+
+using std::vector;
+
+namespace TouchEngine {
+
+size_t const ThresholdCalibration::kReportsNeeded;
+size_t const ThresholdCalibration::kMaximumRayCount;
+float const ThresholdCalibration::kThresholdScale = 0.95f;
+
+static ThresholdSnapshot emptySnapshot() {
+    return ThresholdSnapshot(new vector<Distance>());
+}
+
+ThresholdCalibration::ThresholdCalibration()
+    : thresholds_(emptySnapshot()), reportsReceived_(0), ready_(false)
+{ }
+
+void ThresholdCalibration::reset() {
+    std::atomic_store(&thresholds_, emptySnapshot());
+    reportsReceived_ = 0;
+    ready_ = false;
+}
+
+bool ThresholdCalibration::calibrate(Distance const *distances, size_t count) {
+    if (ready_)
+        throw std::logic_error("ThresholdCalibration received too many reports");
+
+    if (reportsReceived_ == 0) {
+        minimums_.assign(count, kInvalidDistance);
+    }
+
+    if (count < minimums_.size()) {
+        minimums_.resize(count);
+    }
+    for (size_t i = 0, n = minimums_.size(); i < n; ++i) {
+        minimums_[i] = std::min(minimums_[i], distances[i]);
+    }
+
+    if (++reportsReceived_ < kReportsNeeded)
+        return false;
+
+    for (vector<Distance>::iterator it = minimums_.begin(); it != minimums_.end(); ++it) {
+        *it *= kThresholdScale;
+    }
+    std::atomic_store(&thresholds_, ThresholdSnapshot(new vector<Distance>(minimums_)));
+    minimums_.clear();
+    ready_ = true;
+    return true;
+}
+
+void ThresholdCalibration::restore(vector<Distance> const &thresholds) {
+    std::atomic_store(&thresholds_, ThresholdSnapshot(new vector<Distance>(thresholds)));
+    reportsReceived_ = kReportsNeeded;
+    ready_ = true;
+}
+
+void ThresholdCalibration::publishThresholds(vector<Distance> const &thresholds) {
+    if (!ready_)
+        throw std::logic_error("ThresholdCalibration can't publish thresholds before it's ready");
+    std::atomic_store(&thresholds_, ThresholdSnapshot(new vector<Distance>(thresholds)));
+}
+
+size_t ThresholdCalibration::computeTouchedRayMask(Distance const *distances, size_t count, uint64_t *mask) const {
+    // I hold the snapshot for the whole scan, so a concurrent publish can't free it under me.
+    ThresholdSnapshot thresholds = std::atomic_load(&thresholds_);
+    count = std::min(count, std::min(thresholds->size(), kMaximumRayCount));
+    TouchEngine::computeTouchedRayMask(distances, thresholds->data(), count, mask);
+    return count;
+}
+
+size_t ThresholdCalibration::findTouchedSweeps(Distance const *distances, size_t count, SweepRange *ranges, size_t maxRanges) const {
+    uint64_t mask[kMaximumRayCount / kTouchedRayMaskBitsPerWord];
+    count = computeTouchedRayMask(distances, count, mask);
+    return extractSweepsFromTouchedRayMask(mask, count, ranges, maxRanges);
+}
+
+}
@@ -0,0 +1,82 @@
+//
+//  ThresholdCalibration.h
+//  mickeyMouse
+//
+//  Copyright (c) 2012 Rob Mayoff. All rights reserved.
+//
+
+#ifndef ThresholdCalibration_h
+#define ThresholdCalibration_h
+
+#include "SweepKernel.h"
+#include "TouchEngineTypes.h"
+#include <memory>
+#include <vector>
+
+namespace TouchEngine {
+
+// An immutable set of per-ray thresholds.  Whoever holds one can keep using it while newer thresholds are published.
+typedef std::shared_ptr<std::vector<Distance> const> ThresholdSnapshot;
+
+// I learn, for each ray, the distance below which a reading means something is touching the surface.  I take the shortest distance seen in `kReportsNeeded` reports of the untouched surface and pull it in a little.
+//
+// After I'm ready, anyone (for example a `BackgroundModel`) can replace my thresholds with `publishThresholds`, even from another thread while I'm finding sweeps.  Each scan sees either the old thresholds or the new ones, never a mix.
+class ThresholdCalibration {
+public:
+    static size_t const kReportsNeeded = 20;
+
+    // A touch has to come this much closer than the untouched surface to count, so sensor noise doesn't look like a touch.
+    static float const kThresholdScale;
+
+    ThresholdCalibration();
+
+    // I throw away my calibration data and become not ready.
+    void reset();
+
+    bool isReady() const { return ready_; }
+
+    // I update my calibration data with one report of the untouched surface.  I return true if this report made me ready.  It's a logic error to send me this when I'm already ready.
+    bool calibrate(Distance const *distances, size_t count);
+
+    // My current thresholds.  This is empty until I'm ready.
+    ThresholdSnapshot thresholds() const { return std::atomic_load(&thresholds_); }
+
+    // I replace my thresholds with `thresholds` and become ready.
+    void restore(std::vector<Distance> const &thresholds);
+
+    // I replace my thresholds without pausing anyone who is finding sweeps.  It's a logic error to send me this when I'm not ready.
+    void publishThresholds(std::vector<Distance> const &thresholds);
+
+    // The most rays I can check in one scan.  I ignore rays past this.
+    static size_t const kMaximumRayCount = 8192;
+
+    // I call `body(SweepRange)` once for each contiguous range of rays whose distances are shorter than my thresholds, in ray order.
+    template <class Body>
+    void forEachTouchedSweep(Distance const *distances, size_t count, Body body) const {
+        uint64_t mask[kMaximumRayCount / kTouchedRayMaskBitsPerWord];
+        count = computeTouchedRayMask(distances, count, mask);
+        forEachSweepInTouchedRayMask(mask, count, body);
+    }
+
+    // I store the touched sweeps into `ranges`, as `forEachTouchedSweep` would report them, and return how many I stored.  I stop after `maxRanges`.
+    size_t findTouchedSweeps(Distance const *distances, size_t count, SweepRange *ranges, size_t maxRanges) const;
+
+    // I set one bit per ray in `mask` (which needs room for `kMaximumRayCount` bits) for each ray shorter than its threshold.  I return the number of rays I checked, which is less than `count` if I have fewer thresholds.
+    size_t computeTouchedRayMask(Distance const *distances, size_t count, uint64_t *mask) const;
+
+private:
+    ThresholdCalibration(ThresholdCalibration const &); // not implemented
+    ThresholdCalibration &operator=(ThresholdCalibration const &); // not implemented
+
+    // Only touch this with `std::atomic_load` and `std::atomic_store`.
+    ThresholdSnapshot thresholds_;
+
+    // The shortest distance seen for each ray while I'm calibrating.
+    std::vector<Distance> minimums_;
+    size_t reportsReceived_;
+    bool ready_;
+};
+
+}
+
+#endif
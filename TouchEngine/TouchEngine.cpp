@@ -0,0 +1,397 @@
+//
+//  TouchEngine.cpp
+//  mickeyMouse
+//
+//  Copyright (c) 2012 Rob Mayoff. All rights reserved.
+//
+
+#include "TouchEngine.h"
+#include <algorithm>
+#include <stdexcept>
+#include <stdlib.h>
+#include <string>
+#include <string.h>
+
+using std::string;
+using std::vector;
+
+namespace TouchEngine {
+
+char const *stateName(State state) {
+#define StateName(State) case State_##State: return #State
+    switch (state) {
+        StateName(AwaitingThresholdCalibration);
+        StateName(CalibratingThreshold);
+        StateName(AwaitingTouchCalibration);
+        StateName(CalibratingTouch);
+        StateName(DetectingTouches);
+    }
+#undef StateName
+    return "Unknown";
+}
+
+// Public API
+
+Engine::Engine(EngineObserver &observer)
+    : observer_(observer), state_(State_AwaitingThresholdCalibration), rayRegionIsValid_(false), rayRegionMappingRevision_(0), selection_(new MiddleRaySweepSelection), adaptiveThresholdsEnabled_(true), changeDetectionEnabled_(false), quietScans_(0), skippedScanCount_(0), lastScanTimestamp_(0)
+{ }
+
+void Engine::setGeometry(SensorGeometry const &geometry) {
+    geometry_ = geometry;
+    screenCalibration_.setGeometry(geometry);
+    selection_->setGeometry(geometry);
+}
+
+void Engine::setScreenRects(vector<Rect> const &rects) {
+    screenRects_ = rects;
+    rayRegionIsValid_ = false;
+}
+
+void Engine::setChangeDetectionEnabled(bool enabled) {
+    changeDetectionEnabled_ = enabled;
+    changeDetector_.reset();
+    quietScans_ = 0;
+}
+
+void Engine::setSweepSelection(std::unique_ptr<SweepSelection> selection) {
+    selection_ = std::move(selection);
+    selection_->setGeometry(geometry_);
+}
+
+void Engine::reset() {
+    thresholdCalibration_.reset();
+    backgroundModel_.clear();
+    screenCalibration_.reset();
+    notifyObserverOfThresholds();
+    setAppropriateNonBusyState();
+}
+
+bool Engine::isBusy() const {
+    switch (state_) {
+        case State_AwaitingThresholdCalibration: return false;
+        case State_CalibratingThreshold: return true;
+        case State_AwaitingTouchCalibration: return false;
+        case State_CalibratingTouch: return true;
+        case State_DetectingTouches: return false;
+    }
+    return false;
+}
+
+void Engine::startCalibratingThreshold() {
+    requireNotBusy("startCalibratingThreshold");
+    thresholdCalibration_.reset();
+    backgroundModel_.clear();
+    observer_.engineDidUpdateThresholds(*this, NULL, 0);
+    setState(State_CalibratingThreshold);
+}
+
+void Engine::startCalibratingTouchAtPoint(Point screenPoint) {
+    requireNotBusy("startCalibratingTouchAtPoint");
+    screenCalibration_.startCalibratingTouchAtScreenPoint(screenPoint);
+    setState(State_CalibratingTouch);
+}
+
+void Engine::processScan(Distance const *distances, size_t count, double timestamp) {
+    switch (state_) {
+        case State_CalibratingThreshold:
+            calibrateThreshold(distances, count);
+            break;
+        case State_CalibratingTouch:
+            calibrateTouch(distances, count);
+            break;
+        case State_DetectingTouches:
+            if (canSkipScan(distances, count)) {
+                ++skippedScanCount_;
+                break;
+            }
+            detectTouches(scanFilter_.filter(distances, count), count, timestamp);
+            break;
+        case State_AwaitingThresholdCalibration:
+        case State_AwaitingTouchCalibration:
+            break;
+    }
+}
+
+CalibrationData Engine::calibrationData() const {
+    CalibrationData data;
+    data.thresholdsReady = thresholdCalibration_.isReady();
+    if (data.thresholdsReady) {
+        data.thresholds = *thresholdCalibration_.thresholds();
+    }
+    data.sensorPoints = screenCalibration_.sensorPoints();
+    data.screenPoints = screenCalibration_.screenPoints();
+    return data;
+}
+
+void Engine::restoreCalibrationData(CalibrationData const &data) {
+    if (data.thresholdsReady) {
+        thresholdCalibration_.restore(data.thresholds);
+    } else {
+        thresholdCalibration_.reset();
+    }
+    seedBackgroundModel();
+    notifyObserverOfThresholds();
+    screenCalibration_.restore(data.sensorPoints, data.screenPoints);
+    setAppropriateNonBusyState();
+}
+
+// General state management
+
+void Engine::setState(State state) {
+    if (state_ != state) {
+        if (state_ == State_DetectingTouches) {
+            screenPoints_.clear();
+            detectedSensorTouches_.clear();
+            tracker_.endAllTracks();
+            if (tracker_.touchCount() > 0) {
+                notifyObserverOfTrackedTouches(lastScanTimestamp_);
+            }
+            predictor_.reset();
+            scanFilter_.reset();
+            changeDetector_.reset();
+            quietScans_ = 0;
+        }
+        state_ = state;
+        observer_.engineDidChangeState(*this, state);
+    }
+}
+
+void Engine::setAppropriateNonBusyState() {
+    setState(!thresholdCalibration_.isReady() ? State_AwaitingThresholdCalibration
+        : !screenCalibration_.isReady() ? State_AwaitingTouchCalibration
+        : State_DetectingTouches);
+}
+
+void Engine::requireNotBusy(char const *action) const {
+    if (isBusy())
+        throw std::logic_error(string("TouchEngine::Engine received ") + action + " while in state " + stateName(state_));
+}
+
+void Engine::notifyObserverOfThresholds() {
+    if (thresholdCalibration_.isReady()) {
+        ThresholdSnapshot thresholds = thresholdCalibration_.thresholds();
+        observer_.engineDidUpdateThresholds(*this, thresholds->data(), thresholds->size());
+    } else {
+        observer_.engineDidUpdateThresholds(*this, NULL, 0);
+    }
+}
+
+// Threshold calibration details
+
+void Engine::calibrateThreshold(Distance const *distances, size_t count) {
+    if (!thresholdCalibration_.calibrate(distances, count))
+        return;
+    seedBackgroundModel();
+    notifyObserverOfThresholds();
+    observer_.engineDidFinishCalibratingThreshold(*this);
+    setAppropriateNonBusyState();
+}
+
+// Background model details
+
+void Engine::seedBackgroundModel() {
+    if (thresholdCalibration_.isReady()) {
+        backgroundModel_.seed(*thresholdCalibration_.thresholds(), ThresholdCalibration::kThresholdScale);
+    } else {
+        backgroundModel_.clear();
+    }
+}
+
+void Engine::updateBackgroundModel(Distance const *distances, size_t count) {
+    if (!adaptiveThresholdsEnabled_ || !backgroundModel_.isSeeded())
+        return;
+    touchedRayMask_.resize(ThresholdCalibration::kMaximumRayCount / kTouchedRayMaskBitsPerWord);
+    count = thresholdCalibration_.computeTouchedRayMask(distances, count, touchedRayMask_.data());
+    backgroundModel_.update(distances, count, touchedRayMask_.data(), &rayRegion_);
+    if (!backgroundModel_.isDueToPublish())
+        return;
+    backgroundModel_.computeThresholds(learnedThresholds_);
+    thresholdCalibration_.publishThresholds(learnedThresholds_);
+    notifyObserverOfThresholds();
+}
+
+// Touch calibration details
+
+void Engine::calibrateTouch(Distance const *distances, size_t count) {
+    CalibrationResult result;
+    switch (screenCalibration_.calibrate(distances, count, thresholdCalibration_)) {
+        case ScreenCalibration::Result_InProgress: return;
+        case ScreenCalibration::Result_Success: result = CalibrationResult_Success; break;
+        case ScreenCalibration::Result_NoTouchDetected: result = CalibrationResult_NoTouchDetected; break;
+        case ScreenCalibration::Result_MultipleTouchesDetected: result = CalibrationResult_MultipleTouchesDetected; break;
+        default: return;
+    }
+    observer_.engineDidFinishCalibratingTouch(*this, screenCalibration_.currentCalibrationScreenPoint(), result);
+    setAppropriateNonBusyState();
+}
+
+// Touch detection details
+
+bool Engine::isValidScreenPoint(Point point) const {
+    if (screenRects_.empty())
+        return true;
+    for (vector<Rect>::const_iterator it = screenRects_.begin(); it != screenRects_.end(); ++it) {
+        if (it->contains(point))
+            return true;
+    }
+    return false;
+}
+
+// I can skip a scan if nothing in the ray region changed since the last scan I processed and that scan found no touches, so the scan would find nothing either.  After a change, I process one less unchanged scan than the scan filter is long, so the filter's history has caught up with the change before I stop looking.
+bool Engine::canSkipScan(Distance const *distances, size_t count) {
+    if (!changeDetectionEnabled_)
+        return false;
+    updateRayRegionIfNeeded();
+    bool changed = rayRegion_.includesEverything()
+        ? changeDetector_.detectChanges(distances, count)
+        : changeDetector_.detectChanges(distances, count, rayRegion_.mask(), rayRegion_.rayCount());
+    bool quiet = !changed && tracker_.trackCount() == 0 && screenPoints_.empty();
+    if (quiet && quietScans_ + 1 >= scanFilter_.length())
+        return true;
+    quietScans_ = quiet ? quietScans_ + 1 : 0;
+    changeDetector_.setReference(distances, count);
+    return false;
+}
+
+void Engine::detectTouches(Distance const *distances, size_t count, double timestamp) {
+    updateRayRegionIfNeeded();
+    distances = rayRegion_.restrictScan(distances, count);
+    selection_->selectTouches(distances, count, thresholdCalibration_, sensorTouches_);
+    screenPoints_.clear();
+    detectedSensorTouches_.clear();
+    for (vector<SensorTouch>::const_iterator it = sensorTouches_.begin(); it != sensorTouches_.end(); ++it) {
+        Point screenPoint = screenCalibration_.screenPointForRay(it->rayIndex, it->distance);
+        if (isValidScreenPoint(screenPoint)) {
+            screenPoints_.push_back(screenPoint);
+            detectedSensorTouches_.push_back(*it);
+        }
+    }
+    observer_.engineDidDetectTouches(*this, screenPoints_.data(), screenPoints_.size(), timestamp);
+    tracker_.update(screenPoints_.data(), screenPoints_.size(), timestamp);
+    lastScanTimestamp_ = timestamp;
+    notifyObserverOfTrackedTouches(timestamp);
+    updateBackgroundModel(distances, count);
+}
+
+void Engine::updateRayRegionIfNeeded() {
+    if (rayRegionIsValid_ && rayRegionMappingRevision_ == screenCalibration_.mappingRevision())
+        return;
+    rayRegion_.compute(screenCalibration_.screenRays(), screenRects_);
+    rayRegionIsValid_ = true;
+    rayRegionMappingRevision_ = screenCalibration_.mappingRevision();
+}
+
+void Engine::notifyObserverOfTrackedTouches(double timestamp) {
+    predictor_.update(tracker_.touches(), tracker_.touchCount(), timestamp);
+    observer_.engineDidTrackTouches(*this, predictor_.touches(), predictor_.touchCount(), timestamp);
+}
+
+// Calibration data serialization
+
+// The text format is a header line, then the thresholds, then one line per calibrated touch:
+//
+//     touch-engine-calibration 1
+//     thresholds <count> <distance>...
+//     touches <count>
+//     <sensor x> <sensor y> <screen x> <screen y>
+//
+// The threshold count is `-` if the thresholds aren't calibrated, and an invalid distance is `-`.
+
+static char const kCalibrationHeader[] = "touch-engine-calibration";
+static int const kCalibrationVersion = 1;
+
+bool writeCalibrationData(CalibrationData const &data, FILE *file) {
+    fprintf(file, "%s %d\n", kCalibrationHeader, kCalibrationVersion);
+    if (data.thresholdsReady) {
+        fprintf(file, "thresholds %zu", data.thresholds.size());
+        for (vector<Distance>::const_iterator it = data.thresholds.begin(); it != data.thresholds.end(); ++it) {
+            if (isValidDistance(*it)) {
+                fprintf(file, " %.9g", *it);
+            } else {
+                fputs(" -", file);
+            }
+        }
+        fputc('\n', file);
+    } else {
+        fputs("thresholds -\n", file);
+    }
+    size_t count = std::min(data.sensorPoints.size(), data.screenPoints.size());
+    fprintf(file, "touches %zu\n", count);
+    for (size_t i = 0; i < count; ++i) {
+        fprintf(file, "%.17g %.17g %.17g %.17g\n", data.sensorPoints[i].x, data.sensorPoints[i].y, data.screenPoints[i].x, data.screenPoints[i].y);
+    }
+    return !ferror(file);
+}
+
+static bool readWord(FILE *file, char (&word)[64]) {
+    return fscanf(file, "%63s", word) == 1;
+}
+
+static bool readCount(FILE *file, size_t &count) {
+    char word[64];
+    if (!readWord(file, word))
+        return false;
+    char *end;
+    unsigned long value = strtoul(word, &end, 10);
+    if (end == word || *end != '\0')
+        return false;
+    count = value;
+    return true;
+}
+
+static bool readDouble(FILE *file, double &value) {
+    char word[64];
+    if (!readWord(file, word))
+        return false;
+    char *end;
+    value = strtod(word, &end);
+    return end != word && *end == '\0';
+}
+
+bool readCalibrationData(FILE *file, CalibrationData &data) {
+    char word[64];
+    int version;
+    if (!readWord(file, word) || strcmp(word, kCalibrationHeader) != 0 || fscanf(file, "%d", &version) != 1 || version != kCalibrationVersion)
+        return false;
+
+    if (!readWord(file, word) || strcmp(word, "thresholds") != 0 || !readWord(file, word))
+        return false;
+    data.thresholds.clear();
+    data.thresholdsReady = strcmp(word, "-") != 0;
+    if (data.thresholdsReady) {
+        char *end;
+        size_t count = strtoul(word, &end, 10);
+        // A corrupt count could be too big to reserve.
+        if (end == word || *end != '\0' || count > ThresholdCalibration::kMaximumRayCount)
+            return false;
+        data.thresholds.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            if (!readWord(file, word))
+                return false;
+            if (strcmp(word, "-") == 0) {
+                data.thresholds.push_back(kInvalidDistance);
+            } else {
+                Distance distance = strtof(word, &end);
+                if (end == word || *end != '\0')
+                    return false;
+                data.thresholds.push_back(distance);
+            }
+        }
+    }
+
+    size_t touchCount;
+    if (!readWord(file, word) || strcmp(word, "touches") != 0 || !readCount(file, touchCount))
+        return false;
+    data.sensorPoints.clear();
+    data.screenPoints.clear();
+    for (size_t i = 0; i < touchCount; ++i) {
+        Point sensorPoint, screenPoint;
+        if (!readDouble(file, sensorPoint.x) || !readDouble(file, sensorPoint.y) || !readDouble(file, screenPoint.x) || !readDouble(file, screenPoint.y))
+            return false;
+        data.sensorPoints.push_back(sensorPoint);
+        data.screenPoints.push_back(screenPoint);
+    }
+    return true;
+}
+
+}
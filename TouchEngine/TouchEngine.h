@@ -0,0 +1,220 @@
+//
+//  TouchEngine.h
+//  mickeyMouse
+//
+//  Copyright (c) 2012 Rob Mayoff. All rights reserved.
+//
+
+#ifndef TouchEngine_h
+#define TouchEngine_h
+
+#include "BackgroundModel.h"
+#include "ChangeDetector.h"
+#include "MotionPredictor.h"
+#include "RayRegion.h"
+#include "ScanFilter.h"
+#include "ScreenCalibration.h"
+#include "SweepSelection.h"
+#include "ThresholdCalibration.h"
+#include "TouchEngineTypes.h"
+#include "TouchTracker.h"
+#include <memory>
+#include <stdio.h>
+#include <vector>
+
+namespace TouchEngine {
+
+enum State {
+    State_AwaitingThresholdCalibration, // I need to calibrate my touch thresholds.  Tell the user to remove all obstructions (touches) from the sensitive area and then send me `startCalibratingThreshold`.
+    State_CalibratingThreshold, // I am currently calibrating my touch thresholds.  Tell the user not to obstruct (touch) the sensitive area.
+    State_AwaitingTouchCalibration, // I need to calibrate my touch-mapping parameters.  Show the user a point in the sensitive area and ask them to touch it, then send me `startCalibratingTouchAtPoint`.
+    State_CalibratingTouch, // I am currently calibrating my touch-mapping parameters.  Tell the user to touch the point you sent me in the most recent `startCalibratingTouchAtPoint`.
+    State_DetectingTouches
+};
+
+char const *stateName(State state);
+
+enum CalibrationResult {
+    CalibrationResult_Success,
+    CalibrationResult_NoTouchDetected,
+    CalibrationResult_MultipleTouchesDetected
+};
+
+// Everything I need to restore my calibration later, for example after the app restarts.
+struct CalibrationData {
+    bool thresholdsReady;
+    std::vector<Distance> thresholds;
+    std::vector<Point> sensorPoints;
+    std::vector<Point> screenPoints;
+
+    CalibrationData() : thresholdsReady(false) { }
+};
+
+// I write `data` to `file` as text that `readCalibrationData` understands.  I return false if writing fails.
+bool writeCalibrationData(CalibrationData const &data, FILE *file);
+
+// I read calibration data written by `writeCalibrationData`.  I return false if `file` doesn't contain valid calibration data.
+bool readCalibrationData(FILE *file, CalibrationData &data);
+
+class Engine;
+
+// All of my methods do nothing by default, so you only need to override the ones you care about.
+class EngineObserver {
+public:
+    virtual ~EngineObserver() { }
+
+    // I entered `state`.  This is a good time to save my calibration data.
+    virtual void engineDidChangeState(Engine &engine, State state) { (void)engine; (void)state; }
+
+    virtual void engineDidFinishCalibratingThreshold(Engine &engine) { (void)engine; }
+    virtual void engineDidFinishCalibratingTouch(Engine &engine, Point screenPoint, CalibrationResult result) { (void)engine; (void)screenPoint; (void)result; }
+
+    // I processed a scan while detecting touches.  `points` are the touches in screen coordinates, and `timestamp` is what you passed to `processScan`.  I send this for every scan, even if `count` is zero, except the scans I skip as unchanged (see `Engine::setChangeDetectionEnabled`).
+    virtual void engineDidDetectTouches(Engine &engine, Point const *points, size_t count, double timestamp) { (void)engine; (void)points; (void)count; (void)timestamp; }
+
+    // I followed the touches of a scan from the previous scans (see `TouchTracker`) and predicted where they'll be when you see them (see `MotionPredictor`).  I send this right after `engineDidDetectTouches` for every scan, and once more with every touch ended when I stop detecting touches.
+    virtual void engineDidTrackTouches(Engine &engine, TrackedTouch const *touches, size_t count, double timestamp) { (void)engine; (void)touches; (void)count; (void)timestamp; }
+
+    // My touch thresholds changed.  `count` is zero if I have no thresholds.
+    virtual void engineDidUpdateThresholds(Engine &engine, Distance const *thresholds, size_t count) { (void)engine; (void)thresholds; (void)count; }
+};
+
+// I detect touches on a surface scanned by a 2D lidar.  I move through threshold calibration, then touch calibration, then touch detection, and I notify my observer as I go.
+//
+// I don't depend on any UI or device framework.  Send me `processScan` for each distance report and I'll send my observer the touches, in screen coordinates.  I don't have a thread of my own; I notify my observer from inside your calls.
+class Engine {
+public:
+    explicit Engine(EngineObserver &observer);
+
+    // Set this when the sensor connects.  It determines the angle of each ray.
+    void setGeometry(SensorGeometry const &geometry);
+    SensorGeometry const &geometry() const { return geometry_; }
+
+    // For large surfaces, where an affine transform can't follow the sensor's distortion into the far corners.  See `ScreenCalibration::setNonlinearCorrectionEnabled`.
+    void setNonlinearCorrectionEnabled(bool enabled) { screenCalibration_.setNonlinearCorrectionEnabled(enabled); }
+
+    // While I'm detecting touches, I can filter each ray over the last few scans before I compare it against its threshold, to suppress single-scan speckle (see `ScanFilter`).  1, the default, turns the filter off; 3 or 5 is the number of scans in the median.  A touch reaches my observer `(length - 1) / 2` scans later.
+    void setScanFilterLength(size_t length) { scanFilter_.setLength(length); }
+    size_t scanFilterLength() const { return scanFilter_.length(); }
+
+    // While I'm detecting touches and following no touches, I can skip every scan that hasn't changed since the last scan I processed (see `ChangeDetector`): no detection, no mapping, no background learning and no notifications.  That makes an idle surface nearly free.  It's off by default, because my observer no longer hears about every scan.
+    void setChangeDetectionEnabled(bool enabled);
+    bool changeDetectionEnabled() const { return changeDetectionEnabled_; }
+    void setChangeDetectionEpsilon(Distance epsilon) { changeDetector_.setEpsilon(epsilon); }
+
+    // How many scans I've skipped as unchanged since I was created.
+    size_t skippedScanCount() const { return skippedScanCount_; }
+
+    // I only report touches that land inside one of these rectangles.  If there are none, I report every touch.  While I'm detecting touches, I only look at the rays whose beams cross these rectangles (see `RayRegion`).
+    void setScreenRects(std::vector<Rect> const &rects);
+
+    // I use a `MiddleRaySweepSelection` unless you give me something else.
+    void setSweepSelection(std::unique_ptr<SweepSelection> selection);
+
+    // While I'm detecting touches, I keep learning the untouched surface and update my thresholds to follow it (see `BackgroundModel`).  This is on by default.  Turning it off doesn't undo the updates I've already made.
+    void setAdaptiveThresholdsEnabled(bool enabled) { adaptiveThresholdsEnabled_ = enabled; }
+    bool adaptiveThresholdsEnabled() const { return adaptiveThresholdsEnabled_; }
+
+    void setTouchTrackerParameters(TouchTracker::Parameters const &parameters) { tracker_.setParameters(parameters); }
+    TouchTracker const &touchTracker() const { return tracker_; }
+
+    void setMotionPredictorParameters(MotionPredictor::Parameters const &parameters) { predictor_.setParameters(parameters); }
+    MotionPredictor const &motionPredictor() const { return predictor_; }
+
+    // Seconds from the timestamp you pass to `processScan` until my observer's touches reach the user, as you measure it.  I predict touch positions that far ahead, plus the sensor latency in my motion predictor's parameters.
+    void setDeliveryLatency(double seconds) { predictor_.setDeliveryLatency(seconds); }
+
+    void setBackgroundModelParameters(BackgroundModel::Parameters const &parameters) { backgroundModel_.setParameters(parameters); }
+    BackgroundModel const &backgroundModel() const { return backgroundModel_; }
+
+    // I throw away all my calibration data and return to `State_AwaitingThresholdCalibration`.
+    void reset();
+
+    State state() const { return state_; }
+
+    // When this is true, I'm reading scans for calibration, so I can't start anything else.
+    bool isBusy() const;
+
+    bool canStartCalibratingThreshold() const { return !isBusy(); }
+
+    // I calibrate my touch thresholds from the next few scans, on the assumption that nothing is touching the surface.  It's a logic error to send me this when I'm busy.
+    void startCalibratingThreshold();
+
+    bool canStartCalibratingTouch() const { return !isBusy() && thresholdCalibration_.isReady(); }
+
+    // I try to find a single touch in the next few scans and assume it's at `screenPoint`.  It's a logic error to send me this when I'm busy.
+    void startCalibratingTouchAtPoint(Point screenPoint);
+
+    Point currentCalibrationScreenPoint() const { return screenCalibration_.currentCalibrationScreenPoint(); }
+
+    // While I'm detecting touches, you may know where the user meant to touch, say because they tapped a button.  Tell me where I reported the touch and where it should have been, and I'll refine my touch calibration with it (see `ScreenCalibration::refine`).  `weight` is how much it counts relative to a calibration touch.  I return false if my touch calibration isn't ready.
+    bool refineTouchCalibration(Point reportedScreenPoint, Point intendedScreenPoint, double weight) { return screenCalibration_.refine(reportedScreenPoint, intendedScreenPoint, weight); }
+
+    // Give me every distance report from the sensor.  `timestamp` is in seconds, in whatever clock you like; I pass it back to my observer with the touches.
+    void processScan(Distance const *distances, size_t count, double timestamp);
+
+    ThresholdCalibration const &thresholdCalibration() const { return thresholdCalibration_; }
+    ScreenCalibration const &screenCalibration() const { return screenCalibration_; }
+
+    // The rays I looked at in the most recent scan I detected touches in.
+    RayRegion const &rayRegion() const { return rayRegion_; }
+
+    // The touches of the most recent scan I detected touches in, as I sent them to `engineDidDetectTouches`, and the sensor touch each one came from, in the same order.  They're empty once I stop detecting touches.
+    std::vector<Point> const &detectedScreenPoints() const { return screenPoints_; }
+    std::vector<SensorTouch> const &detectedSensorTouches() const { return detectedSensorTouches_; }
+
+    CalibrationData calibrationData() const;
+
+    // I replace my calibration data with `data` and enter the appropriate non-busy state.
+    void restoreCalibrationData(CalibrationData const &data);
+
+private:
+    Engine(Engine const &); // not implemented
+    Engine &operator=(Engine const &); // not implemented
+
+    void setState(State state);
+    void setAppropriateNonBusyState();
+    void requireNotBusy(char const *action) const;
+    void notifyObserverOfThresholds();
+    void seedBackgroundModel();
+    void updateBackgroundModel(Distance const *distances, size_t count);
+    void calibrateThreshold(Distance const *distances, size_t count);
+    void calibrateTouch(Distance const *distances, size_t count);
+    void detectTouches(Distance const *distances, size_t count, double timestamp);
+    void notifyObserverOfTrackedTouches(double timestamp);
+    void updateRayRegionIfNeeded();
+    bool canSkipScan(Distance const *distances, size_t count);
+    bool isValidScreenPoint(Point point) const;
+
+    EngineObserver &observer_;
+    State state_;
+    SensorGeometry geometry_;
+    std::vector<Rect> screenRects_;
+    RayRegion rayRegion_;
+    bool rayRegionIsValid_;
+    unsigned long rayRegionMappingRevision_;
+    ThresholdCalibration thresholdCalibration_;
+    ScreenCalibration screenCalibration_;
+    std::unique_ptr<SweepSelection> selection_;
+    BackgroundModel backgroundModel_;
+    bool adaptiveThresholdsEnabled_;
+    ScanFilter scanFilter_;
+    ChangeDetector changeDetector_;
+    bool changeDetectionEnabled_;
+    size_t quietScans_; // unchanged scans in a row I processed anyway, for the scan filter
+    size_t skippedScanCount_;
+    TouchTracker tracker_;
+    MotionPredictor predictor_;
+    double lastScanTimestamp_;
+
+    // Scratch space for `detectTouches`, kept so I don't allocate for every scan.
+    std::vector<SensorTouch> sensorTouches_;
+    std::vector<Point> screenPoints_;
+    std::vector<SensorTouch> detectedSensorTouches_;
+    std::vector<uint64_t> touchedRayMask_;
+    std::vector<Distance> learnedThresholds_;
+};
+
+}
+
+#endif
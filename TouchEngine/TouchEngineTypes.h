@@ -0,0 +1,100 @@
+//
+//  TouchEngineTypes.h
+//  mickeyMouse
+//
+//  Copyright (c) 2012 Rob Mayoff. All rights reserved.
+//
+
+#ifndef TouchEngineTypes_h
+#define TouchEngineTypes_h
+
+#include <math.h>
+#include <stddef.h>
+
+namespace TouchEngine {
+
+// A distance reported by the sensor, in millimeters.  This matches `Lidar2DDistance`, so you can pass the bytes of a `Lidar2D` distance report straight to me.
+typedef float Distance;
+
+// Note that some code relies on this being the largest possible value, so that an invalid distance is never shorter than a threshold.
+static Distance const kInvalidDistance = HUGE_VALF;
+
+inline bool isValidDistance(Distance distance) { return distance != kInvalidDistance; }
+
+struct Point {
+    double x;
+    double y;
+
+    Point() : x(0), y(0) { }
+    Point(double x_, double y_) : x(x_), y(y_) { }
+};
+
+// A rectangle with the same containment rule as `CGRectContainsPoint`: the minimum edges are inside and the maximum edges are outside.
+struct Rect {
+    double x;
+    double y;
+    double width;
+    double height;
+
+    Rect() : x(0), y(0), width(0), height(0) { }
+    Rect(double x_, double y_, double width_, double height_) : x(x_), y(y_), width(width_), height(height_) { }
+
+    bool contains(Point point) const {
+        return point.x >= x && point.x < x + width && point.y >= y && point.y < y + height;
+    }
+};
+
+// The same layout and meaning as `CGAffineTransform`.
+struct AffineTransform {
+    double a, b, c, d, tx, ty;
+
+    AffineTransform() : a(1), b(0), c(0), d(1), tx(0), ty(0) { }
+
+    Point apply(Point point) const {
+        return Point(a * point.x + c * point.y + tx, b * point.x + d * point.y + ty);
+    }
+
+    // Like `CGAffineTransformInvert`, I return myself unchanged if I'm not invertible.
+    AffineTransform inverted() const {
+        double determinant = a * d - b * c;
+        if (determinant == 0)
+            return *this;
+        AffineTransform inverse;
+        inverse.a = d / determinant;
+        inverse.b = -b / determinant;
+        inverse.c = -c / determinant;
+        inverse.d = a / determinant;
+        inverse.tx = -(inverse.a * tx + inverse.c * ty);
+        inverse.ty = -(inverse.b * tx + inverse.d * ty);
+        return inverse;
+    }
+};
+
+// A contiguous range of rays, like `NSRange`.
+struct SweepRange {
+    size_t location;
+    size_t length;
+
+    SweepRange() : location(0), length(0) { }
+    SweepRange(size_t location_, size_t length_) : location(location_), length(length_) { }
+
+    size_t end() const { return location + length; }
+    size_t middle() const { return location + length / 2; }
+};
+
+// What I need to know about a sensor to turn a ray index into an angle.
+struct SensorGeometry {
+    size_t rayCount;
+    double coverageDegrees;
+
+    SensorGeometry() : rayCount(0), coverageDegrees(0) { }
+    SensorGeometry(size_t rayCount_, double coverageDegrees_) : rayCount(rayCount_), coverageDegrees(coverageDegrees_) { }
+
+    double radiansPerRay() const {
+        return rayCount ? coverageDegrees * (M_PI / 180.0) / rayCount : 0;
+    }
+};
+
+}
+
+#endif
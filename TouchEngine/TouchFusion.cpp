@@ -0,0 +1,584 @@
+//
+//  TouchFusion.cpp
+//  mickeyMouse
+//
+//  Copyright (c) 2012 Rob Mayoff. All rights reserved.
+//
+
+#include "TouchFusion.h"
+#include <algorithm>
+#include <condition_variable>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+using std::vector;
+
+namespace TouchEngine {
+
+// Touch merging
+
+size_t const TouchMerger::kMaximumSensors;
+
+// A width factor between these leaves a touch's confidence alone.
+static double const kNarrowestFullWidth = 0.5;
+static double const kWidestFullWidth = 2;
+
+TouchMerger::Parameters::Parameters()
+    : gateDistance(40), fingerDiameter(15), rangeNoise(10), seeThroughMargin(50)
+{ }
+
+TouchMerger::TouchMerger() { }
+
+void TouchMerger::setSensor(size_t sensor, SensorGeometry const &geometry, AffineTransform const &transform) {
+    if (sensor >= kMaximumSensors)
+        throw std::logic_error("TouchEngine::TouchMerger received too many sensors");
+    if (sensor >= sensors_.size()) {
+        sensors_.resize(sensor + 1);
+    }
+    Sensor &s = sensors_[sensor];
+    s.geometry = geometry;
+    s.radiansPerRay = geometry.radiansPerRay();
+    s.screenToSensor = transform.inverted();
+}
+
+// The lateral error of a touch is about half the spacing of the rays at its range, and its range error is the sensor's range noise.  I scale the inverse of their combined variance so a touch right at the sensor has confidence 1.
+double TouchMerger::confidence(size_t sensor, SensorTouch const &touch) const {
+    if (sensor >= sensors_.size() || !isValidDistance(touch.distance))
+        return 0;
+    double raySpacing = std::max((double)touch.distance, 1.0) * sensors_[sensor].radiansPerRay;
+    double lateralError = raySpacing / 2;
+    double rangeVariance = parameters_.rangeNoise * parameters_.rangeNoise;
+    double confidence = rangeVariance / (rangeVariance + lateralError * lateralError);
+
+    double expectedRays = std::max(parameters_.fingerDiameter / raySpacing, 1.0);
+    double width = touch.sweep.length / expectedRays;
+    if (width < kNarrowestFullWidth) {
+        confidence *= width / kNarrowestFullWidth;
+    } else if (width > kWidestFullWidth) {
+        confidence *= kWidestFullWidth / width;
+    }
+    return confidence;
+}
+
+void TouchMerger::merge(FusionFrame const *const *frames, size_t frameCount, vector<FusedTouch> &touches) {
+    touches.clear();
+    frameCount = std::min(frameCount, sensors_.size());
+
+    detections_.clear();
+    for (size_t s = 0; s < frameCount; ++s) {
+        FusionFrame const *frame = frames[s];
+        if (!frame)
+            continue;
+        size_t count = std::min(frame->screenPoints.size(), frame->sensorTouches.size());
+        for (size_t i = 0; i < count; ++i) {
+            Detection detection = { s, frame->screenPoints[i], confidence(s, frame->sensorTouches[i]) };
+            detections_.push_back(detection);
+        }
+    }
+    // Most confident first, so each touch starts at its best position and the gate is centered where it should be.  A stable sort keeps ties in sensor order, so the result doesn't depend on the sort.
+    std::stable_sort(detections_.begin(), detections_.end());
+
+    for (vector<Detection>::const_iterator d = detections_.begin(); d != detections_.end(); ++d) {
+        unsigned bit = 1u << d->sensor;
+        FusedTouch *best = nearestTouch(touches, d->position, bit);
+        if (best) {
+            double total = best->confidence + d->confidence;
+            if (total > 0) {
+                best->position.x = (best->position.x * best->confidence + d->position.x * d->confidence) / total;
+                best->position.y = (best->position.y * best->confidence + d->position.y * d->confidence) / total;
+            }
+            best->confidence = total;
+            best->sensorMask |= bit;
+        } else {
+            FusedTouch touch = { d->position, d->confidence, bit, 0 };
+            touches.push_back(touch);
+        }
+    }
+
+    // Now every sensor that didn't see a touch gets a say in whether it's real.
+    size_t write = 0;
+    for (size_t i = 0; i < touches.size(); ++i) {
+        FusedTouch touch = touches[i];
+        bool seenThrough = false;
+        for (size_t s = 0; s < frameCount && !seenThrough; ++s) {
+            unsigned bit = 1u << s;
+            if (!frames[s] || (touch.sensorMask & bit))
+                continue;
+            switch (visibility(s, *frames[s], touch.position)) {
+                case Visibility_Occluded:
+                    touch.occludedMask |= bit;
+                    break;
+                case Visibility_SeenThrough:
+                    seenThrough = true;
+                    break;
+                case Visibility_Unknown:
+                    break;
+            }
+        }
+        if (!seenThrough) {
+            touches[write++] = touch;
+        }
+    }
+    touches.resize(write);
+}
+
+void TouchMerger::mergeOnto(size_t primary, FusionFrame const *const *frames, size_t frameCount, vector<FusedTouch> &touches) {
+    touches.clear();
+    frameCount = std::min(frameCount, sensors_.size());
+    if (primary >= frameCount || !frames[primary])
+        return;
+    FusionFrame const &primaryFrame = *frames[primary];
+    unsigned primaryBit = 1u << primary;
+    size_t primaryCount = std::min(primaryFrame.screenPoints.size(), primaryFrame.sensorTouches.size());
+    for (size_t i = 0; i < primaryCount; ++i) {
+        FusedTouch touch = { primaryFrame.screenPoints[i], confidence(primary, primaryFrame.sensorTouches[i]), primaryBit, 0 };
+        touches.push_back(touch);
+    }
+
+    for (size_t s = 0; s < frameCount; ++s) {
+        FusionFrame const *frame = frames[s];
+        if (s == primary || !frame)
+            continue;
+        unsigned bit = 1u << s;
+        size_t count = std::min(frame->screenPoints.size(), frame->sensorTouches.size());
+        for (size_t i = 0; i < count; ++i) {
+            Point position = frame->screenPoints[i];
+            double touchConfidence = confidence(s, frame->sensorTouches[i]);
+            // A touch the primary sensor saw too only gains support.  It stays where the primary sensor saw it.
+            if (FusedTouch *match = nearestTouch(touches, position, bit)) {
+                match->confidence += touchConfidence;
+                match->sensorMask |= bit;
+            } else if (visibility(primary, primaryFrame, position) == Visibility_Occluded) {
+                FusedTouch touch = { position, touchConfidence, bit, primaryBit };
+                touches.push_back(touch);
+            }
+        }
+    }
+}
+
+// One sensor never sees the same finger twice in a scan, so its touches are always different touches.
+FusedTouch *TouchMerger::nearestTouch(vector<FusedTouch> &touches, Point position, unsigned sensorBit) const {
+    FusedTouch *best = NULL;
+    double bestDistance = parameters_.gateDistance;
+    for (vector<FusedTouch>::iterator t = touches.begin(); t != touches.end(); ++t) {
+        if (t->sensorMask & sensorBit)
+            continue;
+        double distance = hypot(t->position.x - position.x, t->position.y - position.y);
+        if (distance < bestDistance) {
+            bestDistance = distance;
+            best = &*t;
+        }
+    }
+    return best;
+}
+
+// I look at the ray nearest the point and its neighbors, because a finger is at least a ray wide and the point is only as accurate as the calibrations.  The nearest of the three rays decides: if even that one reaches past the point, nothing is there.
+TouchMerger::Visibility TouchMerger::visibility(size_t sensor, FusionFrame const &frame, Point screenPoint) const {
+    Sensor const &s = sensors_[sensor];
+    if (s.radiansPerRay <= 0)
+        return Visibility_Unknown;
+    Point sensorPoint = s.screenToSensor.apply(screenPoint);
+    double range = hypot(sensorPoint.x, sensorPoint.y);
+    double radians = atan2(sensorPoint.y, sensorPoint.x);
+    if (radians < 0) {
+        radians += 2 * M_PI;
+    }
+    double ray = radians / s.radiansPerRay + 0.5;
+    size_t rayCount = std::min(s.geometry.rayCount, frame.distances.size());
+    if (ray >= rayCount)
+        return Visibility_Unknown;
+
+    size_t center = (size_t)ray;
+    size_t first = center > 0 ? center - 1 : 0;
+    size_t end = std::min(center + 2, rayCount);
+    Distance nearest = kInvalidDistance;
+    for (size_t i = first; i < end; ++i) {
+        nearest = std::min(nearest, frame.distances[i]);
+    }
+    if (!isValidDistance(nearest))
+        return Visibility_Unknown;
+    if (nearest < range - parameters_.seeThroughMargin)
+        return Visibility_Occluded;
+    if (nearest > range + parameters_.seeThroughMargin)
+        return Visibility_SeenThrough;
+    return Visibility_Unknown;
+}
+
+// Sensor threads
+
+// One sensor: its engine, its thread, and the scans passing between them.  I forward the engine's notifications to the observer you gave `addSensor`, and note when the engine detects touches, so the thread knows the engine has a frame for me.
+class TouchFusion::Sensor : public EngineObserver {
+public:
+    Sensor(TouchFusion &fusion, size_t index_, EngineObserver &observer)
+        : index(index_), engine(*this), hasPublished(false), fusion_(fusion), observer_(observer), hasPending_(false), busy_(false), stopping_(false), pendingTimestamp_(0), droppedScanCount_(0), detected_(false)
+    { }
+
+    void start() {
+        stopping_ = false;
+        thread_ = std::thread(&Sensor::run, this);
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        condition_.notify_all();
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+
+    void submitScan(Distance const *distances, size_t count, double timestamp) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (hasPending_) {
+                ++droppedScanCount_;
+            }
+            pending_.assign(distances, distances + count);
+            pendingTimestamp_ = timestamp;
+            hasPending_ = true;
+        }
+        condition_.notify_all();
+    }
+
+    void waitUntilIdle() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        condition_.wait(lock, [this] { return !hasPending_ && !busy_; });
+    }
+
+    size_t droppedScanCount() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return droppedScanCount_;
+    }
+
+    virtual void engineDidChangeState(Engine &engine, State state) { observer_.engineDidChangeState(engine, state); }
+    virtual void engineDidFinishCalibratingThreshold(Engine &engine) { observer_.engineDidFinishCalibratingThreshold(engine); }
+    virtual void engineDidFinishCalibratingTouch(Engine &engine, Point screenPoint, CalibrationResult result) { observer_.engineDidFinishCalibratingTouch(engine, screenPoint, result); }
+    virtual void engineDidTrackTouches(Engine &engine, TrackedTouch const *touches, size_t count, double timestamp) { observer_.engineDidTrackTouches(engine, touches, count, timestamp); }
+    virtual void engineDidUpdateThresholds(Engine &engine, Distance const *thresholds, size_t count) { observer_.engineDidUpdateThresholds(engine, thresholds, count); }
+
+    virtual void engineDidDetectTouches(Engine &engine, Point const *points, size_t count, double timestamp) {
+        detected_ = true;
+        observer_.engineDidDetectTouches(engine, points, count, timestamp);
+    }
+
+    size_t const index;
+    Engine engine;
+
+    // The thread fills `frame`, and `publishFrame` swaps it into `published` while holding the fusion's mutex.  `published` and `hasPublished` belong to whichever thread holds that mutex.
+    FusionFrame frame;
+    FusionFrame published;
+    bool hasPublished;
+
+private:
+    Sensor(Sensor const &); // not implemented
+    Sensor &operator=(Sensor const &); // not implemented
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (;;) {
+            condition_.wait(lock, [this] { return hasPending_ || stopping_; });
+            // I finish the waiting scan before I stop, so `stop` doesn't lose it.
+            if (!hasPending_)
+                break;
+            working_.swap(pending_);
+            double timestamp = pendingTimestamp_;
+            hasPending_ = false;
+            busy_ = true;
+            lock.unlock();
+
+            detected_ = false;
+            engine.processScan(working_.data(), working_.size(), timestamp);
+            if (detected_) {
+                frame.timestamp = timestamp;
+                frame.screenPoints = engine.detectedScreenPoints();
+                frame.sensorTouches = engine.detectedSensorTouches();
+                frame.distances.swap(working_);
+                fusion_.publishFrame(*this);
+            }
+
+            lock.lock();
+            busy_ = false;
+            condition_.notify_all();
+        }
+    }
+
+    TouchFusion &fusion_;
+    EngineObserver &observer_;
+    std::thread thread_;
+
+    // `mutex_` guards the scan waiting for the thread and the flags around it.
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    bool hasPending_;
+    bool busy_;
+    bool stopping_;
+    vector<Distance> pending_;
+    double pendingTimestamp_;
+    size_t droppedScanCount_;
+
+    // Only the thread touches these.
+    vector<Distance> working_;
+    bool detected_;
+};
+
+// Public API
+
+TouchFusion::TouchFusion(TouchFusionObserver &observer)
+    : observer_(observer), running_(false), interleavingEnabled_(false), maximumSkew_(0.025), lastFusedTimestamp_(-HUGE_VAL), fusedStepCount_(0), lateScanCount_(0), notificationCount_(0), isDelivering_(false)
+{ }
+
+TouchFusion::~TouchFusion() {
+    if (running_) {
+        stop();
+    }
+}
+
+size_t TouchFusion::addSensor(EngineObserver &observer) {
+    if (running_)
+        throw std::logic_error("TouchEngine::TouchFusion received addSensor while running");
+    if (sensors_.size() >= TouchMerger::kMaximumSensors)
+        throw std::logic_error("TouchEngine::TouchFusion received too many sensors");
+    size_t index = sensors_.size();
+    sensors_.push_back(std::unique_ptr<Sensor>(new Sensor(*this, index, observer)));
+    return index;
+}
+
+Engine &TouchFusion::sensorEngine(size_t sensor) {
+    return sensors_.at(sensor)->engine;
+}
+
+void TouchFusion::setInterleavingEnabled(bool enabled) {
+    if (running_)
+        throw std::logic_error("TouchEngine::TouchFusion received setInterleavingEnabled while running");
+    interleavingEnabled_ = enabled;
+}
+
+InterleaveMonitor::Report TouchFusion::interleaveReport() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return interleaveMonitor_.report();
+}
+
+size_t TouchFusion::lateScanCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return lateScanCount_;
+}
+
+size_t TouchFusion::fusedStepCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return fusedStepCount_;
+}
+
+void TouchFusion::start() {
+    if (running_)
+        throw std::logic_error("TouchEngine::TouchFusion received start while running");
+    for (size_t i = 0; i < sensors_.size(); ++i) {
+        if (sensors_[i]->engine.state() != State_DetectingTouches)
+            throw std::logic_error(std::string("TouchEngine::TouchFusion received start while a sensor's engine is in state ") + stateName(sensors_[i]->engine.state()));
+    }
+
+    for (size_t i = 0; i < sensors_.size(); ++i) {
+        Engine const &engine = sensors_[i]->engine;
+        merger_.setSensor(i, engine.geometry(), engine.screenCalibration().transform());
+        sensors_[i]->hasPublished = false;
+    }
+    tracker_.reset();
+    predictor_.reset();
+    lastFusedTimestamp_ = -HUGE_VAL;
+    fusedStepCount_ = 0;
+    interleaveMonitor_.reset(sensors_.size());
+    lateScanCount_ = 0;
+
+    running_ = true;
+    for (size_t i = 0; i < sensors_.size(); ++i) {
+        sensors_[i]->start();
+    }
+}
+
+void TouchFusion::stop() {
+    if (!running_)
+        return;
+    for (size_t i = 0; i < sensors_.size(); ++i) {
+        sensors_[i]->stop();
+    }
+    running_ = false;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    fuseStep();
+    tracker_.endAllTracks();
+    if (tracker_.touchCount() > 0) {
+        predictor_.update(tracker_.touches(), tracker_.touchCount(), lastFusedTimestamp_);
+        queueNotification(lastFusedTimestamp_);
+    }
+    predictor_.reset();
+    deliverNotifications(lock);
+    waitUntilDelivered(lock);
+}
+
+void TouchFusion::submitScan(size_t sensor, Distance const *distances, size_t count, double timestamp) {
+    if (!running_)
+        throw std::logic_error("TouchEngine::TouchFusion received submitScan while not running");
+    sensors_.at(sensor)->submitScan(distances, count, timestamp);
+}
+
+void TouchFusion::waitUntilProcessed() {
+    for (size_t i = 0; i < sensors_.size(); ++i) {
+        sensors_[i]->waitUntilIdle();
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    waitUntilDelivered(lock);
+}
+
+void TouchFusion::flush() {
+    waitUntilProcessed();
+    std::unique_lock<std::mutex> lock(mutex_);
+    fuseStep();
+    deliverNotifications(lock);
+    waitUntilDelivered(lock);
+}
+
+size_t TouchFusion::droppedScanCount() const {
+    size_t count = 0;
+    for (size_t i = 0; i < sensors_.size(); ++i) {
+        count += sensors_[i]->droppedScanCount();
+    }
+    return count;
+}
+
+// Fusion
+
+void TouchFusion::publishFrame(Sensor &sensor) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    acceptFrame(sensor);
+    deliverNotifications(lock);
+}
+
+// A sensor that finishes a second scan before I've merged its first closes the time step, so one slow or silent sensor can't hold up the others.  Otherwise the time step closes when every sensor has finished a scan.  When I'm interleaving, every scan closes a time step of its own, unless it's late.
+void TouchFusion::acceptFrame(Sensor &sensor) {
+    interleaveMonitor_.observeScan(sensor.index, sensor.frame.timestamp);
+    if (interleavingEnabled_) {
+        std::swap(sensor.published, sensor.frame);
+        sensor.hasPublished = true;
+        if (isFresh(sensor)) {
+            fuseInterleavedStep(sensor);
+        } else {
+            ++lateScanCount_;
+        }
+        return;
+    }
+
+    if (isFresh(sensor)) {
+        fuseStep();
+    }
+    std::swap(sensor.published, sensor.frame);
+    sensor.hasPublished = true;
+
+    for (size_t i = 0; i < sensors_.size(); ++i) {
+        if (!isFresh(*sensors_[i]))
+            return;
+    }
+    fuseStep();
+}
+
+bool TouchFusion::isFresh(Sensor const &sensor) const {
+    return sensor.hasPublished && sensor.published.timestamp > lastFusedTimestamp_;
+}
+
+void TouchFusion::fuseStep() {
+    // When I'm interleaving, every fresh scan already made its own time step.
+    if (interleavingEnabled_)
+        return;
+
+    double newest = -HUGE_VAL;
+    for (size_t i = 0; i < sensors_.size(); ++i) {
+        if (isFresh(*sensors_[i])) {
+            newest = std::max(newest, sensors_[i]->published.timestamp);
+        }
+    }
+    if (newest == -HUGE_VAL)
+        return;
+
+    frames_.assign(sensors_.size(), NULL);
+    for (size_t i = 0; i < sensors_.size(); ++i) {
+        Sensor const &sensor = *sensors_[i];
+        if (isFresh(sensor) && sensor.published.timestamp >= newest - maximumSkew_) {
+            frames_[i] = &sensor.published;
+        }
+    }
+    merger_.merge(frames_.data(), frames_.size(), fusedTouches_);
+    finishStep(newest);
+}
+
+void TouchFusion::fuseInterleavedStep(Sensor const &primary) {
+    double timestamp = primary.published.timestamp;
+    frames_.assign(sensors_.size(), NULL);
+    for (size_t i = 0; i < sensors_.size(); ++i) {
+        Sensor const &sensor = *sensors_[i];
+        if (sensor.hasPublished && sensor.published.timestamp >= timestamp - maximumSkew_) {
+            frames_[i] = &sensor.published;
+        }
+    }
+    merger_.mergeOnto(primary.index, frames_.data(), frames_.size(), fusedTouches_);
+    finishStep(timestamp);
+}
+
+void TouchFusion::finishStep(double timestamp) {
+    lastFusedTimestamp_ = timestamp;
+    ++fusedStepCount_;
+    interleaveMonitor_.observeUpdate(timestamp);
+
+    fusedPoints_.clear();
+    for (vector<FusedTouch>::const_iterator it = fusedTouches_.begin(); it != fusedTouches_.end(); ++it) {
+        fusedPoints_.push_back(it->position);
+    }
+    tracker_.update(fusedPoints_.data(), fusedPoints_.size(), timestamp);
+    predictor_.update(tracker_.touches(), tracker_.touchCount(), timestamp);
+    Notification &notification = queueNotification(timestamp);
+    notification.hasFusedTouches = true;
+    notification.fusedTouches.assign(fusedTouches_.begin(), fusedTouches_.end());
+}
+
+TouchFusion::Notification &TouchFusion::queueNotification(double timestamp) {
+    if (notificationCount_ == notifications_.size()) {
+        notifications_.push_back(Notification());
+    }
+    Notification &notification = notifications_[notificationCount_++];
+    notification.timestamp = timestamp;
+    notification.hasFusedTouches = false;
+    notification.fusedTouches.clear();
+    notification.trackedTouches.assign(predictor_.touches(), predictor_.touches() + predictor_.touchCount());
+    return notification;
+}
+
+// Observer notifications
+
+// Whichever thread finds nobody delivering sends every waiting notification, including the ones other threads queue meanwhile, so the observer hears the time steps in order and never from two threads at once.  The other threads go back to their scans instead of waiting for the observer.
+void TouchFusion::deliverNotifications(std::unique_lock<std::mutex> &lock) {
+    if (isDelivering_)
+        return;
+    isDelivering_ = true;
+    while (notificationCount_ > 0) {
+        delivering_.swap(notifications_);
+        size_t count = notificationCount_;
+        notificationCount_ = 0;
+        lock.unlock();
+        for (size_t i = 0; i < count; ++i) {
+            Notification const &notification = delivering_[i];
+            if (notification.hasFusedTouches) {
+                observer_.touchFusionDidFuseTouches(*this, notification.fusedTouches.data(), notification.fusedTouches.size(), notification.timestamp);
+            }
+            observer_.touchFusionDidTrackTouches(*this, notification.trackedTouches.data(), notification.trackedTouches.size(), notification.timestamp);
+        }
+        lock.lock();
+    }
+    isDelivering_ = false;
+    deliveredCondition_.notify_all();
+}
+
+void TouchFusion::waitUntilDelivered(std::unique_lock<std::mutex> &lock) {
+    deliveredCondition_.wait(lock, [this] { return !isDelivering_ && notificationCount_ == 0; });
+}
+
+}
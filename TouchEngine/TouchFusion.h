@@ -0,0 +1,250 @@
+//
+//  TouchFusion.h
+//  mickeyMouse
+//
+//  Copyright (c) 2012 Rob Mayoff. All rights reserved.
+//
+
+#ifndef TouchFusion_h
+#define TouchFusion_h
+
+#include "InterleaveMonitor.h"
+#include "MotionPredictor.h"
+#include "SweepSelection.h"
+#include "TouchEngine.h"
+#include "TouchEngineTypes.h"
+#include "TouchTracker.h"
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace TouchEngine {
+
+// One sensor's touches from one scan, ready to merge with the other sensors'.
+struct FusionFrame {
+    double timestamp;
+    std::vector<Point> screenPoints;
+    std::vector<SensorTouch> sensorTouches; // the sensor touch each screen point came from, in the same order
+    std::vector<Distance> distances; // the whole scan, so I can tell whether the sensor could see the other sensors' touches
+
+    FusionFrame() : timestamp(0) { }
+};
+
+// One touch that I merged from the sensors' touches.
+struct FusedTouch {
+    Point position; // in screen coordinates
+    double confidence; // the sum of the confidences of the sensor touches I merged
+    unsigned sensorMask; // bit `i` is set if sensor `i` saw this touch
+    unsigned occludedMask; // bit `i` is set if sensor `i` missed this touch because something nearer blocked its view
+};
+
+// I merge the touches that several sensors watching the same screen saw at about the same time into a single set of touches.
+//
+// I weight each sensor touch by how precisely the sensor can place it.  The rays of a sensor fan out, so a touch far from the sensor falls between widely-spaced rays and its position across the rays is coarse.  A sweep much narrower than a finger at that range is a finger the sensor only partly sees, and a sweep much wider is probably two fingers or something that isn't a finger, so I trust those less too.
+//
+// I merge touches from different sensors that land within `gateDistance` of each other, most confident first, at their confidence-weighted mean.  A touch that only some sensors saw stays, unless another sensor saw the surface behind it: a ray that reaches past a touch is proof that nothing is there, so the touch was a speckle or a ghost.  If a sensor's ray stops short of the touch, the sensor's view was blocked (by another finger, usually), and I note that in the touch's `occludedMask`.
+class TouchMerger {
+public:
+    // The bits of `FusedTouch::sensorMask`.
+    static size_t const kMaximumSensors = 32;
+
+    struct Parameters {
+        // The farthest apart, in screen points, two sensors' touches can be and still be the same touch.
+        double gateDistance;
+
+        // In millimeters, like distances: the width of a typical fingertip, and one standard deviation of the sensor's range noise.
+        double fingerDiameter;
+        double rangeNoise;
+
+        // How much farther than a touch, in millimeters, a sensor's rays must reach before I believe they saw past it.
+        double seeThroughMargin;
+
+        Parameters();
+    };
+
+    TouchMerger();
+
+    void setParameters(Parameters const &parameters) { parameters_ = parameters; }
+    Parameters const &parameters() const { return parameters_; }
+
+    // Tell me about each sensor before you merge frames from it.  `transform` is its touch calibration's affine transform from sensor to screen coordinates (see `ScreenCalibration::transform`).  I only use it to find which of the sensor's rays points at a touch another sensor saw, so the affine transform is close enough even if the engine maps touches through a correction grid.
+    void setSensor(size_t sensor, SensorGeometry const &geometry, AffineTransform const &transform);
+    size_t sensorCount() const { return sensors_.size(); }
+
+    // I clear `touches` and then append the touches I merge from `frames`.  `frames[i]` is sensor `i`'s frame, or null if sensor `i` has nothing for this time step.
+    void merge(FusionFrame const *const *frames, size_t frameCount, std::vector<FusedTouch> &touches);
+
+    // Like `merge`, but only sensor `primary`'s frame is new, and the others are the most recent frames from sensors whose scans fall between the primary's.  I put each touch where the primary sensor saw it, because the other frames are older.  From the other frames, I only add touches the primary sensor couldn't see because something blocked its view, and I don't let the older frames see through the primary's touches, because a finger that just landed isn't in them yet.
+    void mergeOnto(size_t primary, FusionFrame const *const *frames, size_t frameCount, std::vector<FusedTouch> &touches);
+
+    // How much I trust `touch` from `sensor`, between 0 and 1.
+    double confidence(size_t sensor, SensorTouch const &touch) const;
+
+private:
+    enum Visibility {
+        Visibility_Unknown, // the point is outside the sensor's rays, they didn't return, or they stop about where the point is
+        Visibility_Occluded, // the rays stop short of the point
+        Visibility_SeenThrough // the rays reach past the point
+    };
+
+    struct Sensor {
+        SensorGeometry geometry;
+        double radiansPerRay;
+        AffineTransform screenToSensor;
+    };
+
+    struct Detection {
+        size_t sensor;
+        Point position;
+        double confidence;
+
+        bool operator<(Detection const &other) const { return confidence > other.confidence; }
+    };
+
+    // The touch nearest `position` within my gate distance that `sensorBit`'s sensor hasn't contributed to, or null.
+    FusedTouch *nearestTouch(std::vector<FusedTouch> &touches, Point position, unsigned sensorBit) const;
+    Visibility visibility(size_t sensor, FusionFrame const &frame, Point screenPoint) const;
+
+    Parameters parameters_;
+    std::vector<Sensor> sensors_;
+
+    // Scratch space for `merge`, kept so I don't allocate for every time step.
+    std::vector<Detection> detections_;
+};
+
+class TouchFusion;
+
+// All of my methods do nothing by default, so you only need to override the ones you care about.
+//
+// I send these after I release my lock, so you can ask me for `fusedStepCount`, `lateScanCount`, `interleaveReport` or `droppedScanCount` from inside them.  Don't call my `flush`, `stop` or `waitUntilProcessed` from inside them: those wait for you to return.
+class TouchFusionObserver {
+public:
+    virtual ~TouchFusionObserver() { }
+
+    // I merged the sensors' touches of one time step.  `timestamp` is the newest timestamp of the scans I merged.  I send this from whichever sensor thread completed the time step, or from inside `flush` or `stop`, but never from two threads at once.
+    virtual void touchFusionDidFuseTouches(TouchFusion &fusion, FusedTouch const *touches, size_t count, double timestamp) { (void)fusion; (void)touches; (void)count; (void)timestamp; }
+
+    // I followed the fused touches from the previous time steps and predicted where they'll be when you see them, just like `EngineObserver::engineDidTrackTouches`.  I send this right after `touchFusionDidFuseTouches`, and once more with every touch ended when you stop me.
+    virtual void touchFusionDidTrackTouches(TouchFusion &fusion, TrackedTouch const *touches, size_t count, double timestamp) { (void)fusion; (void)touches; (void)count; (void)timestamp; }
+};
+
+// I detect touches on one screen with two or more sensors, so a finger hidden from one sensor behind another finger is still seen by another sensor.
+//
+// Each sensor has its own `Engine`, which does the expensive per-scan work (detection, mapping and background learning), on its own thread, so the operating system can run the sensors on separate cores.  When every sensor has finished a scan, or when a sensor finishes a second scan before the others finish their first, I merge the scans into one time step with a `TouchMerger` and track and predict the merged touches.  That step is small and it's the only part that runs one at a time.
+//
+// Calibrate each sensor's engine through `sensorEngine` before you `start` me, and leave the engines alone until you `stop` me: while I'm running, only the sensor threads touch them.
+class TouchFusion {
+public:
+    explicit TouchFusion(TouchFusionObserver &observer);
+    ~TouchFusion();
+
+    // I add a sensor and return its index.  `observer` hears from the sensor's engine, from the sensor's thread while I'm running.  It's a logic error to add a sensor while I'm running.
+    size_t addSensor(EngineObserver &observer);
+    size_t sensorCount() const { return sensors_.size(); }
+    Engine &sensorEngine(size_t sensor);
+
+    // The farthest apart, in seconds, two sensors' scans can be and still be merged into one time step, or, when I'm interleaving, how old another sensor's scan can be and still fill in touches.  The default is one scan period of a 40 Hz sensor.  When you interleave, make it a little more than the time between one sensor's scans and the next sensor's, so a scan from nearly a period ago, when a moving finger was somewhere else, doesn't fill in a ghost.
+    void setMaximumSkew(double seconds) { maximumSkew_ = seconds; }
+    double maximumSkew() const { return maximumSkew_; }
+
+    // Two sensors at the same scan rate, half a period apart, can give you touches twice as often as either one.  When I'm interleaving, I don't wait for every sensor: each sensor's scan is a time step of its own, with the touches that sensor saw, filled in from the other sensors' most recent scans (see `TouchMerger::mergeOnto`).  A scan that finishes after a newer scan from another sensor is too late for a time step of its own, but it still fills in later ones.  This is off by default.  It's a logic error to change it while I'm running.
+    void setInterleavingEnabled(bool enabled);
+    bool interleavingEnabled() const { return interleavingEnabled_; }
+
+    // How well the sensors' scans interleave and how evenly my time steps came, since you started me.  The sensors free-run, so only you can move their phases, by restarting one of them until the phase spread is good.
+    InterleaveMonitor::Report interleaveReport() const;
+
+    // Scans I couldn't make a time step of because they finished too late, since you started me.
+    size_t lateScanCount() const;
+
+    void setMergerParameters(TouchMerger::Parameters const &parameters) { merger_.setParameters(parameters); }
+    void setTouchTrackerParameters(TouchTracker::Parameters const &parameters) { tracker_.setParameters(parameters); }
+    void setMotionPredictorParameters(MotionPredictor::Parameters const &parameters) { predictor_.setParameters(parameters); }
+    void setDeliveryLatency(double seconds) { predictor_.setDeliveryLatency(seconds); }
+
+    // I start one thread per sensor.  It's a logic error to start me when I'm already running or when a sensor's engine isn't detecting touches.
+    void start();
+
+    // I process and merge the scans you've given me, end every touch, and stop the sensor threads.
+    void stop();
+
+    bool isRunning() const { return running_; }
+
+    // Give me every scan from sensor `sensor`, with a timestamp on the same clock as the other sensors'.  I copy the scan and return right away.  If the sensor's thread hasn't started on the sensor's previous scan yet, I replace that scan with this one and count it as dropped.  It's a logic error to send me this when I'm not running.
+    void submitScan(size_t sensor, Distance const *distances, size_t count, double timestamp);
+
+    // I wait until the sensor threads have processed every scan you've given me.
+    void waitUntilProcessed();
+
+    // I wait until the sensor threads have processed every scan you've given me, and then merge the time step they finished, even if not every sensor has a scan in it.
+    void flush();
+
+    size_t droppedScanCount() const;
+    size_t fusedStepCount() const;
+
+private:
+    TouchFusion(TouchFusion const &); // not implemented
+    TouchFusion &operator=(TouchFusion const &); // not implemented
+
+    class Sensor;
+
+    // The touches of one time step, copied while I hold `mutex_`, so I can send them to the observer after I release it.
+    struct Notification {
+        double timestamp;
+        bool hasFusedTouches; // false when I only end the tracked touches in `stop`
+        std::vector<FusedTouch> fusedTouches;
+        std::vector<TrackedTouch> trackedTouches;
+
+        Notification() : timestamp(0), hasFusedTouches(false) { }
+    };
+
+    // These run on the sensor threads, and each takes `mutex_`.
+    void publishFrame(Sensor &sensor);
+
+    // These need `mutex_`.
+    void acceptFrame(Sensor &sensor);
+    bool isFresh(Sensor const &sensor) const;
+    void fuseStep();
+    void fuseInterleavedStep(Sensor const &primary);
+    void finishStep(double timestamp);
+    Notification &queueNotification(double timestamp);
+
+    // These take `lock`, which must hold `mutex_`, and release it while the observer runs.
+    void deliverNotifications(std::unique_lock<std::mutex> &lock);
+    void waitUntilDelivered(std::unique_lock<std::mutex> &lock);
+
+    TouchFusionObserver &observer_;
+    std::vector<std::unique_ptr<Sensor> > sensors_;
+    bool running_;
+    bool interleavingEnabled_;
+    double maximumSkew_;
+
+    // Everything below belongs to whichever thread holds `mutex_`.
+    mutable std::mutex mutex_;
+    TouchMerger merger_;
+    TouchTracker tracker_;
+    MotionPredictor predictor_;
+    double lastFusedTimestamp_;
+    size_t fusedStepCount_;
+    InterleaveMonitor interleaveMonitor_;
+    size_t lateScanCount_;
+
+    // Scratch space for `fuseStep`, kept so I don't allocate for every time step.
+    std::vector<FusionFrame const *> frames_;
+    std::vector<FusedTouch> fusedTouches_;
+    std::vector<Point> fusedPoints_;
+
+    // The first `notificationCount_` of `notifications_` wait for the observer.  I keep the rest, so I don't allocate for every time step.  While `isDelivering_`, some thread is sending them without `mutex_`, and any other thread leaves its own to that thread.
+    std::vector<Notification> notifications_;
+    size_t notificationCount_;
+    bool isDelivering_;
+    std::condition_variable deliveredCondition_;
+
+    // Only the delivering thread touches this.
+    std::vector<Notification> delivering_;
+};
+
+}
+
+#endif
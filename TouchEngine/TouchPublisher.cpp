@@ -0,0 +1,336 @@
+//
+//  TouchPublisher.cpp
+//  mickeyMouse
+//
+//  Copyright (c) 2012 Rob Mayoff. All rights reserved.
+//
+
+#include "TouchPublisher.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace TouchEngine {
+
+size_t const TouchPublisher::kMaximumTouches;
+size_t const TouchPublisher::kMaximumSweeps;
+size_t const TouchPublisher::kMaximumBinaryFrameSize;
+size_t const TouchPublisher::kMaximumTUIOFrameSize;
+
+// Section byte writing
+
+namespace {
+
+// I write fields into a buffer that the caller has sized for the largest frame.  The binary encoding is little-endian and OSC is big-endian.
+class ByteWriter {
+public:
+    explicit ByteWriter(unsigned char *bytes) : start_(bytes), p_(bytes) { }
+
+    size_t size() const { return p_ - start_; }
+    unsigned char *position() const { return p_; }
+
+    void u8(uint8_t value) { *p_++ = value; }
+
+    void u16le(uint16_t value) {
+        u8(value & 0xFF);
+        u8(value >> 8);
+    }
+
+    void u32le(uint32_t value) {
+        u16le(value & 0xFFFF);
+        u16le(value >> 16);
+    }
+
+    void u64le(uint64_t value) {
+        u32le(value & 0xFFFFFFFF);
+        u32le(value >> 32);
+    }
+
+    void f32le(double value) {
+        float f = (float)value;
+        uint32_t bits;
+        memcpy(&bits, &f, sizeof bits);
+        u32le(bits);
+    }
+
+    void f64le(double value) {
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof bits);
+        u64le(bits);
+    }
+
+    void u32be(uint32_t value) {
+        u8(value >> 24);
+        u8((value >> 16) & 0xFF);
+        u8((value >> 8) & 0xFF);
+        u8(value & 0xFF);
+    }
+
+    void f32be(double value) {
+        float f = (float)value;
+        uint32_t bits;
+        memcpy(&bits, &f, sizeof bits);
+        u32be(bits);
+    }
+
+    // An OSC string: the characters, a NUL, and more NULs up to a multiple of four bytes.
+    void oscString(char const *string, size_t length) {
+        memcpy(p_, string, length);
+        p_ += length;
+        do {
+            u8(0);
+        } while (size() % 4 != 0);
+    }
+
+    void oscString(char const *string) { oscString(string, strlen(string)); }
+
+private:
+    unsigned char *start_;
+    unsigned char *p_;
+};
+
+// I write one element of an OSC bundle: its size, then its message, whose size I fill in when I'm destroyed.
+class OSCElement {
+public:
+    explicit OSCElement(ByteWriter &writer) : writer_(writer), sizeField_(writer.position()) {
+        writer_.u32be(0);
+    }
+
+    ~OSCElement() {
+        uint32_t size = (uint32_t)(writer_.position() - sizeField_ - 4);
+        ByteWriter(sizeField_).u32be(size);
+    }
+
+private:
+    ByteWriter &writer_;
+    unsigned char *sizeField_;
+};
+
+}
+
+// Section TouchPublisher
+
+TouchPublisher::Parameters::Parameters()
+    : screen(0, 0, 1920, 1080), screenYGrowsUp(false), sourceName("mickeyMouse")
+{ }
+
+TouchPublisher::TouchPublisher()
+    : unixSocket_(-1), udpSocket_(-1), sequence_(0), encodingCount_(0), truncatedCount_(0), binarySize_(0), tuioSize_(0)
+{ }
+
+TouchPublisher::~TouchPublisher() {
+    removeAllSubscribers();
+}
+
+bool TouchPublisher::addUnixSubscriber(char const *path, Encoding encoding) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof address);
+    size_t length = strlen(path);
+    if (length >= sizeof address.sun_path) {
+        errno = ENAMETOOLONG;
+        return false;
+    }
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path, path, length);
+    return addSubscriber(unixSocket_, AF_UNIX, (struct sockaddr const *)&address, (socklen_t)sizeof address, encoding);
+}
+
+bool TouchPublisher::addUDPSubscriber(uint16_t port, Encoding encoding) {
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof address);
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    return addSubscriber(udpSocket_, AF_INET, (struct sockaddr const *)&address, (socklen_t)sizeof address, encoding);
+}
+
+// I make each of my sockets when its first subscriber comes.  They're non-blocking, so a full subscriber queue drops the frame instead of stalling me.
+bool TouchPublisher::addSubscriber(int &socket, int family, struct sockaddr const *address, socklen_t addressLength, Encoding encoding) {
+    if (socket < 0) {
+        int fd = ::socket(family, SOCK_DGRAM, 0);
+        if (fd < 0)
+            return false;
+        // Some systems limit Unix-domain datagrams to the send buffer size, which can be smaller than my largest frame.
+        int bufferSize = (int)std::max(kMaximumBinaryFrameSize, kMaximumTUIOFrameSize) * 16;
+        bool ok = fcntl(fd, F_SETFL, O_NONBLOCK) == 0
+            && fcntl(fd, F_SETFD, FD_CLOEXEC) == 0
+            && setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &bufferSize, sizeof bufferSize) == 0;
+        if (!ok) {
+            int error = errno;
+            close(fd);
+            errno = error;
+            return false;
+        }
+        socket = fd;
+    }
+
+    Subscriber subscriber;
+    memset(&subscriber, 0, sizeof subscriber);
+    subscriber.socket = socket;
+    memcpy(&subscriber.address, address, addressLength);
+    subscriber.addressLength = addressLength;
+    subscriber.encoding = encoding;
+    subscribers_.push_back(subscriber);
+    return true;
+}
+
+void TouchPublisher::removeAllSubscribers() {
+    subscribers_.clear();
+    if (unixSocket_ >= 0) {
+        close(unixSocket_);
+        unixSocket_ = -1;
+    }
+    if (udpSocket_ >= 0) {
+        close(udpSocket_);
+        udpSocket_ = -1;
+    }
+}
+
+void TouchPublisher::publish(double timestamp, TrackedTouch const *touches, size_t touchCount, Point const *screenPoints, SensorTouch const *sensorTouches, size_t sweepCount) {
+    size_t keptTouches = std::min(touchCount, kMaximumTouches);
+    size_t keptSweeps = std::min(sweepCount, kMaximumSweeps);
+    truncatedCount_ += touchCount - keptTouches + sweepCount - keptSweeps;
+
+    bool encoded[2] = { false, false };
+    for (std::vector<Subscriber>::iterator s = subscribers_.begin(); s != subscribers_.end(); ++s) {
+        if (!encoded[s->encoding]) {
+            if (s->encoding == Encoding_Binary) {
+                encodeBinary(timestamp, touches, keptTouches, screenPoints, sensorTouches, keptSweeps);
+            } else {
+                encodeTUIO(touches, keptTouches);
+            }
+            encoded[s->encoding] = true;
+            ++encodingCount_;
+        }
+
+        ssize_t sent;
+        do {
+            sent = sendto(s->socket, frameBytes(s->encoding), frameSize(s->encoding), 0, (struct sockaddr const *)&s->address, s->addressLength);
+        } while (sent < 0 && errno == EINTR);
+        if (sent < 0) {
+            ++s->statistics.droppedCount;
+            s->statistics.lastError = errno;
+        } else {
+            ++s->statistics.sentCount;
+        }
+    }
+    ++sequence_;
+}
+
+void TouchPublisher::encodeBinary(double timestamp, TrackedTouch const *touches, size_t touchCount, Point const *screenPoints, SensorTouch const *sensorTouches, size_t sweepCount) {
+    ByteWriter writer(binary_);
+    writer.u8('M');
+    writer.u8('M');
+    writer.u8('T');
+    writer.u8('S');
+    writer.u16le(1);
+    writer.u16le(32);
+    writer.u16le(32);
+    writer.u16le(24);
+    writer.u32le(sequence_);
+    writer.f64le(timestamp);
+    writer.u16le((uint16_t)touchCount);
+    writer.u16le((uint16_t)sweepCount);
+    writer.u32le(0);
+
+    for (size_t i = 0; i < touchCount; ++i) {
+        TrackedTouch const &touch = touches[i];
+        writer.u32le(touch.identifier);
+        writer.u8((uint8_t)touch.phase);
+        writer.u8((uint8_t)std::min(touch.missedScans, 255u));
+        writer.u16le(0);
+        writer.f32le(touch.position.x);
+        writer.f32le(touch.position.y);
+        writer.f32le(touch.predictedPosition.x);
+        writer.f32le(touch.predictedPosition.y);
+        writer.f32le(touch.velocity.x);
+        writer.f32le(touch.velocity.y);
+    }
+
+    for (size_t i = 0; i < sweepCount; ++i) {
+        SensorTouch const &sensorTouch = sensorTouches[i];
+        writer.u32le((uint32_t)sensorTouch.rayIndex);
+        writer.u32le((uint32_t)sensorTouch.sweep.location);
+        writer.u32le((uint32_t)sensorTouch.sweep.length);
+        writer.f32le(sensorTouch.distance);
+        writer.f32le(screenPoints[i].x);
+        writer.f32le(screenPoints[i].y);
+    }
+
+    binarySize_ = writer.size();
+}
+
+void TouchPublisher::encodeTUIO(TrackedTouch const *touches, size_t touchCount) {
+    static char const kAddress[] = "/tuio/2Dcur";
+    Rect const &screen = parameters_.screen;
+    double yScale = parameters_.screenYGrowsUp ? -1 / screen.height : 1 / screen.height;
+    double yOrigin = parameters_.screenYGrowsUp ? screen.y + screen.height : screen.y;
+
+    ByteWriter writer(tuio_);
+    writer.oscString("#bundle");
+    // The OSC time tag 1 means "immediately".
+    writer.u32be(0);
+    writer.u32be(1);
+
+    {
+        OSCElement element(writer);
+        writer.oscString(kAddress);
+        writer.oscString(",ss");
+        writer.oscString("source");
+        writer.oscString(parameters_.sourceName.c_str(), std::min(parameters_.sourceName.size(), (size_t)63));
+    }
+
+    size_t aliveCount = 0;
+    for (size_t i = 0; i < touchCount; ++i) {
+        aliveCount += touches[i].phase != TouchPhase_Ended;
+    }
+
+    {
+        OSCElement element(writer);
+        writer.oscString(kAddress);
+        char typeTags[2 + kMaximumTouches];
+        typeTags[0] = ',';
+        typeTags[1] = 's';
+        memset(typeTags + 2, 'i', aliveCount);
+        writer.oscString(typeTags, 2 + aliveCount);
+        writer.oscString("alive");
+        for (size_t i = 0; i < touchCount; ++i) {
+            if (touches[i].phase != TouchPhase_Ended) {
+                writer.u32be(touches[i].identifier);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < touchCount; ++i) {
+        TrackedTouch const &touch = touches[i];
+        if (touch.phase == TouchPhase_Ended)
+            continue;
+        OSCElement element(writer);
+        writer.oscString(kAddress);
+        writer.oscString(",sifffff");
+        writer.oscString("set");
+        writer.u32be(touch.identifier);
+        writer.f32be((touch.position.x - screen.x) / screen.width);
+        writer.f32be((touch.position.y - yOrigin) * yScale);
+        writer.f32be(touch.velocity.x / screen.width);
+        writer.f32be(touch.velocity.y * yScale);
+        writer.f32be(0); // I don't estimate acceleration
+    }
+
+    {
+        OSCElement element(writer);
+        writer.oscString(kAddress);
+        writer.oscString(",si");
+        writer.oscString("fseq");
+        writer.u32be(sequence_);
+    }
+
+    tuioSize_ = writer.size();
+}
+
+}
@@ -0,0 +1,141 @@
+//
+//  TouchPublisher.h
+//  mickeyMouse
+//
+//  Copyright (c) 2012 Rob Mayoff. All rights reserved.
+//
+
+#ifndef TouchPublisher_h
+#define TouchPublisher_h
+
+#include "SweepSelection.h"
+#include "TouchEngineTypes.h"
+#include "TouchTracker.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <sys/socket.h>
+#include <vector>
+
+namespace TouchEngine {
+
+// I send the touches of every frame to other processes on the same machine, so a visualizer or an analytics process can watch the touches without owning the sensor.
+//
+// Each subscriber is a datagram socket: a Unix-domain socket path, or a UDP port on the loopback interface.  I send one datagram per frame and never wait: if a subscriber isn't there or can't keep up, I count the frame as dropped for that subscriber and move on, so a slow consumer can't stall the sensor.  Subscribers don't talk back, so you configure them, the way a TUIO tracker is told its clients' ports.
+//
+// I have two encodings.  I encode each frame at most once per encoding, however many subscribers use it, into buffers I own, so publishing doesn't allocate.
+//
+// `Encoding_Binary` has everything I know about the frame.  Every field is little-endian.  A frame is a 32-byte header, then `touchCount` touch records, then `sweepCount` sweep records:
+//
+//     header:  0 "MMTS"  4 u16 version (1)  6 u16 header size (32)  8 u16 touch record size (32)  10 u16 sweep record size (24)
+//              12 u32 sequence  16 f64 timestamp  24 u16 touchCount  26 u16 sweepCount  28 u32 reserved
+//     touch:   0 u32 identifier  4 u8 phase (0 began, 1 moved, 2 ended)  5 u8 missed scans  6 u16 reserved
+//              8 f32 x  12 f32 y  16 f32 predicted x  20 f32 predicted y  24 f32 velocity x  28 f32 velocity y
+//     sweep:   0 u32 ray index  4 u32 sweep location  8 u32 sweep length  12 f32 distance  16 f32 screen x  20 f32 screen y
+//
+// The touches are the tracked touches, oldest first, in screen points.  The sweeps are the detections of the frame's scan, which the tracker matched to the touches.  A reader should skip to the records using the sizes in the header, so I can add fields at the end of a record without breaking it.
+//
+// `Encoding_TUIO` is a TUIO 1.1 `/tuio/2Dcur` bundle (OSC over UDP), which many existing touch clients understand: `source`, `alive` with the touches that are down, `set` for each of them with its position and velocity normalized to `Parameters::screen`, and `fseq` with the sequence number.  TUIO has no room for sweeps.
+//
+// I'm not thread-safe.  Publish from one thread, or lock around me.
+class TouchPublisher {
+public:
+    enum Encoding {
+        Encoding_Binary,
+        Encoding_TUIO
+    };
+
+    // The most touches and sweeps I put in one frame.  I leave out the rest and count them in `truncatedCount`.
+    static size_t const kMaximumTouches = TouchTracker::kMaximumTracks;
+    static size_t const kMaximumSweeps = 32;
+
+    // The largest frame of each encoding.
+    static size_t const kMaximumBinaryFrameSize = 32 + kMaximumTouches * 32 + kMaximumSweeps * 24;
+    static size_t const kMaximumTUIOFrameSize = 4096;
+
+    struct Parameters {
+        // TUIO positions are fractions of this rectangle, from its top left corner.
+        Rect screen;
+
+        // Set this if y grows upward in your screen coordinates, as it does in Cocoa, so I can flip it for TUIO.
+        bool screenYGrowsUp;
+
+        // The application name in TUIO `source` messages.
+        std::string sourceName;
+
+        Parameters();
+    };
+
+    struct SubscriberStatistics {
+        size_t sentCount;
+        size_t droppedCount; // frames the subscriber wasn't there for, or couldn't take because its queue was full
+        int lastError; // the `errno` of the most recent dropped frame
+    };
+
+    TouchPublisher();
+    ~TouchPublisher();
+
+    void setParameters(Parameters const &parameters) { parameters_ = parameters; }
+    Parameters const &parameters() const { return parameters_; }
+
+    // I add a subscriber that reads datagrams from the Unix-domain socket bound at `path`, and return true.  I return false and set `errno` if `path` is too long or I can't make my socket.  The subscriber doesn't have to exist yet.
+    bool addUnixSubscriber(char const *path, Encoding encoding = Encoding_Binary);
+
+    // I add a subscriber that reads datagrams from UDP port `port` on 127.0.0.1, and return true.  I return false and set `errno` if I can't make my socket.  TUIO clients listen on port 3333 by default.
+    bool addUDPSubscriber(uint16_t port, Encoding encoding = Encoding_TUIO);
+
+    // I forget every subscriber and close my sockets.
+    void removeAllSubscribers();
+
+    size_t subscriberCount() const { return subscribers_.size(); }
+    SubscriberStatistics const &subscriberStatistics(size_t subscriber) const { return subscribers_[subscriber].statistics; }
+
+    // I send one frame to every subscriber.  `touches` are the tracked touches, like `EngineObserver::engineDidTrackTouches` gives you, and `screenPoints` and `sensorTouches` are the frame's detections, in the same order, like `Engine::detectedScreenPoints` and `Engine::detectedSensorTouches`.
+    void publish(double timestamp, TrackedTouch const *touches, size_t touchCount, Point const *screenPoints, SensorTouch const *sensorTouches, size_t sweepCount);
+
+    // The frames I've published, which is also the next frame's sequence number.
+    uint32_t frameCount() const { return sequence_; }
+
+    // How many times I've encoded a frame, summed over the encodings.
+    size_t encodingCount() const { return encodingCount_; }
+
+    // How many touches and sweeps I've left out of frames because there were too many.
+    size_t truncatedCount() const { return truncatedCount_; }
+
+    // The most recent frame I encoded in `encoding`.
+    unsigned char const *frameBytes(Encoding encoding) const { return encoding == Encoding_Binary ? binary_ : tuio_; }
+    size_t frameSize(Encoding encoding) const { return encoding == Encoding_Binary ? binarySize_ : tuioSize_; }
+
+private:
+    TouchPublisher(TouchPublisher const &); // not implemented
+    TouchPublisher &operator=(TouchPublisher const &); // not implemented
+
+    struct Subscriber {
+        int socket; // one of my sockets, which I share between subscribers
+        struct sockaddr_storage address;
+        socklen_t addressLength;
+        Encoding encoding;
+        SubscriberStatistics statistics;
+    };
+
+    bool addSubscriber(int &socket, int family, struct sockaddr const *address, socklen_t addressLength, Encoding encoding);
+    void encodeBinary(double timestamp, TrackedTouch const *touches, size_t touchCount, Point const *screenPoints, SensorTouch const *sensorTouches, size_t sweepCount);
+    void encodeTUIO(TrackedTouch const *touches, size_t touchCount);
+
+    Parameters parameters_;
+    std::vector<Subscriber> subscribers_;
+    int unixSocket_;
+    int udpSocket_;
+    uint32_t sequence_;
+    size_t encodingCount_;
+    size_t truncatedCount_;
+
+    unsigned char binary_[kMaximumBinaryFrameSize];
+    size_t binarySize_;
+    unsigned char tuio_[kMaximumTUIOFrameSize];
+    size_t tuioSize_;
+};
+
+}
+
+#endif
@@ -0,0 +1,171 @@
+//
+//  TouchTracker.cpp
+//  mickeyMouse
+//
+//  Copyright (c) 2012 Rob Mayoff. All rights reserved.
+//
+
+#include "TouchTracker.h"
+#include <algorithm>
+
+namespace TouchEngine {
+
+char const *touchPhaseName(TouchPhase phase) {
+    switch (phase) {
+        case TouchPhase_Began: return "began";
+        case TouchPhase_Moved: return "moved";
+        case TouchPhase_Ended: return "ended";
+    }
+    return "unknown";
+}
+
+size_t const TouchTracker::kMaximumTracks;
+
+TouchTracker::Parameters::Parameters()
+    : gateDistance(80), scansToBegin(2), scansToEnd(3)
+{ }
+
+TouchTracker::TouchTracker()
+    : trackCount_(0), nextIdentifier_(1), touchCount_(0)
+{ }
+
+void TouchTracker::reset() {
+    trackCount_ = 0;
+    touchCount_ = 0;
+}
+
+void TouchTracker::update(Point const *points, size_t count, double timestamp) {
+    count = std::min(count, kMaximumTracks);
+    matchPoints(points, count, timestamp);
+    touchCount_ = 0;
+
+    // Update the existing tracks, keeping them oldest first as I drop the ones that end.
+    size_t kept = 0;
+    for (size_t t = 0; t < trackCount_; ++t) {
+        Track track = tracks_[t];
+        int point = pointForTrack_[t];
+        if (point >= 0) {
+            double elapsed = timestamp - track.timestamp;
+            if (elapsed > 0) {
+                track.velocity = Point((points[point].x - track.position.x) / elapsed, (points[point].y - track.position.y) / elapsed);
+            }
+            track.position = points[point];
+            track.timestamp = timestamp;
+            track.hits = std::min(track.hits + 1, parameters_.scansToBegin);
+            track.misses = 0;
+        } else {
+            track.hits = 0;
+            ++track.misses;
+            // A track I haven't begun doesn't get any grace: it was probably a speckle.
+            if (!track.begun || track.misses >= parameters_.scansToEnd) {
+                if (track.begun) {
+                    report(track, TouchPhase_Ended);
+                }
+                continue;
+            }
+        }
+
+        if (track.begun) {
+            report(track, TouchPhase_Moved);
+        } else if (track.hits >= parameters_.scansToBegin) {
+            track.begun = true;
+            report(track, TouchPhase_Began);
+        }
+        tracks_[kept++] = track;
+    }
+    trackCount_ = kept;
+
+    // Every point I didn't match starts a new track, if I have room.
+    for (size_t p = 0; p < count && trackCount_ < kMaximumTracks; ++p) {
+        if (pointIsMatched_[p])
+            continue;
+        Track &track = tracks_[trackCount_++];
+        track.identifier = nextIdentifier_++;
+        track.position = points[p];
+        track.velocity = Point();
+        track.timestamp = timestamp;
+        track.hits = 1;
+        track.misses = 0;
+        track.begun = parameters_.scansToBegin <= 1;
+        if (track.begun) {
+            report(track, TouchPhase_Began);
+        }
+    }
+}
+
+void TouchTracker::endAllTracks() {
+    touchCount_ = 0;
+    for (size_t t = 0; t < trackCount_; ++t) {
+        if (tracks_[t].begun) {
+            report(tracks_[t], TouchPhase_Ended);
+        }
+    }
+    trackCount_ = 0;
+}
+
+namespace {
+
+struct PointXIsLess {
+    Point const *points;
+    explicit PointXIsLess(Point const *points_) : points(points_) { }
+    bool operator()(uint8_t a, uint8_t b) const { return points[a].x < points[b].x; }
+    bool operator()(uint8_t a, double x) const { return points[a].x < x; }
+};
+
+}
+
+void TouchTracker::matchPoints(Point const *points, size_t count, double timestamp) {
+    // I sort the points by x so each track only looks at the points in its gate's x range, instead of every point.
+    for (size_t p = 0; p < count; ++p) {
+        pointsByX_[p] = (uint8_t)p;
+    }
+    PointXIsLess xIsLess(points);
+    std::sort(pointsByX_, pointsByX_ + count, xIsLess);
+
+    double const gate = parameters_.gateDistance;
+    double const gateSquared = gate * gate;
+    size_t candidateCount = 0;
+    for (size_t t = 0; t < trackCount_; ++t) {
+        pointForTrack_[t] = -1;
+        // I gate around where the track should be now if it kept its velocity, so a fast finger that missed a scan still matches.
+        Track const &track = tracks_[t];
+        double elapsed = timestamp - track.timestamp;
+        Point position(track.position.x + track.velocity.x * elapsed, track.position.y + track.velocity.y * elapsed);
+        for (uint8_t const *it = std::lower_bound(pointsByX_, pointsByX_ + count, position.x - gate, xIsLess); it != pointsByX_ + count && points[*it].x <= position.x + gate; ++it) {
+            double dx = points[*it].x - position.x;
+            double dy = points[*it].y - position.y;
+            double distanceSquared = dx * dx + dy * dy;
+            if (distanceSquared <= gateSquared) {
+                Candidate &candidate = candidates_[candidateCount++];
+                candidate.distanceSquared = distanceSquared;
+                candidate.track = (uint8_t)t;
+                candidate.point = *it;
+            }
+        }
+    }
+    std::fill(pointIsMatched_, pointIsMatched_ + count, false);
+
+    std::sort(candidates_, candidates_ + candidateCount);
+    size_t matchesPossible = std::min(trackCount_, count);
+    size_t matches = 0;
+    for (size_t c = 0; c < candidateCount && matches < matchesPossible; ++c) {
+        Candidate const &candidate = candidates_[c];
+        if (pointForTrack_[candidate.track] >= 0 || pointIsMatched_[candidate.point])
+            continue;
+        pointForTrack_[candidate.track] = (int8_t)candidate.point;
+        pointIsMatched_[candidate.point] = true;
+        ++matches;
+    }
+}
+
+void TouchTracker::report(Track const &track, TouchPhase phase) {
+    TrackedTouch &touch = touches_[touchCount_++];
+    touch.identifier = track.identifier;
+    touch.phase = phase;
+    touch.position = track.position;
+    touch.predictedPosition = track.position;
+    touch.velocity = track.velocity;
+    touch.missedScans = track.misses;
+}
+
+}
@@ -0,0 +1,126 @@
+//
+//  TouchTracker.h
+//  mickeyMouse
+//
+//  Copyright (c) 2012 Rob Mayoff. All rights reserved.
+//
+
+#ifndef TouchTracker_h
+#define TouchTracker_h
+
+#include "TouchEngineTypes.h"
+#include <stdint.h>
+
+namespace TouchEngine {
+
+enum TouchPhase {
+    TouchPhase_Began, // This is the first scan I'm reporting this touch.
+    TouchPhase_Moved, // I reported this touch in the previous scan too.  Its position may not have changed.
+    TouchPhase_Ended // The touch lifted.  This is the last time I'll report its identifier.
+};
+
+char const *touchPhaseName(TouchPhase phase);
+
+// One touch that I've followed across scans.
+struct TrackedTouch {
+    uint32_t identifier; // unique for as long as I live (until it wraps around)
+    TouchPhase phase;
+    Point position; // in screen coordinates
+    Point predictedPosition; // where `MotionPredictor` expects the touch to be when its consumer sees it; the same as `position` if nothing predicted it
+    Point velocity; // in screen coordinates per second; from the last two scans that saw this touch, or filtered by `MotionPredictor`
+    unsigned missedScans; // how many scans in a row have not seen this touch; nonzero means I'm holding it across a dropout
+};
+
+// I give the touches of each scan identifiers that stay the same from scan to scan, so a consumer can tell two fingers apart and follow each one.
+//
+// I match each scan's touches to my tracks by gated global nearest neighbour: I consider every (track, touch) pair where the touch is within `gateDistance` of where the track would be if it kept its velocity, sort the pairs by distance, and take them greedily.  Gating keeps the number of pairs proportional to the number of touches unless the fingers are bunched together, so a scan costs O(n log n).  I only compute distances to the touches in each track's gate, which I find by binary search in the touches sorted by x.
+//
+// A new touch has to be seen in `scansToBegin` consecutive scans before I report it, so a speckle doesn't become a touch.  A track has to go unseen for `scansToEnd` consecutive scans before I end it, so one dropped scan doesn't lift a finger.
+//
+// I never allocate memory after I'm constructed.  I ignore touches beyond `kMaximumTracks`.
+class TouchTracker {
+public:
+    static size_t const kMaximumTracks = 32;
+
+    struct Parameters {
+        // The farthest, in screen points, a touch can move between scans and still be the same touch.
+        double gateDistance;
+
+        unsigned scansToBegin;
+        unsigned scansToEnd;
+
+        Parameters();
+    };
+
+    TouchTracker();
+
+    void setParameters(Parameters const &parameters) { parameters_ = parameters; }
+    Parameters const &parameters() const { return parameters_; }
+
+    // I forget all my tracks without ending them.
+    void reset();
+
+    // I match `points`, the touches of one scan, to my tracks and update `touches`.
+    void update(Point const *points, size_t count, double timestamp);
+
+    // I end all of my reported tracks and forget the rest.  Afterward, `touches` holds the ended touches.  Send me this when you stop sending me scans, so consumers see every touch end.
+    void endAllTracks();
+
+    // The touches I'm reporting after the most recent `update` or `endAllTracks`, oldest first.  This includes touches that just ended but not tracks I haven't begun yet.
+    TrackedTouch const *touches() const { return touches_; }
+    size_t touchCount() const { return touchCount_; }
+
+    // How many tracks I'm following, including the ones I haven't begun yet.
+    size_t trackCount() const { return trackCount_; }
+
+private:
+    TouchTracker(TouchTracker const &); // not implemented
+    TouchTracker &operator=(TouchTracker const &); // not implemented
+
+    struct Track {
+        uint32_t identifier;
+        Point position;
+        Point velocity;
+        double timestamp; // when I last saw this track
+        unsigned hits; // consecutive scans that saw this track, up to `scansToBegin`
+        unsigned misses; // consecutive scans that didn't
+        bool begun;
+    };
+
+    struct Candidate {
+        double distanceSquared;
+        uint8_t track;
+        uint8_t point;
+
+        // I break ties by track and then point so the matching doesn't depend on the sort.
+        bool operator<(Candidate const &other) const {
+            return distanceSquared != other.distanceSquared ? distanceSquared < other.distanceSquared
+                : track != other.track ? track < other.track
+                : point < other.point;
+        }
+    };
+
+    void matchPoints(Point const *points, size_t count, double timestamp);
+    void report(Track const &track, TouchPhase phase);
+
+    Parameters parameters_;
+
+    // Ordered oldest first.
+    Track tracks_[kMaximumTracks];
+    size_t trackCount_;
+    uint32_t nextIdentifier_;
+
+    // Scratch space for `update`.
+    Candidate candidates_[kMaximumTracks * kMaximumTracks];
+    uint8_t pointsByX_[kMaximumTracks];
+    int8_t pointForTrack_[kMaximumTracks];
+    bool pointIsMatched_[kMaximumTracks];
+
+    // Room for every old track ending and a full set of new ones beginning in the same scan.
+    TrackedTouch touches_[2 * kMaximumTracks];
+    size_t touchCount_;
+};
+
+}
+
+#endif
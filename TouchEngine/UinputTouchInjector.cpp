@@ -0,0 +1,330 @@
+//
+//  UinputTouchInjector.cpp
+//  mickeyMouse
+//
+//  Copyright (c) 2012 Rob Mayoff. All rights reserved.
+//
+
+#include "UinputTouchInjector.h"
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/uinput.h>
+#include <math.h>
+#include <stdexcept>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+namespace TouchEngine {
+
+// Section UinputEventSink
+
+UinputEventSink::UinputEventSink() : fd_(-1) { }
+
+UinputEventSink::~UinputEventSink() {
+    close();
+}
+
+static bool setUpAxis(int fd, uint16_t code, int maximum) {
+    struct uinput_abs_setup axis;
+    memset(&axis, 0, sizeof axis);
+    axis.code = code;
+    axis.absinfo.minimum = 0;
+    axis.absinfo.maximum = maximum;
+    return ioctl(fd, UI_ABS_SETUP, &axis) == 0;
+}
+
+bool UinputEventSink::open(char const *name, int width, int height, size_t slotCount) {
+    if (fd_ >= 0)
+        throw std::logic_error("TouchEngine::UinputEventSink received open while already open");
+
+    int fd = ::open("/dev/uinput", O_WRONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    struct uinput_setup setup;
+    memset(&setup, 0, sizeof setup);
+    strncpy(setup.name, name, UINPUT_MAX_NAME_SIZE - 1);
+    setup.id.bustype = BUS_VIRTUAL;
+
+    bool ok = ioctl(fd, UI_SET_EVBIT, EV_SYN) == 0
+        && ioctl(fd, UI_SET_EVBIT, EV_KEY) == 0
+        && ioctl(fd, UI_SET_KEYBIT, BTN_TOUCH) == 0
+        && ioctl(fd, UI_SET_EVBIT, EV_ABS) == 0
+        && ioctl(fd, UI_SET_EVBIT, EV_MSC) == 0
+        && ioctl(fd, UI_SET_MSCBIT, MSC_TIMESTAMP) == 0
+        && ioctl(fd, UI_SET_PROPBIT, INPUT_PROP_DIRECT) == 0
+        && setUpAxis(fd, ABS_X, width)
+        && setUpAxis(fd, ABS_Y, height)
+        && setUpAxis(fd, ABS_MT_SLOT, (int)slotCount - 1)
+        && setUpAxis(fd, ABS_MT_TRACKING_ID, 0xFFFF)
+        && setUpAxis(fd, ABS_MT_POSITION_X, width)
+        && setUpAxis(fd, ABS_MT_POSITION_Y, height)
+        && ioctl(fd, UI_DEV_SETUP, &setup) == 0
+        && ioctl(fd, UI_DEV_CREATE) == 0;
+    if (!ok) {
+        int error = errno;
+        ::close(fd);
+        errno = error;
+        return false;
+    }
+
+    fd_ = fd;
+    return true;
+}
+
+void UinputEventSink::close() {
+    if (fd_ < 0)
+        return;
+    ioctl(fd_, UI_DEV_DESTROY);
+    ::close(fd_);
+    fd_ = -1;
+}
+
+bool UinputEventSink::writeEvents(struct input_event const *events, size_t count) {
+    if (fd_ < 0) {
+        errno = EBADF;
+        return false;
+    }
+    size_t size = count * sizeof *events;
+    ssize_t written;
+    do {
+        written = write(fd_, events, size);
+    } while (written < 0 && errno == EINTR);
+    if (written < 0)
+        return false;
+    if ((size_t)written != size) {
+        errno = EIO;
+        return false;
+    }
+    return true;
+}
+
+// Section UinputTouchInjector
+
+size_t const UinputTouchInjector::kMaximumSlots;
+size_t const UinputTouchInjector::kMaximumFrameEvents;
+
+UinputTouchInjector::Parameters::Parameters()
+    : maximumFrameRate(0), refreshRate(0), width(1920), height(1080), slotCount(kMaximumSlots)
+{ }
+
+UinputTouchInjector::UinputTouchInjector(InputEventSink &sink)
+    : sink_(sink), refreshTime_(0), pending_(false), pendingTimestamp_(0), pendingSubmits_(0), nextTrackingID_(0), touchSent_(false), frameEventCount_(0)
+{
+    for (size_t i = 0; i < kMaximumSlots; ++i) {
+        slots_[i].inUse = false;
+    }
+    memset(&statistics_, 0, sizeof statistics_);
+    memset(frame_, 0, sizeof frame_);
+    setParameters(Parameters());
+}
+
+void UinputTouchInjector::setParameters(Parameters const &parameters) {
+    if (parameters.slotCount > kMaximumSlots)
+        throw std::logic_error("TouchEngine::UinputTouchInjector received more slots than kMaximumSlots");
+    parameters_ = parameters;
+
+    frameInterval_ = parameters_.maximumFrameRate > 0 ? 1 / parameters_.maximumFrameRate : 0;
+    if (parameters_.refreshRate > 0) {
+        // I round up with a little slack, so a maximum rate equal to the refresh rate doesn't round up to every other refresh.
+        double refreshPeriod = 1 / parameters_.refreshRate;
+        frameInterval_ = refreshPeriod * std::max(1.0, ceil(frameInterval_ / refreshPeriod - 1e-6));
+    }
+    nextFrameTime_ = -HUGE_VAL;
+}
+
+static int clampedCoordinate(double coordinate, int maximum) {
+    return (int)std::min(std::max(lround(coordinate), 0L), (long)maximum);
+}
+
+bool UinputTouchInjector::submit(TrackedTouch const *touches, size_t count, double timestamp, double now) {
+    bool changed = false;
+    for (size_t i = 0; i < count; ++i) {
+        TrackedTouch const &touch = touches[i];
+        Slot *slot = slotForIdentifier(touch.identifier);
+        if (!slot) {
+            if (touch.phase == TouchPhase_Ended)
+                continue;
+            slot = freeSlot();
+            if (!slot) {
+                ++statistics_.droppedContacts;
+                continue;
+            }
+            slot->inUse = true;
+            slot->identifier = touch.identifier;
+            slot->trackingID = -1;
+            slot->x = slot->y = -1;
+            slot->sentX = slot->sentY = -1;
+            slot->lifting = false;
+            slot->landTime = timestamp;
+            changed = true;
+        }
+        int x = clampedCoordinate(touch.predictedPosition.x, parameters_.width);
+        int y = clampedCoordinate(touch.predictedPosition.y, parameters_.height);
+        changed = changed || x != slot->x || y != slot->y || touch.phase == TouchPhase_Ended;
+        slot->x = x;
+        slot->y = y;
+        slot->lifting = slot->lifting || touch.phase == TouchPhase_Ended;
+    }
+
+    if (changed) {
+        // On refresh boundaries, a change after a quiet spell still waits for the next boundary.
+        if (!pending_ && parameters_.refreshRate > 0) {
+            nextFrameTime_ = std::max(nextFrameTime_, refreshTime_ + ceil((now - refreshTime_) / frameInterval_ - 1e-6) * frameInterval_);
+        }
+        pending_ = true;
+        pendingTimestamp_ = timestamp;
+        ++pendingSubmits_;
+    }
+    return poll(now);
+}
+
+bool UinputTouchInjector::poll(double now) {
+    // Without a frame interval, a contact that landed and lifted in one submit needs a second frame right away.
+    while (pending_ && now >= nextFrameTime_) {
+        if (!writeFrame(now))
+            return false;
+    }
+    return true;
+}
+
+bool UinputTouchInjector::liftAll(double timestamp) {
+    bool anySeen = false;
+    for (size_t i = 0; i < parameters_.slotCount; ++i) {
+        Slot &slot = slots_[i];
+        if (!slot.inUse)
+            continue;
+        if (slot.trackingID < 0) {
+            // The sink never saw this contact, so there's nothing to lift.
+            slot.inUse = false;
+        } else {
+            slot.lifting = true;
+            anySeen = true;
+        }
+    }
+    if (!anySeen && !touchSent_) {
+        pending_ = false;
+        return true;
+    }
+    pending_ = true;
+    pendingTimestamp_ = timestamp;
+    return writeFrame(timestamp);
+}
+
+UinputTouchInjector::Slot *UinputTouchInjector::slotForIdentifier(uint32_t identifier) {
+    for (size_t i = 0; i < parameters_.slotCount; ++i) {
+        if (slots_[i].inUse && slots_[i].identifier == identifier)
+            return &slots_[i];
+    }
+    return 0;
+}
+
+UinputTouchInjector::Slot *UinputTouchInjector::freeSlot() {
+    for (size_t i = 0; i < parameters_.slotCount; ++i) {
+        if (!slots_[i].inUse)
+            return &slots_[i];
+    }
+    return 0;
+}
+
+void UinputTouchInjector::append(uint16_t type, uint16_t code, int32_t value) {
+    struct input_event &event = frame_[frameEventCount_++];
+    event.type = type;
+    event.code = code;
+    event.value = value;
+}
+
+// I work on a copy of my slots and only keep it if the sink takes the frame, so a failed write leaves the changes pending for the next frame.
+bool UinputTouchInjector::writeFrame(double now) {
+    Slot slots[kMaximumSlots];
+    std::copy(slots_, slots_ + kMaximumSlots, slots);
+    int nextTrackingID = nextTrackingID_;
+    bool stillPending = false;
+    frameEventCount_ = 0;
+
+    for (size_t i = 0; i < parameters_.slotCount; ++i) {
+        Slot &slot = slots[i];
+        if (!slot.inUse)
+            continue;
+        if (slot.trackingID >= 0 && slot.lifting) {
+            append(EV_ABS, ABS_MT_SLOT, (int32_t)i);
+            append(EV_ABS, ABS_MT_TRACKING_ID, -1);
+            slot.inUse = false;
+            continue;
+        }
+        if (slot.trackingID >= 0 && slot.x == slot.sentX && slot.y == slot.sentY)
+            continue;
+        append(EV_ABS, ABS_MT_SLOT, (int32_t)i);
+        if (slot.trackingID < 0) {
+            slot.trackingID = nextTrackingID;
+            nextTrackingID = (nextTrackingID + 1) & 0xFFFF;
+            append(EV_ABS, ABS_MT_TRACKING_ID, slot.trackingID);
+            // It landed and lifted since the previous frame.  It goes down now and up in the next frame.
+            stillPending = stillPending || slot.lifting;
+        }
+        if (slot.x != slot.sentX) {
+            append(EV_ABS, ABS_MT_POSITION_X, slot.x);
+        }
+        if (slot.y != slot.sentY) {
+            append(EV_ABS, ABS_MT_POSITION_Y, slot.y);
+        }
+        slot.sentX = slot.x;
+        slot.sentY = slot.y;
+    }
+
+    Slot const *oldest = 0;
+    for (size_t i = 0; i < parameters_.slotCount; ++i) {
+        Slot const &slot = slots[i];
+        if (slot.inUse && slot.trackingID >= 0 && (!oldest || slot.landTime < oldest->landTime)) {
+            oldest = &slot;
+        }
+    }
+    bool touching = oldest != 0;
+    if (frameEventCount_ == 0 && touching == touchSent_) {
+        pending_ = stillPending;
+        return true;
+    }
+    if (touching != touchSent_) {
+        append(EV_KEY, BTN_TOUCH, touching);
+    }
+    if (oldest) {
+        append(EV_ABS, ABS_X, oldest->x);
+        append(EV_ABS, ABS_Y, oldest->y);
+    }
+    // MSC_TIMESTAMP is in microseconds and wraps.
+    append(EV_MSC, MSC_TIMESTAMP, (int32_t)(uint32_t)(int64_t)llround(pendingTimestamp_ * 1e6));
+    append(EV_SYN, SYN_REPORT, 0);
+
+    scheduleNextFrame(now);
+    if (!sink_.writeEvents(frame_, frameEventCount_)) {
+        ++statistics_.writeFailures;
+        return false;
+    }
+
+    std::copy(slots, slots + kMaximumSlots, slots_);
+    nextTrackingID_ = nextTrackingID;
+    touchSent_ = touching;
+    ++statistics_.framesWritten;
+    statistics_.eventsWritten += frameEventCount_;
+    if (pendingSubmits_ > 1) {
+        statistics_.coalescedSubmits += pendingSubmits_ - 1;
+    }
+    pendingSubmits_ = 0;
+    pending_ = stillPending;
+    return true;
+}
+
+// With a refresh rate, frames go out on the boundaries `refreshTime_ + k * frameInterval_`.  Without one, they're just `frameInterval_` apart.
+void UinputTouchInjector::scheduleNextFrame(double now) {
+    if (frameInterval_ <= 0) {
+        nextFrameTime_ = now;
+    } else if (parameters_.refreshRate > 0) {
+        nextFrameTime_ = refreshTime_ + (floor((now - refreshTime_) / frameInterval_ + 1e-6) + 1) * frameInterval_;
+    } else {
+        nextFrameTime_ = now + frameInterval_;
+    }
+}
+
+}
@@ -0,0 +1,161 @@
+//
+//  UinputTouchInjector.h
+//  mickeyMouse
+//
+//  Copyright (c) 2012 Rob Mayoff. All rights reserved.
+//
+
+#ifndef UinputTouchInjector_h
+#define UinputTouchInjector_h
+
+#include "TouchEngineTypes.h"
+#include "TouchTracker.h"
+#include <linux/input.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// This is the Linux counterpart of the app's `CGEvent` posting, so it's only in the Linux build.
+
+namespace TouchEngine {
+
+// I take the input events of one frame, ending with `SYN_REPORT`.
+class InputEventSink {
+public:
+    virtual ~InputEventSink() { }
+
+    // I deliver `events` all at once.  I return false and set `errno` if I can't.
+    virtual bool writeEvents(struct input_event const *events, size_t count) = 0;
+};
+
+// I am a multi-touch screen made with the kernel's uinput module.  X11, Wayland compositors and anything else that reads evdev see me as a direct touch device, like a built-in touch screen.
+class UinputEventSink : public InputEventSink {
+public:
+    UinputEventSink();
+
+    // I close myself if I'm open.
+    virtual ~UinputEventSink();
+
+    // I create a touch screen named `name` with `slotCount` contact slots and positions from 0 to `width` and `height` in screen points.  I return false and set `errno` if I can't open `/dev/uinput` or the kernel rejects the device.  It's a logic error to open me when I'm already open.
+    bool open(char const *name, int width, int height, size_t slotCount);
+
+    // I destroy the device, which lifts any contacts still down.
+    void close();
+
+    bool isOpen() const { return fd_ >= 0; }
+
+    // One `write`, so the kernel hands the whole frame to readers at once.
+    virtual bool writeEvents(struct input_event const *events, size_t count);
+
+private:
+    UinputEventSink(UinputEventSink const &); // not implemented
+    UinputEventSink &operator=(UinputEventSink const &); // not implemented
+
+    int fd_;
+};
+
+// I turn tracked touches into frames of the kernel's multi-touch protocol B (type B, with slots) and write each frame to an `InputEventSink` with a single `write`, ending in one `SYN_REPORT`.
+//
+// I put each contact at the touch's `predictedPosition`, like the app's pointer, to hide the sensor latency.  A frame only has what changed since the previous frame: a new contact gets a slot and a tracking ID, a moved contact gets its new position, and a lifted contact gets tracking ID -1.  Every frame also has `BTN_TOUCH` and `ABS_X`/`ABS_Y` for the oldest contact, for clients that only understand single touch, and `MSC_TIMESTAMP` with the sensor's timestamp of the touches, so clients can tell how far apart the sensor saw them.
+//
+// I can hold frames back to a maximum rate.  The sensors scan at 40 Hz, and two interleaved sensors reach 80 Hz, but a display refreshing at 60 Hz only shows one frame per refresh, and every extra frame costs a compositor wakeup.  When you tell me the display's refresh, I only send frames on refresh boundaries (a whole number of refresh periods apart), so every frame waits the same time for the next refresh and the latency is predictable.  While I'm holding a frame back, newer touches replace its positions, but I never lose a contact's landing or lifting: a contact that lands and lifts between two frames goes down in one frame and up in the next.
+//
+// I don't keep time or run a thread.  You send me touches as they come with `submit`, and call `poll` at `nextFrameTime` while `hasPendingFrame`.  Every time is in seconds on one clock of your choosing.  I don't allocate after construction.
+class UinputTouchInjector {
+public:
+    // The kernel's slots, and so the most contacts I can hold down at once.
+    static size_t const kMaximumSlots = 10;
+
+    // The events of the largest frame: four per slot, three single-touch events, the timestamp and the `SYN_REPORT`.
+    static size_t const kMaximumFrameEvents = kMaximumSlots * 4 + 5;
+
+    struct Parameters {
+        // The most frames per second I write.  0 writes a frame for every `submit`, or for every refresh if you set `refreshRate`.
+        double maximumFrameRate;
+
+        // The display's refresh rate, in Hz.  0 doesn't align frames to refreshes.
+        double refreshRate;
+
+        // The largest position, in screen points, on each axis.  I clamp positions to the screen.  Open the sink with the same size.
+        int width;
+        int height;
+
+        // How many slots the sink has, up to `kMaximumSlots`.
+        size_t slotCount;
+
+        Parameters();
+    };
+
+    struct Statistics {
+        size_t framesWritten;
+        size_t eventsWritten;
+        size_t coalescedSubmits; // submits whose touches went out in a later frame together with newer ones
+        size_t droppedContacts; // contacts I couldn't give a slot because every slot was in use
+        size_t writeFailures;
+    };
+
+    explicit UinputTouchInjector(InputEventSink &sink);
+
+    // It's a logic error to ask for more than `kMaximumSlots` slots.
+    void setParameters(Parameters const &parameters);
+    Parameters const &parameters() const { return parameters_; }
+
+    // The time between frames: the inverse of the maximum rate, rounded up to a whole number of refresh periods if you told me the refresh rate.
+    double frameInterval() const { return frameInterval_; }
+
+    // A time when the display refreshes, such as the last vertical blank, so I can send frames on the refresh boundaries.  Move it a little earlier to give the compositor time to read the frame before the refresh.
+    void setRefreshTime(double refreshTime) { refreshTime_ = refreshTime; }
+
+    // Give me every frame of tracked touches, as `TouchTracker`, `Engine` or `TouchFusion` reports them, with their timestamp.  I write a frame now if the frame interval allows, and otherwise hold the touches for `poll`.  I return false if the sink failed to write.
+    bool submit(TrackedTouch const *touches, size_t count, double timestamp, double now);
+
+    // I write the frame I'm holding if its time has come.  I return false if the sink failed to write.
+    bool poll(double now);
+
+    bool hasPendingFrame() const { return pending_; }
+    double nextFrameTime() const { return nextFrameTime_; }
+
+    // I lift every contact that's down and write the frame right away, whatever the frame interval.  Do this before you close the sink or stop sending me touches.
+    bool liftAll(double timestamp);
+
+    Statistics const &statistics() const { return statistics_; }
+
+private:
+    UinputTouchInjector(UinputTouchInjector const &); // not implemented
+    UinputTouchInjector &operator=(UinputTouchInjector const &); // not implemented
+
+    struct Slot {
+        bool inUse; // a contact holds this slot, whether or not the sink has seen it yet
+        uint32_t identifier; // the `TrackedTouch` identifier
+        int trackingID; // the sink's tracking ID, or -1 while the sink hasn't seen the contact
+        int x, y; // the position to send
+        int sentX, sentY; // the position the sink has
+        bool lifting; // the touch ended, so I'll lift it once the sink has seen it
+        double landTime; // for ordering contacts oldest first
+    };
+
+    Slot *slotForIdentifier(uint32_t identifier);
+    Slot *freeSlot();
+    bool writeFrame(double now);
+    void append(uint16_t type, uint16_t code, int32_t value);
+    void scheduleNextFrame(double now);
+
+    InputEventSink &sink_;
+    Parameters parameters_;
+    double frameInterval_;
+    double refreshTime_;
+    double nextFrameTime_;
+    bool pending_; // I have changes the sink hasn't seen
+    double pendingTimestamp_;
+    size_t pendingSubmits_;
+    int nextTrackingID_;
+    bool touchSent_; // the sink has `BTN_TOUCH` down
+    Slot slots_[kMaximumSlots];
+    Statistics statistics_;
+
+    struct input_event frame_[kMaximumFrameEvents];
+    size_t frameEventCount_;
+};
+
+}
+
+#endif
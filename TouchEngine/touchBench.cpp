@@ -0,0 +1,2993 @@
+//
+//  touchBench.cpp
+//  mickeyMouse
+//
+//  Copyright (c) 2012 Rob Mayoff. All rights reserved.
+//
+
+// I benchmark the hot paths of the touch engine on synthetic scans.  Each benchmark checks that the code it measures agrees with a simple reference before it prints any timings.
+//
+// usage: touchBench [benchmark...]
+//
+// With no arguments, I run every benchmark.
+
+#include "AffineFit.h"
+#include "BackgroundModel.h"
+#include "ChangeDetector.h"
+#include "CorrectionGrid.h"
+#include "GestureRecognizer.h"
+#include "IdlePolicy.h"
+#include "InterleaveMonitor.h"
+#include "MotionPredictor.h"
+#include "RayRegion.h"
+#include "ScanBus.h"
+#include "ScanFilter.h"
+#include "ScreenCalibration.h"
+#include "SweepClustering.h"
+#include "SweepKernel.h"
+#include "SweepSelection.h"
+#include "ThresholdCalibration.h"
+#include "TouchEngine.h"
+#include "TouchEngineTypes.h"
+#include "TouchFusion.h"
+#include "TouchPublisher.h"
+#include "TouchTracker.h"
+#include "UinputTouchInjector.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <errno.h>
+#include <fcntl.h>
+#include <functional>
+#include <math.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace TouchEngine;
+using std::vector;
+
+// Support
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// A small, fast, deterministic generator, so runs are repeatable.
+class Random {
+public:
+    explicit Random(uint64_t seed) : state_(seed * 2 + 1) { }
+
+    uint64_t next() {
+        state_ ^= state_ << 13;
+        state_ ^= state_ >> 7;
+        state_ ^= state_ << 17;
+        return state_;
+    }
+
+    // uniform in [low, high)
+    double uniform(double low, double high) { return low + (high - low) * (next() >> 11) * (1.0 / 9007199254740992.0); }
+
+    size_t below(size_t limit) { return (size_t)(next() % limit); }
+
+private:
+    uint64_t state_;
+};
+
+// Thresholds for a surface about 1.5 m away, with a few rays that never return.
+static vector<Distance> makeThresholds(size_t rayCount, Random &random) {
+    vector<Distance> thresholds(rayCount);
+    for (size_t i = 0; i < rayCount; ++i) {
+        thresholds[i] = random.below(97) == 0 ? kInvalidDistance : (Distance)(0.95 * random.uniform(1400, 1600));
+    }
+    return thresholds;
+}
+
+// A scan of the surface with `touchCount` fingers on it plus occasional single-ray speckle.
+static vector<Distance> makeScan(vector<Distance> const &thresholds, size_t touchCount, Random &random) {
+    size_t rayCount = thresholds.size();
+    vector<Distance> scan(rayCount);
+    for (size_t i = 0; i < rayCount; ++i) {
+        scan[i] = random.below(97) == 0 ? kInvalidDistance : (Distance)random.uniform(1480, 1600);
+        if (random.below(500) == 0) {
+            scan[i] = (Distance)random.uniform(200, 1300);
+        }
+    }
+    for (size_t t = 0; t < touchCount; ++t) {
+        size_t width = 3 + random.below(12);
+        size_t location = random.below(rayCount - width);
+        Distance distance = (Distance)random.uniform(300, 1300);
+        for (size_t i = location; i < location + width; ++i) {
+            scan[i] = distance + (Distance)random.uniform(-3, 3);
+        }
+    }
+    return scan;
+}
+
+// Prevents the compiler from discarding work whose result I don't otherwise use.
+static volatile size_t gSink;
+
+// I count heap allocations so a benchmark can check that the code it measures doesn't allocate.  The fusion benchmark's sensor threads allocate too, so the count is atomic.  I keep both operators out of line, because once GCC inlines one of them, it sees `malloc` paired with `operator delete` or `new` paired with `free`, and warns that they don't match.
+static std::atomic<size_t> gAllocationCount;
+
+__attribute__((noinline)) void *operator new(size_t size) {
+    ++gAllocationCount;
+    if (void *pointer = malloc(size ? size : 1))
+        return pointer;
+    throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void *pointer) noexcept {
+    free(pointer);
+}
+
+// Sweep extraction
+
+// The scalar loop the engine used before the SIMD kernel, as the reference.
+static size_t findSweepsScalarLoop(Distance const *distances, Distance const *thresholds, size_t count, SweepRange *ranges) {
+    size_t found = 0;
+    size_t begin = 0;
+    while (begin < count) {
+        if (distances[begin] < thresholds[begin]) {
+            size_t end = begin + 1;
+            while (end < count && distances[end] < thresholds[end]) {
+                ++end;
+            }
+            ranges[found++] = SweepRange(begin, end - begin);
+            begin = end;
+        } else {
+            ++begin;
+        }
+    }
+    return found;
+}
+
+static size_t findSweepsScalarMask(Distance const *distances, Distance const *thresholds, size_t count, SweepRange *ranges) {
+    uint64_t mask[ThresholdCalibration::kMaximumRayCount / kTouchedRayMaskBitsPerWord];
+    computeTouchedRayMaskScalar(distances, thresholds, count, mask);
+    return extractSweepsFromTouchedRayMask(mask, count, ranges, count);
+}
+
+static size_t findSweepsSIMDMask(Distance const *distances, Distance const *thresholds, size_t count, SweepRange *ranges) {
+    uint64_t mask[ThresholdCalibration::kMaximumRayCount / kTouchedRayMaskBitsPerWord];
+    computeTouchedRayMask(distances, thresholds, count, mask);
+    return extractSweepsFromTouchedRayMask(mask, count, ranges, count);
+}
+
+static size_t findSweepsMaskOnly(Distance const *distances, Distance const *thresholds, size_t count, SweepRange *ranges) {
+    uint64_t mask[ThresholdCalibration::kMaximumRayCount / kTouchedRayMaskBitsPerWord];
+    computeTouchedRayMask(distances, thresholds, count, mask);
+    (void)ranges;
+    return (size_t)mask[0];
+}
+
+typedef size_t (*FindSweepsFunction)(Distance const *distances, Distance const *thresholds, size_t count, SweepRange *ranges);
+
+static bool sameSweeps(SweepRange const *a, size_t aCount, SweepRange const *b, size_t bCount) {
+    if (aCount != bCount)
+        return false;
+    for (size_t i = 0; i < aCount; ++i) {
+        if (a[i].location != b[i].location || a[i].length != b[i].length)
+            return false;
+    }
+    return true;
+}
+
+static bool benchmarkSweeps() {
+    static size_t const kRayCounts[] = { 1081, 1440 };
+    static size_t const kScanCount = 256;
+    static size_t const kRepetitions = 400;
+
+    struct Candidate {
+        char const *name;
+        FindSweepsFunction function;
+    };
+    Candidate const candidates[] = {
+        { "scalar loop (old)", findSweepsScalarLoop },
+        { "scalar mask + ctz", findSweepsScalarMask },
+        { "simd mask + ctz", findSweepsSIMDMask },
+        { "simd mask only", findSweepsMaskOnly },
+    };
+
+    printf("sweeps: touched-sweep extraction, %s kernel\n", touchedRayMaskImplementation());
+
+    for (size_t r = 0; r < sizeof kRayCounts / sizeof kRayCounts[0]; ++r) {
+        size_t rayCount = kRayCounts[r];
+        Random random(rayCount);
+        vector<Distance> thresholds = makeThresholds(rayCount, random);
+        vector<vector<Distance> > scans;
+        for (size_t s = 0; s < kScanCount; ++s) {
+            scans.push_back(makeScan(thresholds, s % 11, random));
+        }
+
+        vector<SweepRange> expected(rayCount), actual(rayCount);
+        for (size_t s = 0; s < kScanCount; ++s) {
+            size_t expectedCount = findSweepsScalarLoop(scans[s].data(), thresholds.data(), rayCount, expected.data());
+            for (size_t c = 1; c < 3; ++c) {
+                size_t actualCount = candidates[c].function(scans[s].data(), thresholds.data(), rayCount, actual.data());
+                if (!sameSweeps(expected.data(), expectedCount, actual.data(), actualCount)) {
+                    fprintf(stderr, "sweeps: %s disagrees with the scalar loop on scan %zu of %zu rays\n", candidates[c].name, s, rayCount);
+                    return false;
+                }
+            }
+        }
+
+        for (size_t c = 0; c < sizeof candidates / sizeof candidates[0]; ++c) {
+            size_t total = 0;
+            double start = now();
+            for (size_t i = 0; i < kRepetitions; ++i) {
+                for (size_t s = 0; s < kScanCount; ++s) {
+                    total += candidates[c].function(scans[s].data(), thresholds.data(), rayCount, actual.data());
+                }
+            }
+            double elapsed = now() - start;
+            gSink = total;
+            printf("  %4zu rays  %-20s %8.1f ns/scan\n", rayCount, candidates[c].name, elapsed / (kRepetitions * kScanCount) * 1e9);
+        }
+    }
+    return true;
+}
+
+// Background model
+
+// A surface that drifts 40 mm farther away over `scanCount` scans with a finger held still on it.  The learned thresholds must follow the surface everywhere except under the finger.
+static bool checkBackgroundDrift(size_t rayCount) {
+    static size_t const kScanCount = 4000;
+    static float const kDrift = 40;
+    Random random(rayCount + 1);
+    vector<Distance> surface(rayCount);
+    for (size_t i = 0; i < rayCount; ++i) {
+        surface[i] = (Distance)random.uniform(1400, 1600);
+    }
+    vector<Distance> thresholds(rayCount);
+    for (size_t i = 0; i < rayCount; ++i) {
+        thresholds[i] = surface[i] * ThresholdCalibration::kThresholdScale;
+    }
+
+    BackgroundModel model;
+    BackgroundModel::Parameters parameters;
+    parameters.absorbAfterScans = 0;
+    model.setParameters(parameters);
+    model.seed(thresholds, ThresholdCalibration::kThresholdScale);
+
+    size_t const fingerBegin = rayCount / 2, fingerEnd = fingerBegin + 8;
+    vector<Distance> scan(rayCount);
+    vector<uint64_t> mask(touchedRayMaskWordCount(rayCount));
+    for (size_t s = 0; s < kScanCount; ++s) {
+        float drift = kDrift * s / kScanCount;
+        for (size_t i = 0; i < rayCount; ++i) {
+            scan[i] = surface[i] + drift + (Distance)random.uniform(-5, 5);
+        }
+        for (size_t i = fingerBegin; i < fingerEnd; ++i) {
+            scan[i] = 700;
+        }
+        computeTouchedRayMask(scan.data(), thresholds.data(), rayCount, mask.data());
+        model.update(scan.data(), rayCount, mask.data());
+        if (model.isDueToPublish()) {
+            model.computeThresholds(thresholds);
+        }
+    }
+
+    vector<float> const &means = model.means();
+    for (size_t i = 0; i < rayCount; ++i) {
+        float expected = surface[i] + kDrift;
+        bool guarded = i + parameters.guardRays >= fingerBegin && i < fingerEnd + parameters.guardRays;
+        if (guarded ? fabsf(means[i] - surface[i]) > 1 : fabsf(means[i] - expected) > 6) {
+            fprintf(stderr, "background: ray %zu of %zu learned %.1f; expected %.1f\n", i, rayCount, means[i], guarded ? surface[i] : expected);
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool benchmarkBackground() {
+    static size_t const kRayCounts[] = { 1081, 1440 };
+    static size_t const kScanCount = 256;
+    static size_t const kRepetitions = 200;
+
+    printf("background: adaptive background model\n");
+
+    for (size_t r = 0; r < sizeof kRayCounts / sizeof kRayCounts[0]; ++r) {
+        size_t rayCount = kRayCounts[r];
+        if (!checkBackgroundDrift(rayCount))
+            return false;
+
+        Random random(rayCount);
+        vector<Distance> thresholds = makeThresholds(rayCount, random);
+        vector<vector<Distance> > scans;
+        vector<vector<uint64_t> > masks;
+        for (size_t s = 0; s < kScanCount; ++s) {
+            scans.push_back(makeScan(thresholds, s % 11, random));
+            masks.push_back(vector<uint64_t>(touchedRayMaskWordCount(rayCount)));
+            computeTouchedRayMask(scans[s].data(), thresholds.data(), rayCount, masks[s].data());
+        }
+
+        BackgroundModel model;
+        model.seed(thresholds, ThresholdCalibration::kThresholdScale);
+        double start = now();
+        for (size_t i = 0; i < kRepetitions; ++i) {
+            for (size_t s = 0; s < kScanCount; ++s) {
+                model.update(scans[s].data(), rayCount, masks[s].data());
+            }
+        }
+        double elapsed = now() - start;
+        printf("  %4zu rays  %-20s %8.1f ns/scan\n", rayCount, "update", elapsed / (kRepetitions * kScanCount) * 1e9);
+
+        ThresholdCalibration calibration;
+        calibration.restore(thresholds);
+        vector<Distance> learned;
+        start = now();
+        for (size_t i = 0; i < kRepetitions; ++i) {
+            model.computeThresholds(learned);
+            calibration.publishThresholds(learned);
+        }
+        elapsed = now() - start;
+        gSink = calibration.thresholds()->size();
+        printf("  %4zu rays  %-20s %8.1f ns/publish\n", rayCount, "compute + publish", elapsed / kRepetitions * 1e9);
+    }
+    return true;
+}
+
+// Touch tracking
+
+// `fingerCount` fingers sliding around the screen at up to 1000 points per second, with a little jitter, each missing from one scan in 50 (but never two in a row).  I check that each finger keeps one identifier from the scan it begins until it lifts at the end.
+static bool benchmarkTrackerWithFingers(size_t fingerCount) {
+    static size_t const kScanCount = 4000;
+    static double const kScanInterval = 0.025;
+    Random random(fingerCount);
+
+    // Each finger swings up and down its own lane, so it speeds up and slows down smoothly like a real hand.
+    vector<double> amplitudes(fingerCount), frequencies(fingerCount), phases(fingerCount);
+    for (size_t f = 0; f < fingerCount; ++f) {
+        amplitudes[f] = random.uniform(100, 450);
+        frequencies[f] = 1000 / amplitudes[f] * random.uniform(0.5, 1);
+        phases[f] = random.uniform(0, 2 * M_PI);
+    }
+
+    vector<vector<Point> > scans(kScanCount);
+    vector<vector<size_t> > fingersOfScans(kScanCount);
+    vector<bool> missedPreviousScan(fingerCount, false);
+    for (size_t s = 0; s < kScanCount; ++s) {
+        for (size_t f = 0; f < fingerCount; ++f) {
+            bool missed = s > 0 && !missedPreviousScan[f] && random.below(50) == 0;
+            missedPreviousScan[f] = missed;
+            if (missed)
+                continue;
+            double x = (f + 0.5) * 1920.0 / fingerCount;
+            double y = 540 + amplitudes[f] * sin(frequencies[f] * s * kScanInterval + phases[f]);
+            scans[s].push_back(Point(x + random.uniform(-2, 2), y + random.uniform(-2, 2)));
+            fingersOfScans[s].push_back(f);
+        }
+    }
+
+    TouchTracker tracker;
+    vector<uint32_t> identifiers(fingerCount, 0);
+    for (size_t s = 0; s < kScanCount; ++s) {
+        tracker.update(scans[s].data(), scans[s].size(), s * kScanInterval);
+        for (size_t i = 0; i < tracker.touchCount(); ++i) {
+            TrackedTouch const &touch = tracker.touches()[i];
+            if (touch.phase == TouchPhase_Ended) {
+                fprintf(stderr, "tracker: touch %u ended at scan %zu with %zu fingers down\n", touch.identifier, s, fingerCount);
+                return false;
+            }
+            // A touch I'm holding across a dropout isn't in this scan.
+            if (touch.missedScans > 0)
+                continue;
+            size_t point = 0;
+            while (point < scans[s].size() && (scans[s][point].x != touch.position.x || scans[s][point].y != touch.position.y)) {
+                ++point;
+            }
+            if (point == scans[s].size()) {
+                fprintf(stderr, "tracker: touch %u at scan %zu isn't any point of the scan\n", touch.identifier, s);
+                return false;
+            }
+            size_t nearest = fingersOfScans[s][point];
+            if (touch.phase == TouchPhase_Began ? identifiers[nearest] != 0 : identifiers[nearest] != touch.identifier) {
+                fprintf(stderr, "tracker: finger %zu of %zu changed identifier at scan %zu\n", nearest, fingerCount, s);
+                return false;
+            }
+            identifiers[nearest] = touch.identifier;
+        }
+    }
+    tracker.endAllTracks();
+    if (tracker.touchCount() != fingerCount) {
+        fprintf(stderr, "tracker: ended %zu touches; expected %zu\n", tracker.touchCount(), fingerCount);
+        return false;
+    }
+
+    static size_t const kRepetitions = 25;
+    size_t allocationsBefore = gAllocationCount;
+    size_t total = 0;
+    double start = now();
+    for (size_t r = 0; r < kRepetitions; ++r) {
+        tracker.reset();
+        for (size_t s = 0; s < kScanCount; ++s) {
+            tracker.update(scans[s].data(), scans[s].size(), s * kScanInterval);
+            total += tracker.touchCount();
+        }
+    }
+    double elapsed = now() - start;
+    gSink = total;
+    if (gAllocationCount != allocationsBefore) {
+        fprintf(stderr, "tracker: allocated %zu times while tracking\n", gAllocationCount.load() - allocationsBefore);
+        return false;
+    }
+    printf("  %4zu fingers  %8.1f ns/scan\n", fingerCount, elapsed / (kRepetitions * kScanCount) * 1e9);
+    return true;
+}
+
+static bool benchmarkTracker() {
+    static size_t const kFingerCounts[] = { 1, 2, 5, 10, 20, 32 };
+    printf("tracker: multi-touch tracking\n");
+    for (size_t i = 0; i < sizeof kFingerCounts / sizeof kFingerCounts[0]; ++i) {
+        if (!benchmarkTrackerWithFingers(kFingerCounts[i]))
+            return false;
+    }
+    return true;
+}
+
+// Motion prediction
+
+// A finger scribbling around the screen at up to about 3000 points per second.
+static Point fingerPosition(double t) {
+    return Point(960 + 400 * sin(2 * M_PI * 0.7 * t) + 150 * sin(2 * M_PI * 1.9 * t + 1),
+        540 + 300 * sin(2 * M_PI * 0.5 * t + 2) + 100 * sin(2 * M_PI * 2.3 * t));
+}
+
+// How far, RMS, the positions a consumer saw were from where the finger really was at that moment.
+static double rmsErrorAtDelivery(vector<double> const &deliveryTimes, vector<Point> const &seen) {
+    double sum = 0;
+    for (size_t i = 0; i < seen.size(); ++i) {
+        Point truth = fingerPosition(deliveryTimes[i]);
+        double dx = seen[i].x - truth.x, dy = seen[i].y - truth.y;
+        sum += dx * dx + dy * dy;
+    }
+    return sqrt(sum / seen.size());
+}
+
+// I find the delay that best explains the positions a consumer saw: the `lag` for which `fingerPosition(deliveryTimes[i] - lag)` is closest to `seen[i]`, in the RMS sense.  A perfect predictor has zero lag.
+static double effectiveLag(vector<double> const &deliveryTimes, vector<Point> const &seen) {
+    double bestLag = 0;
+    double bestError = HUGE_VAL;
+    for (double lag = -0.050; lag <= 0.100; lag += 0.0005) {
+        double sum = 0;
+        for (size_t i = 0; i < seen.size(); ++i) {
+            Point truth = fingerPosition(deliveryTimes[i] - lag);
+            double dx = seen[i].x - truth.x, dy = seen[i].y - truth.y;
+            sum += dx * dx + dy * dy;
+        }
+        double error = sqrt(sum / seen.size());
+        if (error < bestError) {
+            bestError = error;
+            bestLag = lag;
+        }
+    }
+    return bestLag;
+}
+
+static bool benchmarkPrediction() {
+    static double const kScanInterval = 0.025;
+    static size_t const kScanCount = 4000;
+    // The sensor sees the finger half a scan before the scan's timestamp, and the consumer sees the touch this long after it.
+    static double const kSensorLatency = 0.0125;
+    static double const kDeliveryLatencies[] = { 0.005, 0.015, 0.030 };
+
+    printf("prediction: latency hiding for one finger at 40 Hz with 2-point position noise\n");
+    for (size_t l = 0; l < sizeof kDeliveryLatencies / sizeof kDeliveryLatencies[0]; ++l) {
+        double deliveryLatency = kDeliveryLatencies[l];
+        Random random(l + 1);
+        TouchTracker tracker;
+        MotionPredictor predictor;
+        MotionPredictor::Parameters parameters;
+        parameters.sensorLatency = kSensorLatency;
+        predictor.setParameters(parameters);
+        predictor.setDeliveryLatency(deliveryLatency);
+
+        vector<double> deliveryTimes;
+        vector<Point> rawPositions, predictedPositions;
+        for (size_t s = 0; s < kScanCount; ++s) {
+            double timestamp = s * kScanInterval;
+            Point truth = fingerPosition(timestamp - kSensorLatency);
+            Point measured(truth.x + random.uniform(-2, 2) * 1.7, truth.y + random.uniform(-2, 2) * 1.7);
+            tracker.update(&measured, 1, timestamp);
+            predictor.update(tracker.touches(), tracker.touchCount(), timestamp);
+            // Skip the first second, while the filter settles.
+            if (timestamp < 1 || predictor.touchCount() != 1)
+                continue;
+            deliveryTimes.push_back(timestamp + deliveryLatency);
+            rawPositions.push_back(predictor.touches()[0].position);
+            predictedPositions.push_back(predictor.touches()[0].predictedPosition);
+        }
+
+        double rawLag = effectiveLag(deliveryTimes, rawPositions);
+        double predictedLag = effectiveLag(deliveryTimes, predictedPositions);
+        printf("  latency %4.1f ms  raw: lag %5.1f ms, error %5.1f pt  predicted: lag %5.1f ms, error %5.1f pt\n",
+            (kSensorLatency + deliveryLatency) * 1e3, rawLag * 1e3, rmsErrorAtDelivery(deliveryTimes, rawPositions), predictedLag * 1e3, rmsErrorAtDelivery(deliveryTimes, predictedPositions));
+        if (fabs(predictedLag) >= fabs(rawLag)) {
+            fprintf(stderr, "prediction: predicting didn't reduce the lag\n");
+            return false;
+        }
+    }
+    return true;
+}
+
+// Screen mapping
+
+// What `ScreenCalibration` did before it had ray tables.
+static Point screenPointByTrig(AffineTransform const &transform, double radiansPerRay, size_t rayIndex, Distance distance) {
+    double radians = rayIndex * radiansPerRay;
+    return transform.apply(Point(distance * cos(radians), distance * sin(radians)));
+}
+
+static bool benchmarkMapping() {
+    static size_t const kRayCount = 1081;
+    static size_t const kPointCount = 4096;
+    static size_t const kRepetitions = 2000;
+
+    printf("mapping: ray and distance to screen point\n");
+
+    ScreenCalibration calibration;
+    calibration.setGeometry(SensorGeometry(kRayCount, 270));
+    vector<Point> sensorPoints, screenPoints;
+    sensorPoints.push_back(Point(-600, 900));
+    sensorPoints.push_back(Point(700, 1000));
+    sensorPoints.push_back(Point(-50, 1600));
+    screenPoints.push_back(Point(200, 300));
+    screenPoints.push_back(Point(1700, 250));
+    screenPoints.push_back(Point(900, 1000));
+    calibration.restore(sensorPoints, screenPoints);
+    if (!calibration.isReady()) {
+        fprintf(stderr, "mapping: calibration isn't ready\n");
+        return false;
+    }
+
+    Random random(kRayCount);
+    vector<size_t> rays(kPointCount);
+    vector<Distance> distances(kPointCount);
+    for (size_t i = 0; i < kPointCount; ++i) {
+        rays[i] = random.below(kRayCount);
+        distances[i] = (Distance)random.uniform(100, 4000);
+    }
+
+    AffineTransform const &transform = calibration.transform();
+    double const radiansPerRay = calibration.radiansPerRay();
+    double maximumError = 0;
+    for (size_t i = 0; i < kPointCount; ++i) {
+        Point expected = screenPointByTrig(transform, radiansPerRay, rays[i], distances[i]);
+        Point actual = calibration.screenPointForRay(rays[i], distances[i]);
+        maximumError = std::max(maximumError, std::max(fabs(expected.x - actual.x), fabs(expected.y - actual.y)));
+    }
+    if (maximumError > 1e-6) {
+        fprintf(stderr, "mapping: ray table is off by %g points\n", maximumError);
+        return false;
+    }
+
+    double sum = 0;
+    double start = now();
+    for (size_t r = 0; r < kRepetitions; ++r) {
+        for (size_t i = 0; i < kPointCount; ++i) {
+            Point point = screenPointByTrig(transform, radiansPerRay, rays[i], distances[i]);
+            sum += point.x + point.y;
+        }
+    }
+    double trigElapsed = now() - start;
+
+    start = now();
+    for (size_t r = 0; r < kRepetitions; ++r) {
+        for (size_t i = 0; i < kPointCount; ++i) {
+            Point point = calibration.screenPointForRay(rays[i], distances[i]);
+            sum += point.x + point.y;
+        }
+    }
+    double tableElapsed = now() - start;
+    gSink = (size_t)sum;
+
+    double const pointCount = (double)kRepetitions * kPointCount;
+    printf("  %-20s %8.2f ns/point\n", "cos/sin + transform", trigElapsed / pointCount * 1e9);
+    printf("  %-20s %8.2f ns/point\n", "ray table", tableElapsed / pointCount * 1e9);
+    printf("  %-20s %8.2e points\n", "largest difference", maximumError);
+    return true;
+}
+
+// Touch calibration fitting
+
+static double transformDifference(AffineTransform const &x, AffineTransform const &y) {
+    // The coefficients multiply sensor coordinates of a few thousand millimeters, so I weigh their differences accordingly.
+    double linear = std::max(std::max(fabs(x.a - y.a), fabs(x.b - y.b)), std::max(fabs(x.c - y.c), fabs(x.d - y.d))) * 4000;
+    return std::max(linear, std::max(fabs(x.tx - y.tx), fabs(x.ty - y.ty)));
+}
+
+static bool benchmarkFit() {
+    static size_t const kRayCount = 1081;
+    static size_t const kRepetitions = 100000;
+
+    printf("fit: touch calibration by recursive least squares\n");
+
+    AffineTransform truth;
+    truth.a = 0.52;
+    truth.b = -0.07;
+    truth.c = 0.05;
+    truth.d = -0.49;
+    truth.tx = 960;
+    truth.ty = 1100;
+
+    // Three exact touches determine the transform.
+    AffineFit fit;
+    Point const sensorPoints[] = { Point(-600, 900), Point(700, 1000), Point(-50, 1600) };
+    for (size_t i = 0; i < 3; ++i) {
+        fit.add(sensorPoints[i], truth.apply(sensorPoints[i]));
+    }
+    AffineTransform solved;
+    if (!fit.solve(solved) || transformDifference(solved, truth) > 1e-6) {
+        fprintf(stderr, "fit: three exact touches don't give the transform\n");
+        return false;
+    }
+
+    // Collinear touches don't.
+    AffineFit collinear;
+    for (size_t i = 0; i < 3; ++i) {
+        Point sensorPoint(100 * i, 900 + 50 * i);
+        collinear.add(sensorPoint, truth.apply(sensorPoint));
+    }
+    if (collinear.solve(solved)) {
+        fprintf(stderr, "fit: collinear touches gave a transform\n");
+        return false;
+    }
+
+    // Refining with noisy everyday touches converges on the transform.
+    Random random(kRayCount);
+    ScreenCalibration calibration;
+    calibration.setGeometry(SensorGeometry(kRayCount, 270));
+    AffineTransform rough = truth;
+    rough.tx += 15;
+    rough.a *= 1.03;
+    vector<Point> roughSensorPoints(sensorPoints, sensorPoints + 3), roughScreenPoints;
+    for (size_t i = 0; i < 3; ++i) {
+        roughScreenPoints.push_back(rough.apply(sensorPoints[i]));
+    }
+    calibration.restore(roughSensorPoints, roughScreenPoints);
+    double roughError = transformDifference(calibration.transform(), truth);
+    for (size_t i = 0; i < 2000; ++i) {
+        Point sensorPoint(random.uniform(-1500, 1500), random.uniform(300, 2500));
+        Point intended = truth.apply(sensorPoint);
+        Point reported = calibration.transform().apply(Point(sensorPoint.x + random.uniform(-8, 8), sensorPoint.y + random.uniform(-8, 8)));
+        calibration.refine(reported, intended, 0.1);
+    }
+    double refinedError = transformDifference(calibration.transform(), truth);
+    printf("  error of calibration %6.2f pt before refining, %6.2f pt after 2000 touches\n", roughError, refinedError);
+    if (refinedError >= roughError) {
+        fprintf(stderr, "fit: refining didn't improve the calibration\n");
+        return false;
+    }
+
+    double start = now();
+    for (size_t i = 0; i < kRepetitions; ++i) {
+        fit.add(Point(i % 1000, 1000 + i % 700), Point(i % 300, i % 500), 0.01);
+        fit.solve(solved);
+    }
+    double elapsed = now() - start;
+    gSink = (size_t)solved.tx;
+    printf("  %-24s %8.1f ns/touch\n", "add + solve", elapsed / kRepetitions * 1e9);
+
+    start = now();
+    for (size_t i = 0; i < kRepetitions / 100; ++i) {
+        Point reported = calibration.transform().apply(Point(i % 1000, 1000 + i % 700));
+        calibration.refine(reported, reported, 0.01);
+    }
+    elapsed = now() - start;
+    printf("  %-24s %8.1f ns/touch\n", "refine with ray table", elapsed / (kRepetitions / 100) * 1e9);
+    return true;
+}
+
+// Non-linear correction
+
+// A sensor mounted with a tilt, seen through a little barrel distortion: a projective transform plus a radial term.  The errors an affine fit leaves grow toward the corners.
+static Point distortedScreenPoint(Point sensorPoint) {
+    double x = sensorPoint.x / 1000;
+    double y = (sensorPoint.y - 1200) / 1000;
+    double w = 1 + 0.08 * x + 0.12 * y;
+    double radial = 1 + 0.03 * (x * x + y * y);
+    return Point(960 + 900 * x * radial / w, 600 - 800 * y * radial / w);
+}
+
+static bool benchmarkCorrection() {
+    static size_t const kGridSides[] = { 3, 4, 5 };
+    static size_t const kTestPointCount = 20000;
+    static size_t const kRepetitions = 200;
+    static double const kTouchNoise = 2;
+
+    printf("correction: non-linear touch mapping (thin-plate spline grid) against affine\n");
+
+    Random random(38);
+    vector<Point> testSensorPoints(kTestPointCount);
+    for (size_t i = 0; i < kTestPointCount; ++i) {
+        testSensorPoints[i] = Point(random.uniform(-950, 950), random.uniform(550, 1850));
+    }
+
+    for (size_t g = 0; g < sizeof kGridSides / sizeof kGridSides[0]; ++g) {
+        size_t side = kGridSides[g];
+        // The user touches a side x side lattice of targets inset from the edges, a few points off each time.
+        vector<Point> sensorPoints, screenPoints;
+        for (size_t row = 0; row < side; ++row) {
+            for (size_t column = 0; column < side; ++column) {
+                Point sensorPoint(-850 + 1700.0 * column / (side - 1), 650 + 1100.0 * row / (side - 1));
+                Point screenPoint = distortedScreenPoint(sensorPoint);
+                sensorPoints.push_back(sensorPoint);
+                screenPoints.push_back(Point(screenPoint.x + random.uniform(-kTouchNoise, kTouchNoise), screenPoint.y + random.uniform(-kTouchNoise, kTouchNoise)));
+            }
+        }
+
+        AffineFit fit;
+        for (size_t i = 0; i < sensorPoints.size(); ++i) {
+            fit.add(sensorPoints[i], screenPoints[i]);
+        }
+        AffineTransform affine;
+        fit.solve(affine);
+        CorrectionGrid grid;
+        if (sensorPoints.size() >= CorrectionGrid::kMinimumTouches) {
+            double start = now();
+            if (!grid.build(sensorPoints, screenPoints, CorrectionGrid::kDefaultSmoothing)) {
+                fprintf(stderr, "correction: the spline through %zu touches failed\n", sensorPoints.size());
+                return false;
+            }
+            printf("  %2zu touches  build %.2f ms\n", sensorPoints.size(), (now() - start) * 1e3);
+        } else if (grid.build(sensorPoints, screenPoints, CorrectionGrid::kDefaultSmoothing)) {
+            fprintf(stderr, "correction: built a grid from only %zu touches\n", sensorPoints.size());
+            return false;
+        }
+
+        double affineSum = 0, affineWorst = 0, gridSum = 0, gridWorst = 0;
+        for (size_t i = 0; i < kTestPointCount; ++i) {
+            Point truth = distortedScreenPoint(testSensorPoints[i]);
+            Point byAffine = affine.apply(testSensorPoints[i]);
+            double affineError = hypot(byAffine.x - truth.x, byAffine.y - truth.y);
+            affineSum += affineError * affineError;
+            affineWorst = std::max(affineWorst, affineError);
+            if (!grid.isEmpty()) {
+                Point byGrid = grid.screenPointForSensorPoint(testSensorPoints[i]);
+                double gridError = hypot(byGrid.x - truth.x, byGrid.y - truth.y);
+                gridSum += gridError * gridError;
+                gridWorst = std::max(gridWorst, gridError);
+            }
+        }
+        printf("  %2zu touches  affine: rms %5.1f pt, worst %5.1f pt", sensorPoints.size(), sqrt(affineSum / kTestPointCount), affineWorst);
+        if (grid.isEmpty()) {
+            printf("  grid: too few touches\n");
+            continue;
+        }
+        printf("  grid: rms %5.1f pt, worst %5.1f pt\n", sqrt(gridSum / kTestPointCount), gridWorst);
+        if (gridSum >= affineSum) {
+            fprintf(stderr, "correction: the grid is no more accurate than the affine transform\n");
+            return false;
+        }
+
+        double sum = 0;
+        double start = now();
+        for (size_t r = 0; r < kRepetitions; ++r) {
+            for (size_t i = 0; i < kTestPointCount; ++i) {
+                Point point = affine.apply(testSensorPoints[i]);
+                sum += point.x + point.y;
+            }
+        }
+        double affineElapsed = now() - start;
+        start = now();
+        for (size_t r = 0; r < kRepetitions; ++r) {
+            for (size_t i = 0; i < kTestPointCount; ++i) {
+                Point point = grid.screenPointForSensorPoint(testSensorPoints[i]);
+                sum += point.x + point.y;
+            }
+        }
+        double gridElapsed = now() - start;
+        gSink = (size_t)sum;
+        double const lookups = (double)kRepetitions * kTestPointCount;
+        printf("  %2zu touches  affine %.2f ns/lookup, grid %.2f ns/lookup\n", sensorPoints.size(), affineElapsed / lookups * 1e9, gridElapsed / lookups * 1e9);
+    }
+    return true;
+}
+
+// Temporal scan filter
+
+// A moving average over the valid distances, to compare against the median.
+static void averageScans(vector<vector<Distance> > const &history, size_t newest, size_t length, Distance *averages) {
+    size_t rayCount = history[0].size();
+    for (size_t i = 0; i < rayCount; ++i) {
+        double sum = 0;
+        size_t valid = 0;
+        for (size_t k = 0; k < length && k <= newest; ++k) {
+            Distance distance = history[newest - k][i];
+            if (isValidDistance(distance)) {
+                sum += distance;
+                ++valid;
+            }
+        }
+        averages[i] = valid ? (Distance)(sum / valid) : kInvalidDistance;
+    }
+}
+
+static bool checkScanMedians(size_t rayCount) {
+    Random random(rayCount);
+    vector<vector<Distance> > scans(5, vector<Distance>(rayCount));
+    for (size_t k = 0; k < 5; ++k) {
+        for (size_t i = 0; i < rayCount; ++i) {
+            // Plenty of ties and invalid distances, which are where a min/max network could go wrong.
+            scans[k][i] = random.below(7) == 0 ? kInvalidDistance : (Distance)(random.below(8) * 100);
+        }
+    }
+    Distance const *rows[5] = { scans[0].data(), scans[1].data(), scans[2].data(), scans[3].data(), scans[4].data() };
+    vector<Distance> medians(rayCount), scalarMedians(rayCount);
+    for (size_t length = 3; length <= 5; length += 2) {
+        computeScanMedians(rows, length, rayCount, medians.data());
+        computeScanMediansScalar(rows, length, rayCount, scalarMedians.data());
+        for (size_t i = 0; i < rayCount; ++i) {
+            Distance sorted[5];
+            for (size_t k = 0; k < length; ++k) {
+                sorted[k] = rows[k][i];
+            }
+            std::sort(sorted, sorted + length);
+            if (medians[i] != sorted[length / 2] || scalarMedians[i] != sorted[length / 2]) {
+                fprintf(stderr, "filter: wrong %zu-scan median at ray %zu of %zu\n", length, i, rayCount);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Two fingers land at scan 100 and lift at scan 300, on a surface 5% beyond its thresholds with one- and two-ray speckle in one scan in four.  I count the touched sweeps that aren't the fingers, and how many scans late the fingers show up.
+static void measurePhantoms(char const *name, size_t mode, size_t length) {
+    static size_t const kRayCount = 1081;
+    static size_t const kScanCount = 2000;
+    static size_t const kFingerRays[2][2] = { { 300, 310 }, { 700, 706 } };
+    Random random(39);
+    vector<Distance> surface(kRayCount), thresholds(kRayCount);
+    for (size_t i = 0; i < kRayCount; ++i) {
+        surface[i] = (Distance)random.uniform(1400, 1600);
+        thresholds[i] = 0.95f * surface[i];
+    }
+
+    vector<vector<Distance> > history;
+    ScanFilter filter;
+    filter.setLength(mode == 1 ? length : 1);
+    vector<Distance> averages(kRayCount);
+    vector<uint64_t> mask(touchedRayMaskWordCount(kRayCount));
+    SweepRange sweeps[kRayCount / 2 + 1];
+    size_t phantoms = 0;
+    size_t firstSeen = 0;
+    for (size_t s = 0; s < kScanCount; ++s) {
+        size_t cycle = s % 400;
+        bool fingersDown = cycle >= 100 && cycle < 300;
+        history.push_back(surface);
+        vector<Distance> &scan = history.back();
+        for (size_t i = 0; i < kRayCount; ++i) {
+            scan[i] = random.below(97) == 0 ? kInvalidDistance : scan[i] + (Distance)random.uniform(-10, 10);
+        }
+        if (random.below(4) == 0) {
+            size_t ray = random.below(kRayCount - 1);
+            Distance distance = (Distance)random.uniform(200, 1300);
+            scan[ray] = distance;
+            if (random.below(2) == 0) {
+                scan[ray + 1] = distance;
+            }
+        }
+        if (fingersDown) {
+            for (size_t f = 0; f < 2; ++f) {
+                for (size_t i = kFingerRays[f][0]; i < kFingerRays[f][1]; ++i) {
+                    scan[i] = 900 + (Distance)random.uniform(-3, 3);
+                }
+            }
+        }
+
+        Distance const *filtered = scan.data();
+        if (mode == 1) {
+            filtered = filter.filter(scan.data(), kRayCount);
+        } else if (mode == 2) {
+            averageScans(history, s, length, averages.data());
+            filtered = averages.data();
+        }
+        computeTouchedRayMask(filtered, thresholds.data(), kRayCount, mask.data());
+        size_t count = extractSweepsFromTouchedRayMask(mask.data(), kRayCount, sweeps, kRayCount / 2 + 1);
+        bool sawFinger = false;
+        for (size_t i = 0; i < count; ++i) {
+            bool isFinger = false;
+            for (size_t f = 0; f < 2; ++f) {
+                isFinger = isFinger || (sweeps[i].location < kFingerRays[f][1] && sweeps[i].end() > kFingerRays[f][0]);
+            }
+            sawFinger = sawFinger || isFinger;
+            phantoms += !isFinger;
+        }
+        if (cycle == 100) {
+            firstSeen = 0;
+        }
+        if (fingersDown && sawFinger && firstSeen == 0) {
+            firstSeen = cycle - 100 + 1;
+        }
+    }
+    printf("  %-14s %6.2f phantom sweeps per 100 scans, fingers show up %zu scan(s) late\n", name, phantoms * 100.0 / kScanCount, firstSeen - 1);
+}
+
+static bool benchmarkFilter() {
+    static size_t const kRayCounts[] = { 1081, 1440 };
+    static size_t const kRepetitions = 20000;
+
+    printf("filter: temporal median of each ray before thresholding\n");
+    for (size_t r = 0; r < sizeof kRayCounts / sizeof kRayCounts[0]; ++r) {
+        size_t rayCount = kRayCounts[r];
+        if (!checkScanMedians(rayCount))
+            return false;
+
+        Random random(rayCount);
+        vector<Distance> thresholds = makeThresholds(rayCount, random);
+        vector<vector<Distance> > scans;
+        for (size_t k = 0; k < 5; ++k) {
+            scans.push_back(makeScan(thresholds, 2, random));
+        }
+        Distance const *rows[5] = { scans[0].data(), scans[1].data(), scans[2].data(), scans[3].data(), scans[4].data() };
+        vector<Distance> medians(rayCount);
+        for (size_t length = 3; length <= 5; length += 2) {
+            double start = now();
+            for (size_t i = 0; i < kRepetitions; ++i) {
+                computeScanMediansScalar(rows, length, rayCount, medians.data());
+                gSink = (size_t)medians[i % rayCount];
+            }
+            double scalarElapsed = now() - start;
+            start = now();
+            for (size_t i = 0; i < kRepetitions; ++i) {
+                computeScanMedians(rows, length, rayCount, medians.data());
+                gSink = (size_t)medians[i % rayCount];
+            }
+            double simdElapsed = now() - start;
+            printf("  %4zu rays  median of %zu  scalar %8.1f ns/scan  simd %8.1f ns/scan\n", rayCount, length, scalarElapsed / kRepetitions * 1e9, simdElapsed / kRepetitions * 1e9);
+        }
+
+        ScanFilter filter;
+        filter.setLength(3);
+        double start = now();
+        for (size_t i = 0; i < kRepetitions; ++i) {
+            gSink = (size_t)filter.filter(scans[i % 5].data(), rayCount)[i % rayCount];
+        }
+        printf("  %4zu rays  ScanFilter(3) including the history copy %8.1f ns/scan\n", rayCount, (now() - start) / kRepetitions * 1e9);
+    }
+
+    measurePhantoms("unfiltered", 0, 1);
+    measurePhantoms("average of 3", 2, 3);
+    measurePhantoms("median of 3", 1, 3);
+    measurePhantoms("median of 5", 1, 5);
+    return true;
+}
+
+// Sweep clustering
+
+struct Finger {
+    Point center; // sensor coordinates
+    double radius;
+};
+
+// A scan of a flat surface `background` mm away with round fingers on it, each ray stopping at the nearest finger it hits, plus a millimeter or two of range noise.
+static vector<Distance> scanFingers(SensorGeometry const &geometry, vector<Finger> const &fingers, Random &random, double background = 1500) {
+    vector<Distance> scan(geometry.rayCount);
+    double radiansPerRay = geometry.radiansPerRay();
+    for (size_t i = 0; i < geometry.rayCount; ++i) {
+        double dx = cos(i * radiansPerRay);
+        double dy = sin(i * radiansPerRay);
+        double nearest = background;
+        for (size_t f = 0; f < fingers.size(); ++f) {
+            double along = fingers[f].center.x * dx + fingers[f].center.y * dy;
+            double across = fingers[f].center.x * dy - fingers[f].center.y * dx;
+            double halfChord = fingers[f].radius * fingers[f].radius - across * across;
+            if (along > 0 && halfChord >= 0) {
+                nearest = std::min(nearest, along - sqrt(halfChord));
+            }
+        }
+        scan[i] = (Distance)(nearest + random.uniform(-1.5, 1.5));
+    }
+    return scan;
+}
+
+static Point polarPoint(double distance, double radians) {
+    return Point(distance * cos(radians), distance * sin(radians));
+}
+
+static bool benchmarkClustering() {
+    static size_t const kScanCount = 200;
+    static size_t const kRepetitions = 200;
+    SensorGeometry const geometry(1081, 270);
+    double const radiansPerRay = geometry.radiansPerRay();
+    vector<Distance> thresholds(geometry.rayCount, 1425);
+    ThresholdCalibration calibration;
+    calibration.restore(thresholds);
+
+    printf("clustering: splitting touched sweeps into fingers\n");
+
+    // One finger hides half of another, farther along nearly the same ray.  Then the same two fingers well apart in range, and a lone finger.
+    struct Case {
+        char const *name;
+        double ranges[2];
+        double angleOffsetRays;
+        size_t fingerCount;
+    };
+    static Case const kCases[] = {
+        { "overlapping, 40 mm apart in range", { 800, 840 }, 3, 2 },
+        { "overlapping, 300 mm apart in range", { 700, 1000 }, 2, 2 },
+        { "one finger", { 900, 0 }, 0, 1 },
+    };
+
+    Random random(40);
+    for (size_t c = 0; c < sizeof kCases / sizeof kCases[0]; ++c) {
+        Case const &testCase = kCases[c];
+        double radians = 400 * radiansPerRay;
+        vector<Finger> fingers;
+        for (size_t f = 0; f < testCase.fingerCount; ++f) {
+            Finger finger = { polarPoint(testCase.ranges[f] + 8, radians + f * testCase.angleOffsetRays * radiansPerRay), 8 };
+            fingers.push_back(finger);
+        }
+
+        MiddleRaySweepSelection middle;
+        ClusterSweepSelection clustered;
+        clustered.setGeometry(geometry);
+        size_t middleRight = 0, clusteredRight = 0;
+        double worstCentroidError = 0;
+        vector<SensorTouch> touches;
+        for (size_t s = 0; s < kScanCount; ++s) {
+            vector<Distance> scan = scanFingers(geometry, fingers, random);
+            middle.selectTouches(scan.data(), scan.size(), calibration, touches);
+            middleRight += touches.size() == testCase.fingerCount;
+            clustered.selectTouches(scan.data(), scan.size(), calibration, touches);
+            if (touches.size() == testCase.fingerCount) {
+                ++clusteredRight;
+                for (size_t f = 0; f < testCase.fingerCount; ++f) {
+                    // The rays see the near side of a finger, so its centroid sits a little in front of the finger's center.
+                    Point centroid = clustered.clusters()[f].centroid;
+                    double best = HUGE_VAL;
+                    for (size_t g = 0; g < fingers.size(); ++g) {
+                        best = std::min(best, hypot(centroid.x - fingers[g].center.x, centroid.y - fingers[g].center.y));
+                    }
+                    worstCentroidError = std::max(worstCentroidError, best);
+                }
+            }
+        }
+        printf("  %-36s middle ray %5.1f%% right  clustered %5.1f%% right, centroids within %4.1f mm\n", testCase.name,
+            middleRight * 100.0 / kScanCount, clusteredRight * 100.0 / kScanCount, worstCentroidError);
+        if (clusteredRight < kScanCount * 95 / 100) {
+            fprintf(stderr, "clustering: found the wrong number of fingers in %zu of %zu scans\n", kScanCount - clusteredRight, kScanCount);
+            return false;
+        }
+    }
+
+    // Ten fingers spread across the scan, for timing.
+    vector<Finger> fingers;
+    for (size_t f = 0; f < 10; ++f) {
+        Finger finger = { polarPoint(600 + 60 * f, (100 + 90 * f) * radiansPerRay), 8 };
+        fingers.push_back(finger);
+    }
+    vector<Distance> scan = scanFingers(geometry, fingers, random);
+    MiddleRaySweepSelection middle;
+    ClusterSweepSelection clustered;
+    clustered.setGeometry(geometry);
+    vector<SensorTouch> touches;
+    touches.reserve(64);
+    double start = now();
+    for (size_t i = 0; i < kRepetitions * kScanCount; ++i) {
+        middle.selectTouches(scan.data(), scan.size(), calibration, touches);
+    }
+    double middleElapsed = now() - start;
+    start = now();
+    for (size_t i = 0; i < kRepetitions * kScanCount; ++i) {
+        clustered.selectTouches(scan.data(), scan.size(), calibration, touches);
+    }
+    double clusteredElapsed = now() - start;
+    gSink = touches.size();
+    printf("  10 fingers, 1081 rays  middle ray %6.1f ns/scan  clustered %6.1f ns/scan\n",
+        middleElapsed / (kRepetitions * kScanCount) * 1e9, clusteredElapsed / (kRepetitions * kScanCount) * 1e9);
+    return true;
+}
+
+// Selection policies
+
+// The trimmed mean of a sweep the slow way, by sorting it.
+static Distance trimmedMeanBySorting(Distance const *distances, SweepRange sweep) {
+    vector<Distance> sorted(distances + sweep.location, distances + sweep.end());
+    std::sort(sorted.begin(), sorted.end());
+    size_t trim = (size_t)(sweep.length * TrimmedMeanPolicy::kTrimFraction);
+    Distance sum = 0;
+    for (size_t i = trim; i < sorted.size() - trim; ++i) {
+        sum += sorted[i];
+    }
+    return sum / (sorted.size() - 2 * trim);
+}
+
+// Middle-ray selection with a callback through `std::function` for every sweep, like the block-based selection I replaced.
+static void selectMiddleRaysThroughCallbacks(Distance const *distances, size_t count, ThresholdCalibration const &calibration, vector<SensorTouch> &touches) {
+    touches.clear();
+    std::function<void (SweepRange)> report = [&](SweepRange sweep) {
+        size_t middle = sweep.middle();
+        touches.push_back(SensorTouch(middle, distances[middle], sweep));
+    };
+    std::function<void (SweepRange)> forward = [&](SweepRange sweep) { report(sweep); };
+    calibration.forEachTouchedSweep(distances, count, forward);
+}
+
+// A ray that never returned during calibration has an infinite threshold, so any distance at all touches it.  The centroid must still land inside the sweep at a finite distance.
+static bool checkCentroidWithInvalidThresholds() {
+    static size_t const kRayCount = 16;
+    struct {
+        char const *name;
+        size_t invalidStart, invalidEnd;
+    } const cases[] = {
+        { "first ray of the sweep", 3, 4 },
+        { "last ray of the sweep", 6, 7 },
+        { "whole sweep", 3, 7 },
+    };
+    for (size_t c = 0; c < sizeof cases / sizeof *cases; ++c) {
+        vector<Distance> thresholds(kRayCount, 1425);
+        for (size_t i = cases[c].invalidStart; i < cases[c].invalidEnd; ++i) {
+            thresholds[i] = kInvalidDistance;
+        }
+        ThresholdCalibration calibration;
+        calibration.restore(thresholds);
+        vector<Distance> scan(kRayCount, 1500);
+        for (size_t i = 3; i < 7; ++i) {
+            scan[i] = 1000 + 10 * i;
+        }
+        vector<SensorTouch> touches;
+        CentroidSweepSelection centroid;
+        centroid.selectTouches(scan.data(), kRayCount, calibration, touches);
+        if (touches.size() != 1 || touches[0].sweep.location != 3 || touches[0].sweep.length != 4
+            || touches[0].rayIndex < 3 || touches[0].rayIndex >= 7 || !std::isfinite(touches[0].distance)) {
+            fprintf(stderr, "selection: centroid of a sweep with an infinite threshold on its %s is ray %zu at %f\n", cases[c].name,
+                touches.empty() ? (size_t)0 : touches[0].rayIndex, touches.empty() ? 0.0 : (double)touches[0].distance);
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool benchmarkSelection() {
+    static size_t const kScanCount = 200;
+    static size_t const kRepetitions = 200;
+    SensorGeometry const geometry(1081, 270);
+    double const radiansPerRay = geometry.radiansPerRay();
+    vector<Distance> thresholds(geometry.rayCount, 1425);
+    ThresholdCalibration calibration;
+    calibration.restore(thresholds);
+
+    printf("selection: touch selection policies\n");
+
+    // Ten fingers spread across the scan.
+    Random random(42);
+    vector<Finger> fingers;
+    for (size_t f = 0; f < 10; ++f) {
+        Finger finger = { polarPoint(600 + 60 * f, (100 + 90 * f) * radiansPerRay), 8 };
+        fingers.push_back(finger);
+    }
+    vector<vector<Distance> > scans;
+    for (size_t s = 0; s < kScanCount; ++s) {
+        scans.push_back(scanFingers(geometry, fingers, random));
+    }
+
+    vector<SweepRange> sweeps(64);
+    vector<SensorTouch> touches;
+    touches.reserve(64);
+    MiddleRaySweepSelection middle;
+    TrimmedMeanSweepSelection trimmed;
+    CentroidSweepSelection centroid;
+    for (size_t s = 0; s < kScanCount; ++s) {
+        Distance const *scan = scans[s].data();
+        size_t sweepCount = calibration.findTouchedSweeps(scan, geometry.rayCount, sweeps.data(), sweeps.size());
+        middle.selectTouches(scan, geometry.rayCount, calibration, touches);
+        bool ok = touches.size() == sweepCount;
+        for (size_t i = 0; ok && i < sweepCount; ++i) {
+            ok = touches[i].rayIndex == sweeps[i].middle() && touches[i].distance == scan[sweeps[i].middle()];
+        }
+        trimmed.selectTouches(scan, geometry.rayCount, calibration, touches);
+        ok = ok && touches.size() == sweepCount;
+        for (size_t i = 0; ok && i < sweepCount; ++i) {
+            ok = fabsf(touches[i].distance - trimmedMeanBySorting(scan, sweeps[i])) < 1e-3f;
+        }
+        centroid.selectTouches(scan, geometry.rayCount, calibration, touches);
+        ok = ok && touches.size() == sweepCount;
+        for (size_t i = 0; ok && i < sweepCount; ++i) {
+            ok = touches[i].rayIndex >= sweeps[i].location && touches[i].rayIndex < sweeps[i].end();
+        }
+        if (!ok) {
+            fprintf(stderr, "selection: a policy disagrees with its reference in scan %zu\n", s);
+            return false;
+        }
+    }
+    if (!checkCentroidWithInvalidThresholds()) {
+        return false;
+    }
+
+    double start = now();
+    for (size_t i = 0; i < kRepetitions; ++i) {
+        for (size_t s = 0; s < kScanCount; ++s) {
+            selectMiddleRaysThroughCallbacks(scans[s].data(), geometry.rayCount, calibration, touches);
+        }
+    }
+    printf("  %-32s %8.1f ns/scan\n", "middle, callback per sweep", (now() - start) / (kRepetitions * kScanCount) * 1e9);
+
+    for (char const *const *name = kSweepSelectionNames; *name; ++name) {
+        std::unique_ptr<SweepSelection> selection = makeSweepSelection(*name);
+        selection->setGeometry(geometry);
+        size_t touchCount = 0;
+        start = now();
+        for (size_t i = 0; i < kRepetitions; ++i) {
+            for (size_t s = 0; s < kScanCount; ++s) {
+                selection->selectTouches(scans[s].data(), geometry.rayCount, calibration, touches);
+                touchCount += touches.size();
+            }
+        }
+        double elapsed = now() - start;
+        gSink = touchCount;
+        printf("  %-32s %8.1f ns/scan  %5.2f touches/scan\n", *name, elapsed / (kRepetitions * kScanCount) * 1e9, (double)touchCount / (kRepetitions * kScanCount));
+    }
+    return true;
+}
+
+// Change detection
+
+static bool checkChangedRayMask(size_t rayCount) {
+    Random random(rayCount + 1);
+    vector<Distance> reference(rayCount), distances(rayCount);
+    for (size_t i = 0; i < rayCount; ++i) {
+        reference[i] = random.below(37) == 0 ? kInvalidDistance : (Distance)random.uniform(200, 4000);
+        distances[i] = random.below(37) == 0 ? kInvalidDistance : reference[i] + (Distance)random.uniform(-40, 40);
+    }
+    size_t wordCount = touchedRayMaskWordCount(rayCount);
+    vector<uint64_t> expected(wordCount), actual(wordCount);
+    computeChangedRayMaskScalar(distances.data(), reference.data(), rayCount, ChangeDetector::kDefaultEpsilon, expected.data());
+    computeChangedRayMask(distances.data(), reference.data(), rayCount, ChangeDetector::kDefaultEpsilon, actual.data());
+    if (expected != actual) {
+        fprintf(stderr, "change: the changed-ray mask of %zu rays disagrees with the scalar version\n", rayCount);
+        return false;
+    }
+    return true;
+}
+
+// An idle surface 1.5 m away, with a few millimeters of range noise and a few rays that never return.
+static vector<Distance> makeIdleScan(size_t rayCount, Random &random) {
+    vector<Distance> scan(rayCount);
+    for (size_t i = 0; i < rayCount; ++i) {
+        scan[i] = i % 97 == 0 ? kInvalidDistance : (Distance)(1500 + random.uniform(-5, 5));
+    }
+    return scan;
+}
+
+// Calibration data that puts an engine straight into touch detection.
+static CalibrationData makeEngineCalibration(size_t rayCount) {
+    CalibrationData data;
+    data.thresholdsReady = true;
+    data.thresholds.assign(rayCount, 1425);
+    data.sensorPoints.push_back(Point(-600, 900));
+    data.sensorPoints.push_back(Point(700, 1000));
+    data.sensorPoints.push_back(Point(-50, 1600));
+    data.screenPoints.push_back(Point(200, 300));
+    data.screenPoints.push_back(Point(1700, 250));
+    data.screenPoints.push_back(Point(900, 1000));
+    return data;
+}
+
+static bool benchmarkChange() {
+    static size_t const kRayCounts[] = { 1081, 1440 };
+    static size_t const kRepetitions = 100000;
+    static size_t const kIdleScanCount = 20000;
+
+    printf("change: skipping scans that haven't changed\n");
+    for (size_t r = 0; r < sizeof kRayCounts / sizeof kRayCounts[0]; ++r) {
+        size_t rayCount = kRayCounts[r];
+        if (!checkChangedRayMask(rayCount))
+            return false;
+        Random random(rayCount);
+        vector<Distance> reference = makeIdleScan(rayCount, random);
+        vector<Distance> scan = makeIdleScan(rayCount, random);
+        vector<uint64_t> mask(touchedRayMaskWordCount(rayCount));
+        double start = now();
+        for (size_t i = 0; i < kRepetitions; ++i) {
+            computeChangedRayMaskScalar(scan.data(), reference.data(), rayCount, ChangeDetector::kDefaultEpsilon, mask.data());
+            gSink = (size_t)mask[i % mask.size()];
+        }
+        double scalarElapsed = now() - start;
+        start = now();
+        for (size_t i = 0; i < kRepetitions; ++i) {
+            computeChangedRayMask(scan.data(), reference.data(), rayCount, ChangeDetector::kDefaultEpsilon, mask.data());
+            gSink = (size_t)mask[i % mask.size()];
+        }
+        double simdElapsed = now() - start;
+        printf("  %4zu rays  changed-ray mask  scalar %8.1f ns/scan  simd %8.1f ns/scan\n", rayCount, scalarElapsed / kRepetitions * 1e9, simdElapsed / kRepetitions * 1e9);
+    }
+
+    // A calibrated engine watching an idle surface.
+    SensorGeometry const geometry(1081, 270);
+    Random random(43);
+    vector<vector<Distance> > scans;
+    for (size_t s = 0; s < 64; ++s) {
+        scans.push_back(makeIdleScan(geometry.rayCount, random));
+    }
+    CalibrationData data = makeEngineCalibration(geometry.rayCount);
+
+    for (int enabled = 0; enabled < 2; ++enabled) {
+        EngineObserver observer;
+        Engine engine(observer);
+        engine.setGeometry(geometry);
+        engine.restoreCalibrationData(data);
+        engine.setChangeDetectionEnabled(enabled);
+        if (engine.state() != State_DetectingTouches) {
+            fprintf(stderr, "change: the engine isn't detecting touches\n");
+            return false;
+        }
+        double start = now();
+        for (size_t s = 0; s < kIdleScanCount; ++s) {
+            engine.processScan(scans[s % scans.size()].data(), geometry.rayCount, s * 0.025);
+        }
+        double elapsed = now() - start;
+        printf("  idle engine, change detection %-3s %8.1f ns/scan  %zu of %zu scans skipped\n", enabled ? "on" : "off", elapsed / kIdleScanCount * 1e9, engine.skippedScanCount(), kIdleScanCount);
+    }
+    return true;
+}
+
+// Idle power
+
+// An hour of a 40 Hz sensor in front of an empty kiosk, with a five-second touch every six minutes.  The simulated sensor takes three scan periods to apply a new skip count or laser state, and sends nothing while its laser is off.  I check that every touch wakes the policy while the finger is still down.
+static bool simulateIdlePolicy(char const *name, IdlePolicy::Parameters const &parameters) {
+    static double const kScanInterval = 0.025;
+    static double const kSimulatedSeconds = 3600;
+    static double const kTouchInterval = 360;
+    static double const kTouchSeconds = 5;
+    static double const kSensorReconfigurationSeconds = 3 * kScanInterval;
+    SensorGeometry const geometry(1081, 270);
+
+    Random random(44);
+    vector<vector<Distance> > idleScans, touchedScans;
+    for (size_t s = 0; s < 32; ++s) {
+        idleScans.push_back(makeIdleScan(geometry.rayCount, random));
+        touchedScans.push_back(idleScans.back());
+        for (size_t i = 500; i < 510; ++i) {
+            touchedScans.back()[i] = (Distance)(800 + random.uniform(-3, 3));
+        }
+    }
+
+    EngineObserver observer;
+    Engine engine(observer);
+    engine.setGeometry(geometry);
+    engine.restoreCalibrationData(makeEngineCalibration(geometry.rayCount));
+    engine.setChangeDetectionEnabled(true);
+
+    IdlePolicy policy;
+    policy.setParameters(parameters);
+    policy.reset(0);
+    IdlePolicy::SensorRequest applied = policy.sensorRequest();
+    IdlePolicy::SensorRequest pending = applied;
+    double pendingTime = 0;
+    size_t scansSinceSent = 0;
+    size_t touchesSeen = 0;
+    size_t touchCount = 0;
+    bool sawCurrentTouch = false;
+
+    for (size_t s = 0; s * kScanInterval < kSimulatedSeconds; ++s) {
+        double time = s * kScanInterval;
+        double sinceTouch = fmod(time, kTouchInterval);
+        bool touched = time >= kTouchInterval / 2 && sinceTouch >= kTouchInterval / 2 && sinceTouch < kTouchInterval / 2 + kTouchSeconds;
+        if (touched && !sawCurrentTouch && sinceTouch - kTouchInterval / 2 < kScanInterval / 2) {
+            ++touchCount;
+        }
+        if (!touched && sawCurrentTouch) {
+            sawCurrentTouch = false;
+        }
+
+        policy.tick(time);
+        if (policy.sensorRequest() != pending) {
+            pending = policy.sensorRequest();
+            pendingTime = time + kSensorReconfigurationSeconds;
+        }
+        if (pending != applied && time >= pendingTime) {
+            applied = pending;
+            scansSinceSent = applied.skipScans;
+        }
+        if (!applied.laserOn || scansSinceSent++ < applied.skipScans)
+            continue;
+        scansSinceSent = 0;
+
+        if (!policy.shouldExamineScan(time))
+            continue;
+        size_t skippedScanCount = engine.skippedScanCount();
+        Distance const *scan = (touched ? touchedScans : idleScans)[s % idleScans.size()].data();
+        double start = now();
+        engine.processScan(scan, geometry.rayCount, time);
+        double elapsed = now() - start;
+        policy.didExamineScan(time, engine.skippedScanCount() == skippedScanCount, elapsed);
+        if (touched && !sawCurrentTouch && policy.mode() == IdlePolicy::Mode_Active && engine.touchTracker().trackCount() > 0) {
+            sawCurrentTouch = true;
+            ++touchesSeen;
+        }
+    }
+
+    IdlePolicy::Report report = policy.report();
+    printf("  %s: %zu of %zu touches seen, wake latency %.0f ms mean, %.0f ms worst over %zu wakes\n", name, touchesSeen, touchCount,
+        1000 * report.meanWakeLatency, 1000 * report.worstWakeLatency, report.wakeCount);
+    for (int m = 0; m < IdlePolicy::Mode_Count; ++m) {
+        IdlePolicy::ModeStatistics const &statistics = report.modes[m];
+        if (statistics.seconds <= 0)
+            continue;
+        printf("    %-7s %6.0f s  %5.1f scans/s received  %5.1f scans/s examined  %6.2f us/s engine CPU\n", idleModeName((IdlePolicy::Mode)m), statistics.seconds,
+            statistics.scansReceived / statistics.seconds, statistics.scansExamined / statistics.seconds, 1e6 * statistics.processingSeconds / statistics.seconds);
+    }
+    if (touchesSeen != touchCount) {
+        fprintf(stderr, "idle: %s missed %zu touches\n", name, touchCount - touchesSeen);
+        return false;
+    }
+    return true;
+}
+
+static bool benchmarkIdle() {
+    printf("idle: slowing down while nobody touches\n");
+
+    IdlePolicy::Parameters parameters;
+    parameters.idleAfterSeconds = 1e9;
+    if (!simulateIdlePolicy("always active", parameters))
+        return false;
+
+    parameters = IdlePolicy::Parameters();
+    if (!simulateIdlePolicy("host decimation", parameters))
+        return false;
+
+    parameters.idleSensorSkipScans = 3;
+    if (!simulateIdlePolicy("host decimation + sensor skip 3", parameters))
+        return false;
+
+    parameters.dormantAfterSeconds = 60;
+    return simulateIdlePolicy("+ laser off after a minute", parameters);
+}
+
+// Ray region
+
+// The rays that a point sampled every 5 mm along the beam, out to 10 m, puts inside `rect`.
+static vector<bool> raysSampledInsideRect(ScreenCalibration const &calibration, size_t rayCount, Rect const &rect) {
+    vector<bool> inside(rayCount, false);
+    for (size_t i = 0; i < rayCount; ++i) {
+        for (Distance distance = 5; distance <= 10000 && !inside[i]; distance += 5) {
+            inside[i] = rect.contains(calibration.screenPointForRay(i, distance));
+        }
+    }
+    return inside;
+}
+
+static bool benchmarkRegion() {
+    static size_t const kScanCount = 256;
+    static size_t const kRepetitions = 200;
+    SensorGeometry const geometry(1081, 270);
+    Rect const screen(0, 0, 1920, 1080);
+
+    printf("region: only looking at the rays that cross the screen\n");
+
+    // A sensor just outside the top left corner of the screen, at one point per millimeter, so the screen takes up the quarter turn from 90 to 180 degrees of the scan.
+    ScreenCalibration calibration;
+    calibration.setGeometry(geometry);
+    vector<Point> sensorPoints, screenPoints;
+    sensorPoints.push_back(Point(0, 1000));
+    sensorPoints.push_back(Point(-1000, 0));
+    sensorPoints.push_back(Point(-700, 700));
+    screenPoints.push_back(Point(980, -20));
+    screenPoints.push_back(Point(-20, 980));
+    screenPoints.push_back(Point(680, 680));
+    calibration.restore(sensorPoints, screenPoints);
+    if (!calibration.isReady()) {
+        fprintf(stderr, "region: calibration isn't ready\n");
+        return false;
+    }
+
+    RayRegion region;
+    region.compute(calibration.screenRays(), vector<Rect>(1, screen));
+    vector<bool> inside = raysSampledInsideRect(calibration, geometry.rayCount, screen);
+    size_t insideCount = 0;
+    for (size_t i = 0; i < geometry.rayCount; ++i) {
+        bool included = (region.mask()[i / kTouchedRayMaskBitsPerWord] >> (i % kTouchedRayMaskBitsPerWord)) & 1;
+        if (inside[i] && !included) {
+            fprintf(stderr, "region: ray %zu reaches the screen but isn't in the region\n", i);
+            return false;
+        }
+        insideCount += inside[i];
+    }
+    if (region.includedRayCount() > insideCount + 2 * RayRegion::kGuardRays * region.intervals().size()) {
+        fprintf(stderr, "region: %zu rays in the region but only %zu reach the screen\n", region.includedRayCount(), insideCount);
+        return false;
+    }
+    printf("  %zu of %zu rays in %zu interval(s), %zu of them reaching the screen\n", region.includedRayCount(), geometry.rayCount, region.intervals().size(), insideCount);
+
+    Random random(geometry.rayCount);
+    vector<Distance> thresholds = makeThresholds(geometry.rayCount, random);
+    ThresholdCalibration thresholdCalibration;
+    thresholdCalibration.restore(thresholds);
+    vector<vector<Distance> > scans;
+    for (size_t s = 0; s < kScanCount; ++s) {
+        scans.push_back(makeScan(thresholds, s % 11, random));
+    }
+    vector<uint64_t> mask(touchedRayMaskWordCount(geometry.rayCount));
+
+    // What the engine does with each scan it detects touches in, except for mapping the touches to the screen.
+    MiddleRaySweepSelection selection;
+    vector<SensorTouch> touches;
+    touches.reserve(64);
+    double elapsed[2];
+    for (int restricted = 0; restricted < 2; ++restricted) {
+        BackgroundModel model;
+        model.seed(thresholds, ThresholdCalibration::kThresholdScale);
+        size_t touchCount = 0;
+        double start = now();
+        for (size_t i = 0; i < kRepetitions; ++i) {
+            for (size_t s = 0; s < kScanCount; ++s) {
+                Distance const *distances = restricted ? region.restrictScan(scans[s].data(), geometry.rayCount) : scans[s].data();
+                selection.selectTouches(distances, geometry.rayCount, thresholdCalibration, touches);
+                touchCount += touches.size();
+                thresholdCalibration.computeTouchedRayMask(distances, geometry.rayCount, mask.data());
+                model.update(distances, geometry.rayCount, mask.data(), restricted ? &region : NULL);
+            }
+        }
+        elapsed[restricted] = now() - start;
+        gSink = touchCount;
+    }
+    printf("  %-24s %8.1f ns/scan\n", "every ray", elapsed[0] / (kRepetitions * kScanCount) * 1e9);
+    printf("  %-24s %8.1f ns/scan\n", "region only", elapsed[1] / (kRepetitions * kScanCount) * 1e9);
+
+    double start = now();
+    for (size_t i = 0; i < kRepetitions; ++i) {
+        region.compute(calibration.screenRays(), vector<Rect>(1, screen));
+    }
+    printf("  %-24s %8.1f ns\n", "computing the region", (now() - start) / kRepetitions * 1e9);
+    return true;
+}
+
+// Multi-sensor fusion
+
+// Two sensors just outside the top corners of a 1920 x 1080 screen, at one point per millimeter, each seeing the screen in the quarter turn from 90 to 180 degrees of its scan.  Past the screen, their rays reach a wall 2.5 m away.
+static double const kFusionBackground = 2500;
+
+static AffineTransform fusionSensorTransform(size_t sensor) {
+    AffineTransform transform;
+    transform.a = 0;
+    transform.b = -1;
+    transform.c = sensor == 0 ? 1 : -1;
+    transform.d = 0;
+    transform.tx = sensor == 0 ? -20 : 1940;
+    transform.ty = -20;
+    return transform;
+}
+
+static CalibrationData makeFusionCalibration(size_t sensor, size_t rayCount) {
+    AffineTransform transform = fusionSensorTransform(sensor);
+    CalibrationData data;
+    data.thresholdsReady = true;
+    data.thresholds.assign(rayCount, (Distance)(0.95 * kFusionBackground));
+    data.sensorPoints.push_back(Point(0, 1000));
+    data.sensorPoints.push_back(Point(-1000, 0));
+    data.sensorPoints.push_back(Point(-700, 700));
+    for (size_t i = 0; i < data.sensorPoints.size(); ++i) {
+        data.screenPoints.push_back(transform.apply(data.sensorPoints[i]));
+    }
+    return data;
+}
+
+// Fingers at `centers`, in screen coordinates, as `sensor` sees them.
+static vector<Distance> scanFusionFingers(size_t sensor, SensorGeometry const &geometry, vector<Point> const &centers, Random &random) {
+    AffineTransform screenToSensor = fusionSensorTransform(sensor).inverted();
+    vector<Finger> fingers;
+    for (size_t i = 0; i < centers.size(); ++i) {
+        Finger finger = { screenToSensor.apply(centers[i]), 8 };
+        fingers.push_back(finger);
+    }
+    return scanFingers(geometry, fingers, random, kFusionBackground);
+}
+
+static double distanceToNearest(Point point, vector<Point> const &centers) {
+    double best = HUGE_VAL;
+    for (size_t i = 0; i < centers.size(); ++i) {
+        best = std::min(best, hypot(point.x - centers[i].x, point.y - centers[i].y));
+    }
+    return best;
+}
+
+class FusionRecorder : public TouchFusionObserver {
+public:
+    virtual void touchFusionDidFuseTouches(TouchFusion &, FusedTouch const *touches, size_t count, double) {
+        touches_.assign(touches, touches + count);
+    }
+
+    vector<FusedTouch> const &touches() const { return touches_; }
+
+private:
+    vector<FusedTouch> touches_;
+};
+
+class DetectionRecorder : public EngineObserver {
+public:
+    virtual void engineDidDetectTouches(Engine &, Point const *points, size_t count, double) {
+        points_.assign(points, points + count);
+    }
+
+    vector<Point> const &points() const { return points_; }
+
+private:
+    vector<Point> points_;
+};
+
+static void setUpFusionEngine(Engine &engine, size_t sensor, SensorGeometry const &geometry) {
+    engine.setGeometry(geometry);
+    engine.setScreenRects(vector<Rect>(1, Rect(0, 0, 1920, 1080)));
+    engine.restoreCalibrationData(makeFusionCalibration(sensor, geometry.rayCount));
+}
+
+// What `TouchFusion` does with one scan from each sensor, on one thread.
+static void fuseSerially(Engine *const *engines, vector<Distance> const *scans, double timestamp, FusionFrame *frames, TouchMerger &merger, vector<FusedTouch> &touches) {
+    FusionFrame const *framePointers[2];
+    for (size_t k = 0; k < 2; ++k) {
+        engines[k]->processScan(scans[k].data(), scans[k].size(), timestamp);
+        frames[k].timestamp = timestamp;
+        frames[k].screenPoints = engines[k]->detectedScreenPoints();
+        frames[k].sensorTouches = engines[k]->detectedSensorTouches();
+        frames[k].distances = scans[k];
+        framePointers[k] = &frames[k];
+    }
+    merger.merge(framePointers, 2, touches);
+}
+
+// An observer that asks the fusion about itself from inside its callbacks, as a status display would.
+class ReentrantFusionRecorder : public TouchFusionObserver {
+public:
+    ReentrantFusionRecorder() : fuseCount_(0), trackCount_(0), wrongCount_(0) { }
+
+    virtual void touchFusionDidFuseTouches(TouchFusion &fusion, FusedTouch const *, size_t, double) {
+        ++fuseCount_;
+        if (fusion.fusedStepCount() < fuseCount_) {
+            ++wrongCount_;
+        }
+    }
+
+    virtual void touchFusionDidTrackTouches(TouchFusion &fusion, TrackedTouch const *, size_t, double) {
+        ++trackCount_;
+        gSink = fusion.lateScanCount() + fusion.interleaveReport().updateCount + fusion.droppedScanCount();
+    }
+
+    size_t fuseCount() const { return fuseCount_; }
+    size_t trackCount() const { return trackCount_; }
+    size_t wrongCount() const { return wrongCount_; }
+
+private:
+    size_t fuseCount_;
+    size_t trackCount_;
+    size_t wrongCount_;
+};
+
+static bool checkReentrantFusionObserver(SensorGeometry const &geometry) {
+    static size_t const kStepCount = 20;
+    Random random(46);
+    vector<Point> centers(1, Point(900, 500));
+    EngineObserver engineObserver;
+    ReentrantFusionRecorder recorder;
+    TouchFusion fusion(recorder);
+    for (size_t k = 0; k < 2; ++k) {
+        setUpFusionEngine(fusion.sensorEngine(fusion.addSensor(engineObserver)), k, geometry);
+    }
+    fusion.start();
+    for (size_t s = 0; s < kStepCount; ++s) {
+        for (size_t k = 0; k < 2; ++k) {
+            vector<Distance> scan = scanFusionFingers(k, geometry, centers, random);
+            fusion.submitScan(k, scan.data(), scan.size(), s * 0.025 + k * 0.005);
+        }
+        fusion.flush();
+    }
+    fusion.stop();
+    // `stop` ends the finger's touch with one more tracking notification.
+    if (recorder.fuseCount() != kStepCount || recorder.trackCount() != kStepCount + 1 || recorder.wrongCount() != 0) {
+        fprintf(stderr, "fusion: an observer asking about the fusion heard %zu fused and %zu tracked steps, %zu of them with a stale step count\n",
+            recorder.fuseCount(), recorder.trackCount(), recorder.wrongCount());
+        return false;
+    }
+    return true;
+}
+
+static bool benchmarkFusion() {
+    static size_t const kStepCount = 100;
+    static size_t const kTimedStepCount = 2000;
+    SensorGeometry const geometry(1081, 270);
+
+    printf("fusion: merging two sensors' touches on one screen\n");
+
+    if (!checkReentrantFusionObserver(geometry)) {
+        return false;
+    }
+
+    // Three fingers in a line from the first sensor, so it only sees the nearest.  Then a speckle that only the first sensor sees, at a spot the second sensor sees past, next to a real finger.  Then four fingers that both sensors see.
+    struct Case {
+        char const *name;
+        Point fingers[4];
+        size_t fingerCount;
+        bool speckle;
+    };
+    static Case const kCases[] = {
+        { "three in a line from sensor 0", { Point(400, 206), Point(800, 432), Point(1200, 659) }, 3, false },
+        { "a speckle only sensor 0 sees", { Point(1400, 850) }, 1, true },
+        { "four fingers both sensors see", { Point(300, 700), Point(900, 250), Point(1300, 850), Point(1650, 400) }, 4, false },
+    };
+    Point const speckle(700, 700);
+
+    Random random(45);
+    for (size_t c = 0; c < sizeof kCases / sizeof kCases[0]; ++c) {
+        Case const &testCase = kCases[c];
+        vector<Point> centers(testCase.fingers, testCase.fingers + testCase.fingerCount);
+
+        FusionRecorder recorder;
+        DetectionRecorder detectionRecorders[2];
+        TouchFusion fusion(recorder);
+        for (size_t k = 0; k < 2; ++k) {
+            setUpFusionEngine(fusion.sensorEngine(fusion.addSensor(detectionRecorders[k])), k, geometry);
+        }
+        fusion.start();
+
+        size_t rightCount = 0, occludedCount = 0;
+        double sensorErrors[2] = { 0, 0 }, fusedError = 0;
+        size_t sensorPointCounts[2] = { 0, 0 }, fusedPointCount = 0;
+        for (size_t s = 0; s < kStepCount; ++s) {
+            for (size_t k = 0; k < 2; ++k) {
+                vector<Distance> scan = scanFusionFingers(k, geometry, centers, random);
+                if (testCase.speckle && k == 0) {
+                    Point sensorPoint = fusionSensorTransform(0).inverted().apply(speckle);
+                    size_t ray = (size_t)(atan2(sensorPoint.y, sensorPoint.x) / geometry.radiansPerRay() + 0.5);
+                    for (size_t i = ray - 2; i < ray + 2; ++i) {
+                        scan[i] = (Distance)hypot(sensorPoint.x, sensorPoint.y);
+                    }
+                }
+                fusion.submitScan(k, scan.data(), scan.size(), s * 0.025 + k * 0.005);
+            }
+            fusion.flush();
+
+            vector<FusedTouch> const &touches = recorder.touches();
+            rightCount += touches.size() == testCase.fingerCount;
+            for (size_t t = 0; t < touches.size(); ++t) {
+                fusedError += distanceToNearest(touches[t].position, centers);
+                occludedCount += touches[t].occludedMask != 0;
+            }
+            fusedPointCount += touches.size();
+            for (size_t k = 0; k < 2; ++k) {
+                vector<Point> const &points = detectionRecorders[k].points();
+                for (size_t p = 0; p < points.size(); ++p) {
+                    sensorErrors[k] += distanceToNearest(points[p], centers);
+                }
+                sensorPointCounts[k] += points.size();
+            }
+        }
+        fusion.stop();
+
+        printf("  %-32s %5.1f%% right  %.1f occluded per step  mean error: sensor 0 %5.1f, sensor 1 %5.1f, fused %5.1f points\n", testCase.name,
+            rightCount * 100.0 / kStepCount, (double)occludedCount / kStepCount,
+            sensorErrors[0] / std::max(sensorPointCounts[0], (size_t)1), sensorErrors[1] / std::max(sensorPointCounts[1], (size_t)1), fusedError / std::max(fusedPointCount, (size_t)1));
+        if (rightCount < kStepCount * 95 / 100) {
+            fprintf(stderr, "fusion: fused the wrong number of touches in %zu of %zu steps\n", kStepCount - rightCount, kStepCount);
+            return false;
+        }
+        if (fusion.fusedStepCount() != kStepCount) {
+            fprintf(stderr, "fusion: fused %zu steps from %zu pairs of scans\n", fusion.fusedStepCount(), kStepCount);
+            return false;
+        }
+    }
+
+    // Timing, with ten fingers spread across the screen.
+    vector<Point> centers;
+    for (size_t f = 0; f < 10; ++f) {
+        centers.push_back(Point(150 + 170 * f, 200 + 70 * f));
+    }
+    vector<Distance> scans[2];
+    for (size_t k = 0; k < 2; ++k) {
+        scans[k] = scanFusionFingers(k, geometry, centers, random);
+    }
+
+    EngineObserver engineObserver;
+    Engine engine0(engineObserver), engine1(engineObserver);
+    Engine *engines[2] = { &engine0, &engine1 };
+    TouchMerger merger;
+    for (size_t k = 0; k < 2; ++k) {
+        setUpFusionEngine(*engines[k], k, geometry);
+        merger.setSensor(k, geometry, engines[k]->screenCalibration().transform());
+    }
+    FusionFrame frames[2];
+    vector<FusedTouch> touches;
+    double start = now();
+    for (size_t s = 0; s < kTimedStepCount; ++s) {
+        fuseSerially(engines, scans, s * 0.025, frames, merger, touches);
+    }
+    double serialElapsed = now() - start;
+    gSink = touches.size();
+
+    FusionFrame const *framePointers[2] = { &frames[0], &frames[1] };
+    start = now();
+    for (size_t s = 0; s < kTimedStepCount; ++s) {
+        merger.merge(framePointers, 2, touches);
+    }
+    double mergeElapsed = now() - start;
+    gSink = touches.size();
+
+    FusionRecorder recorder;
+    TouchFusion fusion(recorder);
+    for (size_t k = 0; k < 2; ++k) {
+        setUpFusionEngine(fusion.sensorEngine(fusion.addSensor(engineObserver)), k, geometry);
+    }
+    fusion.start();
+    start = now();
+    for (size_t s = 0; s < kTimedStepCount; ++s) {
+        for (size_t k = 0; k < 2; ++k) {
+            fusion.submitScan(k, scans[k].data(), scans[k].size(), s * 0.025);
+        }
+        fusion.flush();
+    }
+    double threadedElapsed = now() - start;
+    fusion.stop();
+    gSink = recorder.touches().size();
+
+    printf("  10 fingers, 2 x 1081 rays  both engines and merge on one thread %7.2f us/step  merge alone %6.2f us/step\n",
+        serialElapsed / kTimedStepCount * 1e6, mergeElapsed / kTimedStepCount * 1e6);
+    printf("  %-26s a thread per sensor, scan to fused touches   %7.2f us/step\n", "", threadedElapsed / kTimedStepCount * 1e6);
+    return true;
+}
+
+// Interleaved sensors
+
+// A finger dragging around a 300-point circle once a second, about 1.9 m/s.
+static Point circlingFinger(double t) {
+    return Point(960 + 300 * cos(2 * M_PI * t), 540 + 300 * sin(2 * M_PI * t));
+}
+
+class UpdateRecorder : public TouchFusionObserver {
+public:
+    UpdateRecorder() : wrongCount_(0) { }
+
+    virtual void touchFusionDidFuseTouches(TouchFusion &, FusedTouch const *touches, size_t count, double timestamp) {
+        if (count != 1) {
+            ++wrongCount_;
+            return;
+        }
+        times_.push_back(timestamp);
+        positions_.push_back(touches[0].position);
+    }
+
+    // The RMS distance from the finger to the most recent update, sampled every millisecond, as a display refreshing at any time would see it.
+    double rmsHoldError(double start, double end) const {
+        double sum = 0;
+        size_t count = 0;
+        size_t next = 0;
+        for (double t = start; t < end; t += 0.001) {
+            while (next < times_.size() && times_[next] <= t) {
+                ++next;
+            }
+            if (next == 0)
+                continue;
+            Point truth = circlingFinger(t);
+            Point const &held = positions_[next - 1];
+            sum += (held.x - truth.x) * (held.x - truth.x) + (held.y - truth.y) * (held.y - truth.y);
+            ++count;
+        }
+        return count ? sqrt(sum / count) : HUGE_VAL;
+    }
+
+    size_t wrongCount() const { return wrongCount_; }
+
+private:
+    vector<double> times_;
+    vector<Point> positions_;
+    size_t wrongCount_;
+};
+
+static bool benchmarkInterleave() {
+    static double const kSeconds = 4;
+    static double const kPeriods[2] = { 0.025, 0.02501 };
+    SensorGeometry const geometry(1081, 270);
+
+    printf("interleave: two 40 Hz sensors half a period apart\n");
+
+    struct Case {
+        char const *name;
+        bool interleaved;
+        double offset; // seconds from sensor 0's first scan to sensor 1's
+    };
+    static Case const kCases[] = {
+        { "stepped, 12.5 ms apart", false, 0.0125 },
+        { "interleaved, 12.5 ms apart", true, 0.0125 },
+        { "interleaved, 1 ms apart", true, 0.001 },
+    };
+
+    Random random(46);
+    double holdErrors[3];
+    for (size_t c = 0; c < sizeof kCases / sizeof kCases[0]; ++c) {
+        Case const &testCase = kCases[c];
+        UpdateRecorder recorder;
+        EngineObserver engineObserver;
+        TouchFusion fusion(recorder);
+        for (size_t k = 0; k < 2; ++k) {
+            setUpFusionEngine(fusion.sensorEngine(fusion.addSensor(engineObserver)), k, geometry);
+        }
+        fusion.setInterleavingEnabled(testCase.interleaved);
+        if (testCase.interleaved) {
+            fusion.setMaximumSkew(0.015);
+        }
+        fusion.start();
+
+        // I send the two sensors' scans in timestamp order, each as soon as it's taken.
+        double nextScan[2] = { 0, testCase.offset };
+        size_t scanCount = 0;
+        for (;;) {
+            size_t k = nextScan[0] <= nextScan[1] ? 0 : 1;
+            double t = nextScan[k];
+            if (t >= kSeconds)
+                break;
+            vector<Point> centers(1, circlingFinger(t));
+            vector<Distance> scan = scanFusionFingers(k, geometry, centers, random);
+            fusion.submitScan(k, scan.data(), scan.size(), t);
+            fusion.waitUntilProcessed();
+            nextScan[k] += kPeriods[k];
+            ++scanCount;
+        }
+        InterleaveMonitor::Report report = fusion.interleaveReport();
+        size_t lateScans = fusion.lateScanCount();
+        fusion.stop();
+
+        holdErrors[c] = recorder.rmsHoldError(0.1, kSeconds);
+        printf("  %-28s sensor 1 at phase %.3f, spread %.2f  %5.1f of %5.1f updates/s, interval %5.2f ms, jitter %5.2f ms, worst %5.2f ms  held position off by %5.1f points RMS, %zu updates without one touch\n",
+            testCase.name, report.sensors[1].phase, report.phaseSpread, report.updateRate, report.idealUpdateRate,
+            report.meanUpdateInterval * 1e3, report.updateIntervalJitter * 1e3, report.worstUpdateInterval * 1e3, holdErrors[c], recorder.wrongCount());
+        // Without interleaving, the two sensors see a fast finger half a period apart, so their touches of it are sometimes too far apart to merge.
+        if ((testCase.interleaved && recorder.wrongCount() > scanCount / 100) || lateScans > 0) {
+            fprintf(stderr, "interleave: %zu updates without exactly one touch and %zu late scans\n", recorder.wrongCount(), lateScans);
+            return false;
+        }
+        if (testCase.interleaved && report.updateRate < 0.95 * report.idealUpdateRate) {
+            fprintf(stderr, "interleave: only %.1f of %.1f updates per second\n", report.updateRate, report.idealUpdateRate);
+            return false;
+        }
+    }
+    if (holdErrors[1] >= holdErrors[0]) {
+        fprintf(stderr, "interleave: interleaving didn't make the held position any closer\n");
+        return false;
+    }
+    return true;
+}
+
+// Gestures
+
+// One finger of a scripted gesture: down at `start`, moving steadily from `from` to `to`, and up at `end`.
+struct ScriptedTouch {
+    uint32_t identifier;
+    double start;
+    double end;
+    Point from;
+    Point to;
+};
+
+// The frames a tracker would report for `script` at 40 Hz, plus a few empty frames at the end.
+static vector<vector<TrackedTouch> > scriptFrames(vector<ScriptedTouch> const &script) {
+    static double const kFrameInterval = 0.025;
+    double last = 0;
+    for (size_t i = 0; i < script.size(); ++i) {
+        last = std::max(last, script[i].end);
+    }
+    vector<vector<TrackedTouch> > frames;
+    for (size_t k = 0; k * kFrameInterval < last + 4 * kFrameInterval; ++k) {
+        double t = k * kFrameInterval;
+        vector<TrackedTouch> frame;
+        for (size_t i = 0; i < script.size(); ++i) {
+            ScriptedTouch const &scripted = script[i];
+            if (t < scripted.start || t >= scripted.end + kFrameInterval)
+                continue;
+            double duration = scripted.end - scripted.start;
+            double fraction = std::min((t - scripted.start) / duration, 1.0);
+            TrackedTouch touch;
+            touch.identifier = scripted.identifier;
+            touch.phase = t < scripted.start + kFrameInterval ? TouchPhase_Began : t >= scripted.end ? TouchPhase_Ended : TouchPhase_Moved;
+            touch.position = Point(scripted.from.x + fraction * (scripted.to.x - scripted.from.x), scripted.from.y + fraction * (scripted.to.y - scripted.from.y));
+            touch.predictedPosition = touch.position;
+            touch.velocity = Point((scripted.to.x - scripted.from.x) / duration, (scripted.to.y - scripted.from.y) / duration);
+            touch.missedScans = 0;
+            frame.push_back(touch);
+        }
+        frames.push_back(frame);
+    }
+    return frames;
+}
+
+// When the tracker is reset in the middle of a drag, the next frame has no touches.  The drag ends there, and the next finger starts a new session.
+static bool checkVanishingFingers() {
+    ScriptedTouch const drag = { 1, 0, 1, Point(500, 500), Point(900, 500) };
+    vector<vector<TrackedTouch> > frames = scriptFrames(vector<ScriptedTouch>(1, drag));
+    GestureRecognizer recognizer;
+    bool dragging = false;
+    size_t f = 0;
+    for ( ; f < frames.size() && !dragging; ++f) {
+        recognizer.update(frames[f].data(), frames[f].size(), f * 0.025);
+        dragging = recognizer.eventCount() > 0 && recognizer.events()[0].type == GestureType_Drag;
+    }
+    recognizer.update(NULL, 0, f * 0.025);
+    bool ended = recognizer.eventCount() == 1 && recognizer.events()[0].type == GestureType_Drag && recognizer.events()[0].phase == GesturePhase_Ended;
+
+    ScriptedTouch const tap = { 2, 0, 0.1, Point(300, 300), Point(300, 300) };
+    frames = scriptFrames(vector<ScriptedTouch>(1, tap));
+    bool tapped = false;
+    for (size_t g = 0; g < frames.size(); ++g) {
+        recognizer.update(frames[g].data(), frames[g].size(), (f + 1 + g) * 0.025);
+        tapped = tapped || (recognizer.eventCount() == 1 && recognizer.events()[0].type == GestureType_Tap);
+    }
+    if (!dragging || !ended || !tapped) {
+        fprintf(stderr, "gestures: an empty frame in the middle of a drag %s\n", !dragging ? "came before the drag began" : !ended ? "didn't end the drag" : "spoiled the next tap");
+        return false;
+    }
+    printf("  %-12s Drag Ended, then a new session taps\n", "empty frame");
+    return true;
+}
+
+static bool benchmarkGestures() {
+    static size_t const kRepetitions = 20000;
+
+    printf("gestures: recognizing gestures from tracked touches\n");
+
+    struct Case {
+        char const *name;
+        ScriptedTouch touches[2];
+        size_t touchCount;
+        char const *expected; // the events in order, with repeated events shown once
+    };
+    static Case const kCases[] = {
+        { "tap", { { 1, 0, 0.1, Point(500, 500), Point(502, 501) } }, 1, "Tap Recognized" },
+        { "double-tap", { { 1, 0, 0.1, Point(500, 500), Point(500, 500) }, { 2, 0.25, 0.35, Point(505, 498), Point(505, 498) } }, 2, "Tap Recognized, DoubleTap Recognized" },
+        { "long press", { { 1, 0, 0.8, Point(500, 500), Point(504, 503) } }, 1, "LongPress Began, LongPress Ended" },
+        { "drag", { { 1, 0, 1, Point(500, 500), Point(900, 500) } }, 1, "Drag Began, Drag Changed, Drag Ended" },
+        { "swipe", { { 1, 0, 0.2, Point(500, 500), Point(900, 500) } }, 1, "Drag Began, Drag Changed, Drag Ended, Swipe Recognized" },
+        { "scroll", { { 1, 0, 0.6, Point(500, 500), Point(500, 700) }, { 2, 0, 0.6, Point(600, 500), Point(600, 700) } }, 2, "Scroll Began, Scroll Changed, Scroll Ended" },
+        { "pinch", { { 1, 0, 0.6, Point(550, 500), Point(450, 500) }, { 2, 0, 0.6, Point(650, 500), Point(750, 500) } }, 2, "Pinch Began, Pinch Changed, Pinch Ended" },
+    };
+
+    vector<vector<TrackedTouch> > pinchFrames;
+    for (size_t c = 0; c < sizeof kCases / sizeof kCases[0]; ++c) {
+        Case const &testCase = kCases[c];
+        vector<ScriptedTouch> script(testCase.touches, testCase.touches + testCase.touchCount);
+        vector<vector<TrackedTouch> > frames = scriptFrames(script);
+
+        GestureRecognizer recognizer;
+        std::string recognized;
+        std::string previous;
+        double scale = 1;
+        double worstLatency = 0;
+        bool dragBeganWhereLanded = true;
+        for (size_t f = 0; f < frames.size(); ++f) {
+            double timestamp = f * 0.025;
+            recognizer.update(frames[f].data(), frames[f].size(), timestamp);
+            for (size_t e = 0; e < recognizer.eventCount(); ++e) {
+                GestureEvent const &event = recognizer.events()[e];
+                std::string name = std::string(gestureTypeName(event.type)) + " " + gesturePhaseName(event.phase);
+                if (name != previous) {
+                    recognized += (recognized.empty() ? "" : ", ") + name;
+                    previous = name;
+                }
+                scale *= event.scale;
+                // A drag presses where the finger landed and then moves to where the finger is.
+                if (event.type == GestureType_Drag && event.phase == GesturePhase_Began) {
+                    Point const &current = frames[f][0].predictedPosition;
+                    dragBeganWhereLanded = event.position.x == script[0].from.x && event.position.y == script[0].from.y
+                        && fabs(event.position.x + event.translation.x - current.x) < 1e-9 && fabs(event.position.y + event.translation.y - current.y) < 1e-9;
+                }
+                // A tap or swipe should be settled by the frame its touch ends, which is the frame whose timestamp the event carries.
+                if (event.phase == GesturePhase_Recognized) {
+                    double lastEnd = 0;
+                    for (size_t i = 0; i < script.size(); ++i) {
+                        if (script[i].end <= timestamp) {
+                            lastEnd = std::max(lastEnd, script[i].end);
+                        }
+                    }
+                    worstLatency = std::max(worstLatency, timestamp - lastEnd);
+                }
+            }
+        }
+        printf("  %-12s %s", testCase.name, recognized.c_str());
+        if (strcmp(testCase.name, "pinch") == 0) {
+            printf(" (scale %.2f)", scale);
+        }
+        printf("\n");
+        if (recognized != testCase.expected) {
+            fprintf(stderr, "gestures: expected %s\n", testCase.expected);
+            return false;
+        }
+        if (!dragBeganWhereLanded) {
+            fprintf(stderr, "gestures: a %s began away from where the finger landed\n", testCase.name);
+            return false;
+        }
+        if (worstLatency > 0.025 + 1e-9) {
+            fprintf(stderr, "gestures: recognized a %s %.0f ms after its touch ended\n", testCase.name, worstLatency * 1e3);
+            return false;
+        }
+        if (strcmp(testCase.name, "pinch") == 0) {
+            pinchFrames = frames;
+        }
+    }
+
+    if (!checkVanishingFingers())
+        return false;
+
+    GestureRecognizer recognizer;
+    size_t allocationsBefore = gAllocationCount;
+    size_t eventCount = 0;
+    double start = now();
+    for (size_t r = 0; r < kRepetitions; ++r) {
+        for (size_t f = 0; f < pinchFrames.size(); ++f) {
+            recognizer.update(pinchFrames[f].data(), pinchFrames[f].size(), (r * pinchFrames.size() + f) * 0.025);
+            eventCount += recognizer.eventCount();
+        }
+    }
+    double elapsed = now() - start;
+    gSink = eventCount;
+    if (gAllocationCount != allocationsBefore) {
+        fprintf(stderr, "gestures: allocated %zu times while recognizing\n", gAllocationCount.load() - allocationsBefore);
+        return false;
+    }
+    printf("  two-finger pinch, %zu frames  %6.1f ns/frame, no allocations\n", pinchFrames.size(), elapsed / (kRepetitions * pinchFrames.size()) * 1e9);
+    return true;
+}
+
+// Uinput
+
+// I decode the frames an injector writes the way the kernel's multi-touch slots do, so I can check what an evdev reader would see.
+class RecordingEventSink : public InputEventSink {
+public:
+    RecordingEventSink() : now(0), malformedFrameCount(0), touching(false), landingCount(0), slot_(0) {
+        for (size_t i = 0; i < UinputTouchInjector::kMaximumSlots; ++i) {
+            trackingIDs[i] = -1;
+            x[i] = y[i] = 0;
+        }
+    }
+
+    double now; // the caller sets this to the time of each call into the injector
+    vector<double> frameTimes;
+    size_t malformedFrameCount; // frames that don't end with their only SYN_REPORT
+
+    int trackingIDs[UinputTouchInjector::kMaximumSlots];
+    int x[UinputTouchInjector::kMaximumSlots];
+    int y[UinputTouchInjector::kMaximumSlots];
+    bool touching;
+    size_t landingCount; // how many contacts have gone down
+
+    size_t contactCount() const {
+        size_t count = 0;
+        for (size_t i = 0; i < UinputTouchInjector::kMaximumSlots; ++i) {
+            count += trackingIDs[i] >= 0;
+        }
+        return count;
+    }
+
+    bool hasContactAt(int contactX, int contactY) const {
+        for (size_t i = 0; i < UinputTouchInjector::kMaximumSlots; ++i) {
+            if (trackingIDs[i] >= 0 && x[i] == contactX && y[i] == contactY)
+                return true;
+        }
+        return false;
+    }
+
+    virtual bool writeEvents(struct input_event const *events, size_t count) {
+        frameTimes.push_back(now);
+        for (size_t i = 0; i < count; ++i) {
+            struct input_event const &event = events[i];
+            bool isReport = event.type == EV_SYN && event.code == SYN_REPORT;
+            if (isReport != (i == count - 1)) {
+                ++malformedFrameCount;
+            }
+            if (event.type == EV_KEY && event.code == BTN_TOUCH) {
+                touching = event.value != 0;
+            } else if (event.type == EV_ABS) {
+                switch (event.code) {
+                    case ABS_MT_SLOT: slot_ = event.value; break;
+                    case ABS_MT_TRACKING_ID:
+                        landingCount += trackingIDs[slot_] < 0 && event.value >= 0;
+                        trackingIDs[slot_] = event.value;
+                        break;
+                    case ABS_MT_POSITION_X: x[slot_] = event.value; break;
+                    case ABS_MT_POSITION_Y: y[slot_] = event.value; break;
+                }
+            }
+        }
+        return true;
+    }
+
+private:
+    int slot_;
+};
+
+class CountingEventSink : public InputEventSink {
+public:
+    CountingEventSink() : frameCount(0), eventCount(0) { }
+
+    size_t frameCount;
+    size_t eventCount;
+
+    virtual bool writeEvents(struct input_event const *events, size_t count) {
+        (void)events;
+        ++frameCount;
+        eventCount += count;
+        return true;
+    }
+};
+
+static TrackedTouch injectedTouch(uint32_t identifier, TouchPhase phase, Point position) {
+    TrackedTouch touch;
+    touch.identifier = identifier;
+    touch.phase = phase;
+    touch.position = position;
+    touch.predictedPosition = position;
+    touch.velocity = Point();
+    touch.missedScans = 0;
+    return touch;
+}
+
+static bool checkInjectedProtocol() {
+    RecordingEventSink sink;
+    UinputTouchInjector injector(sink);
+
+    struct Step {
+        TrackedTouch touches[2];
+        size_t count;
+        size_t expectedContacts;
+        Point expectedPosition; // one of the contacts must be here
+    };
+    Step const steps[] = {
+        { { injectedTouch(1, TouchPhase_Began, Point(100, 100)), injectedTouch(2, TouchPhase_Began, Point(200, 200)) }, 2, 2, Point(200, 200) },
+        { { injectedTouch(1, TouchPhase_Moved, Point(110, 100)), injectedTouch(2, TouchPhase_Moved, Point(200, 200)) }, 2, 2, Point(110, 100) },
+        { { injectedTouch(1, TouchPhase_Ended, Point(110, 100)), injectedTouch(2, TouchPhase_Moved, Point(210, 220)) }, 2, 1, Point(210, 220) },
+        { { injectedTouch(2, TouchPhase_Ended, Point(210, 220)) }, 1, 0, Point() },
+        { { }, 0, 0, Point() },
+    };
+    for (size_t i = 0; i < sizeof steps / sizeof steps[0]; ++i) {
+        Step const &step = steps[i];
+        injector.submit(step.touches, step.count, i * 0.025, i * 0.025);
+        bool contactsMatch = sink.contactCount() == step.expectedContacts && sink.touching == (step.expectedContacts > 0)
+            && (step.expectedContacts == 0 || sink.hasContactAt((int)step.expectedPosition.x, (int)step.expectedPosition.y));
+        if (!contactsMatch) {
+            fprintf(stderr, "uinput: after frame %zu the reader sees %zu contacts, expected %zu\n", i, sink.contactCount(), step.expectedContacts);
+            return false;
+        }
+    }
+    if (sink.frameTimes.size() != 4 || sink.malformedFrameCount > 0) {
+        fprintf(stderr, "uinput: wrote %zu frames (%zu malformed) for 4 changes\n", sink.frameTimes.size(), sink.malformedFrameCount);
+        return false;
+    }
+    printf("  protocol B                 %zu frames in %zu writes, one SYN_REPORT each, contacts match\n", sink.frameTimes.size(), sink.frameTimes.size());
+
+    // A tap that lands and lifts between two frames must still reach the reader, down in one frame and up in the next.
+    UinputTouchInjector::Parameters parameters;
+    parameters.maximumFrameRate = 60;
+    parameters.refreshRate = 60;
+    injector.setParameters(parameters);
+    injector.setRefreshTime(0);
+    TrackedTouch down = injectedTouch(3, TouchPhase_Began, Point(300, 300));
+    TrackedTouch up = injectedTouch(3, TouchPhase_Ended, Point(300, 300));
+    size_t landingsBefore = sink.landingCount;
+    sink.now = 0.020;
+    injector.submit(&down, 1, 0.020, 0.020);
+    sink.now = 0.025;
+    injector.submit(&up, 1, 0.025, 0.025);
+    size_t framesBefore = sink.frameTimes.size();
+    while (injector.hasPendingFrame()) {
+        sink.now = injector.nextFrameTime();
+        injector.poll(sink.now);
+    }
+    size_t frames = sink.frameTimes.size() - framesBefore;
+    if (sink.landingCount != landingsBefore + 1 || sink.contactCount() != 0 || frames != 2) {
+        fprintf(stderr, "uinput: a tap between frames made %zu landings in %zu frames\n", sink.landingCount - landingsBefore, frames);
+        return false;
+    }
+    printf("  tap between two frames     down at %.1f ms, up at %.1f ms\n", sink.frameTimes[framesBefore] * 1e3, sink.frameTimes[framesBefore + 1] * 1e3);
+    return true;
+}
+
+// I feed the injector a finger from two interleaved 40 Hz sensors and poll it the way a caller would.
+static bool simulateInjectionRate(char const *name, double maximumFrameRate, double refreshRate) {
+    static double const kRefreshTime = 0.004;
+    static double const kSeconds = 4;
+    static double const kScanInterval = 0.0125;
+
+    RecordingEventSink sink;
+    UinputTouchInjector injector(sink);
+    UinputTouchInjector::Parameters parameters;
+    parameters.maximumFrameRate = maximumFrameRate;
+    parameters.refreshRate = refreshRate;
+    injector.setParameters(parameters);
+    injector.setRefreshTime(kRefreshTime);
+
+    vector<double> waiting; // the times of submits the sink hasn't seen yet
+    double totalLatency = 0;
+    double worstLatency = 0;
+    size_t submitCount = 0;
+    size_t offBoundaryCount = 0;
+    size_t frameCount = 0;
+    std::function<void ()> checkForFrame = [&]() {
+        if (sink.frameTimes.size() == frameCount)
+            return;
+        frameCount = sink.frameTimes.size();
+        double frameTime = sink.frameTimes.back();
+        for (size_t i = 0; i < waiting.size(); ++i) {
+            totalLatency += frameTime - waiting[i];
+            worstLatency = std::max(worstLatency, frameTime - waiting[i]);
+        }
+        waiting.clear();
+        if (refreshRate > 0) {
+            double phase = fmod(frameTime - kRefreshTime, injector.frameInterval()) / injector.frameInterval();
+            offBoundaryCount += phase > 1e-6 && phase < 1 - 1e-6;
+        }
+    };
+    for (double t = 0; t < kSeconds; t += kScanInterval) {
+        while (injector.hasPendingFrame() && injector.nextFrameTime() <= t) {
+            sink.now = injector.nextFrameTime();
+            injector.poll(sink.now);
+            checkForFrame();
+        }
+        sink.now = t;
+        TrackedTouch touch = injectedTouch(1, t == 0 ? TouchPhase_Began : TouchPhase_Moved, circlingFinger(t));
+        injector.submit(&touch, 1, t, t);
+        waiting.push_back(t);
+        ++submitCount;
+        checkForFrame();
+    }
+
+    double frameRate = sink.frameTimes.size() / kSeconds;
+    printf("  %-26s %5.1f frames/s for %5.1f scans/s, %zu coalesced, mean hold %4.1f ms, worst %4.1f ms\n", name, frameRate, submitCount / kSeconds, injector.statistics().coalescedSubmits, totalLatency / submitCount * 1e3, worstLatency * 1e3);
+    if (maximumFrameRate > 0 && frameRate > maximumFrameRate + 1) {
+        fprintf(stderr, "uinput: wrote %.1f frames/s with a maximum of %.0f\n", frameRate, maximumFrameRate);
+        return false;
+    }
+    if (offBoundaryCount > 0) {
+        fprintf(stderr, "uinput: wrote %zu frames between refresh boundaries\n", offBoundaryCount);
+        return false;
+    }
+    if (worstLatency > injector.frameInterval() + 1e-9) {
+        fprintf(stderr, "uinput: held touches for %.1f ms, longer than a frame interval\n", worstLatency * 1e3);
+        return false;
+    }
+    return true;
+}
+
+static bool benchmarkUinput() {
+    static size_t const kFingerCount = 10;
+    static size_t const kFrames = 200000;
+
+    printf("uinput: writing multi-touch frames for evdev readers\n");
+    if (!checkInjectedProtocol())
+        return false;
+    if (!simulateInjectionRate("every scan", 0, 0))
+        return false;
+    if (!simulateInjectionRate("at most 60 Hz", 60, 0))
+        return false;
+    if (!simulateInjectionRate("60 Hz on refreshes", 60, 60))
+        return false;
+    if (!simulateInjectionRate("30 Hz on 60 Hz refreshes", 30, 60))
+        return false;
+
+    CountingEventSink sink;
+    UinputTouchInjector injector(sink);
+    TrackedTouch touches[kFingerCount];
+    for (size_t i = 0; i < kFingerCount; ++i) {
+        touches[i] = injectedTouch((uint32_t)i + 1, TouchPhase_Began, Point(100 + 150 * i, 500));
+    }
+    size_t allocationsBefore = gAllocationCount;
+    double start = now();
+    for (size_t f = 0; f < kFrames; ++f) {
+        for (size_t i = 0; i < kFingerCount; ++i) {
+            touches[i].predictedPosition.y = 500 + (double)(f % 100);
+        }
+        injector.submit(touches, kFingerCount, f * 0.0125, f * 0.0125);
+        for (size_t i = 0; i < kFingerCount; ++i) {
+            touches[i].phase = TouchPhase_Moved;
+        }
+    }
+    double elapsed = now() - start;
+    gSink = sink.eventCount;
+    if (gAllocationCount != allocationsBefore) {
+        fprintf(stderr, "uinput: allocated %zu times while injecting\n", gAllocationCount.load() - allocationsBefore);
+        return false;
+    }
+    printf("  %zu moving contacts          %6.1f ns/frame, %.0f events in one write per frame, no allocations\n", kFingerCount, elapsed / kFrames * 1e9, (double)sink.eventCount / sink.frameCount);
+    return true;
+}
+
+// Publishing
+
+static uint32_t readU32LE(unsigned char const *p) { return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24; }
+static uint16_t readU16LE(unsigned char const *p) { return (uint16_t)(p[0] | p[1] << 8); }
+static uint32_t readU32BE(unsigned char const *p) { return (uint32_t)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3]; }
+
+static float readF32LE(unsigned char const *p) {
+    uint32_t bits = readU32LE(p);
+    float value;
+    memcpy(&value, &bits, sizeof value);
+    return value;
+}
+
+// A local datagram socket that a subscriber reads from.
+struct TestSubscriber {
+    int fd;
+    std::string path; // for Unix-domain sockets
+    uint16_t port; // for UDP sockets
+    TouchPublisher::Encoding encoding;
+};
+
+static bool openTestSubscriber(TestSubscriber &subscriber, char const *directory, size_t index, bool unixDomain, TouchPublisher::Encoding encoding) {
+    subscriber.encoding = encoding;
+    subscriber.port = 0;
+    subscriber.fd = socket(unixDomain ? AF_UNIX : AF_INET, SOCK_DGRAM, 0);
+    if (subscriber.fd < 0)
+        return false;
+    fcntl(subscriber.fd, F_SETFL, O_NONBLOCK);
+    if (unixDomain) {
+        struct sockaddr_un address;
+        memset(&address, 0, sizeof address);
+        address.sun_family = AF_UNIX;
+        snprintf(address.sun_path, sizeof address.sun_path, "%s/subscriber%zu", directory, index);
+        subscriber.path = address.sun_path;
+        return bind(subscriber.fd, (struct sockaddr *)&address, sizeof address) == 0;
+    }
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof address);
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof address;
+    if (bind(subscriber.fd, (struct sockaddr *)&address, length) != 0 || getsockname(subscriber.fd, (struct sockaddr *)&address, &length) != 0)
+        return false;
+    subscriber.port = ntohs(address.sin_port);
+    return true;
+}
+
+static void closeTestSubscribers(vector<TestSubscriber> &subscribers) {
+    for (size_t i = 0; i < subscribers.size(); ++i) {
+        close(subscribers[i].fd);
+        if (!subscribers[i].path.empty()) {
+            unlink(subscribers[i].path.c_str());
+        }
+    }
+    subscribers.clear();
+}
+
+static size_t drainTestSubscribers(vector<TestSubscriber> const &subscribers) {
+    size_t count = 0;
+    unsigned char buffer[8192];
+    for (size_t i = 0; i < subscribers.size(); ++i) {
+        while (recv(subscribers[i].fd, buffer, sizeof buffer, 0) > 0) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+// I check a binary frame against what I published.
+static bool checkBinaryFrame(unsigned char const *bytes, size_t size, uint32_t sequence, TrackedTouch const *touches, size_t touchCount, Point const *screenPoints, SensorTouch const *sensorTouches, size_t sweepCount) {
+    if (size < 32 || memcmp(bytes, "MMTS", 4) != 0 || readU16LE(bytes + 4) != 1 || readU32LE(bytes + 12) != sequence)
+        return false;
+    size_t headerSize = readU16LE(bytes + 6);
+    size_t touchSize = readU16LE(bytes + 8);
+    size_t sweepSize = readU16LE(bytes + 10);
+    if (readU16LE(bytes + 24) != touchCount || readU16LE(bytes + 26) != sweepCount || size != headerSize + touchCount * touchSize + sweepCount * sweepSize)
+        return false;
+    for (size_t i = 0; i < touchCount; ++i) {
+        unsigned char const *record = bytes + headerSize + i * touchSize;
+        if (readU32LE(record) != touches[i].identifier || record[4] != touches[i].phase || readF32LE(record + 8) != (float)touches[i].position.x || readF32LE(record + 20) != (float)touches[i].predictedPosition.y)
+            return false;
+    }
+    for (size_t i = 0; i < sweepCount; ++i) {
+        unsigned char const *record = bytes + headerSize + touchCount * touchSize + i * sweepSize;
+        if (readU32LE(record) != sensorTouches[i].rayIndex || readU32LE(record + 8) != sensorTouches[i].sweep.length || readF32LE(record + 16) != (float)screenPoints[i].x)
+            return false;
+    }
+    return true;
+}
+
+// I find the alive touch count and the frame sequence number in a TUIO bundle.
+static bool readTUIOFrame(unsigned char const *bytes, size_t size, size_t &aliveCount, uint32_t &sequence) {
+    if (size < 16 || memcmp(bytes, "#bundle", 8) != 0)
+        return false;
+    aliveCount = 0;
+    bool sawSequence = false;
+    for (size_t offset = 16; offset + 4 <= size; ) {
+        size_t elementSize = readU32BE(bytes + offset);
+        unsigned char const *message = bytes + offset + 4;
+        if (offset + 4 + elementSize > size || strcmp((char const *)message, "/tuio/2Dcur") != 0)
+            return false;
+        char const *typeTags = (char const *)message + 12;
+        size_t typeTagsSize = (strlen(typeTags) + 4) & ~(size_t)3;
+        char const *command = typeTags + typeTagsSize;
+        if (strcmp(command, "alive") == 0) {
+            aliveCount = strlen(typeTags) - 2;
+        } else if (strcmp(command, "fseq") == 0) {
+            sequence = readU32BE((unsigned char const *)command + 8);
+            sawSequence = true;
+        }
+        offset += 4 + elementSize;
+    }
+    return sawSequence;
+}
+
+static bool benchmarkPublish() {
+    static size_t const kFrames = 20000;
+    static size_t const kTouchCount = 3;
+
+    printf("publish: sending touch frames to local subscribers\n");
+
+    char directory[] = "/tmp/touchBench-XXXXXX";
+    if (!mkdtemp(directory)) {
+        fprintf(stderr, "publish: mkdtemp: %s\n", strerror(errno));
+        return false;
+    }
+
+    TrackedTouch touches[kTouchCount];
+    Point screenPoints[kTouchCount];
+    SensorTouch sensorTouches[kTouchCount];
+    for (size_t i = 0; i < kTouchCount; ++i) {
+        touches[i] = injectedTouch((uint32_t)i + 7, i == 2 ? TouchPhase_Ended : TouchPhase_Moved, Point(300 + 400 * i, 200 + 100 * i));
+        touches[i].velocity = Point(50, -20);
+        screenPoints[i] = touches[i].position;
+        sensorTouches[i] = SensorTouch(100 + 50 * i, 800 + 10 * i, SweepRange(98 + 50 * i, 5));
+    }
+
+    bool ok = true;
+    vector<TestSubscriber> subscribers;
+    for (size_t i = 0; ok && i < 4; ++i) {
+        TestSubscriber subscriber;
+        ok = openTestSubscriber(subscriber, directory, i, i < 2, i == 3 ? TouchPublisher::Encoding_TUIO : TouchPublisher::Encoding_Binary);
+        subscribers.push_back(subscriber);
+    }
+
+    TouchPublisher publisher;
+    for (size_t i = 0; ok && i < subscribers.size(); ++i) {
+        TestSubscriber const &subscriber = subscribers[i];
+        ok = subscriber.path.empty() ? publisher.addUDPSubscriber(subscriber.port, subscriber.encoding) : publisher.addUnixSubscriber(subscriber.path.c_str(), subscriber.encoding);
+    }
+    std::string absentPath = std::string(directory) + "/absent";
+    ok = ok && publisher.addUnixSubscriber(absentPath.c_str());
+    if (!ok) {
+        fprintf(stderr, "publish: can't set up subscribers: %s\n", strerror(errno));
+        closeTestSubscribers(subscribers);
+        rmdir(directory);
+        return false;
+    }
+
+    // Every subscriber that's there gets each frame, in its encoding.
+    for (uint32_t frame = 0; ok && frame < 3; ++frame) {
+        publisher.publish(frame * 0.025, touches, kTouchCount, screenPoints, sensorTouches, kTouchCount);
+        for (size_t i = 0; ok && i < subscribers.size(); ++i) {
+            unsigned char buffer[8192];
+            ssize_t size = recv(subscribers[i].fd, buffer, sizeof buffer, 0);
+            size_t aliveCount = 0;
+            uint32_t sequence = ~0u;
+            ok = size > 0 && (subscribers[i].encoding == TouchPublisher::Encoding_Binary
+                ? checkBinaryFrame(buffer, size, frame, touches, kTouchCount, screenPoints, sensorTouches, kTouchCount)
+                : readTUIOFrame(buffer, size, aliveCount, sequence) && aliveCount == kTouchCount - 1 && sequence == frame);
+            if (!ok) {
+                fprintf(stderr, "publish: subscriber %zu got a bad frame %u\n", i, frame);
+            }
+        }
+    }
+    TouchPublisher::SubscriberStatistics const &absent = publisher.subscriberStatistics(subscribers.size());
+    if (ok && (absent.droppedCount != 3 || publisher.encodingCount() != 6)) {
+        fprintf(stderr, "publish: dropped %zu frames for the absent subscriber and encoded %zu times for 3 frames\n", absent.droppedCount, publisher.encodingCount());
+        ok = false;
+    }
+    if (ok) {
+        printf("  round trip                 %zu subscribers decode 3 frames (%zu-byte binary, %zu-byte TUIO), absent subscriber dropped (%s)\n", subscribers.size(), publisher.frameSize(TouchPublisher::Encoding_Binary), publisher.frameSize(TouchPublisher::Encoding_TUIO), strerror(absent.lastError));
+    }
+
+    // Publishing costs one encoding per frame however many subscribers there are, plus a send per subscriber.
+    size_t const subscriberCounts[] = { 1, 8 };
+    for (size_t c = 0; ok && c < sizeof subscriberCounts / sizeof subscriberCounts[0]; ++c) {
+        closeTestSubscribers(subscribers);
+        publisher.removeAllSubscribers();
+        for (size_t i = 0; ok && i < subscriberCounts[c]; ++i) {
+            TestSubscriber subscriber;
+            ok = openTestSubscriber(subscriber, directory, i, true, TouchPublisher::Encoding_Binary) && publisher.addUnixSubscriber(subscriber.path.c_str());
+            subscribers.push_back(subscriber);
+        }
+        if (!ok)
+            break;
+        size_t encodingsBefore = publisher.encodingCount();
+        size_t allocationsBefore = gAllocationCount;
+        size_t received = 0;
+        double elapsed = 0;
+        for (size_t frame = 0; frame < kFrames; ++frame) {
+            double start = now();
+            publisher.publish(frame * 0.025, touches, kTouchCount, screenPoints, sensorTouches, kTouchCount);
+            elapsed += now() - start;
+            received += drainTestSubscribers(subscribers);
+        }
+        size_t allocations = gAllocationCount - allocationsBefore;
+        size_t encodings = publisher.encodingCount() - encodingsBefore;
+        printf("  %zu Unix subscriber%s       %6.0f ns/frame, %zu encodings for %zu frames, %zu received\n", subscriberCounts[c], subscriberCounts[c] == 1 ? " " : "s", elapsed / kFrames * 1e9, encodings, kFrames, received);
+        if (encodings != kFrames) {
+            fprintf(stderr, "publish: encoded %zu times for %zu frames\n", encodings, kFrames);
+            ok = false;
+        }
+        if (allocations > 0) {
+            fprintf(stderr, "publish: allocated %zu times while publishing\n", allocations);
+            ok = false;
+        }
+    }
+
+    closeTestSubscribers(subscribers);
+    rmdir(directory);
+    return ok;
+}
+
+// Calibration files
+
+// I return true if `text` reads as calibration data, and report an exception as a failure.
+static bool readCalibrationText(char const *text, CalibrationData &data, bool &threw) {
+    threw = false;
+    FILE *file = tmpfile();
+    if (!file)
+        return false;
+    fputs(text, file);
+    rewind(file);
+    bool ok = false;
+    try {
+        ok = readCalibrationData(file, data);
+    } catch (std::exception const &) {
+        threw = true;
+    }
+    fclose(file);
+    return ok;
+}
+
+static bool benchmarkCalibration() {
+    static size_t const kReads = 2000;
+
+    printf("calibration: reading and writing calibration files\n");
+
+    CalibrationData written = makeEngineCalibration(1440);
+    written.thresholds[7] = kInvalidDistance;
+    FILE *file = tmpfile();
+    if (!file || !writeCalibrationData(written, file)) {
+        fprintf(stderr, "calibration: can't write a calibration file: %s\n", strerror(errno));
+        return false;
+    }
+    long size = ftell(file);
+    std::string text((size_t)size, '\0');
+    rewind(file);
+    bool ok = fread(&text[0], 1, text.size(), file) == text.size();
+    fclose(file);
+
+    CalibrationData data;
+    bool threw;
+    ok = ok && readCalibrationText(text.c_str(), data, threw) && data.thresholdsReady
+        && data.thresholds.size() == written.thresholds.size() && !isValidDistance(data.thresholds[7]) && data.thresholds[8] == written.thresholds[8]
+        && data.sensorPoints.size() == 3 && data.screenPoints[2].x == written.screenPoints[2].x;
+    if (!ok) {
+        fprintf(stderr, "calibration: the round trip lost data\n");
+        return false;
+    }
+
+    // A corrupt file is just invalid, however big the counts in it claim to be.
+    static char const *const kCorruptFiles[] = {
+        "touch-engine-calibration 1\nthresholds 99999999999 1 2 3\ntouches 0\n",
+        "touch-engine-calibration 1\nthresholds 18446744073709551615\n",
+        "touch-engine-calibration 1\nthresholds -1 5\n",
+        "touch-engine-calibration 1\nthresholds 8193\n",
+        "touch-engine-calibration 1\nthresholds x\n",
+        "touch-engine-calibration 1\nthresholds 3 1 2\n",
+        "touch-engine-calibration 1\nthresholds -\ntouches 99999999999\n1 2 3 4\n",
+        "touch-engine-calibration 2\nthresholds -\ntouches 0\n",
+    };
+    size_t const corruptCount = sizeof kCorruptFiles / sizeof kCorruptFiles[0];
+    for (size_t i = 0; i < corruptCount; ++i) {
+        if (readCalibrationText(kCorruptFiles[i], data, threw) || threw) {
+            fprintf(stderr, "calibration: corrupt file %zu %s\n", i, threw ? "threw" : "read as valid");
+            return false;
+        }
+    }
+    printf("  round trip                 %zu thresholds and 3 touches; %zu corrupt files rejected\n", written.thresholds.size(), corruptCount);
+
+    double start = now();
+    for (size_t i = 0; ok && i < kReads; ++i) {
+        ok = readCalibrationText(text.c_str(), data, threw);
+    }
+    double elapsed = now() - start;
+    if (!ok) {
+        fprintf(stderr, "calibration: a read failed\n");
+        return false;
+    }
+    printf("  read %5ld bytes           %8.1f us/file\n", size, elapsed / kReads * 1e6);
+    return true;
+}
+
+// Scan bus
+
+static Distance scanBusDistance(uint64_t sequence, size_t ray) {
+    return (Distance)((sequence * 31 + ray) % 5000);
+}
+
+static void fillScanBusScan(ScanBusWriter const &writer, vector<Distance> &distances) {
+    for (size_t i = 0; i < distances.size(); ++i) {
+        distances[i] = scanBusDistance(writer.publishedCount(), i);
+    }
+}
+
+static void publishScanBusScan(ScanBusWriter &writer, vector<Distance> &distances, double timestamp) {
+    fillScanBusScan(writer, distances);
+    writer.publish(&distances[0], distances.size(), timestamp, timestamp, (uint32_t)(writer.publishedCount() * 25));
+}
+
+static bool scanBusScanHasPattern(ScanBusScan const &scan, size_t rayCount) {
+    if (scan.count != rayCount)
+        return false;
+    bool ok = true;
+    for (size_t i = 0; i < rayCount; ++i) {
+        ok &= scan.distances[i] == scanBusDistance(scan.sequence, i);
+    }
+    return ok;
+}
+
+// I check the ring's bookkeeping in one process, with a ring small enough to overrun on purpose.
+static bool checkScanBus(char const *name) {
+    static size_t const kRayCount = 16;
+
+    ScanBusReader missing;
+    if (missing.attach(name) || errno != ENOENT) {
+        fprintf(stderr, "scanbus: attached to a bus that doesn't exist\n");
+        return false;
+    }
+
+    ScanBusWriter writer;
+    ScanBusReader reader;
+    if (!writer.create(name, 4, kRayCount, SensorGeometry(kRayCount, 240)) || !reader.attach(name)) {
+        fprintf(stderr, "scanbus: can't make a bus: %s\n", strerror(errno));
+        return false;
+    }
+    vector<Distance> distances(kRayCount);
+    ScanBusScan scan;
+    bool ok = reader.geometry().rayCount == kRayCount && reader.slotCount() == 4 && !reader.nextScan(scan);
+
+    // A reader that keeps up gets every scan.
+    publishScanBusScan(writer, distances, 1);
+    ok = ok && reader.nextScan(scan) && scan.sequence == 0 && scan.timestamp == 1 && scanBusScanHasPattern(scan, kRayCount) && reader.isIntact(scan) && !reader.nextScan(scan);
+
+    // A reader that falls behind skips to the oldest scan the writer can't be changing, and counts the rest.
+    for (int i = 0; i < 10; ++i) {
+        publishScanBusScan(writer, distances, 2 + i);
+    }
+    ok = ok && reader.nextScan(scan) && scan.sequence == 8 && scanBusScanHasPattern(scan, kRayCount) && reader.overrunCount() == 7;
+
+    // Once the writer comes around to a scan's slot, the scan isn't intact any more.
+    bool wasIntact = reader.isIntact(scan);
+    for (int i = 0; i < 4; ++i) {
+        publishScanBusScan(writer, distances, 12 + i);
+    }
+    ok = ok && wasIntact && !reader.isIntact(scan);
+
+    ok = ok && reader.latestScan(scan) && scan.sequence == 14 && scanBusScanHasPattern(scan, kRayCount) && reader.overrunCount() == 7 && !reader.nextScan(scan);
+    if (!ok) {
+        fprintf(stderr, "scanbus: the ring's bookkeeping is wrong\n");
+        return false;
+    }
+    printf("  ring                       in order, 7 overrun scans skipped and counted, overwritten scan detected\n");
+    return true;
+}
+
+struct ScanBusConsumerResult {
+    size_t scanCount;
+    size_t badScanCount; // scans whose distances were wrong or that the writer overwrote while I read them
+    uint64_t overrunCount;
+    uint64_t lastSequence;
+    double readSeconds;
+    double latencySum;
+    double worstLatency;
+};
+
+// I run in a child process.  I read every scan in place until the last one, check its distances, and send my result to the parent.
+static void runScanBusConsumer(char const *name, size_t scanCount, size_t rayCount, int readyFd, int resultFd) {
+    ScanBusReader reader;
+    char ready = reader.attach(name) ? 1 : 0;
+    if (write(readyFd, &ready, 1) != 1 || !ready)
+        _exit(1);
+
+    ScanBusConsumerResult result;
+    memset(&result, 0, sizeof result);
+    double deadline = now() + scanCount / 40.0 + 2;
+    while (result.lastSequence + 1 < scanCount && now() < deadline) {
+        ScanBusScan scan;
+        double start = now();
+        if (!reader.nextScan(scan)) {
+            usleep(100);
+            continue;
+        }
+        bool good = scanBusScanHasPattern(scan, rayCount) && reader.isIntact(scan);
+        double end = now();
+        result.readSeconds += end - start;
+        result.latencySum += end - scan.timestamp;
+        result.worstLatency = std::max(result.worstLatency, end - scan.timestamp);
+        result.scanCount += 1;
+        result.badScanCount += good ? 0 : 1;
+        result.lastSequence = scan.sequence;
+    }
+    result.overrunCount = reader.overrunCount();
+    _exit(write(resultFd, &result, sizeof result) == (ssize_t)sizeof result ? 0 : 1);
+}
+
+static bool benchmarkScanBus() {
+    static size_t const kRayCount = 1440;
+    static size_t const kSlotCount = 16;
+    static size_t const kScanCount = 120;
+    static size_t const kConsumerCount = 8;
+    static double const kScanInterval = 1 / 40.0;
+
+    printf("scanbus: sharing scans with other processes\n");
+
+    char name[64];
+    snprintf(name, sizeof name, "/touchBench-%d", (int)getpid());
+    if (!checkScanBus(name))
+        return false;
+
+    ScanBusWriter writer;
+    if (!writer.create(name, kSlotCount, kRayCount, SensorGeometry(kRayCount, 240))) {
+        fprintf(stderr, "scanbus: can't make a bus: %s\n", strerror(errno));
+        return false;
+    }
+    int readyPipe[2], resultPipe[2];
+    if (pipe(readyPipe) != 0 || pipe(resultPipe) != 0) {
+        fprintf(stderr, "scanbus: pipe: %s\n", strerror(errno));
+        return false;
+    }
+
+    // The consumers are separate processes that only share the bus with me.
+    fflush(stdout);
+    fflush(stderr);
+    vector<pid_t> consumers;
+    bool ok = true;
+    for (size_t i = 0; ok && i < kConsumerCount; ++i) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            runScanBusConsumer(name, kScanCount, kRayCount, readyPipe[1], resultPipe[1]);
+        }
+        ok = pid > 0;
+        if (ok) {
+            consumers.push_back(pid);
+        }
+    }
+    for (size_t i = 0; ok && i < consumers.size(); ++i) {
+        char ready = 0;
+        ok = read(readyPipe[0], &ready, 1) == 1 && ready;
+    }
+
+    // I publish at the sensor's rate, timestamping each scan when I publish it, so a consumer's latency is how long the scan waited on the bus.
+    vector<Distance> distances(kRayCount);
+    double publishSeconds = 0;
+    double worstPublish = 0;
+    size_t allocationsBefore = gAllocationCount;
+    double next = now();
+    for (size_t s = 0; ok && s < kScanCount; ++s) {
+        double delay = next - now();
+        if (delay > 0) {
+            usleep((useconds_t)(delay * 1e6));
+        }
+        fillScanBusScan(writer, distances);
+        double start = now();
+        writer.publish(&distances[0], kRayCount, start, start, (uint32_t)(s * 25));
+        double elapsed = now() - start;
+        publishSeconds += elapsed;
+        worstPublish = std::max(worstPublish, elapsed);
+        next += kScanInterval;
+    }
+    size_t allocations = gAllocationCount - allocationsBefore;
+
+    ScanBusConsumerResult total;
+    memset(&total, 0, sizeof total);
+    size_t resultCount = 0;
+    for (size_t i = 0; ok && i < consumers.size(); ++i) {
+        ScanBusConsumerResult result;
+        ok = read(resultPipe[0], &result, sizeof result) == (ssize_t)sizeof result;
+        if (ok) {
+            total.scanCount += result.scanCount;
+            total.badScanCount += result.badScanCount;
+            total.overrunCount += result.overrunCount;
+            total.readSeconds += result.readSeconds;
+            total.latencySum += result.latencySum;
+            total.worstLatency = std::max(total.worstLatency, result.worstLatency);
+            resultCount += result.lastSequence + 1 == kScanCount ? 1 : 0;
+        }
+    }
+    for (size_t i = 0; i < consumers.size(); ++i) {
+        int status;
+        waitpid(consumers[i], &status, 0);
+    }
+    close(readyPipe[0]);
+    close(readyPipe[1]);
+    close(resultPipe[0]);
+    close(resultPipe[1]);
+    writer.destroy();
+
+    if (!ok || resultCount != kConsumerCount) {
+        fprintf(stderr, "scanbus: only %zu of %zu consumers read to the last scan\n", resultCount, kConsumerCount);
+        return false;
+    }
+    printf("  publish                    %6.0f ns/scan (worst %.0f ns), %zu rays at 40 Hz into %zu slots\n", publishSeconds / kScanCount * 1e9, worstPublish * 1e9, kRayCount, kSlotCount);
+    printf("  read in place              %6.0f ns/scan, %zu consumers\n", total.readSeconds / std::max(total.scanCount, (size_t)1) * 1e9, kConsumerCount);
+    printf("  latency                    %6.1f us mean, %.1f us worst, %zu scans read, %llu overrun\n", total.latencySum / std::max(total.scanCount, (size_t)1) * 1e6, total.worstLatency * 1e6, total.scanCount, (unsigned long long)total.overrunCount);
+    if (total.badScanCount > 0) {
+        fprintf(stderr, "scanbus: consumers read %zu bad scans\n", total.badScanCount);
+        ok = false;
+    }
+    if (total.scanCount + total.overrunCount != kConsumerCount * kScanCount) {
+        fprintf(stderr, "scanbus: consumers read %zu and lost %llu of %zu scans\n", total.scanCount, (unsigned long long)total.overrunCount, kConsumerCount * kScanCount);
+        ok = false;
+    }
+    if (allocations > 0) {
+        fprintf(stderr, "scanbus: allocated %zu times while publishing\n", allocations);
+        ok = false;
+    }
+    return ok;
+}
+
+// Driver
+
+struct Benchmark {
+    char const *name;
+    bool (*run)();
+};
+
+static Benchmark const kBenchmarks[] = {
+    { "sweeps", benchmarkSweeps },
+    { "background", benchmarkBackground },
+    { "tracker", benchmarkTracker },
+    { "prediction", benchmarkPrediction },
+    { "mapping", benchmarkMapping },
+    { "fit", benchmarkFit },
+    { "correction", benchmarkCorrection },
+    { "filter", benchmarkFilter },
+    { "clustering", benchmarkClustering },
+    { "selection", benchmarkSelection },
+    { "region", benchmarkRegion },
+    { "change", benchmarkChange },
+    { "calibration", benchmarkCalibration },
+    { "idle", benchmarkIdle },
+    { "fusion", benchmarkFusion },
+    { "interleave", benchmarkInterleave },
+    { "gestures", benchmarkGestures },
+    { "uinput", benchmarkUinput },
+    { "publish", benchmarkPublish },
+    { "scanbus", benchmarkScanBus },
+};
+
+int main(int argc, char *argv[]) {
+    size_t const benchmarkCount = sizeof kBenchmarks / sizeof kBenchmarks[0];
+    bool ok = true;
+    if (argc < 2) {
+        for (size_t i = 0; i < benchmarkCount; ++i) {
+            ok = kBenchmarks[i].run() && ok;
+        }
+        return ok ? 0 : 1;
+    }
+
+    for (int a = 1; a < argc; ++a) {
+        Benchmark const *benchmark = NULL;
+        for (size_t i = 0; i < benchmarkCount; ++i) {
+            if (strcmp(argv[a], kBenchmarks[i].name) == 0) {
+                benchmark = &kBenchmarks[i];
+            }
+        }
+        if (!benchmark) {
+            fprintf(stderr, "usage: %s [benchmark...]\nbenchmarks:", argv[0]);
+            for (size_t i = 0; i < benchmarkCount; ++i) {
+                fprintf(stderr, " %s", kBenchmarks[i].name);
+            }
+            fputc('\n', stderr);
+            return 2;
+        }
+        ok = benchmark->run() && ok;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,286 @@
+//
+//  touchReplay.cpp
+//  mickeyMouse
+//
+//  Copyright (c) 2012 Rob Mayoff. All rights reserved.
+//
+
+// I run a scan recording through the touch engine and print what it does: state changes, calibration results and the touches it detects.  When I'm done, I print how long the engine spent on each scan to standard error.
+//
+// usage: touchReplay [-c calibration] [-o calibration] [-d] [-m length] [-n] [-b bus] [-p socket] [-u port] [-s selection] [-q] [-t] [recording]
+//
+//   -c  Restore this calibration (written by -o) before replaying, so a recording of plain scans can be replayed in touch detection.
+//   -o  Write the engine's calibration here after replaying.
+//   -d  Skip scans that haven't changed since the last one the engine processed, while no touches are down.
+//   -m  Filter each ray with a median over this many scans (1, 3 or 5) before detecting touches.
+//   -n  Map touches through a non-linear correction grid when the calibration has enough touches for one.
+//   -b  Put every scan on a `ScanBusWriter` with this POSIX shared memory name, like the app's `scanBusName` default, for testing scan bus readers.  I replay as fast as I can, so a reader that isn't fast enough will overrun.
+//   -p  Publish every frame of touches to the Unix-domain datagram socket at this path, in `TouchPublisher`'s binary encoding.  You can give this more than once.
+//   -u  Publish every frame of touches as TUIO to this UDP port on the loopback interface.  You can give this more than once.
+//   -s  Select touches with this selection: middle (the default), ewma, centroid, trimmed or cluster.
+//   -q  Don't print touches, just the timing summary.
+//   -t  Print tracked touches, with their identifiers, phases and predicted positions, instead of the raw touches of each scan.
+//
+// I read the recording from standard input if you don't name one.
+
+#include "ScanBus.h"
+#include "ScanRecording.h"
+#include "TouchEngine.h"
+#include "TouchPublisher.h"
+#include <algorithm>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+using namespace TouchEngine;
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static char const *calibrationResultName(CalibrationResult result) {
+    switch (result) {
+        case CalibrationResult_Success: return "success";
+        case CalibrationResult_NoTouchDetected: return "no-touch";
+        case CalibrationResult_MultipleTouchesDetected: return "multiple-touches";
+    }
+    return "unknown";
+}
+
+class Printer : public EngineObserver {
+public:
+    Printer() : quiet(false), tracks(false), publisher(NULL), previousTouchCount_(0) { }
+
+    bool quiet;
+    bool tracks;
+    TouchPublisher *publisher;
+
+    virtual void engineDidChangeState(Engine &engine, State state) {
+        (void)engine;
+        printf("state %s\n", stateName(state));
+    }
+
+    virtual void engineDidFinishCalibratingThreshold(Engine &engine) {
+        printf("thresholds calibrated for %zu rays\n", engine.thresholdCalibration().thresholds()->size());
+    }
+
+    virtual void engineDidFinishCalibratingTouch(Engine &engine, Point screenPoint, CalibrationResult result) {
+        (void)engine;
+        printf("touch calibration at %g,%g: %s\n", screenPoint.x, screenPoint.y, calibrationResultName(result));
+    }
+
+    virtual void engineDidDetectTouches(Engine &engine, Point const *points, size_t count, double timestamp) {
+        (void)engine;
+        // I only print the scans where something is touching, plus the first scan after the last touch lifts.
+        if (!quiet && !tracks && (count > 0 || previousTouchCount_ > 0)) {
+            printf("%.6f touches %zu", timestamp, count);
+            for (size_t i = 0; i < count; ++i) {
+                printf(" %.1f,%.1f", points[i].x, points[i].y);
+            }
+            putchar('\n');
+        }
+        previousTouchCount_ = count;
+    }
+
+    virtual void engineDidTrackTouches(Engine &engine, TrackedTouch const *touches, size_t count, double timestamp) {
+        if (publisher) {
+            std::vector<Point> const &points = engine.detectedScreenPoints();
+            publisher->publish(timestamp, touches, count, points.data(), engine.detectedSensorTouches().data(), points.size());
+        }
+        if (quiet || !tracks || count == 0)
+            return;
+        printf("%.6f tracks %zu", timestamp, count);
+        for (size_t i = 0; i < count; ++i) {
+            TrackedTouch const &touch = touches[i];
+            printf(" %u:%s:%.1f,%.1f>%.1f,%.1f", touch.identifier, touchPhaseName(touch.phase), touch.position.x, touch.position.y, touch.predictedPosition.x, touch.predictedPosition.y);
+        }
+        putchar('\n');
+    }
+
+private:
+    size_t previousTouchCount_;
+};
+
+static bool restoreCalibration(Engine &engine, char const *path) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "error: %s: %s\n", path, strerror(errno));
+        return false;
+    }
+    CalibrationData data;
+    bool ok = readCalibrationData(file, data);
+    fclose(file);
+    if (!ok) {
+        fprintf(stderr, "error: %s: not a calibration file\n", path);
+        return false;
+    }
+    engine.restoreCalibrationData(data);
+    return true;
+}
+
+static bool saveCalibration(Engine const &engine, char const *path) {
+    FILE *file = fopen(path, "w");
+    if (!file || !writeCalibrationData(engine.calibrationData(), file) || fclose(file) != 0) {
+        fprintf(stderr, "error: %s: %s\n", path, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    char const *calibrationInPath = NULL;
+    char const *calibrationOutPath = NULL;
+    bool nonlinearCorrection = false;
+    bool changeDetection = false;
+    size_t scanFilterLength = 1;
+    char const *selectionName = NULL;
+    Printer printer;
+    TouchPublisher publisher;
+    char const *scanBusName = NULL;
+    ScanBusWriter scanBus;
+    // Recordings come from the app, whose screen coordinates are Cocoa's.
+    TouchPublisher::Parameters publisherParameters;
+    publisherParameters.screenYGrowsUp = true;
+
+    int option;
+    while ((option = getopt(argc, argv, "c:o:dm:nb:p:u:s:qt")) != -1) {
+        switch (option) {
+            case 'c': calibrationInPath = optarg; break;
+            case 'o': calibrationOutPath = optarg; break;
+            case 'd': changeDetection = true; break;
+            case 'm': scanFilterLength = (size_t)atoi(optarg); break;
+            case 'n': nonlinearCorrection = true; break;
+            case 'b': scanBusName = optarg; break;
+            case 'p':
+                if (!publisher.addUnixSubscriber(optarg)) {
+                    fprintf(stderr, "error: %s: %s\n", optarg, strerror(errno));
+                    return 1;
+                }
+                break;
+            case 'u':
+                if (!publisher.addUDPSubscriber((uint16_t)atoi(optarg))) {
+                    fprintf(stderr, "error: UDP port %s: %s\n", optarg, strerror(errno));
+                    return 1;
+                }
+                break;
+            case 's': selectionName = optarg; break;
+            case 'q': printer.quiet = true; break;
+            case 't': printer.tracks = true; break;
+            default:
+                fprintf(stderr, "usage: %s [-c calibration] [-o calibration] [-d] [-m length] [-n] [-b bus] [-p socket] [-u port] [-s selection] [-q] [-t] [recording]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    FILE *recording = stdin;
+    if (optind < argc) {
+        recording = fopen(argv[optind], "r");
+        if (!recording) {
+            fprintf(stderr, "error: %s: %s\n", argv[optind], strerror(errno));
+            return 1;
+        }
+    }
+
+    publisher.setParameters(publisherParameters);
+    if (publisher.subscriberCount() > 0) {
+        printer.publisher = &publisher;
+    }
+
+    Engine engine(printer);
+    engine.setNonlinearCorrectionEnabled(nonlinearCorrection);
+    engine.setChangeDetectionEnabled(changeDetection);
+    if (scanFilterLength != 1 && scanFilterLength != 3 && scanFilterLength != 5) {
+        fprintf(stderr, "error: the scan filter length must be 1, 3 or 5\n");
+        return 2;
+    }
+    engine.setScanFilterLength(scanFilterLength);
+    if (selectionName) {
+        std::unique_ptr<SweepSelection> selection = makeSweepSelection(selectionName);
+        if (!selection) {
+            fprintf(stderr, "error: unknown selection %s; choose from", selectionName);
+            for (char const *const *name = kSweepSelectionNames; *name; ++name) {
+                fprintf(stderr, " %s", *name);
+            }
+            fprintf(stderr, "\n");
+            return 2;
+        }
+        engine.setSweepSelection(std::move(selection));
+    }
+    if (calibrationInPath && !restoreCalibration(engine, calibrationInPath))
+        return 1;
+
+    ScanRecordingReader reader(recording);
+    RecordingEvent event;
+    std::vector<Rect> screens;
+    size_t scanCount = 0;
+    double totalSeconds = 0;
+    double worstSeconds = 0;
+
+    while (reader.readEvent(event)) {
+        switch (event.kind) {
+            case RecordingEvent::Kind_Geometry:
+                engine.setGeometry(event.geometry);
+                if (scanBusName) {
+                    scanBus.destroy();
+                    if (!scanBus.create(scanBusName, 16, event.geometry.rayCount, event.geometry)) {
+                        fprintf(stderr, "error: scan bus %s: %s\n", scanBusName, strerror(errno));
+                        return 1;
+                    }
+                }
+                break;
+            case RecordingEvent::Kind_Screen:
+                screens.push_back(event.screen);
+                engine.setScreenRects(screens);
+                if (screens.size() == 1) {
+                    publisherParameters.screen = event.screen;
+                    publisher.setParameters(publisherParameters);
+                }
+                break;
+            case RecordingEvent::Kind_CalibrateThresholds:
+                if (engine.canStartCalibratingThreshold()) {
+                    engine.startCalibratingThreshold();
+                } else {
+                    printf("ignoring calibrate-thresholds in state %s\n", stateName(engine.state()));
+                }
+                break;
+            case RecordingEvent::Kind_CalibrateTouch:
+                if (engine.canStartCalibratingTouch()) {
+                    engine.startCalibratingTouchAtPoint(event.screenPoint);
+                } else {
+                    printf("ignoring calibrate-touch in state %s\n", stateName(engine.state()));
+                }
+                break;
+            case RecordingEvent::Kind_Scan: {
+                if (scanBus.isCreated() && event.distances.size() <= scanBus.maximumRayCount()) {
+                    scanBus.publish(event.distances.data(), event.distances.size(), event.timestamp, event.timestamp, (uint32_t)(event.timestamp * 1000));
+                }
+                double start = now();
+                engine.processScan(event.distances.data(), event.distances.size(), event.timestamp);
+                double elapsed = now() - start;
+                ++scanCount;
+                totalSeconds += elapsed;
+                worstSeconds = std::max(worstSeconds, elapsed);
+                break;
+            }
+        }
+    }
+
+    if (!reader.errorMessage().empty()) {
+        fprintf(stderr, "error: %s\n", reader.errorMessage().c_str());
+        return 1;
+    }
+
+    fprintf(stderr, "%zu scans, %.3f us mean, %.3f us worst per scan (including printing)\n", scanCount, scanCount ? totalSeconds / scanCount * 1e6 : 0, worstSeconds * 1e6);
+    if (changeDetection) {
+        fprintf(stderr, "%zu scans skipped as unchanged\n", engine.skippedScanCount());
+    }
+
+    if (calibrationOutPath && !saveCalibration(engine, calibrationOutPath))
+        return 1;
+    return 0;
+}
@@ -5,6 +5,7 @@ Copyright (c) 2012 Rob Mayoff. All rights reserved.
 
 #import "Dumper.h"
 #import "Lidar2D.h"
+#import "NSData+Lidar2D.h"
 
 @interface Dumper () <Lidar2DObserver>
 @end
@@ -36,6 +37,8 @@ Copyright (c) 2012 Rob Mayoff. All rights reserved.
 
 - (void)lidar2dDidConnect:(Lidar2D *)device {
     NSLog(@"device %@ connected", device);
+    printf("# device %s serial %s\n", device.devicePath.UTF8String, device.serialNumber.UTF8String);
+    printf("geometry %lu %.17g\n", (unsigned long)device.rayCount, device.coverageDegrees);
 }
 
 - (void)lidar2dDidDisconnect:(Lidar2D *)device {
@@ -48,12 +51,19 @@ Copyright (c) 2012 Rob Mayoff. All rights reserved.
     myself_ = nil;
 }
 
-- (void)lidar2d:(Lidar2D *)device didReceiveDistances:(const Lidar2DDistance *)distances {
-    NSMutableString *string = [[NSMutableString alloc] init];
-    for (NSUInteger i = 0, l = device.rayCount; i < l; ++i) {
-        [string appendFormat:@"%u ", distances[i]];
+// I print each report as a `scan` line of a `TouchEngine` scan recording, so `touchReplay` can replay my output.
+- (void)lidar2d:(Lidar2D *)device didReceiveDistanceData:(NSData *)distanceData {
+    (void)device;
+    Lidar2DDistance const *distances = distanceData.lidar2D_distances;
+    printf("scan %.6f", CFAbsoluteTimeGetCurrent());
+    for (NSUInteger i = 0, l = distanceData.lidar2D_distanceCount; i < l; ++i) {
+        if (isLidar2DDistanceValid(distances[i])) {
+            printf(" %g", distances[i]);
+        } else {
+            fputs(" -", stdout);
+        }
     }
-    printf("device %s reported distances: %s\n", device.description.UTF8String, string.UTF8String);
+    putchar('\n');
 }
 
 @end
@@ -0,0 +1,70 @@
+#ifndef URG_SERIAL_PROBE_H
+#define URG_SERIAL_PROBE_H
+
+/*!
+  \file
+  \brief Concurrent identification of serial ports
+
+  urg_serial_probe_ports() opens every port that urg_serial_find_port()
+  finds at the same time, asks each one for its version information, and
+  waits for all of the answers within a single deadline.  Scanning many
+  ports therefore costs about one timeout, not one baud rate detection per
+  port.
+
+  The probe multiplexes the ports with poll(), so it is only available on
+  POSIX systems.  On Windows, urg_serial_probe_ports() is not declared;
+  open each port with urg_open() instead.
+*/
+
+#include "urg_detect_os.h"
+
+#if !defined(URG_WINDOWS_OS)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum {
+    URG_SERIAL_PROBE_NAME_SIZE = 255,
+    URG_SERIAL_PROBE_FIELD_SIZE = 128,
+};
+
+
+//! What urg_serial_probe_ports() learned about one port
+typedef struct
+{
+    char port[URG_SERIAL_PROBE_NAME_SIZE]; /*!< Port name */
+    int is_urg;                 /*!< 1 if the port answered VV, 0 otherwise */
+    long baudrate;              /*!< Baud rate of the answer [bps] */
+    char vendor[URG_SERIAL_PROBE_FIELD_SIZE]; /*!< VEND field */
+    char product[URG_SERIAL_PROBE_FIELD_SIZE]; /*!< PROD field (model) */
+    char firmware[URG_SERIAL_PROBE_FIELD_SIZE]; /*!< FIRM field */
+    char protocol[URG_SERIAL_PROBE_FIELD_SIZE]; /*!< PROT field */
+    char serial_id[URG_SERIAL_PROBE_FIELD_SIZE]; /*!< SERI field */
+} urg_serial_probe_t;
+
+
+/*!
+  \brief Identifies every serial port at once
+
+  Sends "SCIP2.0" and "VV" to every port found by urg_serial_find_port(),
+  trying 115200, 19200 and 38400 bps in turn, and fills one entry of
+  \a results per port.  A port that cannot be opened or does not answer
+  before \a timeout_msec has is_urg set to 0.
+
+  \param[out] results Probe results, one per port
+  \param[in] max_results Capacity of \a results
+  \param[in] timeout_msec Deadline for the whole scan [msec]
+
+  \retval >=0 Number of entries filled in \a results
+*/
+extern int urg_serial_probe_ports(urg_serial_probe_t *results,
+                                  int max_results, int timeout_msec);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !URG_WINDOWS_OS */
+
+#endif /* !URG_SERIAL_PROBE_H */
@@ -0,0 +1,50 @@
+/*!
+  \brief Identifies the sensors on all serial ports at once
+*/
+
+#include "urg_serial_probe.h"
+#include <stdio.h>
+
+#if defined(URG_WINDOWS_OS)
+
+int main(void)
+{
+    printf("urg_serial_probe_ports: not supported on Windows.\n");
+    return 1;
+}
+
+#else
+
+
+enum {
+    MAX_PORTS = 32,
+    TIMEOUT_MSEC = 1000,
+};
+
+
+int main(void)
+{
+    urg_serial_probe_t results[MAX_PORTS];
+    int n = urg_serial_probe_ports(results, MAX_PORTS, TIMEOUT_MSEC);
+    int i;
+
+    if (n == 0) {
+        printf("could not found ports.\n");
+        return 1;
+    }
+
+    for (i = 0; i < n; ++i) {
+        urg_serial_probe_t *result = &results[i];
+        printf("%s", result->port);
+        if (result->is_urg) {
+            printf(" [URG] %ld bps, %s, serial %s, firmware %s",
+                   result->baudrate, result->product,
+                   result->serial_id, result->firmware);
+        }
+        printf("\n");
+    }
+
+    return 0;
+}
+
+#endif
@@ -8,6 +8,8 @@
 */
 
 #include <fcntl.h>
+#include <sys/select.h>
+#include <sys/time.h>
 #include <unistd.h>
 
 #include <stdio.h>
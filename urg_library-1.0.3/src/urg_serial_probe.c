@@ -0,0 +1,330 @@
+/*!
+  \file
+  \brief Concurrent identification of serial ports
+
+  All ports are opened non-blocking and multiplexed with poll(), so the
+  probe needs no threads.  There is no Windows implementation.
+*/
+
+#include "urg_serial_probe.h"
+#include "urg_serial_utils.h"
+#include "urg_detect_os.h"
+#include <string.h>
+
+
+#if !defined(URG_WINDOWS_OS)
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+
+enum {
+    MAX_PROBE_PORTS = 32,
+    PROBE_BUFFER_SIZE = 1024,
+    MIN_ATTEMPT_MSEC = 50,
+};
+
+static const long probe_baudrates[] = { 115200, 19200, 38400 };
+
+/* SCIP 1.1 sensors need "SCIP2.0" before they understand "VV". */
+static const char probe_command[] = "SCIP2.0\nVV\n";
+
+
+typedef struct
+{
+    int fd;
+    int baudrate_index;
+    long attempt_deadline;
+    int filled;
+    char buffer[PROBE_BUFFER_SIZE];
+} probe_state_t;
+
+
+static long monotonic_msec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+
+static speed_t speed_for_baudrate(long baudrate)
+{
+    switch (baudrate) {
+    case 19200:
+        return B19200;
+    case 38400:
+        return B38400;
+    default:
+        return B115200;
+    }
+}
+
+
+static int open_port(const char *device)
+{
+    struct termios sio;
+    int fd;
+
+#ifndef URG_MAC_OS
+    enum { O_EXLOCK = 0x0 };
+#endif
+    fd = open(device, O_RDWR | O_EXLOCK | O_NONBLOCK | O_NOCTTY);
+    if (fd < 0) {
+        return -1;
+    }
+    fcntl(fd, F_SETFD, fcntl(fd, F_GETFD) | FD_CLOEXEC);
+
+    if (tcgetattr(fd, &sio) < 0) {
+        close(fd);
+        return -1;
+    }
+    sio.c_iflag = 0;
+    sio.c_oflag = 0;
+    sio.c_cflag &= ~(CSIZE | PARENB | CSTOPB);
+    sio.c_cflag |= CS8 | CREAD | CLOCAL;
+    sio.c_lflag &= ~(ICANON | ECHO | ISIG | IEXTEN);
+    sio.c_cc[VMIN] = 0;
+    sio.c_cc[VTIME] = 0;
+    if (tcsetattr(fd, TCSANOW, &sio) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+
+/*
+  Switches to the next baud rate and sends the probe.
+  Returns 0 when there is no baud rate left to try.
+*/
+static int start_attempt(probe_state_t *state, long now, long attempt_msec)
+{
+    struct termios sio;
+    speed_t speed;
+
+    if (state->baudrate_index >= (int)(sizeof(probe_baudrates) / sizeof(probe_baudrates[0]))) {
+        return 0;
+    }
+
+    speed = speed_for_baudrate(probe_baudrates[state->baudrate_index]);
+    if (tcgetattr(state->fd, &sio) == 0) {
+        cfsetospeed(&sio, speed);
+        cfsetispeed(&sio, speed);
+        tcsetattr(state->fd, TCSANOW, &sio);
+    }
+    tcflush(state->fd, TCIOFLUSH);
+    state->filled = 0;
+    state->attempt_deadline = now + attempt_msec;
+
+    if (write(state->fd, probe_command, sizeof(probe_command) - 1) < 0
+        && errno != EAGAIN) {
+        /* This baud rate is hopeless; the deadline will move us on. */
+        state->attempt_deadline = now;
+    }
+    return 1;
+}
+
+
+static void copy_field(char *dest, const char *value, int length)
+{
+    if (length >= URG_SERIAL_PROBE_FIELD_SIZE) {
+        length = URG_SERIAL_PROBE_FIELD_SIZE - 1;
+    }
+    memcpy(dest, value, length);
+    dest[length] = '\0';
+}
+
+
+/*
+  Looks for a complete VV response in the buffer:
+  "VV\n" "00P\n" then "KEY:value;c\n" lines and an empty line.
+  Returns 1 and fills in result when one is found.
+*/
+static int parse_vv_response(const char *buffer, int filled,
+                             urg_serial_probe_t *result)
+{
+    const char *end = buffer + filled;
+    const char *p = buffer;
+
+    for (; p + 3 <= end; ++p) {
+        const char *line;
+        const char *response_end;
+
+        if ((p != buffer && p[-1] != '\n') || memcmp(p, "VV\n", 3) != 0) {
+            continue;
+        }
+
+        response_end = NULL;
+        for (line = p; line + 1 < end; ++line) {
+            if (line[0] == '\n' && line[1] == '\n') {
+                response_end = line + 1;
+                break;
+            }
+        }
+        if (!response_end) {
+            return 0;
+        }
+
+        /* The status line must be "00" plus a checksum character. */
+        line = p + 3;
+        if (response_end - line < 4 || memcmp(line, "00", 2) != 0) {
+            return 0;
+        }
+        line = (const char *)memchr(line, '\n', response_end - line) + 1;
+
+        while (line < response_end) {
+            const char *line_end = memchr(line, '\n', response_end - line + 1);
+            const char *colon = memchr(line, ':', line_end - line);
+            const char *semicolon = line_end;
+            while (semicolon > line && *semicolon != ';') {
+                --semicolon;
+            }
+            if (colon && semicolon > colon) {
+                const char *value = colon + 1;
+                int key_length = (int)(colon - line);
+                int value_length = (int)(semicolon - value);
+                if (key_length == 4 && !memcmp(line, "VEND", 4)) {
+                    copy_field(result->vendor, value, value_length);
+                } else if (key_length == 4 && !memcmp(line, "PROD", 4)) {
+                    copy_field(result->product, value, value_length);
+                } else if (key_length == 4 && !memcmp(line, "FIRM", 4)) {
+                    copy_field(result->firmware, value, value_length);
+                } else if (key_length == 4 && !memcmp(line, "PROT", 4)) {
+                    copy_field(result->protocol, value, value_length);
+                } else if (key_length == 4 && !memcmp(line, "SERI", 4)) {
+                    copy_field(result->serial_id, value, value_length);
+                }
+            }
+            line = line_end + 1;
+        }
+        return 1;
+    }
+    return 0;
+}
+
+
+static void finish_port(probe_state_t *state)
+{
+    if (state->fd >= 0) {
+        close(state->fd);
+        state->fd = -1;
+    }
+}
+
+
+int urg_serial_probe_ports(urg_serial_probe_t *results,
+                           int max_results, int timeout_msec)
+{
+    probe_state_t states[MAX_PROBE_PORTS];
+    struct pollfd fds[MAX_PROBE_PORTS];
+    int indexes[MAX_PROBE_PORTS];
+    int n = urg_serial_find_port();
+    long now = monotonic_msec();
+    long deadline = now + timeout_msec;
+    long attempt_msec = timeout_msec /
+        (long)(sizeof(probe_baudrates) / sizeof(probe_baudrates[0]));
+    int i;
+
+    if (attempt_msec < MIN_ATTEMPT_MSEC) {
+        attempt_msec = MIN_ATTEMPT_MSEC;
+    }
+    if (n > max_results) {
+        n = max_results;
+    }
+    if (n > MAX_PROBE_PORTS) {
+        n = MAX_PROBE_PORTS;
+    }
+
+    for (i = 0; i < n; ++i) {
+        urg_serial_probe_t *result = &results[i];
+        memset(result, 0, sizeof(*result));
+        snprintf(result->port, URG_SERIAL_PROBE_NAME_SIZE, "%s",
+                 urg_serial_port_name(i));
+
+        states[i].baudrate_index = 0;
+        states[i].fd = open_port(result->port);
+        if (states[i].fd >= 0 && !start_attempt(&states[i], now, attempt_msec)) {
+            finish_port(&states[i]);
+        }
+    }
+
+    while (1) {
+        int active = 0;
+        long wait_until = deadline;
+
+        for (i = 0; i < n; ++i) {
+            if (states[i].fd < 0) {
+                continue;
+            }
+            fds[active].fd = states[i].fd;
+            fds[active].events = POLLIN;
+            fds[active].revents = 0;
+            indexes[active] = i;
+            ++active;
+            if (states[i].attempt_deadline < wait_until) {
+                wait_until = states[i].attempt_deadline;
+            }
+        }
+        if (active == 0 || now >= deadline) {
+            break;
+        }
+
+        if (poll(fds, active, wait_until > now ? (int)(wait_until - now) : 0) < 0
+            && errno != EINTR) {
+            break;
+        }
+        now = monotonic_msec();
+
+        for (i = 0; i < active; ++i) {
+            probe_state_t *state = &states[indexes[i]];
+            urg_serial_probe_t *result = &results[indexes[i]];
+
+            if (fds[i].revents & (POLLERR | POLLHUP | POLLNVAL)) {
+                finish_port(state);
+                continue;
+            }
+            if (fds[i].revents & POLLIN) {
+                int space = PROBE_BUFFER_SIZE - state->filled;
+                ssize_t n_read;
+                if (space == 0) {
+                    /* Keep the newest half; a VV response is much shorter. */
+                    memmove(state->buffer,
+                            state->buffer + PROBE_BUFFER_SIZE / 2,
+                            PROBE_BUFFER_SIZE / 2);
+                    state->filled = PROBE_BUFFER_SIZE / 2;
+                    space = PROBE_BUFFER_SIZE / 2;
+                }
+                n_read = read(state->fd, state->buffer + state->filled, space);
+                if (n_read > 0) {
+                    state->filled += (int)n_read;
+                    if (parse_vv_response(state->buffer, state->filled, result)) {
+                        result->is_urg = 1;
+                        result->baudrate =
+                            probe_baudrates[state->baudrate_index];
+                        finish_port(state);
+                        continue;
+                    }
+                }
+            }
+            if (now >= state->attempt_deadline) {
+                ++state->baudrate_index;
+                if (!start_attempt(state, now, attempt_msec)) {
+                    finish_port(state);
+                }
+            }
+        }
+    }
+
+    for (i = 0; i < n; ++i) {
+        finish_port(&states[i]);
+    }
+    return n;
+}
+
+#endif